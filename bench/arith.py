@@ -0,0 +1,23 @@
+#
+# arith.py
+#
+# benchmark: int and real arithmetic in nested while loops
+#
+total = 0
+x = 0.5
+i = 0
+while i < 1500:
+{
+  j = 0
+  while j < 500:
+  {
+    k = i * j
+    k = k % 97
+    total = total + k
+    x = x * 1.0000001
+    j = j + 1
+  }
+  i = i + 1
+}
+print(total)
+print(x)
@@ -0,0 +1,317 @@
+/*bench.c*/
+
+//
+// Benchmark harness for the nuPython interpreter: runs each
+// workload a number of times with --phase-stats=json, and reports
+// the median and 95th percentile wall time, the peak resident set
+// size and the median time of each phase, as a table on stdout and
+// optionally as JSON. Given a baseline written by an earlier run,
+// a workload whose median is slower by more than the threshold is
+// a regression, and the exit status is 1.
+//
+// usage: bench_out [options] interpreter workload.py ...
+//
+// options:
+//   --runs=N          runs per workload (default: 5)
+//   --json=FILE       write the results as JSON to FILE
+//   --baseline=FILE   compare medians with the JSON in FILE
+//   --threshold=PCT   % slower than the baseline that counts as
+//                     a regression (default: 10)
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>      // true, false
+#include <string.h>
+
+#include "run.h"
+
+
+struct BENCH_RESULT
+{
+  char name[64];          // the workload's file name, without .py
+  double median_ms;
+  double p95_ms;
+  long max_rss_kb;
+
+  int num_phases;
+  char phase_names[BENCH_MAX_PHASES][16];
+  double phase_ms[BENCH_MAX_PHASES];  // median of each
+};
+
+
+//
+// Private functions:
+//
+
+//Returns where result keeps the named phase, adding it if new;
+// -1 if there's no room
+static int result_phase(struct BENCH_RESULT* result, const char* name);
+
+//Returns the given percentile (0..100) of the n sorted values
+static double percentile(const double sorted[], int n, double p);
+
+//Orders doubles, smallest first, for qsort
+static int compare_doubles(const void* a, const void* b);
+
+//Returns the median_ms the baseline gives the named workload, or
+// a negative number if it gives none
+static double baseline_median(const char* baseline, const char* name);
+
+//Reads the whole file; returns NULL if it can't be read
+static char* read_file(const char* path);
+
+//Writes the results as JSON to the given file; returns true if
+// written
+static bool write_json(const char* path, struct BENCH_RESULT results[], int n, int runs);
+
+
+//
+// main
+//
+int main(int argc, char* argv[])
+{
+  int runs = 5;
+  double threshold = 10.0;
+  const char* json_path = NULL;
+  const char* baseline_path = NULL;
+  int first = 1;
+
+  for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+    if (strncmp(argv[first], "--runs=", 7) == 0)
+      runs = atoi(argv[first] + 7);
+    else if (strncmp(argv[first], "--json=", 7) == 0)
+      json_path = argv[first] + 7;
+    else if (strncmp(argv[first], "--baseline=", 11) == 0)
+      baseline_path = argv[first] + 11;
+    else if (strncmp(argv[first], "--threshold=", 12) == 0)
+      threshold = atof(argv[first] + 12);
+    else {
+      fprintf(stderr, "**ERROR: unknown option '%s'.\n", argv[first]);
+      return 2;
+    }
+  }
+
+  if (runs <= 0 || argc - first < 2) {
+    fprintf(stderr, "usage: %s [--runs=N] [--json=FILE] [--baseline=FILE] [--threshold=PCT] interpreter workload.py ...\n", argv[0]);
+    return 2;
+  }
+
+  const char* interpreter = argv[first];
+  int num_workloads = argc - first - 1;
+
+  char* baseline = NULL;
+  if (baseline_path != NULL) {
+    baseline = read_file(baseline_path);
+    if (baseline == NULL)
+      fprintf(stderr, "**no baseline at '%s', nothing to compare with\n", baseline_path);
+  }
+
+  struct BENCH_RESULT* results = (struct BENCH_RESULT*) calloc(num_workloads, sizeof(struct BENCH_RESULT));
+  double* walls = (double*) malloc(runs * sizeof(double));
+  double* phases = (double*) malloc((size_t) runs * BENCH_MAX_PHASES * sizeof(double));  // [phase][run]
+  if (results == NULL || walls == NULL || phases == NULL) {
+    fprintf(stderr, "**OUT OF MEMORY (bench)\n");
+    return 2;
+  }
+
+  printf("%-12s %10s %10s %10s %10s %8s  %s\n", "workload", "median ms", "p95 ms", "peak KB", "baseline", "change", "phases (median ms)");
+
+  int regressions = 0;
+  int failures = 0;
+
+  for (int w = 0; w < num_workloads; w++) {
+    const char* workload = argv[first + 1 + w];
+    struct BENCH_RESULT* result = &results[w];
+
+    const char* base = strrchr(workload, '/');
+    base = (base != NULL) ? base + 1 : workload;
+    snprintf(result->name, sizeof(result->name), "%.*s", (int) strcspn(base, "."), base);
+
+    bool ok = true;
+    for (int r = 0; r < runs && ok; r++) {
+      struct BENCH_RUN run;
+      ok = bench_run(interpreter, workload, &run);
+      if (!ok)
+        break;
+
+      walls[r] = run.wall_ms;
+      if (run.rss_kb > result->max_rss_kb)
+        result->max_rss_kb = run.rss_kb;
+
+      for (int p = 0; p < BENCH_MAX_PHASES; p++)
+        phases[p * runs + r] = 0.0;
+      for (int p = 0; p < run.num_phases; p++) {
+        int at = result_phase(result, run.phase_names[p]);
+        if (at >= 0)
+          phases[at * runs + r] = run.phase_ms[p];
+      }
+    }
+
+    if (!ok) {
+      printf("%-12s failed, see the output above\n", result->name);
+      failures++;
+      continue;
+    }
+
+    qsort(walls, runs, sizeof(double), compare_doubles);
+    result->median_ms = percentile(walls, runs, 50.0);
+    result->p95_ms = percentile(walls, runs, 95.0);
+
+    for (int p = 0; p < result->num_phases; p++) {
+      qsort(&phases[p * runs], runs, sizeof(double), compare_doubles);
+      result->phase_ms[p] = percentile(&phases[p * runs], runs, 50.0);
+    }
+
+    //
+    // compare with the baseline, if it has this workload:
+    //
+    double before = (baseline != NULL) ? baseline_median(baseline, result->name) : -1.0;
+    char change[32] = "-";
+    char was[32] = "-";
+    bool regressed = false;
+
+    if (before > 0.0) {
+      double pct = 100.0 * (result->median_ms - before) / before;
+      regressed = pct > threshold;
+      snprintf(was, sizeof(was), "%.1f", before);
+      snprintf(change, sizeof(change), "%+.1f%%", pct);
+    }
+
+    printf("%-12s %10.1f %10.1f %10ld %10s %8s ", result->name, result->median_ms, result->p95_ms,
+           result->max_rss_kb, was, change);
+    for (int p = 0; p < result->num_phases; p++)
+      printf(" %s=%.1f", result->phase_names[p], result->phase_ms[p]);
+    printf("%s\n", regressed ? "  REGRESSION" : "");
+
+    if (regressed)
+      regressions++;
+  }
+
+  if (json_path != NULL) {
+    if (write_json(json_path, results, num_workloads, runs))
+      printf("**wrote results to '%s'\n", json_path);
+    else {
+      fprintf(stderr, "**ERROR: unable to write results to '%s'.\n", json_path);
+      failures++;
+    }
+  }
+
+  if (regressions > 0)
+    printf("**%d workload(s) more than %.0f%% slower than the baseline\n", regressions, threshold);
+
+  free(baseline);
+  free(results);
+  free(walls);
+  free(phases);
+
+  return (regressions > 0 || failures > 0) ? 1 : 0;
+}
+
+
+//
+// Private functions:
+//
+
+static int result_phase(struct BENCH_RESULT* result, const char* name)
+{
+  for (int p = 0; p < result->num_phases; p++) {
+    if (strcmp(result->phase_names[p], name) == 0)
+      return p;
+  }
+
+  if (result->num_phases == BENCH_MAX_PHASES)
+    return -1;
+
+  snprintf(result->phase_names[result->num_phases], sizeof(result->phase_names[0]), "%s", name);
+  return result->num_phases++;
+}
+
+static double percentile(const double sorted[], int n, double p)
+{
+  if (p == 50.0 && n % 2 == 0)
+    return (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+
+  //
+  // nearest rank:
+  //
+  int rank = (int) ((p / 100.0) * n + 0.999999);
+  if (rank < 1)
+    rank = 1;
+  if (rank > n)
+    rank = n;
+  return sorted[rank - 1];
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+  double x = *(const double*) a;
+  double y = *(const double*) b;
+
+  return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static double baseline_median(const char* baseline, const char* name)
+{
+  char key[96];
+  snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+
+  const char* at = strstr(baseline, key);
+  if (at == NULL)
+    return -1.0;
+
+  at = strstr(at, "\"median_ms\": ");
+  if (at == NULL)
+    return -1.0;
+
+  return strtod(at + strlen("\"median_ms\": "), NULL);
+}
+
+static char* read_file(const char* path)
+{
+  FILE* in = fopen(path, "rb");
+  if (in == NULL)
+    return NULL;
+
+  fseek(in, 0, SEEK_END);
+  long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+
+  char* text = (size >= 0) ? (char*) malloc(size + 1) : NULL;
+  if (text != NULL) {
+    size_t got = fread(text, 1, size, in);
+    text[got] = '\0';
+  }
+
+  fclose(in);
+  return text;
+}
+
+static bool write_json(const char* path, struct BENCH_RESULT results[], int n, int runs)
+{
+  FILE* out = fopen(path, "w");
+  if (out == NULL)
+    return false;
+
+  fprintf(out, "{\"runs\": %d, \"workloads\": [", runs);
+
+  bool first = true;
+  for (int w = 0; w < n; w++) {
+    struct BENCH_RESULT* result = &results[w];
+    if (result->median_ms <= 0.0)
+      continue;  // failed
+
+    fprintf(out, "%s\n  {\"name\": \"%s\", \"median_ms\": %.3f, \"p95_ms\": %.3f, \"max_rss_kb\": %ld, \"phases\": {",
+            first ? "" : ",", result->name, result->median_ms, result->p95_ms, result->max_rss_kb);
+    for (int p = 0; p < result->num_phases; p++)
+      fprintf(out, "%s\"%s\": %.3f", (p > 0) ? ", " : "", result->phase_names[p], result->phase_ms[p]);
+    fprintf(out, "}}");
+
+    first = false;
+  }
+
+  fprintf(out, "\n]}\n");
+
+  return fclose(out) == 0;
+}
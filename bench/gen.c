@@ -0,0 +1,321 @@
+/*gen.c*/
+
+//
+// Generates valid nuPython programs of a given size, for testing
+// how the front end and the interpreter scale. The program first
+// assigns every variable, then repeats a few top-level statements
+// followed by a nest of while loops, until it has about --lines
+// lines. Each loop runs --iterations times with its own counter, so
+// the program always ends. Statements are drawn from a mix of int
+// arithmetic, real arithmetic, string concatenation and print().
+// Expressions have at most one operator, as the parser requires.
+// String concatenations only read variables that are never written
+// again, so strings can't keep growing inside loops.
+//
+// usage: gen_out [options] > program.py
+//
+// options:
+//   --lines=N         about how many lines to write, up to 10M
+//                     (default: 1000)
+//   --vars=N          # of variables (default: 100)
+//   --depth=N         loop nesting depth, 0 for straight-line code
+//                     (default: 2)
+//   --body=N          statements in each loop (default: 8)
+//   --iterations=N    times each loop runs (default: 3)
+//   --str-bytes=N     length of string literals (default: 16)
+//   --mix=I,R,S,P     relative weights of int, real, string and
+//                     print statements (default: 60,20,15,5)
+//   --seed=N          seed for the choices made (default: 1)
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+
+
+#define GEN_MAX_LINES 10000000LL
+
+enum GEN_KINDS
+{
+  GEN_INT = 0,
+  GEN_REAL,
+  GEN_STR,
+  GEN_PRINT,
+  GEN_NUM_KINDS
+};
+
+struct GEN
+{
+  long long lines;        // written so far
+  long long max_lines;
+  int depth;
+  int body;
+  int iterations;
+  int str_bytes;
+  int weights[GEN_NUM_KINDS];
+  int total_weight;
+  unsigned long long state;
+
+  int num_ints;           // i0, i1, ...
+  int num_reals;          // r0, r1, ...
+  int num_strs;           // s0, s1, ... written by statements
+  int num_consts;         // k0, k1, ... strings only read
+
+  char* literal;          // str_bytes characters
+};
+
+
+//
+// Private functions:
+//
+
+//Returns a pseudo-random number in 0..n-1, xorshift64
+static int pick(struct GEN* gen, int n);
+
+//Writes the given number of indents, 2 spaces each
+static void indent(struct GEN* gen, int level);
+
+//Writes a fresh string literal, with quotes
+static void literal(struct GEN* gen);
+
+//Writes one statement of a kind drawn from the mix
+static void statement(struct GEN* gen, int level);
+
+//Writes a while loop at the given nesting level, and the loops
+// nested in it
+static void loop_nest(struct GEN* gen, int level);
+
+
+//
+// main
+//
+int main(int argc, char* argv[])
+{
+  struct GEN gen;
+  memset(&gen, 0, sizeof(gen));
+  gen.max_lines = 1000;
+  gen.depth = 2;
+  gen.body = 8;
+  gen.iterations = 3;
+  gen.str_bytes = 16;
+  gen.weights[GEN_INT] = 60;
+  gen.weights[GEN_REAL] = 20;
+  gen.weights[GEN_STR] = 15;
+  gen.weights[GEN_PRINT] = 5;
+  gen.state = 1;
+
+  int vars = 100;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--lines=", 8) == 0)
+      gen.max_lines = atoll(argv[i] + 8);
+    else if (strncmp(argv[i], "--vars=", 7) == 0)
+      vars = atoi(argv[i] + 7);
+    else if (strncmp(argv[i], "--depth=", 8) == 0)
+      gen.depth = atoi(argv[i] + 8);
+    else if (strncmp(argv[i], "--body=", 7) == 0)
+      gen.body = atoi(argv[i] + 7);
+    else if (strncmp(argv[i], "--iterations=", 13) == 0)
+      gen.iterations = atoi(argv[i] + 13);
+    else if (strncmp(argv[i], "--str-bytes=", 12) == 0)
+      gen.str_bytes = atoi(argv[i] + 12);
+    else if (strncmp(argv[i], "--mix=", 6) == 0) {
+      if (sscanf(argv[i] + 6, "%d,%d,%d,%d", &gen.weights[GEN_INT], &gen.weights[GEN_REAL],
+                 &gen.weights[GEN_STR], &gen.weights[GEN_PRINT]) != 4) {
+        fprintf(stderr, "**ERROR: --mix expects 4 weights, e.g. --mix=60,20,15,5.\n");
+        return 2;
+      }
+    }
+    else if (strncmp(argv[i], "--seed=", 7) == 0)
+      gen.state = strtoull(argv[i] + 7, NULL, 10);
+    else {
+      fprintf(stderr, "**ERROR: unknown option '%s', see gen.c for usage.\n", argv[i]);
+      return 2;
+    }
+  }
+
+  for (int k = 0; k < GEN_NUM_KINDS; k++) {
+    if (gen.weights[k] < 0)
+      gen.weights[k] = 0;
+    gen.total_weight += gen.weights[k];
+  }
+
+  if (gen.max_lines <= 0 || gen.max_lines > GEN_MAX_LINES || vars < 4 || gen.depth < 0 ||
+      gen.body < 1 || gen.iterations < 1 || gen.str_bytes < 0 || gen.total_weight == 0) {
+    fprintf(stderr, "**ERROR: --lines must be 1..%lld, --vars at least 4, --body and --iterations "
+                    "positive, and some --mix weight positive.\n", GEN_MAX_LINES);
+    return 2;
+  }
+  if (gen.state == 0)
+    gen.state = 1;  // xorshift never leaves 0
+
+  //
+  // the variables are split by the weights of their kinds, with at
+  // least one of each; a third of the strings are only read:
+  //
+  int typed = gen.weights[GEN_INT] + gen.weights[GEN_REAL] + gen.weights[GEN_STR];
+  if (typed == 0)
+    typed = 1;
+  gen.num_reals = 1 + (vars - 4) * gen.weights[GEN_REAL] / typed;
+  int strings = 2 + (vars - 4) * gen.weights[GEN_STR] / typed;
+  gen.num_consts = 1 + strings / 3;
+  gen.num_strs = strings - gen.num_consts;
+  gen.num_ints = vars - gen.num_reals - strings;
+
+  gen.literal = (char*) malloc(gen.str_bytes + 1);
+  if (gen.literal == NULL)
+    return 2;
+
+  static char buffer[1 << 16];
+  setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+
+  printf("#\n# generated by gen_out: about %lld lines, %d variables, loops %d deep\n#\n",
+         gen.max_lines, vars, gen.depth);
+  gen.lines += 3;
+
+  for (int v = 0; v < gen.num_ints; v++, gen.lines++)
+    printf("i%d = %d\n", v, pick(&gen, 1000));
+  for (int v = 0; v < gen.num_reals; v++, gen.lines++)
+    printf("r%d = %d.%d\n", v, pick(&gen, 100), 1 + pick(&gen, 9));
+  for (int v = 0; v < gen.num_consts; v++, gen.lines++) {
+    printf("k%d = ", v);
+    literal(&gen);
+    printf("\n");
+  }
+  for (int v = 0; v < gen.num_strs; v++, gen.lines++)
+    printf("s%d = \"\"\n", v);
+
+  while (gen.lines < gen.max_lines) {
+    for (int s = 0; s < gen.body && gen.lines < gen.max_lines; s++)
+      statement(&gen, 0);
+
+    if (gen.depth > 0 && gen.lines < gen.max_lines)
+      loop_nest(&gen, 0);
+  }
+
+  free(gen.literal);
+  return (fflush(stdout) == 0) ? 0 : 1;
+}
+
+
+//
+// Private functions:
+//
+
+static int pick(struct GEN* gen, int n)
+{
+  unsigned long long x = gen->state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  gen->state = x;
+
+  return (int) ((x >> 16) % (unsigned long long) n);
+}
+
+static void indent(struct GEN* gen, int level)
+{
+  for (int i = 0; i < level; i++)
+    fputs("  ", stdout);
+}
+
+static void literal(struct GEN* gen)
+{
+  for (int c = 0; c < gen->str_bytes; c++)
+    gen->literal[c] = (char) ('a' + pick(gen, 26));
+  gen->literal[gen->str_bytes] = '\0';
+
+  printf("\"%s\"", gen->literal);
+}
+
+static void statement(struct GEN* gen, int level)
+{
+  static const char IntOps[] = { '+', '-', '*' };
+  static const char RealOps[] = { '+', '-', '*' };
+
+  int kind = 0;
+  int choice = pick(gen, gen->total_weight);
+  while (choice >= gen->weights[kind]) {
+    choice -= gen->weights[kind];
+    kind++;
+  }
+
+  indent(gen, level);
+
+  if (kind == GEN_INT) {
+    int target = pick(gen, gen->num_ints);
+
+    if (pick(gen, 4) == 0)  // divide by a literal, never 0
+      printf("i%d = i%d %c %d\n", target, pick(gen, gen->num_ints), pick(gen, 2) ? '/' : '%', 1 + pick(gen, 97));
+    else
+      printf("i%d = i%d %c i%d\n", target, pick(gen, gen->num_ints), IntOps[pick(gen, 3)], pick(gen, gen->num_ints));
+  }
+  else if (kind == GEN_REAL) {
+    int target = pick(gen, gen->num_reals);
+
+    if (pick(gen, 4) == 0)
+      printf("r%d = r%d * 0.5\n", target, pick(gen, gen->num_reals));
+    else
+      printf("r%d = r%d %c r%d\n", target, pick(gen, gen->num_reals), RealOps[pick(gen, 3)], pick(gen, gen->num_reals));
+  }
+  else if (kind == GEN_STR) {
+    int target = pick(gen, gen->num_strs);
+    int form = pick(gen, 4);
+
+    printf("s%d = ", target);
+    if (form == 0) {
+      printf("k%d + ", pick(gen, gen->num_consts));
+      literal(gen);
+    }
+    else if (form == 1) {
+      literal(gen);
+      printf(" + k%d", pick(gen, gen->num_consts));
+    }
+    else if (form == 2)
+      printf("k%d + k%d", pick(gen, gen->num_consts), pick(gen, gen->num_consts));
+    else
+      literal(gen);
+    printf("\n");
+  }
+  else {
+    int form = pick(gen, 3);
+
+    if (form == 0)
+      printf("print(i%d)\n", pick(gen, gen->num_ints));
+    else if (form == 1)
+      printf("print(r%d)\n", pick(gen, gen->num_reals));
+    else
+      printf("print(s%d)\n", pick(gen, gen->num_strs));
+  }
+
+  gen->lines++;
+}
+
+static void loop_nest(struct GEN* gen, int level)
+{
+  indent(gen, level);
+  printf("n%d = 0\n", level);
+  indent(gen, level);
+  printf("while n%d < %d:\n", level, gen->iterations);
+  indent(gen, level);
+  printf("{\n");
+  gen->lines += 3;
+
+  int before = gen->body / 2;
+  for (int s = 0; s < before; s++)
+    statement(gen, level + 1);
+
+  if (level + 1 < gen->depth)
+    loop_nest(gen, level + 1);
+
+  for (int s = before; s < gen->body; s++)
+    statement(gen, level + 1);
+
+  indent(gen, level + 1);
+  printf("n%d = n%d + 1\n", level, level);
+  indent(gen, level);
+  printf("}\n");
+  gen->lines += 2;
+}
@@ -0,0 +1,15 @@
+#
+# print.py
+#
+# benchmark: output-bound, printing ints, reals and strings
+#
+i = 0
+x = 0.25
+while i < 300000:
+{
+  print(i)
+  print(x)
+  print("line of output")
+  x = x + 0.5
+  i = i + 1
+}
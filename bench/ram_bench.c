@@ -0,0 +1,302 @@
+/*ram_bench.c*/
+
+//
+// Microbenchmark for the RAM module (compiler/ram.c): measures the
+// throughput of ram_write_cell_by_name, ram_read_cell_by_name,
+// ram_read_cell_by_addr and ram_get_addr, and of a mix of reads and
+// writes by name, as the number of variables grows from 10 to
+// --max-vars, for int values and for strings of a few sizes. Writes
+// one CSV row per measurement to stdout:
+//
+//   op,vars,str_bytes,read_pct,ops,ns_per_op,mops_per_sec,heap_bytes_per_var,status
+//
+// heap_bytes_per_var is what populating memory allocated, per
+// variable (glibc only, empty elsewhere). Each measurement stops
+// after --ops operations or --budget-ms milliseconds, whichever
+// comes first, and then says "budget" in status. If populating
+// memory runs out of budget, larger numbers of variables are
+// skipped for that value size.
+//
+// usage: ram_bench_out [--max-vars=N] [--ops=N] [--budget-ms=N]
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <time.h>     // clock_gettime
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>   // mallinfo2
+#define RAM_BENCH_MALLINFO 1
+#else
+#define RAM_BENCH_MALLINFO 0
+#endif
+
+#include "ram.h"
+
+
+//
+// Operations timed at each size:
+//
+enum RAM_BENCH_OPS
+{
+  BENCH_POPULATE = 0,    // first writes by name, i.e. inserts
+  BENCH_WRITE_BY_NAME,   // overwrites
+  BENCH_READ_BY_NAME,
+  BENCH_READ_BY_ADDR,
+  BENCH_GET_ADDR,
+  BENCH_MIXED            // reads and writes by name, read_pct % reads
+};
+
+static const char* OpNames[] = {
+  "populate", "write_by_name", "read_by_name", "read_by_addr", "get_addr", "mixed"
+};
+
+//
+// Value sizes: 0 => int values, else strings of that many bytes:
+//
+static const int StrBytes[] = { 0, 16, 1024 };
+
+//
+// Read percentages of the mixed workload:
+//
+static const int ReadPcts[] = { 10, 50, 90 };
+
+struct RAM_BENCH
+{
+  long long max_ops;
+  double budget_ns;
+  char** names;          // "v0", "v1", ...
+  char* text;            // str_bytes of 'x'
+};
+
+
+//
+// Private functions:
+//
+
+//Returns the monotonic clock in nanoseconds
+static double now_ns(void);
+
+//Returns the next pseudo-random number, xorshift64
+static unsigned long long next_random(unsigned long long* state);
+
+//Returns the bytes malloc has handed out, 0 if unknown
+static long long heap_in_use(void);
+
+//Fills in the value to write: an int, or the bench's string
+static struct RAM_VALUE make_value(struct RAM_BENCH* bench, int str_bytes, int i);
+
+//Times op on memory holding vars variables, writing one row;
+// returns false if the budget ran out first
+static bool measure(struct RAM_BENCH* bench, struct RAM* memory, int op, int vars, int str_bytes, int read_pct);
+
+//Writes one CSV row
+static void write_row(int op, int vars, int str_bytes, int read_pct, long long ops, double ns,
+                      long long heap_per_var, bool finished);
+
+
+//
+// main
+//
+int main(int argc, char* argv[])
+{
+  int max_vars = 1000000;
+  struct RAM_BENCH bench;
+  bench.max_ops = 100000;
+  bench.budget_ns = 1000.0 * 1e6;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--max-vars=", 11) == 0)
+      max_vars = atoi(argv[i] + 11);
+    else if (strncmp(argv[i], "--ops=", 6) == 0)
+      bench.max_ops = atoll(argv[i] + 6);
+    else if (strncmp(argv[i], "--budget-ms=", 12) == 0)
+      bench.budget_ns = atof(argv[i] + 12) * 1e6;
+    else {
+      fprintf(stderr, "usage: %s [--max-vars=N] [--ops=N] [--budget-ms=N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (max_vars < 10 || bench.max_ops <= 0 || bench.budget_ns <= 0.0) {
+    fprintf(stderr, "**ERROR: --max-vars must be at least 10, --ops and --budget-ms positive.\n");
+    return 2;
+  }
+
+  bench.names = (char**) malloc(max_vars * sizeof(char*));
+  bench.text = (char*) malloc(StrBytes[sizeof(StrBytes) / sizeof(StrBytes[0]) - 1] + 1);
+  if (bench.names == NULL || bench.text == NULL) {
+    fprintf(stderr, "**OUT OF MEMORY (ram_bench)\n");
+    return 2;
+  }
+  for (int i = 0; i < max_vars; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "v%d", i);
+    bench.names[i] = (char*) malloc(strlen(name) + 1);
+    if (bench.names[i] == NULL) {
+      fprintf(stderr, "**OUT OF MEMORY (ram_bench)\n");
+      return 2;
+    }
+    strcpy(bench.names[i], name);
+  }
+
+  printf("op,vars,str_bytes,read_pct,ops,ns_per_op,mops_per_sec,heap_bytes_per_var,status\n");
+
+  for (size_t s = 0; s < sizeof(StrBytes) / sizeof(StrBytes[0]); s++) {
+    int str_bytes = StrBytes[s];
+    memset(bench.text, 'x', str_bytes);
+    bench.text[str_bytes] = '\0';
+
+    for (long long vars = 10; vars <= max_vars; vars *= 10) {
+      struct RAM* memory = ram_init();
+      if (memory == NULL)
+        return 2;
+
+      if (!measure(&bench, memory, BENCH_POPULATE, (int) vars, str_bytes, 0)) {
+        fprintf(stderr, "**populating %lld variables of %d bytes ran out of budget, skipping larger sizes\n",
+                vars, str_bytes);
+        ram_destroy(memory);
+        break;
+      }
+
+      measure(&bench, memory, BENCH_WRITE_BY_NAME, (int) vars, str_bytes, 0);
+      measure(&bench, memory, BENCH_READ_BY_NAME, (int) vars, str_bytes, 100);
+      measure(&bench, memory, BENCH_READ_BY_ADDR, (int) vars, str_bytes, 100);
+      measure(&bench, memory, BENCH_GET_ADDR, (int) vars, str_bytes, 100);
+      for (size_t r = 0; r < sizeof(ReadPcts) / sizeof(ReadPcts[0]); r++)
+        measure(&bench, memory, BENCH_MIXED, (int) vars, str_bytes, ReadPcts[r]);
+
+      ram_destroy(memory);
+      fflush(stdout);
+    }
+  }
+
+  for (int i = 0; i < max_vars; i++)
+    free(bench.names[i]);
+  free(bench.names);
+  free(bench.text);
+
+  return 0;
+}
+
+
+//
+// Private functions:
+//
+
+static double now_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec * 1e9 + (double) now.tv_nsec;
+}
+
+static unsigned long long next_random(unsigned long long* state)
+{
+  unsigned long long x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+static long long heap_in_use(void)
+{
+#if RAM_BENCH_MALLINFO
+  struct mallinfo2 info = mallinfo2();
+  return (long long) (info.uordblks + info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+static struct RAM_VALUE make_value(struct RAM_BENCH* bench, int str_bytes, int i)
+{
+  struct RAM_VALUE value;
+
+  if (str_bytes == 0) {
+    value.value_type = RAM_TYPE_INT;
+    value.types.i = i;
+  }
+  else {
+    value.value_type = RAM_TYPE_STR;
+    value.types.s = bench->text;  // ram duplicates it
+  }
+  return value;
+}
+
+static bool measure(struct RAM_BENCH* bench, struct RAM* memory, int op, int vars, int str_bytes, int read_pct)
+{
+  //
+  // populating writes each name once, in order; the rest pick
+  // variables at random, the same sequence every run:
+  //
+  long long max_ops = (op == BENCH_POPULATE) ? vars : bench->max_ops;
+  unsigned long long state = 0x9E3779B97F4A7C15ull ^ (unsigned long long) (op * 131 + vars);
+  long long heap_before = heap_in_use();
+  long long ops = 0;
+  bool finished = true;
+  volatile int sink = 0;  // keeps reads from being optimized away
+
+  double start = now_ns();
+
+  for (; ops < max_ops; ops++) {
+    //
+    // the clock is only looked at every 64 ops:
+    //
+    if ((ops & 63) == 63 && now_ns() - start > bench->budget_ns) {
+      finished = false;
+      break;
+    }
+
+    unsigned long long random = next_random(&state);
+    int i = (op == BENCH_POPULATE) ? (int) ops : (int) (random % (unsigned long long) vars);
+    int kind = op;
+
+    if (op == BENCH_MIXED)
+      kind = ((int) ((random >> 32) % 100) < read_pct) ? BENCH_READ_BY_NAME : BENCH_WRITE_BY_NAME;
+
+    if (kind == BENCH_POPULATE || kind == BENCH_WRITE_BY_NAME) {
+      ram_write_cell_by_name(memory, make_value(bench, str_bytes, i), bench->names[i]);
+    }
+    else if (kind == BENCH_READ_BY_NAME) {
+      struct RAM_VALUE* value = ram_read_cell_by_name(memory, bench->names[i]);
+      sink += value->value_type;
+      ram_free_value(value);
+    }
+    else if (kind == BENCH_READ_BY_ADDR) {
+      struct RAM_VALUE* value = ram_read_cell_by_addr(memory, i);
+      sink += value->value_type;
+      ram_free_value(value);
+    }
+    else {
+      sink += ram_get_addr(memory, bench->names[i]);
+    }
+  }
+
+  double elapsed = now_ns() - start;
+
+  long long heap_per_var = -1;
+  if (op == BENCH_POPULATE && RAM_BENCH_MALLINFO && ops > 0)
+    heap_per_var = (heap_in_use() - heap_before) / ops;
+
+  write_row(op, vars, str_bytes, read_pct, ops, elapsed, heap_per_var, finished);
+  return finished;
+}
+
+static void write_row(int op, int vars, int str_bytes, int read_pct, long long ops, double ns,
+                      long long heap_per_var, bool finished)
+{
+  double per_op = (ops > 0) ? ns / (double) ops : 0.0;
+  double mops = (ns > 0.0) ? (double) ops * 1e3 / ns : 0.0;
+
+  printf("%s,%d,%d,%d,%lld,%.1f,%.3f,", OpNames[op], vars, str_bytes, read_pct, ops, per_op, mops);
+  if (heap_per_var >= 0)
+    printf("%lld", heap_per_var);
+  printf(",%s\n", finished ? "ok" : "budget");
+}
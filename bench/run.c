@@ -0,0 +1,184 @@
+/*run.c*/
+
+//
+// Runs the interpreter on one program for the benchmarks: fork and
+// exec it with stderr on a pipe, read the --phase-stats JSON that
+// comes back, and take the peak RSS from wait4(). The prebuilt
+// parser recurses once per statement, so the child gets as much
+// stack as it is allowed.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE   // wait4
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>      // true, false
+#include <string.h>
+#include <time.h>         // clock_gettime
+#include <unistd.h>       // fork, execl, pipe
+#include <fcntl.h>        // open
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h> // struct rusage, setrlimit
+#include <sys/wait.h>     // wait4
+
+#include "run.h"
+
+
+//
+// Private functions:
+//
+
+//Reads the phases out of --phase-stats=json output into run
+static void parse_phases(const char* json, struct BENCH_RUN* run);
+
+
+//
+// Public functions:
+//
+
+//
+// bench_run
+//
+// Runs the interpreter on the program once and measures it.
+//
+bool bench_run(const char* interpreter, const char* program, struct BENCH_RUN* run)
+{
+  memset(run, 0, sizeof(struct BENCH_RUN));
+
+  int err[2];
+  if (pipe(err) != 0)
+    return false;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(err[0]);
+    close(err[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    //
+    // the program's output is discarded, the phase stats come back
+    // through the pipe; --no-cache so every run parses:
+    //
+    int null = open("/dev/null", O_RDWR);
+    dup2(null, 0);
+    dup2(null, 1);
+    dup2(err[1], 2);
+    close(err[0]);
+
+    //
+    // a million-line program overflows the usual 8 MB stack in the
+    // parser; the limit set here is the one the exec'd stack gets:
+    //
+    struct rlimit stack;
+    if (getrlimit(RLIMIT_STACK, &stack) == 0 && stack.rlim_cur != stack.rlim_max) {
+      stack.rlim_cur = stack.rlim_max;
+      setrlimit(RLIMIT_STACK, &stack);
+    }
+
+    execl(interpreter, interpreter, "--no-cache", "--phase-stats=json", program, (char*) NULL);
+    _exit(127);
+  }
+
+  close(err[1]);
+
+  size_t length = 0;
+  size_t capacity = 4096;
+  char* text = (char*) malloc(capacity);
+  ssize_t bytes = 1;
+
+  while (text != NULL && bytes > 0) {
+    if (capacity - length < 1024) {
+      char* bigger = (char*) realloc(text, capacity * 2);
+      if (bigger == NULL) {
+        free(text);
+        text = NULL;
+        break;
+      }
+      text = bigger;
+      capacity *= 2;
+    }
+    bytes = read(err[0], text + length, capacity - length - 1);
+    if (bytes > 0)
+      length += bytes;
+  }
+  close(err[0]);
+
+  int status = 0;
+  struct rusage usage;
+  memset(&usage, 0, sizeof(usage));
+  wait4(pid, &status, 0, &usage);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (text == NULL)
+    return false;
+  text[length] = '\0';
+
+  if (WIFSIGNALED(status)) {
+    fprintf(stderr, "**'%s %s' was killed by signal %d (%s):\n%s", interpreter, program,
+            WTERMSIG(status), strsignal(WTERMSIG(status)), text);
+    free(text);
+    return false;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "**'%s %s' failed:\n%s", interpreter, program, text);
+    free(text);
+    return false;
+  }
+
+  run->wall_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+  run->rss_kb = usage.ru_maxrss;  // kilobytes on Linux
+  parse_phases(text, run);
+
+  free(text);
+  return true;
+}
+
+//
+// bench_phase
+//
+// Returns the time of the named phase, 0 if none.
+//
+double bench_phase(const struct BENCH_RUN* run, const char* name)
+{
+  for (int p = 0; p < run->num_phases; p++) {
+    if (strcmp(run->phase_names[p], name) == 0)
+      return run->phase_ms[p];
+  }
+  return 0.0;
+}
+
+
+//
+// Private functions:
+//
+
+static void parse_phases(const char* json, struct BENCH_RUN* run)
+{
+  //
+  // each phase is {"name": "parse", "ms": 0.615, ...}:
+  //
+  const char* at = strstr(json, "{\"counters\":");
+
+  while (at != NULL && run->num_phases < BENCH_MAX_PHASES && (at = strstr(at, "{\"name\": \"")) != NULL) {
+    at += strlen("{\"name\": \"");
+    int length = (int) strcspn(at, "\"");
+
+    const char* ms = strstr(at, "\"ms\": ");
+    if (ms == NULL)
+      return;
+
+    int p = run->num_phases++;
+    snprintf(run->phase_names[p], sizeof(run->phase_names[p]), "%.*s", length, at);
+    run->phase_ms[p] = strtod(ms + strlen("\"ms\": "), NULL);
+
+    at = ms;
+  }
+}
@@ -0,0 +1,51 @@
+/*run.h*/
+
+//
+// Runs the interpreter on one program for the benchmarks, measuring
+// its wall time, peak memory and the time of each phase as reported
+// by --phase-stats=json.
+
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+//
+// Most phases --phase-stats reports (PHASE_MAX in phase.h):
+//
+#define BENCH_MAX_PHASES 8
+
+struct BENCH_RUN
+{
+  double wall_ms;
+  long rss_kb;            // peak resident set size
+
+  int num_phases;         // in the order they ran
+  char phase_names[BENCH_MAX_PHASES][16];
+  double phase_ms[BENCH_MAX_PHASES];
+};
+
+
+//
+// Public functions:
+//
+
+//
+// bench_run
+//
+// Runs "interpreter --no-cache --phase-stats=json program" with
+// stdin and stdout on /dev/null, so every run parses and the
+// program's output costs nothing to display, and fills in *run.
+// Returns false if the interpreter couldn't be run, failed or
+// crashed, in which case what it wrote to stderr has been passed
+// on, with the signal that killed it.
+//
+bool bench_run(const char* interpreter, const char* program, struct BENCH_RUN* run);
+
+//
+// bench_phase
+//
+// Returns the time of the named phase in run, 0 if it had none.
+//
+double bench_phase(const struct BENCH_RUN* run, const char* name);
@@ -0,0 +1,312 @@
+/*scale.c*/
+
+//
+// Scale test for the nuPython interpreter: generates programs of
+// 1,000, 10,000, ... lines with gen_out, runs each once, and records
+// the parse, build, optimize and execute times and the peak memory
+// against the number of lines. Between two sizes, a measure that
+// grows by more than (lines ratio)^SCALE_SUPERLINEAR is flagged as
+// superlinear, and the exit status is 1. Writes the numbers as CSV
+// and, for gnuplot, a script that plots them on log-log axes.
+//
+// A size whose memory, projected linearly from the size before,
+// wouldn't fit in the memory available is skipped, with the sizes
+// after it. A size the interpreter fails or crashes on is flagged
+// too, and ends the test.
+//
+// NOTE: the parser recurses once per statement, so programs of a
+// few hundred thousand lines need more than the usual 8 MB stack,
+// e.g. "ulimit -s unlimited" before running.
+//
+// usage: scale_out [options] interpreter generator [generator options]
+//
+// options:
+//   --max-lines=N     largest program, up to 10M lines (default: 1M)
+//   --program=FILE    where to write each program (default: scale.py)
+//   --csv=FILE        write the numbers as CSV to FILE
+//   --plot=FILE       write a gnuplot script plotting the CSV to FILE
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE   // _SC_AVPHYS_PAGES
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>      // true, false
+#include <string.h>
+#include <math.h>         // log
+#include <unistd.h>       // fork, execv, sysconf
+#include <fcntl.h>        // open
+#include <sys/types.h>
+#include <sys/wait.h>     // waitpid
+
+#include "run.h"
+
+
+//
+// A measure growing faster than lines^1.25 is superlinear; below the
+// floors it's too small to time or weigh reliably:
+//
+#define SCALE_SUPERLINEAR 1.25
+#define SCALE_FLOOR_MS 20.0
+#define SCALE_FLOOR_KB 20480
+
+#define SCALE_MAX_SIZES 8
+#define SCALE_NUM_MEASURES 6
+
+static const char* Measures[SCALE_NUM_MEASURES] = {
+  "parse", "build", "optimize", "execute", "total", "rss"
+};
+
+struct SCALE_POINT
+{
+  long long lines;
+  double values[SCALE_NUM_MEASURES];  // ms, and KB for rss
+};
+
+
+//
+// Private functions:
+//
+
+//Runs the generator with --lines=lines and its options, writing
+// the program to path; returns true if successful
+static bool generate(const char* generator, char* options[], int num_options, long long lines, const char* path);
+
+//Returns the memory available, in KB
+static long long available_kb(void);
+
+//Writes the points as CSV; returns true if written
+static bool write_csv(const char* path, struct SCALE_POINT points[], int n);
+
+//Writes a gnuplot script for the CSV; returns true if written
+static bool write_plot(const char* path, const char* csv_path);
+
+
+//
+// main
+//
+int main(int argc, char* argv[])
+{
+  long long max_lines = 1000000;
+  const char* program = "scale.py";
+  const char* csv_path = NULL;
+  const char* plot_path = NULL;
+  int first = 1;
+
+  for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+    if (strncmp(argv[first], "--max-lines=", 12) == 0)
+      max_lines = atoll(argv[first] + 12);
+    else if (strncmp(argv[first], "--program=", 10) == 0)
+      program = argv[first] + 10;
+    else if (strncmp(argv[first], "--csv=", 6) == 0)
+      csv_path = argv[first] + 6;
+    else if (strncmp(argv[first], "--plot=", 7) == 0)
+      plot_path = argv[first] + 7;
+    else {
+      fprintf(stderr, "**ERROR: unknown option '%s'.\n", argv[first]);
+      return 2;
+    }
+  }
+
+  if (argc - first < 2 || max_lines < 1000 || max_lines > 10000000) {
+    fprintf(stderr, "usage: %s [--max-lines=N] [--program=FILE] [--csv=FILE] [--plot=FILE] "
+                    "interpreter generator [generator options]\n", argv[0]);
+    return 2;
+  }
+
+  const char* interpreter = argv[first];
+  const char* generator = argv[first + 1];
+  char** options = &argv[first + 2];
+  int num_options = argc - first - 2;
+
+  struct SCALE_POINT points[SCALE_MAX_SIZES];
+  int n = 0;
+  int flagged = 0;
+
+  printf("%10s %10s %10s %10s %10s %10s %10s\n", "lines", "parse ms", "build ms", "optimize ms",
+         "execute ms", "total ms", "peak MB");
+
+  for (long long lines = 1000; lines <= max_lines && n < SCALE_MAX_SIZES; lines *= 10) {
+    if (n > 0) {
+      long long projected = (long long) (points[n - 1].values[5] * (double) lines / (double) points[n - 1].lines);
+      long long available = available_kb();
+
+      if (projected > available) {
+        printf("**skipping %lld lines and up: about %lld MB needed, %lld MB available\n",
+               lines, projected / 1024, available / 1024);
+        break;
+      }
+    }
+
+    if (!generate(generator, options, num_options, lines, program)) {
+      fprintf(stderr, "**ERROR: '%s' couldn't generate %lld lines.\n", generator, lines);
+      return 2;
+    }
+
+    struct BENCH_RUN run;
+    bool ok = bench_run(interpreter, program, &run);
+    remove(program);
+
+    if (!ok) {
+      printf("**FAILED at %lld lines, see the error above\n", lines);
+      flagged++;
+      break;
+    }
+
+    struct SCALE_POINT* point = &points[n];
+    point->lines = lines;
+    point->values[0] = bench_phase(&run, "parse");
+    point->values[1] = bench_phase(&run, "build");
+    point->values[2] = bench_phase(&run, "optimize");
+    point->values[3] = bench_phase(&run, "execute");
+    point->values[4] = run.wall_ms;
+    point->values[5] = (double) run.rss_kb;
+
+    printf("%10lld %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", lines, point->values[0], point->values[1],
+           point->values[2], point->values[3], point->values[4], point->values[5] / 1024.0);
+    fflush(stdout);
+
+    //
+    // growth since the size before: m2 / m1 = (lines2 / lines1)^e
+    //
+    if (n > 0) {
+      struct SCALE_POINT* before = &points[n - 1];
+      double ratio = (double) lines / (double) before->lines;
+
+      for (int m = 0; m < SCALE_NUM_MEASURES; m++) {
+        double floor = (m == 5) ? SCALE_FLOOR_KB : SCALE_FLOOR_MS;
+        if (point->values[m] < floor || before->values[m] <= 0.0)
+          continue;
+
+        double exponent = log(point->values[m] / before->values[m]) / log(ratio);
+        if (exponent > SCALE_SUPERLINEAR) {
+          printf("**SUPERLINEAR: %s grows as lines^%.2f from %lld to %lld lines\n",
+                 Measures[m], exponent, before->lines, lines);
+          flagged++;
+        }
+      }
+    }
+
+    n++;
+  }
+
+  if (csv_path != NULL) {
+    if (write_csv(csv_path, points, n))
+      printf("**wrote '%s'\n", csv_path);
+    else
+      fprintf(stderr, "**ERROR: unable to write '%s'.\n", csv_path);
+  }
+
+  if (plot_path != NULL && csv_path != NULL) {
+    if (write_plot(plot_path, csv_path))
+      printf("**wrote '%s', run gnuplot on it to plot\n", plot_path);
+    else
+      fprintf(stderr, "**ERROR: unable to write '%s'.\n", plot_path);
+  }
+
+  if (flagged > 0)
+    printf("**%d problem(s) found\n", flagged);
+
+  return (flagged > 0) ? 1 : 0;
+}
+
+
+//
+// Private functions:
+//
+
+static bool generate(const char* generator, char* options[], int num_options, long long lines, const char* path)
+{
+  char lines_option[32];
+  snprintf(lines_option, sizeof(lines_option), "--lines=%lld", lines);
+
+  char** args = (char**) malloc((num_options + 3) * sizeof(char*));
+  if (args == NULL)
+    return false;
+
+  args[0] = (char*) generator;
+  args[1] = lines_option;
+  for (int i = 0; i < num_options; i++)
+    args[2 + i] = options[i];
+  args[2 + num_options] = NULL;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+      _exit(127);
+    dup2(out, 1);
+    execv(generator, args);
+    _exit(127);
+  }
+
+  free(args);
+
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid)
+    return false;
+
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static long long available_kb(void)
+{
+  long pages = sysconf(_SC_AVPHYS_PAGES);
+  long size = sysconf(_SC_PAGESIZE);
+
+  if (pages <= 0 || size <= 0)
+    return 0;
+  return (long long) pages * (size / 1024);
+}
+
+static bool write_csv(const char* path, struct SCALE_POINT points[], int n)
+{
+  FILE* out = fopen(path, "w");
+  if (out == NULL)
+    return false;
+
+  fprintf(out, "lines,parse_ms,build_ms,optimize_ms,execute_ms,total_ms,rss_kb\n");
+  for (int i = 0; i < n; i++) {
+    fprintf(out, "%lld,%.3f,%.3f,%.3f,%.3f,%.3f,%.0f\n", points[i].lines, points[i].values[0],
+            points[i].values[1], points[i].values[2], points[i].values[3], points[i].values[4],
+            points[i].values[5]);
+  }
+
+  return fclose(out) == 0;
+}
+
+static bool write_plot(const char* path, const char* csv_path)
+{
+  FILE* out = fopen(path, "w");
+  if (out == NULL)
+    return false;
+
+  //
+  // the PNG goes next to the CSV, with the same name:
+  //
+  int stem = (int) strlen(csv_path);
+  const char* dot = strrchr(csv_path, '.');
+  if (dot != NULL && strchr(dot, '/') == NULL)
+    stem = (int) (dot - csv_path);
+
+  fprintf(out, "# plots %s, written by scale_out\n", csv_path);
+  fprintf(out, "set datafile separator ','\n");
+  fprintf(out, "set terminal png size 1000,800\n");
+  fprintf(out, "set output '%.*s.png'\n", stem, csv_path);
+  fprintf(out, "set logscale xy\n");
+  fprintf(out, "set key left top\n");
+  fprintf(out, "set xlabel 'lines'\n");
+  fprintf(out, "set multiplot layout 2,1\n");
+  fprintf(out, "set ylabel 'ms'\n");
+  fprintf(out, "plot '%s' using 1:2 with linespoints title 'parse', \\\n", csv_path);
+  fprintf(out, "     '' using 1:3 with linespoints title 'build', \\\n");
+  fprintf(out, "     '' using 1:4 with linespoints title 'optimize', \\\n");
+  fprintf(out, "     '' using 1:5 with linespoints title 'execute', \\\n");
+  fprintf(out, "     '' using 1:6 with linespoints title 'total'\n");
+  fprintf(out, "set ylabel 'peak KB'\n");
+  fprintf(out, "plot '%s' using 1:7 with linespoints title 'peak RSS'\n", csv_path);
+  fprintf(out, "unset multiplot\n");
+
+  return fclose(out) == 0;
+}
@@ -0,0 +1,23 @@
+#
+# strings.py
+#
+# benchmark: building strings by concatenation, in lines of 100
+# pieces that are then thrown away
+#
+lines = 0
+chars = 0
+while lines < 20000:
+{
+  line = ""
+  n = 0
+  while n < 100:
+  {
+    piece = "ab" + "c"
+    line = line + piece
+    n = n + 1
+  }
+  chars = chars + 300
+  lines = lines + 1
+}
+print(line)
+print(chars)
@@ -0,0 +1,813 @@
+#
+# variables.py
+#
+# benchmark: 400 variables, all read and written on every pass
+# of the loop, so lookups dominate
+#
+i = 0
+v0 = 0
+v1 = 1
+v2 = 2
+v3 = 3
+v4 = 4
+v5 = 5
+v6 = 6
+v7 = 7
+v8 = 8
+v9 = 9
+v10 = 10
+v11 = 11
+v12 = 12
+v13 = 13
+v14 = 14
+v15 = 15
+v16 = 16
+v17 = 17
+v18 = 18
+v19 = 19
+v20 = 20
+v21 = 21
+v22 = 22
+v23 = 23
+v24 = 24
+v25 = 25
+v26 = 26
+v27 = 27
+v28 = 28
+v29 = 29
+v30 = 30
+v31 = 31
+v32 = 32
+v33 = 33
+v34 = 34
+v35 = 35
+v36 = 36
+v37 = 37
+v38 = 38
+v39 = 39
+v40 = 40
+v41 = 41
+v42 = 42
+v43 = 43
+v44 = 44
+v45 = 45
+v46 = 46
+v47 = 47
+v48 = 48
+v49 = 49
+v50 = 50
+v51 = 51
+v52 = 52
+v53 = 53
+v54 = 54
+v55 = 55
+v56 = 56
+v57 = 57
+v58 = 58
+v59 = 59
+v60 = 60
+v61 = 61
+v62 = 62
+v63 = 63
+v64 = 64
+v65 = 65
+v66 = 66
+v67 = 67
+v68 = 68
+v69 = 69
+v70 = 70
+v71 = 71
+v72 = 72
+v73 = 73
+v74 = 74
+v75 = 75
+v76 = 76
+v77 = 77
+v78 = 78
+v79 = 79
+v80 = 80
+v81 = 81
+v82 = 82
+v83 = 83
+v84 = 84
+v85 = 85
+v86 = 86
+v87 = 87
+v88 = 88
+v89 = 89
+v90 = 90
+v91 = 91
+v92 = 92
+v93 = 93
+v94 = 94
+v95 = 95
+v96 = 96
+v97 = 97
+v98 = 98
+v99 = 99
+v100 = 100
+v101 = 101
+v102 = 102
+v103 = 103
+v104 = 104
+v105 = 105
+v106 = 106
+v107 = 107
+v108 = 108
+v109 = 109
+v110 = 110
+v111 = 111
+v112 = 112
+v113 = 113
+v114 = 114
+v115 = 115
+v116 = 116
+v117 = 117
+v118 = 118
+v119 = 119
+v120 = 120
+v121 = 121
+v122 = 122
+v123 = 123
+v124 = 124
+v125 = 125
+v126 = 126
+v127 = 127
+v128 = 128
+v129 = 129
+v130 = 130
+v131 = 131
+v132 = 132
+v133 = 133
+v134 = 134
+v135 = 135
+v136 = 136
+v137 = 137
+v138 = 138
+v139 = 139
+v140 = 140
+v141 = 141
+v142 = 142
+v143 = 143
+v144 = 144
+v145 = 145
+v146 = 146
+v147 = 147
+v148 = 148
+v149 = 149
+v150 = 150
+v151 = 151
+v152 = 152
+v153 = 153
+v154 = 154
+v155 = 155
+v156 = 156
+v157 = 157
+v158 = 158
+v159 = 159
+v160 = 160
+v161 = 161
+v162 = 162
+v163 = 163
+v164 = 164
+v165 = 165
+v166 = 166
+v167 = 167
+v168 = 168
+v169 = 169
+v170 = 170
+v171 = 171
+v172 = 172
+v173 = 173
+v174 = 174
+v175 = 175
+v176 = 176
+v177 = 177
+v178 = 178
+v179 = 179
+v180 = 180
+v181 = 181
+v182 = 182
+v183 = 183
+v184 = 184
+v185 = 185
+v186 = 186
+v187 = 187
+v188 = 188
+v189 = 189
+v190 = 190
+v191 = 191
+v192 = 192
+v193 = 193
+v194 = 194
+v195 = 195
+v196 = 196
+v197 = 197
+v198 = 198
+v199 = 199
+v200 = 200
+v201 = 201
+v202 = 202
+v203 = 203
+v204 = 204
+v205 = 205
+v206 = 206
+v207 = 207
+v208 = 208
+v209 = 209
+v210 = 210
+v211 = 211
+v212 = 212
+v213 = 213
+v214 = 214
+v215 = 215
+v216 = 216
+v217 = 217
+v218 = 218
+v219 = 219
+v220 = 220
+v221 = 221
+v222 = 222
+v223 = 223
+v224 = 224
+v225 = 225
+v226 = 226
+v227 = 227
+v228 = 228
+v229 = 229
+v230 = 230
+v231 = 231
+v232 = 232
+v233 = 233
+v234 = 234
+v235 = 235
+v236 = 236
+v237 = 237
+v238 = 238
+v239 = 239
+v240 = 240
+v241 = 241
+v242 = 242
+v243 = 243
+v244 = 244
+v245 = 245
+v246 = 246
+v247 = 247
+v248 = 248
+v249 = 249
+v250 = 250
+v251 = 251
+v252 = 252
+v253 = 253
+v254 = 254
+v255 = 255
+v256 = 256
+v257 = 257
+v258 = 258
+v259 = 259
+v260 = 260
+v261 = 261
+v262 = 262
+v263 = 263
+v264 = 264
+v265 = 265
+v266 = 266
+v267 = 267
+v268 = 268
+v269 = 269
+v270 = 270
+v271 = 271
+v272 = 272
+v273 = 273
+v274 = 274
+v275 = 275
+v276 = 276
+v277 = 277
+v278 = 278
+v279 = 279
+v280 = 280
+v281 = 281
+v282 = 282
+v283 = 283
+v284 = 284
+v285 = 285
+v286 = 286
+v287 = 287
+v288 = 288
+v289 = 289
+v290 = 290
+v291 = 291
+v292 = 292
+v293 = 293
+v294 = 294
+v295 = 295
+v296 = 296
+v297 = 297
+v298 = 298
+v299 = 299
+v300 = 300
+v301 = 301
+v302 = 302
+v303 = 303
+v304 = 304
+v305 = 305
+v306 = 306
+v307 = 307
+v308 = 308
+v309 = 309
+v310 = 310
+v311 = 311
+v312 = 312
+v313 = 313
+v314 = 314
+v315 = 315
+v316 = 316
+v317 = 317
+v318 = 318
+v319 = 319
+v320 = 320
+v321 = 321
+v322 = 322
+v323 = 323
+v324 = 324
+v325 = 325
+v326 = 326
+v327 = 327
+v328 = 328
+v329 = 329
+v330 = 330
+v331 = 331
+v332 = 332
+v333 = 333
+v334 = 334
+v335 = 335
+v336 = 336
+v337 = 337
+v338 = 338
+v339 = 339
+v340 = 340
+v341 = 341
+v342 = 342
+v343 = 343
+v344 = 344
+v345 = 345
+v346 = 346
+v347 = 347
+v348 = 348
+v349 = 349
+v350 = 350
+v351 = 351
+v352 = 352
+v353 = 353
+v354 = 354
+v355 = 355
+v356 = 356
+v357 = 357
+v358 = 358
+v359 = 359
+v360 = 360
+v361 = 361
+v362 = 362
+v363 = 363
+v364 = 364
+v365 = 365
+v366 = 366
+v367 = 367
+v368 = 368
+v369 = 369
+v370 = 370
+v371 = 371
+v372 = 372
+v373 = 373
+v374 = 374
+v375 = 375
+v376 = 376
+v377 = 377
+v378 = 378
+v379 = 379
+v380 = 380
+v381 = 381
+v382 = 382
+v383 = 383
+v384 = 384
+v385 = 385
+v386 = 386
+v387 = 387
+v388 = 388
+v389 = 389
+v390 = 390
+v391 = 391
+v392 = 392
+v393 = 393
+v394 = 394
+v395 = 395
+v396 = 396
+v397 = 397
+v398 = 398
+v399 = 399
+while i < 5000:
+{
+  v0 = v1 + 1
+  v1 = v8 + 2
+  v2 = v15 + 3
+  v3 = v22 + 4
+  v4 = v29 + 5
+  v5 = v36 + 6
+  v6 = v43 + 7
+  v7 = v50 + 8
+  v8 = v57 + 9
+  v9 = v64 + 1
+  v10 = v71 + 2
+  v11 = v78 + 3
+  v12 = v85 + 4
+  v13 = v92 + 5
+  v14 = v99 + 6
+  v15 = v106 + 7
+  v16 = v113 + 8
+  v17 = v120 + 9
+  v18 = v127 + 1
+  v19 = v134 + 2
+  v20 = v141 + 3
+  v21 = v148 + 4
+  v22 = v155 + 5
+  v23 = v162 + 6
+  v24 = v169 + 7
+  v25 = v176 + 8
+  v26 = v183 + 9
+  v27 = v190 + 1
+  v28 = v197 + 2
+  v29 = v204 + 3
+  v30 = v211 + 4
+  v31 = v218 + 5
+  v32 = v225 + 6
+  v33 = v232 + 7
+  v34 = v239 + 8
+  v35 = v246 + 9
+  v36 = v253 + 1
+  v37 = v260 + 2
+  v38 = v267 + 3
+  v39 = v274 + 4
+  v40 = v281 + 5
+  v41 = v288 + 6
+  v42 = v295 + 7
+  v43 = v302 + 8
+  v44 = v309 + 9
+  v45 = v316 + 1
+  v46 = v323 + 2
+  v47 = v330 + 3
+  v48 = v337 + 4
+  v49 = v344 + 5
+  v50 = v351 + 6
+  v51 = v358 + 7
+  v52 = v365 + 8
+  v53 = v372 + 9
+  v54 = v379 + 1
+  v55 = v386 + 2
+  v56 = v393 + 3
+  v57 = v0 + 4
+  v58 = v7 + 5
+  v59 = v14 + 6
+  v60 = v21 + 7
+  v61 = v28 + 8
+  v62 = v35 + 9
+  v63 = v42 + 1
+  v64 = v49 + 2
+  v65 = v56 + 3
+  v66 = v63 + 4
+  v67 = v70 + 5
+  v68 = v77 + 6
+  v69 = v84 + 7
+  v70 = v91 + 8
+  v71 = v98 + 9
+  v72 = v105 + 1
+  v73 = v112 + 2
+  v74 = v119 + 3
+  v75 = v126 + 4
+  v76 = v133 + 5
+  v77 = v140 + 6
+  v78 = v147 + 7
+  v79 = v154 + 8
+  v80 = v161 + 9
+  v81 = v168 + 1
+  v82 = v175 + 2
+  v83 = v182 + 3
+  v84 = v189 + 4
+  v85 = v196 + 5
+  v86 = v203 + 6
+  v87 = v210 + 7
+  v88 = v217 + 8
+  v89 = v224 + 9
+  v90 = v231 + 1
+  v91 = v238 + 2
+  v92 = v245 + 3
+  v93 = v252 + 4
+  v94 = v259 + 5
+  v95 = v266 + 6
+  v96 = v273 + 7
+  v97 = v280 + 8
+  v98 = v287 + 9
+  v99 = v294 + 1
+  v100 = v301 + 2
+  v101 = v308 + 3
+  v102 = v315 + 4
+  v103 = v322 + 5
+  v104 = v329 + 6
+  v105 = v336 + 7
+  v106 = v343 + 8
+  v107 = v350 + 9
+  v108 = v357 + 1
+  v109 = v364 + 2
+  v110 = v371 + 3
+  v111 = v378 + 4
+  v112 = v385 + 5
+  v113 = v392 + 6
+  v114 = v399 + 7
+  v115 = v6 + 8
+  v116 = v13 + 9
+  v117 = v20 + 1
+  v118 = v27 + 2
+  v119 = v34 + 3
+  v120 = v41 + 4
+  v121 = v48 + 5
+  v122 = v55 + 6
+  v123 = v62 + 7
+  v124 = v69 + 8
+  v125 = v76 + 9
+  v126 = v83 + 1
+  v127 = v90 + 2
+  v128 = v97 + 3
+  v129 = v104 + 4
+  v130 = v111 + 5
+  v131 = v118 + 6
+  v132 = v125 + 7
+  v133 = v132 + 8
+  v134 = v139 + 9
+  v135 = v146 + 1
+  v136 = v153 + 2
+  v137 = v160 + 3
+  v138 = v167 + 4
+  v139 = v174 + 5
+  v140 = v181 + 6
+  v141 = v188 + 7
+  v142 = v195 + 8
+  v143 = v202 + 9
+  v144 = v209 + 1
+  v145 = v216 + 2
+  v146 = v223 + 3
+  v147 = v230 + 4
+  v148 = v237 + 5
+  v149 = v244 + 6
+  v150 = v251 + 7
+  v151 = v258 + 8
+  v152 = v265 + 9
+  v153 = v272 + 1
+  v154 = v279 + 2
+  v155 = v286 + 3
+  v156 = v293 + 4
+  v157 = v300 + 5
+  v158 = v307 + 6
+  v159 = v314 + 7
+  v160 = v321 + 8
+  v161 = v328 + 9
+  v162 = v335 + 1
+  v163 = v342 + 2
+  v164 = v349 + 3
+  v165 = v356 + 4
+  v166 = v363 + 5
+  v167 = v370 + 6
+  v168 = v377 + 7
+  v169 = v384 + 8
+  v170 = v391 + 9
+  v171 = v398 + 1
+  v172 = v5 + 2
+  v173 = v12 + 3
+  v174 = v19 + 4
+  v175 = v26 + 5
+  v176 = v33 + 6
+  v177 = v40 + 7
+  v178 = v47 + 8
+  v179 = v54 + 9
+  v180 = v61 + 1
+  v181 = v68 + 2
+  v182 = v75 + 3
+  v183 = v82 + 4
+  v184 = v89 + 5
+  v185 = v96 + 6
+  v186 = v103 + 7
+  v187 = v110 + 8
+  v188 = v117 + 9
+  v189 = v124 + 1
+  v190 = v131 + 2
+  v191 = v138 + 3
+  v192 = v145 + 4
+  v193 = v152 + 5
+  v194 = v159 + 6
+  v195 = v166 + 7
+  v196 = v173 + 8
+  v197 = v180 + 9
+  v198 = v187 + 1
+  v199 = v194 + 2
+  v200 = v201 + 3
+  v201 = v208 + 4
+  v202 = v215 + 5
+  v203 = v222 + 6
+  v204 = v229 + 7
+  v205 = v236 + 8
+  v206 = v243 + 9
+  v207 = v250 + 1
+  v208 = v257 + 2
+  v209 = v264 + 3
+  v210 = v271 + 4
+  v211 = v278 + 5
+  v212 = v285 + 6
+  v213 = v292 + 7
+  v214 = v299 + 8
+  v215 = v306 + 9
+  v216 = v313 + 1
+  v217 = v320 + 2
+  v218 = v327 + 3
+  v219 = v334 + 4
+  v220 = v341 + 5
+  v221 = v348 + 6
+  v222 = v355 + 7
+  v223 = v362 + 8
+  v224 = v369 + 9
+  v225 = v376 + 1
+  v226 = v383 + 2
+  v227 = v390 + 3
+  v228 = v397 + 4
+  v229 = v4 + 5
+  v230 = v11 + 6
+  v231 = v18 + 7
+  v232 = v25 + 8
+  v233 = v32 + 9
+  v234 = v39 + 1
+  v235 = v46 + 2
+  v236 = v53 + 3
+  v237 = v60 + 4
+  v238 = v67 + 5
+  v239 = v74 + 6
+  v240 = v81 + 7
+  v241 = v88 + 8
+  v242 = v95 + 9
+  v243 = v102 + 1
+  v244 = v109 + 2
+  v245 = v116 + 3
+  v246 = v123 + 4
+  v247 = v130 + 5
+  v248 = v137 + 6
+  v249 = v144 + 7
+  v250 = v151 + 8
+  v251 = v158 + 9
+  v252 = v165 + 1
+  v253 = v172 + 2
+  v254 = v179 + 3
+  v255 = v186 + 4
+  v256 = v193 + 5
+  v257 = v200 + 6
+  v258 = v207 + 7
+  v259 = v214 + 8
+  v260 = v221 + 9
+  v261 = v228 + 1
+  v262 = v235 + 2
+  v263 = v242 + 3
+  v264 = v249 + 4
+  v265 = v256 + 5
+  v266 = v263 + 6
+  v267 = v270 + 7
+  v268 = v277 + 8
+  v269 = v284 + 9
+  v270 = v291 + 1
+  v271 = v298 + 2
+  v272 = v305 + 3
+  v273 = v312 + 4
+  v274 = v319 + 5
+  v275 = v326 + 6
+  v276 = v333 + 7
+  v277 = v340 + 8
+  v278 = v347 + 9
+  v279 = v354 + 1
+  v280 = v361 + 2
+  v281 = v368 + 3
+  v282 = v375 + 4
+  v283 = v382 + 5
+  v284 = v389 + 6
+  v285 = v396 + 7
+  v286 = v3 + 8
+  v287 = v10 + 9
+  v288 = v17 + 1
+  v289 = v24 + 2
+  v290 = v31 + 3
+  v291 = v38 + 4
+  v292 = v45 + 5
+  v293 = v52 + 6
+  v294 = v59 + 7
+  v295 = v66 + 8
+  v296 = v73 + 9
+  v297 = v80 + 1
+  v298 = v87 + 2
+  v299 = v94 + 3
+  v300 = v101 + 4
+  v301 = v108 + 5
+  v302 = v115 + 6
+  v303 = v122 + 7
+  v304 = v129 + 8
+  v305 = v136 + 9
+  v306 = v143 + 1
+  v307 = v150 + 2
+  v308 = v157 + 3
+  v309 = v164 + 4
+  v310 = v171 + 5
+  v311 = v178 + 6
+  v312 = v185 + 7
+  v313 = v192 + 8
+  v314 = v199 + 9
+  v315 = v206 + 1
+  v316 = v213 + 2
+  v317 = v220 + 3
+  v318 = v227 + 4
+  v319 = v234 + 5
+  v320 = v241 + 6
+  v321 = v248 + 7
+  v322 = v255 + 8
+  v323 = v262 + 9
+  v324 = v269 + 1
+  v325 = v276 + 2
+  v326 = v283 + 3
+  v327 = v290 + 4
+  v328 = v297 + 5
+  v329 = v304 + 6
+  v330 = v311 + 7
+  v331 = v318 + 8
+  v332 = v325 + 9
+  v333 = v332 + 1
+  v334 = v339 + 2
+  v335 = v346 + 3
+  v336 = v353 + 4
+  v337 = v360 + 5
+  v338 = v367 + 6
+  v339 = v374 + 7
+  v340 = v381 + 8
+  v341 = v388 + 9
+  v342 = v395 + 1
+  v343 = v2 + 2
+  v344 = v9 + 3
+  v345 = v16 + 4
+  v346 = v23 + 5
+  v347 = v30 + 6
+  v348 = v37 + 7
+  v349 = v44 + 8
+  v350 = v51 + 9
+  v351 = v58 + 1
+  v352 = v65 + 2
+  v353 = v72 + 3
+  v354 = v79 + 4
+  v355 = v86 + 5
+  v356 = v93 + 6
+  v357 = v100 + 7
+  v358 = v107 + 8
+  v359 = v114 + 9
+  v360 = v121 + 1
+  v361 = v128 + 2
+  v362 = v135 + 3
+  v363 = v142 + 4
+  v364 = v149 + 5
+  v365 = v156 + 6
+  v366 = v163 + 7
+  v367 = v170 + 8
+  v368 = v177 + 9
+  v369 = v184 + 1
+  v370 = v191 + 2
+  v371 = v198 + 3
+  v372 = v205 + 4
+  v373 = v212 + 5
+  v374 = v219 + 6
+  v375 = v226 + 7
+  v376 = v233 + 8
+  v377 = v240 + 9
+  v378 = v247 + 1
+  v379 = v254 + 2
+  v380 = v261 + 3
+  v381 = v268 + 4
+  v382 = v275 + 5
+  v383 = v282 + 6
+  v384 = v289 + 7
+  v385 = v296 + 8
+  v386 = v303 + 9
+  v387 = v310 + 1
+  v388 = v317 + 2
+  v389 = v324 + 3
+  v390 = v331 + 4
+  v391 = v338 + 5
+  v392 = v345 + 6
+  v393 = v352 + 7
+  v394 = v359 + 8
+  v395 = v366 + 9
+  v396 = v373 + 1
+  v397 = v380 + 2
+  v398 = v387 + 3
+  v399 = v394 + 4
+  i = i + 1
+}
+print(v0)
+print(v399)
@@ -0,0 +1,650 @@
+/*alloc.c*/
+
+//
+// Allocation profiler for nuPython runs. With glibc, the program's
+// own malloc, calloc, realloc and free replace the C library's for
+// every caller in the process, including the prebuilt front end,
+// and forward to glibc's __libc_malloc etc. Until alloc_start(),
+// and after alloc_report(), that is all they do.
+//
+// While counting, each allocation is charged to a site, the code
+// that called malloc, and to the current phase. The site is the
+// return address of the malloc call; when that is inside the C
+// library (strdup, fopen, ...), a backtrace finds the first caller
+// back in the program. Every live block is kept in a hash table
+// on its address, holding its size and the site it came from, so
+// that free() can take it off that site's live bytes. The tables
+// are allocated with __libc_calloc, outside what's counted, and a
+// lock guards them, since other threads (e.g. the sampler's) also
+// allocate.
+//
+
+
+#define _GNU_SOURCE   // popen, pclose
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdint.h>   // uintptr_t
+#include <unistd.h>   // getpid
+#include <pthread.h>
+
+#include "alloc.h"
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define ALLOC_INTERPOSE 1
+#include <execinfo.h> // backtrace
+#include <link.h>     // ElfW
+#else
+#define ALLOC_INTERPOSE 0
+#endif
+
+
+//
+// How deep a backtrace looks for a caller inside the program:
+//
+#define ALLOC_MAX_FRAMES 12
+
+//
+// One (site, phase) pair:
+//
+struct ALLOC_SITE
+{
+  uintptr_t address;    // return address of the call
+  int phase;
+  long long count;
+  long long bytes;
+  long long live;       // bytes still allocated
+};
+
+//
+// One live block; address 0 => an empty slot, 1 => a freed one:
+//
+struct ALLOC_BLOCK
+{
+  uintptr_t address;
+  size_t size;
+  int site;             // index into Sites
+};
+
+struct ALLOC_PHASE
+{
+  const char* name;
+  long long count;
+  long long bytes;
+  long long frees;
+  long long peak;       // most bytes live during the phase
+};
+
+static bool Tracking = false;
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// true while this thread is inside the tracker, so the mallocs that
+// backtrace() and the tables make aren't counted:
+//
+static _Thread_local bool Inside = false;
+
+static struct ALLOC_PHASE Phases[ALLOC_MAX_PHASES];
+static int NumPhases = 0;
+static int Current = 0;         // index into Phases
+
+static struct ALLOC_SITE* Sites = NULL;
+static int NumSites = 0;
+static int* SiteSlots = NULL;   // hash table of Sites indices, -1 => empty
+static int SiteSlotsSize = 0;   // a power of 2
+
+static struct ALLOC_BLOCK* Blocks = NULL;
+static size_t BlocksSize = 0;   // a power of 2
+static size_t BlocksUsed = 0;   // live and freed slots
+
+static long long Live = 0;
+static long long Peak = 0;
+static int PeakPhase = 0;
+static long long Untracked = 0; // frees of blocks allocated before starting
+
+
+#if ALLOC_INTERPOSE
+
+//
+// glibc's allocator, under the names it exports for this:
+//
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+//
+// Bounds of the program's code, from the linker:
+//
+extern char __executable_start;
+extern char etext;
+
+#endif
+
+
+//
+// Private functions:
+//
+
+//Charges an allocation of size bytes at ptr to the site that
+// called, whose return address is caller
+static void record(void* ptr, size_t size, void* caller);
+
+//Takes the block at ptr off its site's live bytes
+static void forget(void* ptr);
+
+//Returns the site in the program that made the call, walking back
+// past the C library if need be
+static uintptr_t find_site(void* caller);
+
+//Returns the index of the (address, phase) site, adding it if
+// new; -1 if out of memory
+static int site_index(uintptr_t address, int phase);
+
+//Grows the live block table; returns false if out of memory
+static bool grow_blocks(void);
+
+//Returns the slot of the block at address, or of the empty slot
+// where it would go
+static size_t block_slot(uintptr_t address);
+
+//Orders site indices by bytes allocated, most first
+static int compare_sites(const void* a, const void* b);
+
+//Names the given sites "function at file:line" with addr2line;
+// names that can't be found are left empty
+static void name_sites(int* order, int n, char names[][128]);
+
+//Writes bytes as B, KB, MB or GB
+static void print_bytes(FILE* out, long long bytes);
+
+//The C library's allocator, outside of what's counted
+static void* raw_calloc(size_t count, size_t size);
+static void* raw_realloc(void* ptr, size_t size);
+static void raw_free(void* ptr);
+
+
+//
+// Public functions:
+//
+
+//
+// alloc_start
+//
+// Starts counting.
+//
+bool alloc_start(void)
+{
+#if ALLOC_INTERPOSE
+  if (Tracking)
+    return true;
+
+  //
+  // the first backtrace() loads libgcc, allocating, so get that
+  // done before anything is counted:
+  //
+  void* frames[2];
+  backtrace(frames, 2);
+
+  pthread_mutex_lock(&Lock);
+
+  NumPhases = 1;
+  Current = 0;
+  Phases[0].name = "startup";
+  Tracking = grow_blocks();
+
+  pthread_mutex_unlock(&Lock);
+  return Tracking;
+#else
+  return false;
+#endif
+}
+
+//
+// alloc_phase
+//
+// Switches to the named phase.
+//
+void alloc_phase(const char* name)
+{
+  if (!Tracking)
+    return;
+
+  pthread_mutex_lock(&Lock);
+
+  //
+  // phases past the last one are lumped into it:
+  //
+  if (NumPhases < ALLOC_MAX_PHASES) {
+    Current = NumPhases++;
+    Phases[Current].name = name;
+  }
+  if (Live > Phases[Current].peak)
+    Phases[Current].peak = Live;
+
+  pthread_mutex_unlock(&Lock);
+}
+
+//
+// alloc_report
+//
+// Stops counting and writes the report.
+//
+void alloc_report(FILE* out)
+{
+  if (!Tracking)
+    return;
+
+  pthread_mutex_lock(&Lock);
+  Tracking = false;
+  pthread_mutex_unlock(&Lock);
+
+  //
+  // nothing else touches the tables once counting has stopped:
+  //
+  fprintf(out, "**ALLOCATIONS: peak live ");
+  print_bytes(out, Peak);
+  fprintf(out, " during %s, ", Phases[PeakPhase].name);
+  print_bytes(out, Live);
+  fprintf(out, " still live at exit");
+  if (Untracked > 0)
+    fprintf(out, ", %lld frees of memory allocated before counting", Untracked);
+  fprintf(out, "\n");
+
+  fprintf(out, "  %-10s %12s %12s %12s %12s\n", "phase", "allocs", "bytes", "frees", "peak live");
+  for (int p = 0; p < NumPhases; p++) {
+    fprintf(out, "  %-10s %12lld %12lld %12lld %12lld\n", Phases[p].name, Phases[p].count,
+            Phases[p].bytes, Phases[p].frees, Phases[p].peak);
+  }
+
+  int* order = (int*) raw_calloc(NumSites + 1, sizeof(int));
+  if (order == NULL)
+    return;
+  for (int s = 0; s < NumSites; s++)
+    order[s] = s;
+  qsort(order, NumSites, sizeof(int), compare_sites);
+
+  int n = (NumSites < ALLOC_TOP_SITES) ? NumSites : ALLOC_TOP_SITES;
+
+  char (*names)[128] = (char (*)[128]) raw_calloc(n + 1, 128);
+  if (names == NULL) {
+    raw_free(order);
+    return;
+  }
+  name_sites(order, n, names);
+
+  fprintf(out, "**TOP %d ALLOCATION SITES, by bytes\n", n);
+  fprintf(out, "  %12s %12s %12s  %-10s %s\n", "allocs", "bytes", "live at exit", "phase", "site");
+
+  for (int i = 0; i < n; i++) {
+    struct ALLOC_SITE* site = &Sites[order[i]];
+
+    fprintf(out, "  %12lld %12lld %12lld  %-10s ", site->count, site->bytes, site->live,
+            Phases[site->phase].name);
+    if (names[i][0] != '\0')
+      fprintf(out, "%s\n", names[i]);
+    else
+      fprintf(out, "%#lx\n", (unsigned long) site->address);
+  }
+
+  raw_free(names);
+  raw_free(order);
+}
+
+
+#if ALLOC_INTERPOSE
+
+//
+// The C library's entry points, replaced:
+//
+
+void* malloc(size_t size)
+{
+  void* ptr = __libc_malloc(size);
+
+  if (Tracking && ptr != NULL && !Inside)
+    record(ptr, size, __builtin_return_address(0));
+  return ptr;
+}
+
+void* calloc(size_t count, size_t size)
+{
+  void* ptr = __libc_calloc(count, size);
+
+  if (Tracking && ptr != NULL && !Inside)
+    record(ptr, count * size, __builtin_return_address(0));
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+  void* moved = __libc_realloc(ptr, size);
+
+  //
+  // a failed realloc leaves the block where it was, still live;
+  // else the old block is gone (size 0 => just freed):
+  //
+  if (Tracking && !Inside && (moved != NULL || size == 0)) {
+    if (ptr != NULL)
+      forget(ptr);
+    if (moved != NULL)
+      record(moved, size, __builtin_return_address(0));
+  }
+  return moved;
+}
+
+void free(void* ptr)
+{
+  if (Tracking && ptr != NULL && !Inside)
+    forget(ptr);
+
+  __libc_free(ptr);
+}
+
+#endif
+
+
+//
+// Private functions:
+//
+
+static void record(void* ptr, size_t size, void* caller)
+{
+  Inside = true;
+  uintptr_t address = find_site(caller);
+
+  pthread_mutex_lock(&Lock);
+
+  if (Tracking && (2 * (BlocksUsed + 1) <= BlocksSize || grow_blocks())) {
+    int index = site_index(address, Current);
+
+    if (index >= 0) {
+      size_t slot = block_slot((uintptr_t) ptr);
+      if (Blocks[slot].address == 0)
+        BlocksUsed++;
+
+      Blocks[slot].address = (uintptr_t) ptr;
+      Blocks[slot].size = size;
+      Blocks[slot].site = index;
+
+      struct ALLOC_SITE* site = &Sites[index];
+      site->count++;
+      site->bytes += size;
+      site->live += size;
+
+      Phases[Current].count++;
+      Phases[Current].bytes += size;
+
+      Live += size;
+      if (Live > Phases[Current].peak)
+        Phases[Current].peak = Live;
+      if (Live > Peak) {
+        Peak = Live;
+        PeakPhase = Current;
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&Lock);
+  Inside = false;
+}
+
+static void forget(void* ptr)
+{
+  Inside = true;
+  pthread_mutex_lock(&Lock);
+
+  if (Tracking) {
+    size_t slot = block_slot((uintptr_t) ptr);
+
+    if (Blocks[slot].address == (uintptr_t) ptr) {
+      Sites[Blocks[slot].site].live -= Blocks[slot].size;
+      Live -= Blocks[slot].size;
+      Phases[Current].frees++;
+      Blocks[slot].address = 1;  // freed, keeps probe chains intact
+    }
+    else {
+      Untracked++;
+    }
+  }
+
+  pthread_mutex_unlock(&Lock);
+  Inside = false;
+}
+
+static uintptr_t find_site(void* caller)
+{
+#if ALLOC_INTERPOSE
+  uintptr_t start = (uintptr_t) &__executable_start;
+  uintptr_t end = (uintptr_t) &etext;
+  uintptr_t address = (uintptr_t) caller;
+
+  if (address >= start && address < end)
+    return address;
+
+  //
+  // called from the C library: the site is the first frame back in
+  // the program after the first one outside it (the frames before
+  // are this function and malloc's):
+  //
+  void* frames[ALLOC_MAX_FRAMES];
+  int n = backtrace(frames, ALLOC_MAX_FRAMES);
+  bool outside = false;
+
+  for (int f = 0; f < n; f++) {
+    uintptr_t frame = (uintptr_t) frames[f];
+    bool inside = frame >= start && frame < end;
+
+    if (!inside)
+      outside = true;
+    else if (outside)
+      return frame;
+  }
+  return address;
+#else
+  return (uintptr_t) caller;
+#endif
+}
+
+static int site_index(uintptr_t address, int phase)
+{
+  //
+  // grow at half full, rehashing the indices:
+  //
+  if (2 * (NumSites + 1) > SiteSlotsSize) {
+    int size = (SiteSlotsSize == 0) ? 1024 : 2 * SiteSlotsSize;
+    int* slots = (int*) raw_calloc(size, sizeof(int));
+    struct ALLOC_SITE* sites = (struct ALLOC_SITE*) raw_realloc(Sites, (size / 2) * sizeof(struct ALLOC_SITE));
+
+    if (slots == NULL || sites == NULL) {
+      raw_free(slots);
+      if (sites != NULL)
+        Sites = sites;
+      return -1;
+    }
+    Sites = sites;
+
+    memset(slots, 0xff, size * sizeof(int));  // -1
+    for (int s = 0; s < NumSites; s++) {
+      unsigned int slot = (unsigned int) ((Sites[s].address >> 2) * 31u + (unsigned int) Sites[s].phase) & (size - 1);
+      while (slots[slot] >= 0)
+        slot = (slot + 1) & (size - 1);
+      slots[slot] = s;
+    }
+
+    raw_free(SiteSlots);
+    SiteSlots = slots;
+    SiteSlotsSize = size;
+  }
+
+  int mask = SiteSlotsSize - 1;
+  unsigned int slot = (unsigned int) ((address >> 2) * 31u + (unsigned int) phase) & mask;
+
+  while (SiteSlots[slot] >= 0) {
+    struct ALLOC_SITE* site = &Sites[SiteSlots[slot]];
+    if (site->address == address && site->phase == phase)
+      return SiteSlots[slot];
+    slot = (slot + 1) & mask;
+  }
+
+  int index = NumSites++;
+  memset(&Sites[index], 0, sizeof(struct ALLOC_SITE));
+  Sites[index].address = address;
+  Sites[index].phase = phase;
+  SiteSlots[slot] = index;
+
+  return index;
+}
+
+static bool grow_blocks(void)
+{
+  //
+  // freed slots are dropped when rehashing, so the table only
+  // doubles if more than a quarter of it is live:
+  //
+  size_t live = 0;
+  for (size_t i = 0; i < BlocksSize; i++) {
+    if (Blocks[i].address > 1)
+      live++;
+  }
+
+  size_t size = (BlocksSize == 0) ? 4096 : BlocksSize;
+  if (4 * live > size)
+    size *= 2;
+
+  struct ALLOC_BLOCK* old = Blocks;
+  size_t old_size = BlocksSize;
+
+  Blocks = (struct ALLOC_BLOCK*) raw_calloc(size, sizeof(struct ALLOC_BLOCK));
+  if (Blocks == NULL) {
+    Blocks = old;
+    return false;
+  }
+  BlocksSize = size;
+  BlocksUsed = 0;
+
+  for (size_t i = 0; i < old_size; i++) {
+    if (old[i].address > 1) {
+      Blocks[block_slot(old[i].address)] = old[i];
+      BlocksUsed++;
+    }
+  }
+
+  raw_free(old);
+  return true;
+}
+
+static size_t block_slot(uintptr_t address)
+{
+  //
+  // malloc's blocks are 16-byte aligned, so the low bits carry
+  // nothing; a freed slot is reused only if the address isn't
+  // further along the chain:
+  //
+  size_t mask = BlocksSize - 1;
+  size_t slot = (size_t) ((address >> 4) * 0x9E3779B97F4A7C15ull) & mask;
+  size_t freed = BlocksSize;
+
+  while (Blocks[slot].address != 0 && Blocks[slot].address != address) {
+    if (Blocks[slot].address == 1 && freed == BlocksSize)
+      freed = slot;
+    slot = (slot + 1) & mask;
+  }
+
+  if (Blocks[slot].address == 0 && freed != BlocksSize)
+    return freed;
+  return slot;
+}
+
+static int compare_sites(const void* a, const void* b)
+{
+  const struct ALLOC_SITE* x = &Sites[*(const int*) a];
+  const struct ALLOC_SITE* y = &Sites[*(const int*) b];
+
+  if (x->bytes != y->bytes)
+    return (x->bytes > y->bytes) ? -1 : 1;
+  return (x->count > y->count) ? -1 : (x->count < y->count);
+}
+
+static void name_sites(int* order, int n, char names[][128])
+{
+#if ALLOC_INTERPOSE
+  if (n == 0)
+    return;
+
+  //
+  // addr2line wants addresses as in the file, so a position
+  // independent program's load address comes off; the address
+  // before the return address is inside the call itself:
+  //
+  uintptr_t base = 0;
+  const ElfW(Ehdr)* header = (const ElfW(Ehdr)*) &__executable_start;
+  if (header->e_type == ET_DYN)
+    base = (uintptr_t) &__executable_start;
+
+  char* command = (char*) raw_calloc(n + 4, 24);
+  if (command == NULL)
+    return;
+
+  int length = sprintf(command, "addr2line -C -f -p -s -e /proc/%ld/exe", (long) getpid());
+  for (int i = 0; i < n; i++)
+    length += sprintf(command + length, " %#lx", (unsigned long) (Sites[order[i]].address - base - 1));
+  strcpy(command + length, " 2>/dev/null");
+
+  FILE* names_in = popen(command, "r");
+  raw_free(command);
+  if (names_in == NULL)
+    return;
+
+  //
+  // one line per address; "??" means it couldn't be found:
+  //
+  for (int i = 0; i < n && fgets(names[i], 128, names_in) != NULL; i++) {
+    names[i][strcspn(names[i], "\n")] = '\0';
+    if (strncmp(names[i], "??", 2) == 0)
+      names[i][0] = '\0';
+  }
+
+  pclose(names_in);
+#endif
+}
+
+static void print_bytes(FILE* out, long long bytes)
+{
+  if (bytes >= 1024LL * 1024 * 1024)
+    fprintf(out, "%.1f GB", (double) bytes / (1024.0 * 1024 * 1024));
+  else if (bytes >= 1024LL * 1024)
+    fprintf(out, "%.1f MB", (double) bytes / (1024.0 * 1024));
+  else if (bytes >= 1024)
+    fprintf(out, "%.1f KB", (double) bytes / 1024.0);
+  else
+    fprintf(out, "%lld B", bytes);
+}
+
+static void* raw_calloc(size_t count, size_t size)
+{
+#if ALLOC_INTERPOSE
+  return __libc_calloc(count, size);
+#else
+  return calloc(count, size);
+#endif
+}
+
+static void* raw_realloc(void* ptr, size_t size)
+{
+#if ALLOC_INTERPOSE
+  return __libc_realloc(ptr, size);
+#else
+  return realloc(ptr, size);
+#endif
+}
+
+static void raw_free(void* ptr)
+{
+#if ALLOC_INTERPOSE
+  __libc_free(ptr);
+#else
+  free(ptr);
+#endif
+}
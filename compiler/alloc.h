@@ -0,0 +1,57 @@
+/*alloc.h*/
+
+//
+// Allocation profiler for nuPython runs: when started, every
+// malloc, calloc, realloc and free in the process, including those
+// of the prebuilt scanner, parser and program graph, is counted
+// against the phase of the run and the code that called it.
+
+
+#pragma once
+
+#include <stdio.h>    // FILE
+#include <stdbool.h>  // true, false
+
+
+//
+// Most phases allocations are attributed to, and how many sites
+// the report lists:
+//
+#define ALLOC_MAX_PHASES 8
+#define ALLOC_TOP_SITES 15
+
+
+//
+// Public functions:
+//
+
+//
+// alloc_start
+//
+// Starts counting allocations, in the phase "startup" until
+// alloc_phase() is called. Memory allocated before the call is
+// not counted when freed. Returns false if allocations can't be
+// tracked in this build (they can only be with glibc, and not
+// under a sanitizer, which tracks malloc itself).
+//
+bool alloc_start(void);
+
+//
+// alloc_phase
+//
+// Attributes the allocations that follow to the named phase, e.g.
+// "parse". The name must stay valid until alloc_report(). Does
+// nothing if allocations aren't being counted.
+//
+void alloc_phase(const char* name);
+
+//
+// alloc_report
+//
+// Stops counting and writes, to the given stream, the peak live
+// memory and the phase it was reached in, the allocations of each
+// phase, and the ALLOC_TOP_SITES sites that allocated the most
+// bytes, named by function and source line where addr2line is
+// installed. Does nothing if allocations weren't being counted.
+//
+void alloc_report(FILE* out);
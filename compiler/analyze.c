@@ -0,0 +1,1312 @@
+/*analyze.c*/
+
+//
+// Static semantic analysis of a nuPython program graph. For every
+// statement we compute, for every variable, the set of types it may
+// hold when the statement starts (plus whether it may be undefined),
+// by flowing sets along the graph until they stop growing. Reading a
+// variable that turns out to be undefined, or applying an operator
+// to the wrong types, stops execution, so after a read the variable
+// is known to be defined. The sets found at each read then decide
+// which nodes are annotated; a node reached from several places
+// (e.g. a loop body the optimizer copied) gets only what holds at
+// all of them.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdint.h>   // uintptr_t
+
+#include "programgraph.h"
+#include "ram.h"
+#include "analyze.h"
+#include "optimize.h"    // STMT_SWITCH, STMT_FUSED, STMT_COUNTED
+
+
+//
+// What a variable may be, one bit per possibility:
+//
+#define T_UNDEF   0x01
+#define T_INT     0x02
+#define T_REAL    0x04
+#define T_STR     0x08
+#define T_BOOL    0x10
+#define T_OTHER   0x20  // None, pointers
+#define T_VALUES  (T_INT | T_REAL | T_STR | T_BOOL | T_OTHER)
+
+//
+// Sets are only kept where a block of straight-line statements
+// starts. Programs whose sets would need more bytes than this are
+// not analyzed; collecting stops as soon as a program is known to
+// be too big, so large programs cost little. The million-line
+// programs of "make scale" need about 40 MB:
+//
+#define ANALYZE_MAX_STATE (64 << 20)
+
+//
+// One annotation, so it can be undone:
+//
+struct ANNOTATION
+{
+  struct ELEMENT* element;  // either an element...
+  int   old_type;
+  char* old_value;
+
+  struct EXPR* expr;        // ...or an expression...
+  int   old_operator;
+
+  struct STMT_ASSIGNMENT* assignment;  // ...or an assignment
+  char* old_name;
+  int   old_value_type;
+};
+
+struct ANALYSIS
+{
+  struct ANNOTATION* annotations;
+  int num_annotations;
+  int capacity;
+
+  int num_ints;   // slots given out
+  int num_reals;
+};
+
+//
+// Pointer to index lookup, open addressing:
+//
+struct PTR_SLOT
+{
+  const void* key;
+  int         index;
+};
+
+struct PTR_MAP
+{
+  struct PTR_SLOT* slots;
+  int capacity;  // power of 2
+  int count;
+};
+
+//
+// What was seen at the reads of an element, or the operands of an
+// expression, over all the statements that contain it:
+//
+struct NODE_FACT
+{
+  void* node;
+  bool  is_expr;
+  unsigned char lhs;  // element: its set before the read
+  unsigned char rhs;
+};
+
+//
+// An error that happens whenever its statement runs; certain if the
+// statement runs whenever the program does:
+//
+struct DIAGNOSTIC
+{
+  int  line;
+  int  stmt;      // index into stmts
+  bool certain;
+  char message[160];
+};
+
+struct ANALYZER
+{
+  struct STMT** stmts;
+  int num_stmts;
+  int stmts_capacity;
+  struct PTR_MAP stmt_map;
+
+  char** vars;
+  int num_vars;
+  int vars_capacity;
+  int* var_slots;        // index + 1, 0 => empty
+  int var_slots_capacity;
+
+  unsigned char* in;     // num_blocks x num_vars sets
+  int* block;            // per statement, its set in `in`, -1 => inside a block
+  int num_blocks;
+  bool* reached;
+  unsigned char* assigned;  // per variable, what its assignments produce
+  int* slots;               // per variable, its slot or -1
+
+  struct NODE_FACT* facts;
+  int num_facts;
+  int facts_capacity;
+  struct PTR_MAP fact_map;
+
+  struct DIAGNOSTIC* diagnostics;
+  int num_diagnostics;
+  int diagnostics_capacity;
+
+  int* succ;             // per statement, 2 successor indices, -1 => none
+
+  bool recording;        // second pass, collect facts and errors
+  int  current;          // statement the second pass is at
+  bool failed;           // out of memory, or too big to analyze
+};
+
+
+//
+// Private functions:
+//
+
+//Finds the index of key, -1 if absent; map_add returns its index
+static int map_find(struct PTR_MAP* map, const void* key);
+static bool map_add(struct PTR_MAP* map, const void* key, int index);
+
+//Collects every statement reachable from program
+static void collect_stmts(struct ANALYZER* a, struct STMT* program);
+
+//Fills in the successors of stmt, returns how many
+static int successors(struct STMT* stmt, struct STMT* succ[2]);
+
+//Returns the index of the named variable, adding it if asked
+static int var_index(struct ANALYZER* a, const char* name, bool add);
+
+//Adds every variable named in stmt
+static void collect_vars(struct ANALYZER* a, struct STMT* stmt);
+
+//Marks the diagnostics whose statement runs on every path through
+// the program, i.e. dominates its end
+static void find_certain(struct ANALYZER* a);
+
+//Applies stmt to the sets in state. Returns false if execution
+// always stops at stmt.
+static bool transfer(struct ANALYZER* a, struct STMT* stmt, unsigned char* state);
+
+//Returns the types a read of element can produce, updating state;
+// sets *stops if the read always fails
+static unsigned char read_element(struct ANALYZER* a, struct ELEMENT* element, unsigned char* state, int line, bool* stops);
+
+//Returns the types a binary expression can produce, updating
+// state; sets *stops if it always fails
+static unsigned char read_binary(struct ANALYZER* a, struct EXPR* expr, unsigned char* state, int line, bool* stops);
+
+//Returns the type of lhs op rhs for single types, 0 if it fails;
+// *error is set to the message if it fails with one
+static unsigned char operator_result(int op, unsigned char lhs, unsigned char rhs, const char** error);
+
+//Returns the fact for node, adding it if need be
+static struct NODE_FACT* fact_for(struct ANALYZER* a, void* node, bool is_expr);
+
+//Records an error found by the second pass
+static void diagnose(struct ANALYZER* a, int line, const char* format, const char* name);
+
+//Annotates the nodes the facts allow, logging the changes
+static void annotate(struct ANALYZER* a, struct ANALYSIS* analysis);
+
+//Returns a copy of name to annotate a node with, NULL if out of memory
+static char* annotated_name(const char* name, int slot);
+
+//Appends an annotation to the log
+static bool log_annotation(struct ANALYSIS* analysis, struct ANNOTATION* annotation);
+
+//Orders diagnostics by line, then message, certain ones first
+static int compare_diagnostics(const void* p1, const void* p2);
+
+//Frees the analyzer's tables
+static void free_analyzer(struct ANALYZER* a);
+
+
+//
+// Public functions:
+//
+
+//
+// analyze_program
+//
+// Infers variable types throughout the program, annotates what
+// can be skipped at run time, and reports certain errors.
+//
+struct ANALYSIS* analyze_program(struct STMT* program, FILE* report)
+{
+  struct ANALYSIS* analysis = (struct ANALYSIS*) malloc(sizeof(struct ANALYSIS));
+  if (analysis == NULL) {
+    fprintf(stderr, "Error: Failed to allocate memory for analysis");
+    return NULL;
+  }
+  analysis->annotations = NULL;
+  analysis->num_annotations = 0;
+  analysis->capacity = 0;
+  analysis->num_ints = 0;
+  analysis->num_reals = 0;
+
+  if (program == NULL)
+    return analysis;
+
+  struct ANALYZER a;
+  memset(&a, 0, sizeof(a));
+
+  collect_stmts(&a, program);
+
+  a.succ = (int*) malloc(2 * ((size_t) a.num_stmts + 1) * sizeof(int));
+  a.block = (int*) calloc((size_t) a.num_stmts + 1, sizeof(int));
+  if (a.succ == NULL || a.block == NULL)
+    a.failed = true;
+
+  //
+  // the successors are looked up once, every pass below uses them.
+  // A statement starts a block unless its only predecessor has it
+  // as its only successor; block[] counts predecessors for now:
+  //
+  for (int s = 0; s < a.num_stmts && !a.failed; s++) {
+    struct STMT* succ[2];
+    int num_succ = successors(a.stmts[s], succ);
+
+    for (int i = 0; i < 2; i++) {
+      int t = (i < num_succ) ? map_find(&a.stmt_map, succ[i]) : -1;
+      a.succ[2 * s + i] = t;
+      if (t >= 0)
+        a.block[t] += (num_succ == 1) ? 1 : 2;
+    }
+  }
+
+  for (int s = 0; s < a.num_stmts && !a.failed; s++)
+    a.block[s] = (s == 0 || a.block[s] != 1) ? a.num_blocks++ : -1;
+
+  for (int i = 0; i < a.num_stmts && !a.failed; i++) {
+    collect_vars(&a, a.stmts[i]);
+    if ((size_t) a.num_blocks * (size_t) a.num_vars > ANALYZE_MAX_STATE)
+      a.failed = true;
+  }
+
+  if (a.failed) { // too big, run unannotated
+    free_analyzer(&a);
+    return analysis;
+  }
+
+  size_t state_size = (size_t) a.num_blocks * (size_t) a.num_vars;
+
+  a.in = (unsigned char*) malloc(state_size + a.num_vars);
+  a.reached = (bool*) calloc(a.num_stmts, sizeof(bool));
+  a.assigned = (unsigned char*) calloc(a.num_vars + 1, sizeof(unsigned char));
+  a.slots = (int*) malloc((a.num_vars + 1) * sizeof(int));
+  int* worklist = (int*) malloc(a.num_stmts * sizeof(int));
+  bool* queued = (bool*) calloc(a.num_stmts, sizeof(bool));
+
+  if (a.in == NULL || a.reached == NULL || a.assigned == NULL || a.slots == NULL
+      || worklist == NULL || queued == NULL) {
+    free(worklist);
+    free(queued);
+    free_analyzer(&a);
+    return analysis;
+  }
+
+  unsigned char* state = a.in + state_size;  // scratch set
+
+  //
+  // first pass: flow the sets through each block, and into the
+  // blocks it leads to, until they stop changing. Everything is
+  // undefined at the start:
+  //
+  memset(a.in, T_UNDEF, a.num_vars);
+  a.reached[0] = true;
+  worklist[0] = 0;
+  queued[0] = true;
+  int num_work = 1;
+
+  while (num_work > 0) {
+    int s = worklist[--num_work];
+    queued[s] = false;
+
+    memcpy(state, a.in + (size_t) a.block[s] * a.num_vars, a.num_vars);
+    bool runs = transfer(&a, a.stmts[s], state);
+
+    while (runs && a.succ[2 * s] >= 0 && a.block[a.succ[2 * s]] < 0) {
+      s = a.succ[2 * s];
+      a.reached[s] = true;
+      runs = transfer(&a, a.stmts[s], state);
+    }
+
+    if (!runs)
+      continue;
+
+    for (int i = 0; i < 2 && a.succ[2 * s + i] >= 0; i++) {
+      int t = a.succ[2 * s + i];
+      unsigned char* target = a.in + (size_t) a.block[t] * a.num_vars;
+      bool changed = false;
+
+      if (!a.reached[t]) {
+        memcpy(target, state, a.num_vars);
+        a.reached[t] = true;
+        changed = true;
+      }
+      else {
+        for (int v = 0; v < a.num_vars; v++) {
+          if ((target[v] | state[v]) != target[v]) {
+            target[v] |= state[v];
+            changed = true;
+          }
+        }
+      }
+
+      if (changed && !queued[t]) {
+        worklist[num_work++] = t;
+        queued[t] = true;
+      }
+    }
+  }
+
+  //
+  // second pass: what does each read see, and which errors are sure?
+  //
+  a.recording = true;
+  for (int s = 0; s < a.num_stmts; s++) {
+    if (!a.reached[s] || a.block[s] < 0)
+      continue;
+
+    memcpy(state, a.in + (size_t) a.block[s] * a.num_vars, a.num_vars);
+    a.current = s;
+    bool runs = transfer(&a, a.stmts[s], state);
+
+    for (int t = a.succ[2 * s]; runs && t >= 0 && a.block[t] < 0; t = a.succ[2 * t]) {
+      a.current = t;
+      runs = transfer(&a, a.stmts[t], state);
+    }
+  }
+
+  if (!a.failed)
+    annotate(&a, analysis);
+
+  //
+  // an error is only certain if its statement always runs, else it
+  // may be in a loop or branch that never does, and is a warning:
+  //
+  if (report != NULL && a.num_diagnostics > 0) {
+    find_certain(&a);
+    qsort(a.diagnostics, a.num_diagnostics, sizeof(struct DIAGNOSTIC), compare_diagnostics);
+
+    for (int i = 0; i < a.num_diagnostics; i++) {
+      struct DIAGNOSTIC* d = &a.diagnostics[i];
+
+      if (i > 0 && d->line == d[-1].line && strcmp(d->message, d[-1].message) == 0)
+        continue; // same error reached twice, e.g. in a copied loop body
+
+      fprintf(report, "**STATIC %s: %s (line %d)\n", d->certain ? "ERROR" : "WARNING", d->message, d->line);
+    }
+    fflush(report);
+  }
+
+  free(worklist);
+  free(queued);
+  free_analyzer(&a);
+
+  return analysis;
+}
+
+
+//
+// analyze_reserve
+//
+// Makes room in memory for the analysis' slots.
+//
+bool analyze_reserve(struct ANALYSIS* analysis, struct RAM* memory)
+{
+  if (analysis == NULL)
+    return true;
+
+  return ram_reserve_slots(memory, analysis->num_ints, analysis->num_reals);
+}
+
+
+//
+// analyze_peek
+//
+// Returns the value of an annotated identifier, using the address
+// found by the last read if it still names the same variable.
+//
+struct RAM_VALUE* analyze_peek(struct RAM* memory, struct ELEMENT* element)
+{
+  struct ANALYZE_NAME* name = ANALYZE_NAME_OF(element->element_value);
+
+  //
+  // slot variables know their cell:
+  //
+  if (element->element_type == ELEMENT_INT_SLOT)
+    return ram_peek_cell_by_addr(memory, memory->int_cells[name->slot]);
+  if (element->element_type == ELEMENT_REAL_SLOT)
+    return ram_peek_cell_by_addr(memory, memory->real_cells[name->slot]);
+
+  if (name->addr < 0 || name->addr >= memory->num_values
+      || strcmp(memory->cells[name->addr].identifier, name->name) != 0)
+    name->addr = ram_get_addr(memory, name->name);
+
+  return ram_peek_cell_by_addr(memory, name->addr);
+}
+
+
+//
+// analyze_restore
+//
+// Undoes the annotations in the given log, last first, and frees
+// the log.
+//
+void analyze_restore(struct ANALYSIS* analysis)
+{
+  if (analysis == NULL)
+    return;
+
+  for (int i = analysis->num_annotations - 1; i >= 0; i--) {
+    struct ANNOTATION* annotation = &analysis->annotations[i];
+
+    if (annotation->element != NULL) {
+      char* name = annotation->element->element_value;
+
+      annotation->element->element_type = annotation->old_type;
+      annotation->element->element_value = annotation->old_value;
+
+      free(ANALYZE_NAME_OF(name));
+    }
+    else if (annotation->expr != NULL) {
+      annotation->expr->operator = annotation->old_operator;
+    }
+    else {
+      char* name = annotation->assignment->var_name;
+
+      annotation->assignment->var_name = annotation->old_name;
+      annotation->assignment->rhs->value_type = annotation->old_value_type;
+
+      free(ANALYZE_NAME_OF(name));
+    }
+  }
+
+  free(analysis->annotations);
+  free(analysis);
+}
+
+
+//
+// Private functions:
+//
+
+static size_t hash_ptr(const void* p, int capacity)
+{
+  uintptr_t h = (uintptr_t) p;
+  h ^= h >> 17;
+  h *= 0x9E3779B97F4A7C15ULL;
+  return (size_t) (h ^ (h >> 29)) & (size_t) (capacity - 1);
+}
+
+static int map_find(struct PTR_MAP* map, const void* key)
+{
+  if (map->capacity == 0)
+    return -1;
+
+  size_t slot = hash_ptr(key, map->capacity);
+  while (map->slots[slot].key != NULL) {
+    if (map->slots[slot].key == key)
+      return map->slots[slot].index;
+    slot = (slot + 1) & (size_t) (map->capacity - 1);
+  }
+  return -1;
+}
+
+static bool map_add(struct PTR_MAP* map, const void* key, int index)
+{
+  if (2 * (map->count + 1) > map->capacity) {
+    int capacity = (map->capacity == 0) ? 256 : 2 * map->capacity;
+    struct PTR_SLOT* slots = (struct PTR_SLOT*) calloc(capacity, sizeof(struct PTR_SLOT));
+    if (slots == NULL)
+      return false;
+
+    for (int i = 0; i < map->capacity; i++) {
+      if (map->slots[i].key == NULL)
+        continue;
+      size_t slot = hash_ptr(map->slots[i].key, capacity);
+      while (slots[slot].key != NULL)
+        slot = (slot + 1) & (size_t) (capacity - 1);
+      slots[slot] = map->slots[i];
+    }
+    free(map->slots);
+    map->slots = slots;
+    map->capacity = capacity;
+  }
+
+  size_t slot = hash_ptr(key, map->capacity);
+  while (map->slots[slot].key != NULL)
+    slot = (slot + 1) & (size_t) (map->capacity - 1);
+
+  map->slots[slot].key = key;
+  map->slots[slot].index = index;
+  map->count++;
+  return true;
+}
+
+static int successors(struct STMT* stmt, struct STMT* succ[2])
+{
+  int n = 0;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT)
+    succ[n++] = stmt->types.assignment->next_stmt;
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    succ[n++] = stmt->types.function_call->next_stmt;
+  else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    succ[n++] = stmt->types.while_loop->loop_body;
+    succ[n++] = stmt->types.while_loop->next_stmt;
+  }
+  else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+    succ[n++] = stmt->types.if_then_else->true_path;
+    succ[n++] = stmt->types.if_then_else->false_path;
+  }
+  else if (stmt->stmt_type == STMT_SWITCH) {
+    //
+    // every way through goes where the chain as written would, so
+    // analyze that:
+    //
+    succ[n++] = OPT_SWITCH_OF(stmt)->fallback;
+  }
+  else if (stmt->stmt_type == STMT_FUSED) {
+    //
+    // likewise the statement as written:
+    //
+    succ[n++] = OPT_FUSED_OF(stmt)->original;
+  }
+  else if (stmt->stmt_type == STMT_COUNTED) {
+    succ[n++] = OPT_COUNTED_OF(stmt)->original;
+  }
+  else
+    succ[n++] = stmt->types.pass->next_stmt;
+
+  //
+  // drop the NULLs, i.e. the end of the program:
+  //
+  int kept = 0;
+  for (int i = 0; i < n; i++) {
+    if (succ[i] != NULL)
+      succ[kept++] = succ[i];
+  }
+  return kept;
+}
+
+static void collect_stmts(struct ANALYZER* a, struct STMT* program)
+{
+  //
+  // depth-first with an explicit stack, chains can be very long:
+  //
+  int stack_capacity = 64;
+  int num_stack = 0;
+  struct STMT** stack = (struct STMT**) malloc(stack_capacity * sizeof(struct STMT*));
+  if (stack == NULL) {
+    a->failed = true;
+    return;
+  }
+
+  stack[num_stack++] = program;
+
+  while (num_stack > 0 && !a->failed) {
+    struct STMT* stmt = stack[--num_stack];
+    if (map_find(&a->stmt_map, stmt) >= 0)
+      continue;
+
+    if (a->num_stmts == a->stmts_capacity) {
+      int capacity = (a->stmts_capacity == 0) ? 64 : 2 * a->stmts_capacity;
+      struct STMT** stmts = (struct STMT**) realloc(a->stmts, capacity * sizeof(struct STMT*));
+      if (stmts == NULL) {
+        a->failed = true;
+        break;
+      }
+      a->stmts = stmts;
+      a->stmts_capacity = capacity;
+    }
+
+    if (!map_add(&a->stmt_map, stmt, a->num_stmts)) {
+      a->failed = true;
+      break;
+    }
+    a->stmts[a->num_stmts++] = stmt;
+
+    struct STMT* succ[2];
+    int num_succ = successors(stmt, succ);
+
+    if (num_stack + num_succ > stack_capacity) {
+      stack_capacity *= 2;
+      struct STMT** bigger = (struct STMT**) realloc(stack, stack_capacity * sizeof(struct STMT*));
+      if (bigger == NULL) {
+        a->failed = true;
+        break;
+      }
+      stack = bigger;
+    }
+
+    // push the later path first so the main path is numbered first
+    for (int i = num_succ - 1; i >= 0; i--) {
+      if (map_find(&a->stmt_map, succ[i]) < 0)
+        stack[num_stack++] = succ[i];
+    }
+  }
+
+  free(stack);
+}
+
+static size_t hash_name(const char* name, int capacity)
+{
+  size_t h = 14695981039346656037ULL;
+  for (const unsigned char* p = (const unsigned char*) name; *p != '\0'; p++) {
+    h ^= *p;
+    h *= 1099511628211ULL;
+  }
+  return h & (size_t) (capacity - 1);
+}
+
+static int var_index(struct ANALYZER* a, const char* name, bool add)
+{
+  if (a->var_slots_capacity > 0) {
+    size_t slot = hash_name(name, a->var_slots_capacity);
+    while (a->var_slots[slot] != 0) {
+      int v = a->var_slots[slot] - 1;
+      if (strcmp(a->vars[v], name) == 0)
+        return v;
+      slot = (slot + 1) & (size_t) (a->var_slots_capacity - 1);
+    }
+  }
+
+  if (!add)
+    return -1;
+
+  if (a->num_vars == a->vars_capacity) {
+    int capacity = (a->vars_capacity == 0) ? 16 : 2 * a->vars_capacity;
+    char** vars = (char**) realloc(a->vars, capacity * sizeof(char*));
+    if (vars == NULL) {
+      a->failed = true;
+      return -1;
+    }
+    a->vars = vars;
+    a->vars_capacity = capacity;
+  }
+
+  if (2 * (a->num_vars + 1) > a->var_slots_capacity) {
+    int capacity = (a->var_slots_capacity == 0) ? 64 : 2 * a->var_slots_capacity;
+    int* slots = (int*) calloc(capacity, sizeof(int));
+    if (slots == NULL) {
+      a->failed = true;
+      return -1;
+    }
+    for (int v = 0; v < a->num_vars; v++) {
+      size_t slot = hash_name(a->vars[v], capacity);
+      while (slots[slot] != 0)
+        slot = (slot + 1) & (size_t) (capacity - 1);
+      slots[slot] = v + 1;
+    }
+    free(a->var_slots);
+    a->var_slots = slots;
+    a->var_slots_capacity = capacity;
+  }
+
+  int v = a->num_vars++;
+  a->vars[v] = (char*) name;
+
+  size_t slot = hash_name(name, a->var_slots_capacity);
+  while (a->var_slots[slot] != 0)
+    slot = (slot + 1) & (size_t) (a->var_slots_capacity - 1);
+  a->var_slots[slot] = v + 1;
+
+  return v;
+}
+
+static void collect_element(struct ANALYZER* a, struct ELEMENT* element)
+{
+  if (element != NULL && element->element_type == ELEMENT_IDENTIFIER)
+    var_index(a, element->element_value, true);
+}
+
+static void collect_expr(struct ANALYZER* a, struct EXPR* expr)
+{
+  collect_element(a, expr->lhs->element);
+  if (expr->isBinaryExpr && expr->rhs != NULL)
+    collect_element(a, expr->rhs->element);
+}
+
+static void collect_vars(struct ANALYZER* a, struct STMT* stmt)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    var_index(a, stmt->types.assignment->var_name, true);
+
+    struct VALUE* rhs = stmt->types.assignment->rhs;
+    if (rhs->value_type == VALUE_EXPR)
+      collect_expr(a, rhs->types.expr);
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+    collect_element(a, stmt->types.function_call->parameter);
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    collect_expr(a, stmt->types.while_loop->condition);
+  }
+  else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+    collect_expr(a, stmt->types.if_then_else->condition);
+  }
+}
+
+static void find_certain(struct ANALYZER* a)
+{
+  //
+  // dominators of the end (Cooper, Harvey & Kennedy): node n is the
+  // end, which every reached statement without a reached successor
+  // goes to. The nodes are numbered in postorder, then each node's
+  // immediate dominator is refined from its predecessors' until
+  // nothing changes. The statements that always run are the chain
+  // of immediate dominators up from the end.
+  //
+  int n = a->num_stmts;
+  int* edges = (int*) malloc(2 * ((size_t) n + 1) * sizeof(int));  // 2 per node, -1 => none
+  int* first_pred = (int*) calloc(n + 2, sizeof(int));
+  int* preds = (int*) malloc(2 * ((size_t) n + 1) * sizeof(int));
+  int* number = (int*) malloc((n + 1) * sizeof(int));              // postorder, -1 => not visited
+  int* order = (int*) malloc((n + 1) * sizeof(int));               // postorder -> node
+  int* stack = (int*) malloc((n + 1) * sizeof(int));
+  int* next = (int*) calloc(n + 1, sizeof(int));                   // next edge to visit
+  int* idom = (int*) malloc((n + 1) * sizeof(int));
+  bool* always = (bool*) calloc(n + 1, sizeof(bool));
+  int count = 0;       // # of nodes numbered so far
+  int depth = 0;       // of stack
+  bool changed = true;
+
+  if (edges == NULL || first_pred == NULL || preds == NULL || number == NULL || order == NULL
+      || stack == NULL || next == NULL || idom == NULL || always == NULL)
+    goto done;
+
+  //
+  // the edges, ignoring statements the first pass never reached:
+  //
+  for (int s = 0; s <= n; s++) {
+    int num_edges = 0;
+
+    for (int i = 0; s < n && a->reached[s] && i < 2; i++) {
+      int t = a->succ[2 * s + i];
+      if (t >= 0 && a->reached[t])
+        edges[2 * s + num_edges++] = t;
+    }
+    if (s < n && a->reached[s] && num_edges == 0)
+      edges[2 * s + num_edges++] = n;
+    while (num_edges < 2)
+      edges[2 * s + num_edges++] = -1;
+
+    for (int i = 0; i < 2 && edges[2 * s + i] >= 0; i++)
+      first_pred[edges[2 * s + i] + 1]++;
+  }
+
+  for (int s = 0; s <= n; s++)
+    first_pred[s + 1] += first_pred[s];
+
+  for (int s = 0; s <= n; s++)
+    for (int i = 0; i < 2 && edges[2 * s + i] >= 0; i++) {
+      int t = edges[2 * s + i];
+      preds[first_pred[t] + next[t]++] = s;
+    }
+
+  //
+  // postorder, by depth-first search from the first statement:
+  //
+  for (int s = 0; s <= n; s++) {
+    number[s] = -1;
+    next[s] = 0;
+  }
+
+  stack[depth++] = 0;
+  number[0] = n + 1;  // visited, not yet numbered
+
+  while (depth > 0) {
+    int s = stack[depth - 1];
+
+    if (next[s] < 2 && edges[2 * s + next[s]] >= 0) {
+      int t = edges[2 * s + next[s]++];
+      if (number[t] == -1) {
+        number[t] = n + 1;
+        stack[depth++] = t;
+      }
+      continue;
+    }
+
+    depth--;
+    number[s] = count;
+    order[count++] = s;
+  }
+
+  if (number[n] == -1)
+    goto done;  // the program never ends
+
+  //
+  // immediate dominators, in reverse postorder; the first statement
+  // is last in postorder:
+  //
+  for (int s = 0; s <= n; s++)
+    idom[s] = -1;
+  idom[0] = 0;
+
+  while (changed) {
+    changed = false;
+
+    for (int k = count - 2; k >= 0; k--) {
+      int s = order[k];
+      int dom = -1;
+
+      for (int p = first_pred[s]; p < first_pred[s + 1]; p++) {
+        int x = preds[p];
+        if (idom[x] == -1)
+          continue;  // not processed yet
+
+        int y = dom;
+        while (y != -1 && x != y) {
+          while (number[x] < number[y])
+            x = idom[x];
+          while (number[y] < number[x])
+            y = idom[y];
+        }
+        dom = x;
+      }
+
+      if (idom[s] != dom) {
+        idom[s] = dom;
+        changed = true;
+      }
+    }
+  }
+
+  for (int s = idom[n]; !always[s]; s = idom[s])
+    always[s] = true;
+
+  for (int i = 0; i < a->num_diagnostics; i++)
+    a->diagnostics[i].certain = always[a->diagnostics[i].stmt];
+
+done:
+  free(edges);
+  free(first_pred);
+  free(preds);
+  free(number);
+  free(order);
+  free(stack);
+  free(next);
+  free(idom);
+  free(always);
+}
+
+static bool transfer(struct ANALYZER* a, struct STMT* stmt, unsigned char* state)
+{
+  bool stops = false;
+  int line = stmt->line;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    struct VALUE* rhs = stmt->types.assignment->rhs;
+    unsigned char result;
+
+    if (rhs->value_type == VALUE_FUNCTION_CALL) {
+      char* function_name = rhs->types.function_call->function_name;
+
+      if (strcmp(function_name, "input") == 0)
+        result = T_STR;
+      else if (strcmp(function_name, "int") == 0)
+        result = T_INT;
+      else if (strcmp(function_name, "float") == 0)
+        result = T_REAL;
+      else
+        result = T_OTHER;
+    }
+    else if (rhs->types.expr->isBinaryExpr) {
+      result = read_binary(a, rhs->types.expr, state, line, &stops);
+    }
+    else {
+      result = read_element(a, rhs->types.expr->lhs->element, state, line, &stops);
+    }
+
+    if (stops)
+      return false;
+
+    int v = var_index(a, stmt->types.assignment->var_name, false);
+    if (a->recording)
+      a->assigned[v] |= result;
+
+    state[v] = result;
+    return true;
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+    if (strcmp(stmt->types.function_call->function_name, "print") != 0)
+      return false; // execution stops at unknown functions
+
+    struct ELEMENT* parameter = stmt->types.function_call->parameter;
+    if (parameter != NULL && parameter->element_type == ELEMENT_IDENTIFIER)
+      read_element(a, parameter, state, line, &stops);
+
+    return !stops;
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP || stmt->stmt_type == STMT_IF_THEN_ELSE) {
+    struct EXPR* condition = (stmt->stmt_type == STMT_WHILE_LOOP)
+      ? stmt->types.while_loop->condition : stmt->types.if_then_else->condition;
+
+    if (condition->isBinaryExpr)
+      read_binary(a, condition, state, line, &stops);
+    else
+      read_element(a, condition->lhs->element, state, line, &stops);
+
+    return !stops;
+  }
+
+  return true; // pass
+}
+
+static unsigned char read_element(struct ANALYZER* a, struct ELEMENT* element, unsigned char* state, int line, bool* stops)
+{
+  switch (element->element_type)
+  {
+  case ELEMENT_INT_LITERAL:
+    return T_INT;
+  case ELEMENT_REAL_LITERAL:
+    return T_REAL;
+  case ELEMENT_STR_LITERAL:
+    return T_STR;
+  case ELEMENT_TRUE:
+  case ELEMENT_FALSE:
+    return T_BOOL;
+
+  case ELEMENT_IDENTIFIER: {
+    int v = var_index(a, element->element_value, false);
+    unsigned char set = state[v];
+
+    if (a->recording) {
+      struct NODE_FACT* fact = fact_for(a, element, false);
+      if (fact != NULL)
+        fact->lhs |= set;
+    }
+
+    if ((set & T_VALUES) == 0) { // never assigned on any path here
+      if (a->recording)
+        diagnose(a, line, "name '%s' is not defined", element->element_value);
+      *stops = true;
+      return 0;
+    }
+
+    state[v] = set & ~T_UNDEF;  // if it wasn't defined, we stopped
+    return set & T_VALUES;
+  }
+
+  default: // None can't be read, execution stops
+    *stops = true;
+    return 0;
+  }
+}
+
+static unsigned char read_binary(struct ANALYZER* a, struct EXPR* expr, unsigned char* state, int line, bool* stops)
+{
+  if (expr->operator == OPERATOR_NO_OP || expr->rhs == NULL) {
+    *stops = true;
+    return 0;
+  }
+
+  unsigned char lhs = read_element(a, expr->lhs->element, state, line, stops);
+  if (*stops)
+    return 0;
+
+  unsigned char rhs = read_element(a, expr->rhs->element, state, line, stops);
+  if (*stops)
+    return 0;
+
+  if (a->recording) {
+    struct NODE_FACT* fact = fact_for(a, expr, true);
+    if (fact != NULL) {
+      fact->lhs |= lhs;
+      fact->rhs |= rhs;
+    }
+  }
+
+  //
+  // the result can be anything any pair of types produces:
+  //
+  unsigned char result = 0;
+  const char* error = NULL;
+
+  for (unsigned char l = T_INT; l <= T_OTHER; l <<= 1) {
+    for (unsigned char r = T_INT; r <= T_OTHER; r <<= 1) {
+      if ((lhs & l) && (rhs & r))
+        result |= operator_result(expr->operator, l, r, &error);
+    }
+  }
+
+  if (result == 0) {
+    //
+    // every combination fails; only one combination => certain message
+    //
+    bool single = (lhs & (lhs - 1)) == 0 && (rhs & (rhs - 1)) == 0;
+    if (a->recording && single && error != NULL)
+      diagnose(a, line, error, NULL);
+    *stops = true;
+    return 0;
+  }
+
+  //
+  // x / 0 and x % 0 always fail:
+  //
+  struct ELEMENT* divisor = expr->rhs->element;
+  bool by_zero = (expr->operator == OPERATOR_DIV || expr->operator == OPERATOR_MOD)
+    && ((divisor->element_type == ELEMENT_INT_LITERAL && atoi(divisor->element_value) == 0)
+        || (divisor->element_type == ELEMENT_REAL_LITERAL && atof(divisor->element_value) == 0.0))
+    && (lhs & ~(T_INT | T_REAL)) == 0;
+
+  if (by_zero) {
+    if (a->recording)
+      diagnose(a, line, "division by zero", NULL);
+    *stops = true;
+    return 0;
+  }
+
+  return result;
+}
+
+static unsigned char operator_result(int op, unsigned char lhs, unsigned char rhs, const char** error)
+{
+  bool relational = op >= OPERATOR_EQUAL && op <= OPERATOR_GTE;
+  bool arithmetic = op <= OPERATOR_DIV;
+
+  if (lhs == T_STR && rhs == T_STR) {
+    if (op == OPERATOR_PLUS)
+      return T_STR;
+    if (relational)
+      return T_BOOL;
+    *error = "invalid operand for string";
+    return 0;
+  }
+
+  bool numeric = (lhs == T_INT || lhs == T_REAL) && (rhs == T_INT || rhs == T_REAL);
+  if (numeric) {
+    if (relational)
+      return T_BOOL;
+    if (arithmetic)
+      return (lhs == T_INT && rhs == T_INT) ? T_INT : T_REAL;
+    return 0; // is / in, fails without a message
+  }
+
+  *error = "invalid operand types";
+  return 0;
+}
+
+static struct NODE_FACT* fact_for(struct ANALYZER* a, void* node, bool is_expr)
+{
+  int i = map_find(&a->fact_map, node);
+  if (i >= 0)
+    return &a->facts[i];
+
+  if (a->num_facts == a->facts_capacity) {
+    int capacity = (a->facts_capacity == 0) ? 64 : 2 * a->facts_capacity;
+    struct NODE_FACT* facts = (struct NODE_FACT*) realloc(a->facts, capacity * sizeof(struct NODE_FACT));
+    if (facts == NULL) {
+      a->failed = true;
+      return NULL;
+    }
+    a->facts = facts;
+    a->facts_capacity = capacity;
+  }
+
+  if (!map_add(&a->fact_map, node, a->num_facts)) {
+    a->failed = true;
+    return NULL;
+  }
+
+  struct NODE_FACT* fact = &a->facts[a->num_facts++];
+  fact->node = node;
+  fact->is_expr = is_expr;
+  fact->lhs = 0;
+  fact->rhs = 0;
+  return fact;
+}
+
+static void diagnose(struct ANALYZER* a, int line, const char* format, const char* name)
+{
+  if (a->num_diagnostics == a->diagnostics_capacity) {
+    int capacity = (a->diagnostics_capacity == 0) ? 8 : 2 * a->diagnostics_capacity;
+    struct DIAGNOSTIC* diagnostics = (struct DIAGNOSTIC*) realloc(a->diagnostics, capacity * sizeof(struct DIAGNOSTIC));
+    if (diagnostics == NULL)
+      return;
+    a->diagnostics = diagnostics;
+    a->diagnostics_capacity = capacity;
+  }
+
+  struct DIAGNOSTIC* d = &a->diagnostics[a->num_diagnostics++];
+  d->line = line;
+  d->stmt = a->current;
+  d->certain = false;
+  snprintf(d->message, sizeof(d->message), format, name);
+}
+
+static void annotate(struct ANALYZER* a, struct ANALYSIS* analysis)
+{
+  //
+  // variables whose every assignment produces an int (or every one
+  // a real) get a slot:
+  //
+  for (int v = 0; v < a->num_vars; v++) {
+    if (a->assigned[v] == T_INT)
+      a->slots[v] = analysis->num_ints++;
+    else if (a->assigned[v] == T_REAL)
+      a->slots[v] = analysis->num_reals++;
+    else
+      a->slots[v] = -1;
+  }
+
+  for (int i = 0; i < a->num_facts; i++) {
+    struct NODE_FACT* fact = &a->facts[i];
+    struct ANNOTATION annotation;
+    memset(&annotation, 0, sizeof(annotation));
+
+    if (!fact->is_expr) {
+      struct ELEMENT* element = (struct ELEMENT*) fact->node;
+      int v = var_index(a, element->element_value, false);
+      int type;
+
+      if ((fact->lhs & T_VALUES) == 0) // always fails
+        continue;
+
+      if (a->slots[v] >= 0) {
+        //
+        // a slot read, the slot's cell says if it's defined yet:
+        //
+        type = (a->assigned[v] == T_INT) ? ELEMENT_INT_SLOT : ELEMENT_REAL_SLOT;
+      }
+      else if ((fact->lhs & T_UNDEF) == 0) {
+        //
+        // a read that always finds the variable defined:
+        //
+        type = ELEMENT_DEFINED;
+        if (fact->lhs == T_INT)
+          type = ELEMENT_DEFINED_INT;
+        else if (fact->lhs == T_REAL)
+          type = ELEMENT_DEFINED_REAL;
+        else if (fact->lhs == T_STR)
+          type = ELEMENT_DEFINED_STR;
+        else if (fact->lhs == T_BOOL)
+          type = ELEMENT_DEFINED_BOOLEAN;
+      }
+      else
+        continue;
+
+      char* name = annotated_name(element->element_value, a->slots[v]);
+      if (name == NULL)
+        return;
+
+      annotation.element = element;
+      annotation.old_type = element->element_type;
+      annotation.old_value = element->element_value;
+      if (!log_annotation(analysis, &annotation)) {
+        free(ANALYZE_NAME_OF(name));
+        return;
+      }
+
+      element->element_type = type;
+      element->element_value = name;
+    }
+    else {
+      //
+      // an operator whose operand types are always the same:
+      //
+      struct EXPR* expr = (struct EXPR*) fact->node;
+      int flag = 0;
+
+      if (fact->lhs == T_INT && fact->rhs == T_INT)
+        flag = EXPR_INT_OPERANDS;
+      else if ((fact->lhs == T_INT || fact->lhs == T_REAL) && (fact->rhs == T_INT || fact->rhs == T_REAL))
+        flag = EXPR_REAL_OPERANDS;
+      else if (fact->lhs == T_STR && fact->rhs == T_STR)
+        flag = EXPR_STR_OPERANDS;
+
+      if (flag == 0)
+        continue;
+
+      annotation.expr = expr;
+      annotation.old_operator = expr->operator;
+      if (!log_annotation(analysis, &annotation))
+        return;
+
+      expr->operator |= flag;
+    }
+  }
+
+  //
+  // assignments to slot variables:
+  //
+  for (int s = 0; s < a->num_stmts; s++) {
+    if (!a->reached[s] || a->stmts[s]->stmt_type != STMT_ASSIGNMENT)
+      continue;
+
+    struct STMT_ASSIGNMENT* assignment = a->stmts[s]->types.assignment;
+    int v = var_index(a, assignment->var_name, false);
+    if (a->slots[v] < 0)
+      continue;
+
+    char* name = annotated_name(assignment->var_name, a->slots[v]);
+    if (name == NULL)
+      return;
+
+    struct ANNOTATION annotation;
+    memset(&annotation, 0, sizeof(annotation));
+    annotation.assignment = assignment;
+    annotation.old_name = assignment->var_name;
+    annotation.old_value_type = assignment->rhs->value_type;
+    if (!log_annotation(analysis, &annotation)) {
+      free(ANALYZE_NAME_OF(name));
+      return;
+    }
+
+    assignment->var_name = name;
+    assignment->rhs->value_type |= (a->assigned[v] == T_INT) ? VALUE_INT_TARGET : VALUE_REAL_TARGET;
+  }
+}
+
+static char* annotated_name(const char* name, int slot)
+{
+  size_t len = strlen(name);
+  struct ANALYZE_NAME* copy = (struct ANALYZE_NAME*) malloc(sizeof(struct ANALYZE_NAME) + len + 1);
+  if (copy == NULL)
+    return NULL;
+
+  copy->addr = -1;
+  copy->slot = slot;
+  copy->name = (char*) (copy + 1);
+  memcpy(copy->name, name, len + 1);
+  return copy->name;
+}
+
+static bool log_annotation(struct ANALYSIS* analysis, struct ANNOTATION* annotation)
+{
+  if (analysis->num_annotations == analysis->capacity) {
+    int capacity = (analysis->capacity == 0) ? 64 : 2 * analysis->capacity;
+    struct ANNOTATION* annotations = (struct ANNOTATION*) realloc(analysis->annotations, capacity * sizeof(struct ANNOTATION));
+    if (annotations == NULL)
+      return false;
+    analysis->annotations = annotations;
+    analysis->capacity = capacity;
+  }
+
+  analysis->annotations[analysis->num_annotations++] = *annotation;
+  return true;
+}
+
+static int compare_diagnostics(const void* p1, const void* p2)
+{
+  const struct DIAGNOSTIC* d1 = (const struct DIAGNOSTIC*) p1;
+  const struct DIAGNOSTIC* d2 = (const struct DIAGNOSTIC*) p2;
+
+  if (d1->line != d2->line)
+    return (d1->line < d2->line) ? -1 : 1;
+
+  int diff = strcmp(d1->message, d2->message);
+  if (diff != 0)
+    return diff;
+  return (int) d2->certain - (int) d1->certain;
+}
+
+static void free_analyzer(struct ANALYZER* a)
+{
+  free(a->stmts);
+  free(a->stmt_map.slots);
+  free(a->vars);
+  free(a->var_slots);
+  free(a->in);
+  free(a->block);
+  free(a->reached);
+  free(a->assigned);
+  free(a->slots);
+  free(a->succ);
+  free(a->facts);
+  free(a->fact_map.slots);
+  free(a->diagnostics);
+}
@@ -0,0 +1,130 @@
+/*analyze.h*/
+
+//
+// Static semantic analysis of a nuPython program graph. Finds the
+// types each variable can have at each point of the program, marks
+// the reads and expressions whose checks can be skipped at run
+// time, and reports errors that are certain to happen, or that
+// happen if some statement runs.
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+
+
+//
+// Element types given to identifiers that are proven to be defined
+// wherever they are read; the type says what the variable holds:
+//
+enum ANALYZE_ELEMENT_TYPES
+{
+  ELEMENT_DEFINED = 16,     // defined, type not known
+  ELEMENT_DEFINED_INT,
+  ELEMENT_DEFINED_REAL,
+  ELEMENT_DEFINED_STR,
+  ELEMENT_DEFINED_BOOLEAN,
+  ELEMENT_INT_SLOT,         // only ever an int, kept in memory->ints
+  ELEMENT_REAL_SLOT         // only ever a real, kept in memory->reals
+};
+
+#define ELEMENT_IS_DEFINED(type) ((type) >= ELEMENT_DEFINED && (type) <= ELEMENT_DEFINED_BOOLEAN)
+#define ELEMENT_IS_SLOT(type) ((type) == ELEMENT_INT_SLOT || (type) == ELEMENT_REAL_SLOT)
+#define ELEMENT_IS_ANALYZED(type) ((type) >= ELEMENT_DEFINED && (type) <= ELEMENT_REAL_SLOT)
+
+//
+// Flags or'ed into an EXPR's operator when the types of both
+// operands are known:
+//
+#define EXPR_INT_OPERANDS   0x100  // int and int
+#define EXPR_REAL_OPERANDS  0x200  // int or real, at least one real
+#define EXPR_STR_OPERANDS   0x400  // str and str
+#define EXPR_OPERATOR_MASK  0x0FF  // the enum OPERATORS part
+
+//
+// Flags or'ed into the rhs value_type of an assignment whose
+// variable only ever holds an int (or a real); its var_name then
+// gives the slot, see ANALYZE_SLOT:
+//
+#define VALUE_INT_TARGET    0x100
+#define VALUE_REAL_TARGET   0x200
+#define VALUE_TYPE_MASK     0x0FF  // the enum VALUE_TYPES part
+
+//
+// The element_value / var_name of an annotated node points at the
+// name of one of these, which is stored right after it:
+//
+struct ANALYZE_NAME
+{
+  int   addr;  // where the variable was last found in memory
+  int   slot;  // int or real slot, -1 if none
+  char* name;  // == (char*) (this + 1)
+};
+
+#define ANALYZE_NAME_OF(var_name) ((struct ANALYZE_NAME*) (var_name) - 1)
+#define ANALYZE_SLOT(var_name) (ANALYZE_NAME_OF(var_name)->slot)
+
+//
+// Log of the annotations made to a program graph.
+//
+struct ANALYSIS;
+
+
+//
+// Public functions:
+//
+
+//
+// analyze_program
+//
+// Infers the types of the variables at every point of the given
+// program graph, following loops until nothing changes. Reads of
+// variables that are defined on every path get an ELEMENT_DEFINED*
+// element type, and binary expressions whose operand types are
+// known get an EXPR_*_OPERANDS flag, so execute() can skip those
+// checks. Variables that only ever hold an int, or only ever a
+// real, are given a slot in memory's untagged arrays: their reads
+// become ELEMENT_INT_SLOT / ELEMENT_REAL_SLOT and assignments to
+// them get a VALUE_*_TARGET flag. Errors that happen whenever
+// their statement runs (e.g. reading a variable that is never
+// assigned, or "a" + 1) are written to report, if not NULL,
+// before anything executes: as a **STATIC ERROR if the statement
+// runs whenever the program does, else, if it is in a loop or a
+// branch that may never run, as a **STATIC WARNING. Programs too
+// big to analyze quickly are not analyzed.
+//
+// Returns a log of the annotations, which must be passed to
+// analyze_restore() before the graph is destroyed or printed.
+//
+struct ANALYSIS* analyze_program(struct STMT* program, FILE* report);
+
+//
+// analyze_reserve
+//
+// Makes room in memory for the slots the analysis gave out. Must
+// be called before the analyzed program executes with memory.
+// Returns true if successful.
+//
+bool analyze_reserve(struct ANALYSIS* analysis, struct RAM* memory);
+
+//
+// analyze_peek
+//
+// Returns the value of an element annotated by analyze_program(),
+// like ram_peek_cell_by_name() but remembering the variable's
+// address so later reads are a single comparison. Returns NULL if
+// the variable is not in memory after all.
+//
+struct RAM_VALUE* analyze_peek(struct RAM* memory, struct ELEMENT* element);
+
+//
+// analyze_restore
+//
+// Removes the annotations recorded in the given log, returning
+// the graph to its original form, and frees the log.
+//
+void analyze_restore(struct ANALYSIS* analysis);
@@ -0,0 +1,354 @@
+/*batch.c*/
+
+//
+// Runs many nuPython programs at once on a pool of threads. The
+// executor and memory are reentrant, and each program prints into
+// its own captured OUTPUT, so programs never share state. The
+// parser and program graph builder print their messages with
+// printf, so they run one at a time with file descriptor 1
+// pointed at a temporary file, and what they print is moved into
+// the capture. The only other writes to standard output are the
+// finished programs' output, which is written under the same
+// lock, so nothing else ends up in the file.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>   // dup, dup2, pread, ftruncate
+
+#include "token.h"
+#include "scanner.h"
+#include "parser.h"
+#include "tokenqueue.h"
+
+#include "programgraph.h"
+#include "ram.h"
+#include "execute.h"
+#include "optimize.h"
+#include "output.h"
+#include "nupyc.h"
+#include "source.h"
+#include "analyze.h"
+#include "batch.h"
+
+
+//
+// One program to run:
+//
+struct BATCH_JOB
+{
+  char*          filename;
+  struct OUTPUT* out;   // everything the program printed
+  bool           done;
+};
+
+//
+// State shared by the worker threads:
+//
+struct BATCH
+{
+  struct BATCH_JOB* jobs;
+  int               num_jobs;
+  int               next_job;  // next job to hand out
+  bool              repr;
+  bool              use_cache;
+
+  pthread_mutex_t   lock;      // protects next_job and jobs[].done
+  pthread_cond_t    job_done;
+};
+
+
+//
+// the parser and graph builder write to stdout, so only one
+// thread at a time may be in them, or write to stdout; what they
+// print goes to a temporary file, NULL if none could be made:
+//
+static pthread_mutex_t FrontEndLock = PTHREAD_MUTEX_INITIALIZER;
+static FILE* FrontEndCapture = NULL;
+
+
+//
+// Private functions:
+//
+
+//Takes jobs off the batch until there are none left
+static void* worker(void* arg);
+
+//Parses and executes one program, output goes to job->out
+static void run_program(struct BATCH_JOB* job, bool use_cache);
+
+//Runs the parser and graph builder with their output captured
+static struct STMT* build_program(struct SOURCE* source, struct OUTPUT* out, struct TokenQueue** tokens);
+
+
+//
+// Public functions:
+//
+
+//
+// batch_run
+//
+// Runs the given files num_threads at a time, writing their
+// output to standard output in the order given.
+//
+void batch_run(char* filenames[], int num_files, int num_threads, bool repr, bool use_cache)
+{
+  struct OUTPUT* out = output_current();  // create stdout before threads start
+
+  if (num_files <= 0)
+    return;
+  if (num_threads < 1)
+    num_threads = 1;
+  if (num_threads > num_files)
+    num_threads = num_files;
+
+  struct BATCH batch;
+  batch.jobs = (struct BATCH_JOB*) malloc(num_files * sizeof(struct BATCH_JOB));
+  if (batch.jobs == NULL) {
+    output_puts(out, "**OUT OF MEMORY (batch)");
+    return;
+  }
+  batch.num_jobs = num_files;
+  batch.next_job = 0;
+  batch.repr = repr;
+  batch.use_cache = use_cache;
+  pthread_mutex_init(&batch.lock, NULL);
+  pthread_cond_init(&batch.job_done, NULL);
+
+  FrontEndCapture = tmpfile();  // NULL => the front end prints straight to stdout
+
+  for (int i = 0; i < num_files; i++) {
+    batch.jobs[i].filename = filenames[i];
+    batch.jobs[i].out = NULL;
+    batch.jobs[i].done = false;
+  }
+
+  pthread_t* threads = (pthread_t*) malloc(num_threads * sizeof(pthread_t));
+  int num_started = 0;
+
+  if (threads != NULL) {
+    for (; num_started < num_threads; num_started++) {
+      if (pthread_create(&threads[num_started], NULL, worker, &batch) != 0)
+        break;
+    }
+  }
+
+  if (num_started == 0) // no threads, run everything here
+    worker(&batch);
+
+  //
+  // write each program's output once it and all before it are done:
+  //
+  for (int i = 0; i < num_files; i++) {
+    pthread_mutex_lock(&batch.lock);
+    while (!batch.jobs[i].done)
+      pthread_cond_wait(&batch.job_done, &batch.lock);
+    pthread_mutex_unlock(&batch.lock);
+
+    pthread_mutex_lock(&FrontEndLock);  // fd 1 may be redirected
+
+    struct OUTPUT* captured = batch.jobs[i].out;
+    if (captured != NULL) {
+      output_write(out, captured->buffer, captured->length);
+      output_destroy(captured);
+    }
+    output_sync(out);
+
+    pthread_mutex_unlock(&FrontEndLock);
+  }
+
+  for (int i = 0; i < num_started; i++)
+    pthread_join(threads[i], NULL);
+
+  if (FrontEndCapture != NULL) {
+    fclose(FrontEndCapture);
+    FrontEndCapture = NULL;
+  }
+
+  pthread_cond_destroy(&batch.job_done);
+  pthread_mutex_destroy(&batch.lock);
+  free(threads);
+  free(batch.jobs);
+}
+
+
+//
+// Private functions:
+//
+
+static void* worker(void* arg)
+{
+  struct BATCH* batch = (struct BATCH*) arg;
+
+  while (true) {
+    pthread_mutex_lock(&batch->lock);
+    int i = batch->next_job++;
+    pthread_mutex_unlock(&batch->lock);
+
+    if (i >= batch->num_jobs)
+      break;
+
+    struct BATCH_JOB* job = &batch->jobs[i];
+
+    job->out = output_init(OUTPUT_CAPTURE, OUTPUT_FLUSH_NEVER);
+    if (job->out != NULL) {
+      job->out->repr = batch->repr;
+
+      output_set_current(job->out);
+      run_program(job, batch->use_cache);
+      output_set_current(NULL);
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    job->done = true;
+    pthread_cond_broadcast(&batch->job_done);
+    pthread_mutex_unlock(&batch->lock);
+  }
+
+  return NULL;
+}
+
+static void run_program(struct BATCH_JOB* job, bool use_cache)
+{
+  struct OUTPUT* out = job->out;
+
+  struct SOURCE* source = source_open(job->filename);
+
+  if (source == NULL) // unable to open:
+  {
+    output_printf(out, "**ERROR: unable to open input file '%s' for input.\n", job->filename);
+    return;
+  }
+
+  unsigned long long source_hash = 0;
+  long long source_length = -1;
+  struct NUPYC* image = NULL;
+
+  if (use_cache) {
+    source_hash = nupyc_hash_buffer(source->text, source->length);
+    source_length = (long long) source->length;
+    image = nupyc_cache_load(source_hash, source_length);
+  }
+
+  struct TokenQueue* tokens = NULL;
+  struct STMT* program = NULL;
+
+  if (image != NULL) {
+    output_puts(out, "**parsing successful, valid syntax");
+    output_puts(out, "**building program graph...");
+    program = nupyc_program(image);
+  }
+  else {
+    program = build_program(source, out, &tokens);
+
+    if (tokens == NULL) { // syntax error, already output:
+      source_close(source);
+      return;
+    }
+
+    if (use_cache)
+      nupyc_cache_store(program, source_hash, source_length);
+  }
+
+  source_close(source);
+
+  struct OPT_LOG* optimizations = optimize_program(program);
+  struct ANALYSIS* analysis = analyze_program(program, NULL);  // keep captures as-is
+
+  output_puts(out, "**executing...");
+
+  struct RAM* memory = ram_init();
+  analyze_reserve(analysis, memory);
+
+  execute(program, memory);
+
+  output_puts(out, "**done");
+
+  ram_print(memory);
+
+  //
+  // cleanup:
+  //
+  ram_destroy(memory);
+  analyze_restore(analysis);
+  optimize_restore(optimizations);
+  if (image != NULL) {
+    nupyc_close(image);
+  }
+  else {
+    programgraph_destroy(program);
+    tokenqueue_destroy(tokens);
+  }
+}
+
+static struct STMT* build_program(struct SOURCE* source, struct OUTPUT* out, struct TokenQueue** tokens)
+{
+  struct STMT* program = NULL;
+
+  pthread_mutex_lock(&FrontEndLock);
+
+  //
+  // point file descriptor 1 at the capture file; stdout's buffer
+  // is flushed on either side so nothing crosses over:
+  //
+  int capture = (FrontEndCapture != NULL) ? fileno(FrontEndCapture) : -1;
+  int console = -1;
+
+  if (capture >= 0) {
+    fflush(stdout);
+    console = dup(STDOUT_FILENO);
+    if (console >= 0 && dup2(capture, STDOUT_FILENO) < 0) {
+      close(console);
+      console = -1;
+    }
+  }
+
+  *tokens = parser_parse_buffer(source->text, source->length);
+
+  if (*tokens == NULL)
+  {
+    printf("**parsing failed...\n");
+  }
+  else
+  {
+    printf("**parsing successful, valid syntax\n");
+    printf("**building program graph...\n");
+
+    program = programgraph_build(*tokens);
+  }
+
+  if (console >= 0) {
+    fflush(stdout);
+    dup2(console, STDOUT_FILENO);
+    close(console);
+
+    //
+    // the descriptors share one offset, the end of what was printed;
+    // move it into the capture and empty the file for the next:
+    //
+    off_t length = lseek(capture, 0, SEEK_CUR);
+    char chunk[4096];
+
+    for (off_t pos = 0; pos < length; ) {
+      ssize_t n = pread(capture, chunk, sizeof(chunk), pos);
+      if (n <= 0)
+        break;
+      output_write(out, chunk, (size_t) n);
+      pos += n;
+    }
+
+    if (ftruncate(capture, 0) != 0 || lseek(capture, 0, SEEK_SET) != 0) {
+      fclose(FrontEndCapture);  // can't be reused, print directly from now on
+      FrontEndCapture = NULL;
+    }
+  }
+
+  pthread_mutex_unlock(&FrontEndLock);
+
+  return program;
+}
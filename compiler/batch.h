@@ -0,0 +1,34 @@
+/*batch.h*/
+
+//
+// Runs many nuPython programs at once on a pool of threads.
+
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+//
+// Public functions:
+//
+
+//
+// batch_run
+//
+// Parses and executes each of the given files, num_threads at
+// a time. Every program gets its own memory and its own output
+// buffer; the buffers are written to standard output in the
+// order the files were given, each as soon as it and all the
+// files before it are done, so the output is identical to
+// running the files one after the other. If repr is true, reals
+// are printed the way Python does; if use_cache is true, programs
+// are loaded from and saved to the compiled program cache.
+//
+// NOTE: programs that call input() all read from the same
+// standard input, in no particular order. The prebuilt scanner,
+// parser and program graph builder call exit() when they fail
+// (e.g. out of memory); that ends the whole batch, and the output
+// of programs not yet written is lost.
+//
+void batch_run(char* filenames[], int num_files, int num_threads, bool repr, bool use_cache);
@@ -14,10 +14,17 @@
 #include <stdbool.h>  // true, false
 #include <string.h>
 #include <assert.h>
+#include <limits.h>   // INT_MAX
 
 #include "programgraph.h"
 #include "ram.h"
 #include "execute.h"
+#include "output.h"
+#include "format.h"
+#include "input.h"
+#include "analyze.h"
+#include "optimize.h"
+#include "reduce.h"
 #include <math.h>
 
 //
@@ -29,6 +36,14 @@
 // declare them here with the keyword static,
 // and implement them at the end of the file (still with keyword static)
 
+//Executes one statement of any type
+//
+// Takes the statement, a memory structure, and where to store the
+// statement that follows
+//
+// Returns true if successful, false o/w
+static bool execute_stmt(struct STMT* stmt, struct RAM* memory, struct STMT** next);
+
 //Executes a function call statement 
 //
 // Takes a statement structure and a memory sttrucutre
@@ -85,14 +100,16 @@ static struct RESULT execute_input_function(char* prompt, int line);
 //
 // Takes the string to convert and the line number for error reporting
 //
-// Returns a result structure containing the integer value if successful
+// Returns a result structure containing the integer value if successful,
+// after outputting an error message if the string is not a valid int
 static struct RESULT execute_int_function(char* s, int line);
 
 //Converts a string to a float value
 //
 // Takes the string to convert and the line number for error reporting
 //
-// Returns a result structure containing the float value if successful
+// Returns a result structure containing the float value if successful,
+// after outputting an error message if the string is not a valid float
 static struct RESULT execute_float_function(char* s, int line);
 
 
@@ -104,6 +121,14 @@ static struct RESULT execute_float_function(char* s, int line);
 // Returns  a result strucutrue containing success and value arguments.
 static struct RESULT execute_binary_expression(struct EXPR* expr, struct RAM* memory, int line);
 
+//Checks for an assignment of the form s = s + t, which can append
+// to s in place instead of building a new string
+//
+// Takes the variable assigned to and the expression assigned
+//
+// Returns true if the expression is the variable plus something
+static bool is_self_append(char* varname, struct EXPR* expr);
+
 // Retrieves the values of an element struct
 //
 //Takes a pointer to the element struct, memory struct, and the line number of the expression
@@ -112,6 +137,59 @@ static struct RESULT execute_binary_expression(struct EXPR* expr, struct RAM* me
 // Returns  a result strucutrue containing success and value arguments.
 static struct RESULT retrieve_value(struct ELEMENT* element, struct RAM* memory, int line);
 
+//Evaluates the condition of a while loop or if statement
+//
+// Returns a result structure containing success and the value
+static struct RESULT execute_condition(struct EXPR* condition, struct RAM* memory, int line);
+
+//Returns the statement a lowered if/elif chain goes to for the int value
+static struct STMT* execute_switch(struct OPT_SWITCH* sw, int value);
+
+//Executes a fused statement directly on its variables' memory cells
+//
+// Returns true and sets *next if successful, false (having changed
+// nothing) if the operands aren't of the types the fused operation
+// handles, in which case the statement as written must run instead
+static bool execute_fused(struct OPT_FUSED* fused, struct RAM* memory, struct STMT** next);
+
+//Executes one statement like execute_stmt(), except that a counted
+// loop runs to the end in one go
+static bool execute_run(struct STMT* stmt, struct RAM* memory, struct STMT** next);
+
+//Reads a counted loop's i and n into *i and *limit
+//
+// Returns false if either is not an int, in which case the loop must
+// run as written
+static bool counted_start(struct OPT_COUNTED* counted, struct RAM* memory, int* i, int* limit);
+
+//Runs a counted loop from i until it ends, keeping i in a local
+//
+// Returns true if successful, false after outputting an error message;
+// i's memory cell is up to date either way
+static bool execute_counted(struct OPT_COUNTED* counted, struct RAM* memory, int i, int limit, struct STMT** next);
+
+//Runs a counted loop that is a reduction in one go, from *i up to
+// limit, and sets *i to where the loop would stop
+//
+// Returns false, having changed nothing, if the sum can't be done
+// exactly this way (e.g. i would wrap around, or total is a real
+// too large or not whole), in which case the loop must run
+static bool execute_reduction(struct OPT_COUNTED* counted, struct RAM* memory, int* i, int limit);
+
+//Returns the memory cell of a fused statement's operand, NULL if the
+// variable is not defined
+static struct RAM_CELL* fused_cell(struct RAM* memory, struct OPT_OPERAND* operand);
+
+//Returns where an int (or real) cell's value lives, its slot if bound to one
+static int* cell_int(struct RAM* memory, struct RAM_CELL* cell);
+static double* cell_real(struct RAM* memory, struct RAM_CELL* cell);
+
+//Writes the value assigned by an assignment to its variable, straight
+// into the variable's slot if analyze.c gave it one
+//
+// Returns true if successful
+static bool write_variable(struct STMT_ASSIGNMENT* assignment, struct RAM_VALUE value, struct RAM* memory);
+
 
 
 struct RESULT
@@ -120,6 +198,8 @@ struct RESULT
   struct RAM_VALUE ram_value;  
 
 };
+
+EXECUTE_THREAD_LOCAL struct STMT* volatile execute_current = NULL;
 //
 // Public functions:
 //
@@ -138,51 +218,180 @@ void execute(struct STMT* program, struct RAM* memory)
   struct STMT* stmt = program;
 
   while(stmt != NULL) {
-    if (stmt->stmt_type == STMT_ASSIGNMENT){
-      int stmt_line = stmt->line;
-      //printf("Line %d: assignment\n", stmt_line);
-      if (execute_assignment(stmt, memory) == false){
-        return;
-      }
-      stmt = stmt->types.assignment->next_stmt;
+    if (!execute_run(stmt, memory, &stmt)){
+      output_sync(output_current()); // stopped by an error, show it now
+      execute_current = NULL;
+      return;
     }
-    else if (stmt->stmt_type == STMT_FUNCTION_CALL){
-      int stmt_line = stmt->line;
-      //printf("Line %d: function call\n", stmt_line);
-      if (execute_function_call(stmt, memory) == false){
-        return;
-      }
-      stmt = stmt->types.function_call->next_stmt;
-    }
-    else if (stmt->stmt_type == STMT_WHILE_LOOP){
-      struct EXPR* condition = stmt->types.while_loop->condition;
-      struct RESULT condition_result;
-
-        if (condition->isBinaryExpr) {
-          condition_result = execute_binary_expression(condition, memory, stmt->line);
-        } 
-        else {
-          // If not a binary expression, just retrieve the value of lhs
-          condition_result = retrieve_value(condition->lhs->element, memory, stmt->line);
-        }
+  }
+  execute_current = NULL;
+}
 
-      if(!condition_result.success){
-        return;
-      }
-      if(condition_result.ram_value.types.i != 0){
-        stmt = stmt->types.while_loop->loop_body;
-      }
-      else{
-        stmt = stmt->types.while_loop->next_stmt;
-      }
+//
+// execute_step
+//
+// Executes the single statement stmt and returns the statement
+// that runs next, or NULL if the program is done or a semantic
+// error occurred (*success tells which).
+//
+struct STMT* execute_step(struct STMT* stmt, struct RAM* memory, bool* success)
+{
+  struct STMT* next = NULL;
+
+  *success = execute_stmt(stmt, memory, &next);
+  if (!*success){
+    output_sync(output_current());
+    return NULL;
+  }
+  return next;
+}
+
+//
+// execute_unit
+//
+// Executes stmt like execute_step(), a counted loop to its end.
+//
+struct STMT* execute_unit(struct STMT* stmt, struct RAM* memory, bool* success)
+{
+  struct STMT* next = NULL;
+
+  *success = execute_run(stmt, memory, &next);
+  if (!*success){
+    output_sync(output_current());
+    return NULL;
+  }
+  return next;
+}
+
+//
+// execute_with_budget
+//
+// Executes at most max_steps statements of the program, starting
+// where the cursor left off, and returns the cursor's status.
+//
+int execute_with_budget(struct STMT* program, struct RAM* memory, struct EXECUTE_CURSOR* cursor, long long max_steps)
+{
+  if (cursor->status == EXECUTE_READY){ // first call, start at the top
+    cursor->stmt = program;
+    cursor->status = EXECUTE_PAUSED;
+  }
+  if (cursor->status != EXECUTE_PAUSED){
+    return cursor->status;
+  }
+
+  struct STMT* stmt = cursor->stmt;
+  long long steps = 0;
+
+  while(stmt != NULL && steps < max_steps) {
+    if (!execute_stmt(stmt, memory, &stmt)){
+      cursor->stmt = stmt; // the stmt that failed
+      cursor->steps += steps + 1;
+      cursor->status = EXECUTE_FAILED;
+      output_sync(output_current());
+      execute_current = NULL;
+      return cursor->status;
+    }
+    steps++;
+  }
+  execute_current = NULL;
+
+  cursor->stmt = stmt;
+  cursor->steps += steps;
+  if (stmt == NULL){
+    cursor->status = EXECUTE_COMPLETED;
+  }
+  return cursor->status;
+}
+
+//
+// Executes one statement and sets *next to the statement that
+// follows. Returns false if a semantic error occurred, in which
+// case *next is left unchanged.
+//
+static bool execute_stmt(struct STMT* stmt, struct RAM* memory, struct STMT** next)
+{
+  execute_current = stmt;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT){
+    int stmt_line = stmt->line;
+    //printf("Line %d: assignment\n", stmt_line);
+    if (execute_assignment(stmt, memory) == false){
+      return false;
+    }
+    *next = stmt->types.assignment->next_stmt;
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL){
+    int stmt_line = stmt->line;
+    //printf("Line %d: function call\n", stmt_line);
+    if (execute_function_call(stmt, memory) == false){
+      return false;
+    }
+    *next = stmt->types.function_call->next_stmt;
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP){
+    struct RESULT condition_result = execute_condition(stmt->types.while_loop->condition, memory, stmt->line);
+
+    if(!condition_result.success){
+      return false;
+    }
+    if(condition_result.ram_value.types.i != 0){
+      *next = stmt->types.while_loop->loop_body;
+    }
+    else{
+      *next = stmt->types.while_loop->next_stmt;
+    }
+  }
+  else if (stmt->stmt_type == STMT_IF_THEN_ELSE){
+    struct RESULT condition_result = execute_condition(stmt->types.if_then_else->condition, memory, stmt->line);
+
+    if(!condition_result.success){
+      return false;
+    }
+    if(condition_result.ram_value.types.i != 0){
+      *next = stmt->types.if_then_else->true_path;
+    }
+    else{
+      *next = stmt->types.if_then_else->false_path;
+    }
+  }
+  else if (stmt->stmt_type == STMT_SWITCH){
+    struct OPT_SWITCH* sw = OPT_SWITCH_OF(stmt);
+    struct RESULT value = retrieve_value(sw->var, memory, stmt->line);
+
+    if(!value.success){
+      return false;
+    }
+    if(value.ram_value.value_type != RAM_TYPE_INT){
+      *next = sw->fallback; // compare as written
     }
     else{
-      assert(stmt->stmt_type == STMT_PASS);
-      int stmt_line = stmt->line;
-      // printf("Line %d: pass\n", stmt_line);
-      stmt = stmt->types.pass->next_stmt;
+      *next = execute_switch(sw, value.ram_value.types.i);
+    }
+  }
+  else if (stmt->stmt_type == STMT_FUSED){
+    struct OPT_FUSED* fused = OPT_FUSED_OF(stmt);
+
+    if (execute_fused(fused, memory, next)){
+      fused->runs++;
     }
+    else{
+      fused->fallbacks++;
+      return execute_stmt(fused->original, memory, next);
+    }
+  }
+  else if (stmt->stmt_type == STMT_COUNTED){
+    struct OPT_COUNTED* counted = OPT_COUNTED_OF(stmt);
+
+    counted->fallbacks++; // one test at a time
+    return execute_stmt(counted->original, memory, next);
+  }
+  else{
+    assert(stmt->stmt_type == STMT_PASS);
+    int stmt_line = stmt->line;
+    // printf("Line %d: pass\n", stmt_line);
+    *next = stmt->types.pass->next_stmt;
   }
+  return true;
 }
 
 bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
@@ -208,9 +417,10 @@ bool execute_function_call(struct STMT* stmt, struct RAM* memory) {
 // Helper function to execute print function calls
 static bool execute_print(struct STMT* stmt, struct RAM* memory) {
   struct ELEMENT* parameter = stmt->types.function_call->parameter;
+  struct OUTPUT* out = output_current();
   
   if (parameter == NULL) {
-    printf("\n"); // Print empty line if no parameter
+    output_write(out, "\n", 1); // Print empty line if no parameter
     return true;
   }
   
@@ -219,43 +429,49 @@ static bool execute_print(struct STMT* stmt, struct RAM* memory) {
   
   if (element_type == ELEMENT_INT_LITERAL) {
     int int_value = atoi(value);
-    printf("%d\n", int_value); // Print integer literal
+    output_int(out, int_value); // Print integer literal
+    output_write(out, "\n", 1);
   }
-  else if (element_type == ELEMENT_IDENTIFIER) {
-    struct RAM_VALUE* ram_value = ram_read_cell_by_name(memory, value);
+  else if (element_type == ELEMENT_IDENTIFIER || ELEMENT_IS_ANALYZED(element_type)) {
+    struct RAM_VALUE* ram_value = (element_type == ELEMENT_IDENTIFIER)
+      ? ram_peek_cell_by_name(memory, value)
+      : analyze_peek(memory, parameter);
     
     int line = stmt->line;
     if (ram_value == NULL) {
       // Error if variable is undefined
-      printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
+      output_printf(out, "**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
       return false;
     }
     // Print element based on type
     if (ram_value->value_type == RAM_TYPE_INT) {
-      printf("%d\n", ram_value->types.i);
+      output_int(out, ram_value->types.i);
+      output_write(out, "\n", 1);
     }
     else if (ram_value->value_type == RAM_TYPE_REAL) {
-      printf("%f\n", ram_value->types.d);
+      output_real(out, ram_value->types.d);
+      output_write(out, "\n", 1);
     }
     else if (ram_value->value_type == RAM_TYPE_STR) {
-      printf("%s\n", ram_value->types.s);
+      output_puts(out, ram_value->types.s);
     }
     else if (ram_value->value_type == RAM_TYPE_BOOLEAN) {
-      printf("%s\n", ram_value->types.i ? "True" : "False");
+      output_puts(out, ram_value->types.i ? "True" : "False");
     }
   }
   else if (element_type == ELEMENT_REAL_LITERAL) {
     double real_value = atof(value);
-    printf("%f\n", real_value); // Print Float value
+    output_real(out, real_value); // Print Float value
+    output_write(out, "\n", 1);
   }
   else if (element_type == ELEMENT_STR_LITERAL) {
-    printf("%s\n", value); // Print string value
+    output_puts(out, value); // Print string value
   }
   else if (element_type == ELEMENT_TRUE || element_type == ELEMENT_FALSE) {
-    printf("%s\n", value); // Print boolean value
+    output_puts(out, value); // Print boolean value
   }
   else {
-    printf("%s\n", value); // Print other literals
+    output_puts(out, value); // Print other literals
   }
   
   return true;
@@ -265,39 +481,18 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory){
   if(stmt->stmt_type == STMT_ASSIGNMENT){
     
     char* varname = stmt->types.assignment->var_name; // Get variable name
-    if (stmt->types.assignment->rhs->value_type == VALUE_FUNCTION_CALL){
-      char* function_name = stmt->types.assignment->rhs->types.function_call->function_name;
-      
-      struct RESULT function_result;
-      function_result.success = false;
-      if(strcmp(function_name, "input") == 0){
-        char* input_prompt = stmt->types.assignment->rhs->types.function_call->parameter->element_value;
-        function_result = execute_input_function(input_prompt, stmt->line);
-      }
-      else if(strcmp(function_name, "int") == 0){
-        char* str_variable = stmt->types.assignment->rhs->types.function_call->parameter->element_value;
-        struct RAM_VALUE* str_value = ram_read_cell_by_name(memory, str_variable);
-
-        function_result = execute_int_function(str_value->types.s, stmt->line);
-
-        if(!function_result.success){
-          printf("**SEMANTIC ERROR: invalid string for int() (line %d)\n", stmt->line);
-          return false;
-        }
+    if ((stmt->types.assignment->rhs->value_type & VALUE_TYPE_MASK) == VALUE_FUNCTION_CALL){
+      struct RAM_VALUE function_value;
 
+      if (!execute_call(stmt->types.assignment->rhs->types.function_call, memory, stmt->line, &function_value)){
+        return false;
       }
-      else if (strcmp(function_name, "float") == 0){
-        char* str_variable = stmt->types.assignment->rhs->types.function_call->parameter->element_value;
-        struct RAM_VALUE* str_value = ram_read_cell_by_name(memory, str_variable);
-
-        function_result = execute_float_function(str_value->types.s, stmt->line);
-
-        if(!function_result.success){
-          printf("**SEMANTIC ERROR: invalid string for float() (line %d)\n", stmt->line);
-          return false;
-        }
+      if (function_value.value_type == RAM_TYPE_STR){
+        // input()'s line, memory keeps it instead of a copy
+        char* line = function_value.types.s;
+        return ram_take_str_by_name(memory, line, (int) strlen(line), varname);
       }
-      if (ram_write_cell_by_name(memory, function_result.ram_value, varname) == false){
+      if (write_variable(stmt->types.assignment, function_value, memory) == false){
         return false;
       }
       return true;
@@ -305,6 +500,21 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory){
     else {
       struct EXPR* expr = stmt->types.assignment->rhs->types.expr; // rhs value
       
+      if (is_self_append(varname, expr)){
+        int address = ram_get_addr(memory, varname);
+        struct RAM_VALUE* target = ram_peek_cell_by_addr(memory, address);
+
+        if (target != NULL && target->value_type == RAM_TYPE_STR){
+          struct RESULT suffix = retrieve_value(expr->rhs->element, memory, stmt->line);
+          if (!suffix.success){
+            return false;
+          }
+          if (suffix.ram_value.value_type == RAM_TYPE_STR){
+            return ram_append_cell_by_addr(memory, suffix.ram_value.types.s, address);
+          }
+        }
+        // not str + str, evaluate as usual (and report the error)
+      }
 
       struct RESULT result;
       
@@ -318,7 +528,12 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory){
         return false; 
       }
       //write value to memory cell
-      if (ram_write_cell_by_name(memory, result.ram_value, varname) == false){
+      bool written = write_variable(stmt->types.assignment, result.ram_value, memory);
+
+      if (expr->isBinaryExpr && result.ram_value.value_type == RAM_TYPE_STR){
+        free(result.ram_value.types.s); // concatenation, memory made its own copy
+      }
+      if (!written){
         return false; //Error writing to memory
       }
       return true;
@@ -327,16 +542,60 @@ bool execute_assignment(struct STMT* stmt, struct RAM* memory){
   }
   return false;
 }
+//
+// execute_call
+//
+// Calls input(), int() or float() and stores the result in *value.
+// Returns false after outputting an error message if the call
+// fails.
+//
+bool execute_call(struct FUNCTION_CALL* call, struct RAM* memory, int line, struct RAM_VALUE* value){
+  char* function_name = call->function_name;
+
+  struct RESULT function_result;
+  function_result.success = false;
+  function_result.ram_value.value_type = RAM_TYPE_NONE; // unknown function
+
+  if(strcmp(function_name, "input") == 0){
+    char* input_prompt = call->parameter->element_value;
+    function_result = execute_input_function(input_prompt, line);
+  }
+  else if(strcmp(function_name, "int") == 0){
+    char* str_variable = call->parameter->element_value;
+    struct RAM_VALUE* str_value = ram_peek_cell_by_name(memory, str_variable);
+
+    function_result = execute_int_function(str_value->types.s, line);
+
+    if(!function_result.success){
+      return false; // error already output
+    }
+  }
+  else if (strcmp(function_name, "float") == 0){
+    char* str_variable = call->parameter->element_value;
+    struct RAM_VALUE* str_value = ram_peek_cell_by_name(memory, str_variable);
+
+    function_result = execute_float_function(str_value->types.s, line);
+
+    if(!function_result.success){
+      return false; // error already output
+    }
+  }
+  *value = function_result.ram_value;
+  return true;
+}
+
 static struct RESULT execute_input_function(char* prompt, int line){
   struct RESULT result;
   result.success = false;
-  char lineBuffer[256];
-  printf("%s", prompt);
-  fgets(lineBuffer, sizeof(lineBuffer), stdin);
-  lineBuffer[strcspn(lineBuffer, "\r\n")] = '\0';
-  char* str_input = (char*) malloc(strlen(lineBuffer) + 1);
-
-  strcpy(str_input, lineBuffer);
+  struct OUTPUT* out = output_current();
+  output_write(out, prompt, strlen(prompt));
+  output_sync(out); // user must see the prompt before we block
+  int length;
+  char* str_input = input_read_line(&length); // any length, the caller owns it
+
+  if (str_input == NULL){ // end of input, an empty line
+    str_input = (char*) calloc(1, 1);
+  }
   result.ram_value.value_type = RAM_TYPE_STR;
   result.ram_value.types.s = str_input;
   return result;
@@ -344,48 +603,28 @@ static struct RESULT execute_input_function(char* prompt, int line){
 
 static struct RESULT execute_int_function(char* s, int line){
   struct RESULT result;
-  result.success = false;
-  int convert = atoi(s);
-  int i = 0;
-  bool valid = true;
-  if (convert != 0){
-    valid = true;
-  }
-  else{
-    for (int i = 0; s[i] != '\0'; i++) {
-    if (s[i] != '0' && s[i] != '.')
-        valid = false;
-    }
+  result.ram_value.value_type = RAM_TYPE_INT;
+
+  int status = format_parse_int(s, &result.ram_value.types.i);
+  result.success = (status == FORMAT_PARSE_OK);
+
+  if (status == FORMAT_PARSE_INVALID){
+    output_printf(output_current(), "**SEMANTIC ERROR: invalid string for int() (line %d)\n", line);
   }
-  if (valid){
-    result.success = true;
-    result.ram_value.value_type = RAM_TYPE_INT;
-    result.ram_value.types.i = convert;
-    return result;
+  else if (status == FORMAT_PARSE_RANGE){
+    output_printf(output_current(), "**SEMANTIC ERROR: int() value out of range (line %d)\n", line);
   }
   return result;
-
 }
 static struct RESULT execute_float_function(char* s, int line){
   struct RESULT result;
-  result.success = false;
-  double convert = atof(s);
-  int i = 0;
-  bool valid = true;
-  if (convert != 0){
-    valid = true;
-  }
-  else{
-    for (int i = 0; s[i] != '\0'; i++) {
-    if (s[i] != '0' && s[i] != '.')
-        valid = false;
-    }
-  }
-  if (valid){
-    result.success = true;
-    result.ram_value.value_type = RAM_TYPE_REAL;
-    result.ram_value.types.d = convert;
-    return result;
+  result.ram_value.value_type = RAM_TYPE_REAL;
+
+  int status = format_parse_real(s, &result.ram_value.types.d);
+  result.success = (status == FORMAT_PARSE_OK);
+
+  if (status == FORMAT_PARSE_INVALID){
+    output_printf(output_current(), "**SEMANTIC ERROR: invalid string for float() (line %d)\n", line);
   }
   return result;
 }
@@ -404,33 +643,94 @@ static struct RESULT execute_binary_expression(struct EXPR* expr, struct RAM* me
     return result;
   }
 
-  if (expr->operator != OPERATOR_NO_OP && expr->rhs != NULL){
+  int operator = expr->operator & EXPR_OPERATOR_MASK;
+
+  if (operator != OPERATOR_NO_OP && expr->rhs != NULL){
     //binary operation
     struct RESULT rhs = retrieve_value(expr->rhs->element, memory, line);
     if(!rhs.success){
       return result;
     }
 
-    if (lhs.ram_value.value_type == RAM_TYPE_STR && rhs.ram_value.value_type == RAM_TYPE_STR){
-        return execute_string(lhs.ram_value, rhs.ram_value, expr->operator, line);
+    //Operand types analyze.c proved, no need to check them
+    if (expr->operator & EXPR_INT_OPERANDS){
+      result = execute_int(lhs.ram_value, rhs.ram_value, operator, line);
     }
-
-    else if (lhs.ram_value.value_type == RAM_TYPE_INT && rhs.ram_value.value_type == RAM_TYPE_INT){
-    return execute_int(lhs.ram_value, rhs.ram_value, expr->operator, line);
+    else if (expr->operator & EXPR_REAL_OPERANDS){
+      result = execute_float(lhs.ram_value, rhs.ram_value, operator, line);
     }
-
-    else if((lhs.ram_value.value_type == RAM_TYPE_REAL && rhs.ram_value.value_type == RAM_TYPE_REAL) || 
-        (lhs.ram_value.value_type == RAM_TYPE_REAL && rhs.ram_value.value_type == RAM_TYPE_INT) ||
-        (lhs.ram_value.value_type == RAM_TYPE_INT && rhs.ram_value.value_type == RAM_TYPE_REAL)){
-      
-      return execute_float(lhs.ram_value, rhs.ram_value, expr->operator, line);
+    else if (expr->operator & EXPR_STR_OPERANDS){
+      result = execute_string(lhs.ram_value, rhs.ram_value, operator, line);
+    }
+    else{
+      result.success = execute_operator(lhs.ram_value, rhs.ram_value, operator, line, &result.ram_value);
     }
-    printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
     return result;
   }
   return result;
 }
 
+//
+// execute_int_power
+//
+// Square-and-multiply in unsigned arithmetic, which wraps.
+//
+int execute_int_power(int base, int exponent){
+  if (exponent < 0){
+    if (base == 0)
+      return INT_MIN;  // infinite as a real
+    if (base == 1)
+      return 1;
+    if (base == -1)
+      return (exponent % 2 == 0) ? 1 : -1;
+    return 0;
+  }
+
+  unsigned int result = 1;
+  unsigned int factor = (unsigned int) base;
+
+  while (exponent > 0){
+    if (exponent & 1)
+      result *= factor;
+    factor *= factor;
+    exponent >>= 1;
+  }
+  return (int) result;
+}
+
+//
+// execute_operator
+//
+// Applies operator to lhs and rhs, dispatching on their types.
+// Returns false after outputting an error message if the types
+// don't allow it.
+//
+bool execute_operator(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int operator, int line, struct RAM_VALUE* value){
+  struct RESULT result;
+  result.success = false;
+
+  if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR){
+    result = execute_string(lhs, rhs, operator, line);
+  }
+  else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_INT){
+    result = execute_int(lhs, rhs, operator, line);
+  }
+  else if((lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) || 
+      (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) ||
+      (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL)){
+    result = execute_float(lhs, rhs, operator, line);
+  }
+  else {
+    output_printf(output_current(), "**SEMANTIC ERROR: invalid operand types (line %d)\n", line);
+    return false;
+  }
+
+  if (result.success){
+    *value = result.ram_value;
+  }
+  return result.success;
+}
+
 static struct RESULT execute_string(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int operator, int line){
   struct RESULT result;
   result.success = false;
@@ -440,7 +740,7 @@ static struct RESULT execute_string(struct RAM_VALUE lhs, struct RAM_VALUE rhs,
     char* concat_string = (char*) malloc(strlen(lhs.types.s) + strlen(rhs.types.s) + 1);
 
     if (concat_string == NULL){
-      printf("**Segmentation Fault: memory allocation failed (line %d)\n", line);
+      output_printf(output_current(), "**Segmentation Fault: memory allocation failed (line %d)\n", line);
       return result;
     }
 
@@ -481,7 +781,7 @@ static struct RESULT execute_string(struct RAM_VALUE lhs, struct RAM_VALUE rhs,
     return result;
   }
 
- printf("**SEMANTIC ERROR: invalid operand for string (line %d)\n", line);
+ output_printf(output_current(), "**SEMANTIC ERROR: invalid operand for string (line %d)\n", line);
  return result;
 }
 static struct RESULT execute_int(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int operator, int line){
@@ -495,23 +795,23 @@ static struct RESULT execute_int(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int
   if (operator == OPERATOR_PLUS){ // Addition
     
     result.success = true;      
-    result.ram_value.types.i = lhs_value + rhs_value;
+    result.ram_value.types.i = (int) ((unsigned int) lhs_value + (unsigned int) rhs_value);
     return result;
   }
   else if (operator == OPERATOR_MINUS){ // Substraction
     result.success = true;        
-    result.ram_value.types.i = lhs_value - rhs_value;
+    result.ram_value.types.i = (int) ((unsigned int) lhs_value - (unsigned int) rhs_value);
     return result;
   }
   else if(operator== OPERATOR_ASTERISK){//Multiplication
     result.success = true;
-    result.ram_value.types.i = lhs_value * rhs_value;
+    result.ram_value.types.i = (int) ((unsigned int) lhs_value * (unsigned int) rhs_value);
     return result;
   }
   else if(operator == OPERATOR_MOD){ // Modulo
     if (rhs_value == 0)
     {//Handle division by 0
-      printf( "**ZeroDivisionError: division by zero (line %d)\n", line);
+      output_printf(output_current(), "**ZeroDivisionError: division by zero (line %d)\n", line);
       result.success = false;
       return result;
     }
@@ -522,7 +822,7 @@ static struct RESULT execute_int(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int
   else if(operator == OPERATOR_DIV){ //Division
     if (rhs_value == 0)
     {//Handle division by 0
-      printf( "**ZeroDivisionError: division by zero (line %d)\n", line);
+      output_printf(output_current(), "**ZeroDivisionError: division by zero (line %d)\n", line);
       result.success = false;
       return result;
     }
@@ -532,7 +832,7 @@ static struct RESULT execute_int(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int
   }
   else if(operator == OPERATOR_POWER){ //Power
     result.success = true;
-    result.ram_value.types.i = pow(lhs_value, rhs_value);
+    result.ram_value.types.i = execute_int_power(lhs_value, rhs_value);
     return result;
   }
   
@@ -609,7 +909,7 @@ static struct RESULT execute_float(struct RAM_VALUE lhs, struct RAM_VALUE rhs, i
   else if(operator == OPERATOR_MOD){ // Modulo
     if (rhs_value == 0)
     {//Handle division by 0
-      printf( "**ZeroDivisionError: division by zero (line %d)\n", line);
+      output_printf(output_current(), "**ZeroDivisionError: division by zero (line %d)\n", line);
       result.success = false;
       return result;
     }
@@ -620,7 +920,7 @@ static struct RESULT execute_float(struct RAM_VALUE lhs, struct RAM_VALUE rhs, i
   else if(operator == OPERATOR_DIV){ //Division
     if (rhs_value == 0)
     {//Handle division by 0
-      printf( "**ZeroDivisionError: division by zero (line %d)\n", line);
+      output_printf(output_current(), "**ZeroDivisionError: division by zero (line %d)\n", line);
       result.success = false;
       return result;
     }
@@ -687,8 +987,6 @@ static struct RESULT retrieve_value(struct ELEMENT* element, struct RAM* memory,
 
   char* value = element->element_value; //Get the element value string
 
-  struct RAM_VALUE* varvalue = ram_read_cell_by_name(memory, value); // Read from memory 
-
   if (element->element_type == ELEMENT_INT_LITERAL){//Integer literal case
     result.success = true;
     result.ram_value.types.i = atoi(value);
@@ -696,9 +994,11 @@ static struct RESULT retrieve_value(struct ELEMENT* element, struct RAM* memory,
     return result;
   }
   else if(element->element_type == ELEMENT_IDENTIFIER){//Handle variable identifier
+    struct RAM_VALUE* varvalue = ram_peek_cell_by_name(memory, value); // Read from memory, no copy
+
     if(varvalue == NULL){
       //Error if variable is undefined
-      printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
+      output_printf(output_current(), "**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
       return result;
     }
     result.success = true;
@@ -715,6 +1015,41 @@ static struct RESULT retrieve_value(struct ELEMENT* element, struct RAM* memory,
     }
     return result;
   }
+  else if(ELEMENT_IS_DEFINED(element->element_type)){//Identifier analyze.c proved defined
+    struct RAM_VALUE* varvalue = analyze_peek(memory, element);
+
+    if(varvalue == NULL){
+      output_printf(output_current(), "**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
+      return result;
+    }
+    result.success = true;
+    result.ram_value = *varvalue; // type already known, copy as is
+    return result;
+  }
+  else if(element->element_type == ELEMENT_INT_SLOT){//Variable that is always an int, no tag
+    int slot = ANALYZE_SLOT(value);
+
+    if(memory->int_cells[slot] < 0){
+      output_printf(output_current(), "**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
+      return result;
+    }
+    result.success = true;
+    result.ram_value.value_type = RAM_TYPE_INT;
+    result.ram_value.types.i = memory->ints[slot];
+    return result;
+  }
+  else if(element->element_type == ELEMENT_REAL_SLOT){//Variable that is always a real, no tag
+    int slot = ANALYZE_SLOT(value);
+
+    if(memory->real_cells[slot] < 0){
+      output_printf(output_current(), "**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", value, line);
+      return result;
+    }
+    result.success = true;
+    result.ram_value.value_type = RAM_TYPE_REAL;
+    result.ram_value.types.d = memory->reals[slot];
+    return result;
+  }
   else if(element->element_type == ELEMENT_REAL_LITERAL){
     result.success = true;
     result.ram_value.types.d = atof(value);
@@ -745,4 +1080,323 @@ static struct RESULT retrieve_value(struct ELEMENT* element, struct RAM* memory,
   return result;
 }
 
+static bool is_self_append(char* varname, struct EXPR* expr){
+  if (!expr->isBinaryExpr || (expr->operator & EXPR_OPERATOR_MASK) != OPERATOR_PLUS || expr->rhs == NULL){
+    return false;
+  }
+  struct ELEMENT* lhs = expr->lhs->element;
+
+  return (lhs->element_type == ELEMENT_IDENTIFIER || ELEMENT_IS_ANALYZED(lhs->element_type))
+    && strcmp(lhs->element_value, varname) == 0;
+}
+static bool write_variable(struct STMT_ASSIGNMENT* assignment, struct RAM_VALUE value, struct RAM* memory){
+  int target = assignment->rhs->value_type & (VALUE_INT_TARGET | VALUE_REAL_TARGET);
+
+  if (target == 0){
+    return ram_write_cell_by_name(memory, value, assignment->var_name);
+  }
+
+  int slot = ANALYZE_SLOT(assignment->var_name);
+
+  if (target == VALUE_INT_TARGET){
+    if (memory->int_cells[slot] < 0 && ram_bind_slot(memory, assignment->var_name, RAM_TYPE_INT, slot) < 0){
+      return false;
+    }
+    memory->ints[slot] = value.types.i;
+  }
+  else{
+    if (memory->real_cells[slot] < 0 && ram_bind_slot(memory, assignment->var_name, RAM_TYPE_REAL, slot) < 0){
+      return false;
+    }
+    memory->reals[slot] = value.types.d;
+  }
+  return true;
+}
+static struct RESULT execute_condition(struct EXPR* condition, struct RAM* memory, int line){
+  if (condition->isBinaryExpr) {
+    return execute_binary_expression(condition, memory, line);
+  }
+  // If not a binary expression, just retrieve the value of lhs
+  return retrieve_value(condition->lhs->element, memory, line);
+}
+static struct STMT* execute_switch(struct OPT_SWITCH* sw, int value){
+  if (sw->table != NULL){
+    unsigned int index = (unsigned int) value - (unsigned int) sw->min;
+
+    if (index < (unsigned int) sw->count && sw->table[index] != NULL){
+      return sw->table[index];
+    }
+    return sw->otherwise;
+  }
+
+  int low = 0;
+  int high = sw->num_cases - 1;
+
+  while (low <= high){ // binary search of the sorted cases
+    int middle = low + (high - low) / 2;
+
+    if (sw->cases[middle].value == value){
+      return sw->cases[middle].target;
+    }
+    if (sw->cases[middle].value < value){
+      low = middle + 1;
+    }
+    else{
+      high = middle - 1;
+    }
+  }
+  return sw->otherwise;
+}
+
+static bool execute_fused(struct OPT_FUSED* fused, struct RAM* memory, struct STMT** next){
+  struct RAM_CELL* target = fused_cell(memory, &fused->target);
+  if (target == NULL){
+    return false; // not defined, the original reports it
+  }
+  int type = target->value.value_type;
+
+  if (fused->op == OPT_FUSED_LOOP){
+    struct STMT_WHILE_LOOP* loop = fused->original->types.while_loop;
+    int rhs = fused->k;
+
+    if (type != RAM_TYPE_INT){
+      return false;
+    }
+    if (fused->operand.name != NULL){
+      struct RAM_CELL* operand = fused_cell(memory, &fused->operand);
+      if (operand == NULL || operand->value.value_type != RAM_TYPE_INT){
+        return false;
+      }
+      rhs = *cell_int(memory, operand);
+    }
+    int lhs = *cell_int(memory, target);
+    bool holds;
+
+    switch (fused->compare){
+      case OPERATOR_LT:  holds = lhs < rhs;  break;
+      case OPERATOR_LTE: holds = lhs <= rhs; break;
+      case OPERATOR_GT:  holds = lhs > rhs;  break;
+      case OPERATOR_GTE: holds = lhs >= rhs; break;
+      case OPERATOR_EQUAL: holds = lhs == rhs; break;
+      default: holds = lhs != rhs; break;
+    }
+    *next = holds ? loop->loop_body : loop->next_stmt;
+    return true;
+  }
+
+  if (fused->op == OPT_FUSED_INC){
+    if (type == RAM_TYPE_INT){
+      int* x = cell_int(memory, target);
+      *x = (int) ((unsigned int) *x + (unsigned int) fused->k);
+    }
+    else if (type == RAM_TYPE_REAL){
+      double* x = cell_real(memory, target);
+      *x = *x + (float) fused->k; // as execute_float() converts it
+    }
+    else{
+      return false;
+    }
+  }
+  else if (fused->op == OPT_FUSED_ADD){
+    struct RAM_CELL* operand = fused_cell(memory, &fused->operand);
+    if (operand == NULL){
+      return false;
+    }
+    int operand_type = operand->value.value_type;
 
+    if (type == RAM_TYPE_INT && operand_type == RAM_TYPE_INT){
+      int y = *cell_int(memory, operand);
+      int* x = cell_int(memory, target);
+      *x = (int) ((unsigned int) *x + (unsigned int) y);
+    }
+    else if (type == RAM_TYPE_REAL && (operand_type == RAM_TYPE_INT || operand_type == RAM_TYPE_REAL)){
+      double y = (operand_type == RAM_TYPE_INT) ? (float) *cell_int(memory, operand) : *cell_real(memory, operand);
+      double* x = cell_real(memory, target);
+      *x = *x + y;
+    }
+    else{
+      return false; // int + real changes the type, let the original do it
+    }
+  }
+  else{
+    assert(fused->op == OPT_FUSED_APPEND);
+    if (type != RAM_TYPE_STR || !ram_append_cell_by_addr(memory, fused->text, fused->target.addr)){
+      return false;
+    }
+  }
+
+  *next = fused->original->types.assignment->next_stmt;
+  return true;
+}
+
+static bool execute_run(struct STMT* stmt, struct RAM* memory, struct STMT** next){
+  if (stmt->stmt_type == STMT_COUNTED){
+    struct OPT_COUNTED* counted = OPT_COUNTED_OF(stmt);
+    int i;
+    int limit;
+
+    if (counted_start(counted, memory, &i, &limit)){
+      execute_current = stmt;
+      counted->runs++;
+      return execute_counted(counted, memory, i, limit, next);
+    }
+  }
+  return execute_stmt(stmt, memory, next);
+}
+
+static bool counted_start(struct OPT_COUNTED* counted, struct RAM* memory, int* i, int* limit){
+  struct RAM_CELL* counter = fused_cell(memory, &counted->counter);
+  if (counter == NULL || counter->value.value_type != RAM_TYPE_INT){
+    return false;
+  }
+
+  *limit = counted->bound;
+  if (counted->limit.name != NULL){
+    struct RAM_CELL* cell = fused_cell(memory, &counted->limit);
+    if (cell == NULL || cell->value.value_type != RAM_TYPE_INT){
+      return false;
+    }
+    *limit = *cell_int(memory, cell);
+  }
+
+  *i = *cell_int(memory, counter);
+  return true;
+}
+
+static bool execute_counted(struct OPT_COUNTED* counted, struct RAM* memory, int i, int limit, struct STMT** next){
+  struct STMT_WHILE_LOOP* loop = counted->original->types.while_loop;
+  int addr = counted->counter.addr; // the body never writes i, so neither moves nor retypes it
+  bool success = true;
+
+  if (counted->reduction != NULL){
+    if (execute_reduction(counted, memory, &i, limit)){
+      counted->reduction->runs++; // i is now past the limit
+    }
+    else{
+      counted->reduction->fallbacks++;
+    }
+  }
+
+  while (success && (counted->inclusive ? i <= limit : i < limit)){
+    if (counted->reads_counter){
+      *cell_int(memory, &memory->cells[addr]) = i;
+    }
+
+    //
+    // the body, up to the increment, which is done here:
+    //
+    struct STMT* stmt = loop->loop_body;
+    while (stmt != counted->increment){
+      if (!execute_run(stmt, memory, &stmt)){
+        success = false;
+        break;
+      }
+    }
+    if (success){
+      i = (int) ((unsigned int) i + (unsigned int) counted->step);
+    }
+  }
+
+  *cell_int(memory, &memory->cells[addr]) = i; // cells may have moved, look it up again
+
+  if (success){
+    *next = loop->next_stmt;
+  }
+  return success;
+}
+
+static bool execute_reduction(struct OPT_COUNTED* counted, struct RAM* memory, int* i, int limit){
+  struct OPT_REDUCTION* reduction = counted->reduction;
+
+  long long first = *i;
+  long long last = counted->inclusive ? (long long) limit : (long long) limit - 1;
+  if (last < first){
+    return false; // doesn't run at all
+  }
+
+  long long count = (last - first) / counted->step + 1;
+  long long end = first + count * counted->step;
+  if (end > INT_MAX){
+    return false; // i wraps around and the loop goes on
+  }
+
+  struct RAM_CELL* cell = fused_cell(memory, &reduction->acc);
+  if (cell == NULL){
+    return false;
+  }
+
+  struct REDUCE_SUM sum;
+  struct RAM_VALUE total;
+
+  if (cell->value.value_type == RAM_TYPE_INT){
+    reduce_poly(reduction->coeffs, *i, counted->step, count, &sum);
+
+    unsigned int value = (unsigned int) *cell_int(memory, cell);
+    total.value_type = RAM_TYPE_INT;
+    total.types.i = (int) (reduction->subtract ? value - (unsigned int) sum.sum : value + (unsigned int) sum.sum);
+  }
+  else if (cell->value.value_type == RAM_TYPE_REAL){
+    //
+    // an int is added to a real as a float, see execute_float();
+    // adding whole numbers that are exact floats to a whole real
+    // is exact, in any order, as long as no partial sum passes
+    // 2^53; -0.0 would come out as -0.0 where the loop can end at
+    // 0.0:
+    //
+    double value = *cell_real(memory, cell);
+    if (value != floor(value) || fabs(value) > REDUCE_EXACT || (value == 0.0 && signbit(value))){
+      return false;
+    }
+
+    reduce_poly(reduction->coeffs, *i, counted->step, count, &sum);
+    if (sum.bits >= REDUCE_EXACT_FLOAT || (double) sum.magnitude > REDUCE_EXACT - fabs(value)){
+      return false;
+    }
+
+    total.value_type = RAM_TYPE_REAL;
+    total.types.d = reduction->subtract ? value - (double) sum.sum : value + (double) sum.sum;
+  }
+  else{
+    return false;
+  }
+
+  //
+  // t keeps its last value, then the total:
+  //
+  if (reduction->term != NULL){
+    struct RAM_VALUE term;
+    term.value_type = RAM_TYPE_INT;
+    term.types.i = reduce_poly_at(reduction->coeffs, (int) (end - counted->step));
+
+    if (!write_variable(reduction->term, term, memory)){
+      return false;
+    }
+  }
+  if (!write_variable(reduction->total, total, memory)){
+    return false;
+  }
+
+  *i = (int) end;
+  return true;
+}
+
+static struct RAM_CELL* fused_cell(struct RAM* memory, struct OPT_OPERAND* operand){
+  int addr = operand->addr;
+
+  if (addr < 0 || addr >= memory->num_values || strcmp(memory->cells[addr].identifier, operand->name) != 0){
+    addr = ram_get_addr(memory, operand->name);
+    if (addr < 0){
+      return NULL;
+    }
+    operand->addr = addr;
+  }
+  return &memory->cells[addr];
+}
+
+static int* cell_int(struct RAM* memory, struct RAM_CELL* cell){
+  return (cell->slot >= 0) ? &memory->ints[cell->slot] : &cell->value.types.i;
+}
+
+static double* cell_real(struct RAM* memory, struct RAM_CELL* cell){
+  return (cell->slot >= 0) ? &memory->reals[cell->slot] : &cell->value.types.d;
+}
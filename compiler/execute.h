@@ -9,6 +9,40 @@
 #include "programgraph.h"
 #include "ram.h"
 
+
+//
+// Status of an execution that runs a few statements at a time:
+//
+enum EXECUTE_STATUS
+{
+  EXECUTE_READY = 0,   // not started, the cursor is zero-initialized
+  EXECUTE_PAUSED,      // budget used up, call again to continue
+  EXECUTE_COMPLETED,   // ran off the end of the program
+  EXECUTE_FAILED       // stopped by a semantic error
+};
+
+struct EXECUTE_CURSOR
+{
+  struct STMT* stmt;  // next stmt to execute, or the stmt that failed
+  int status;         // enum EXECUTE_STATUS
+  long long steps;    // # of stmts executed so far
+};
+
+//
+// The statement this thread is executing, or NULL when it isn't
+// executing a program; a sampling profiler's signal handler reads
+// it (see sampler.h). Each thread has its own, so --batch workers
+// don't write to the same variable.
+//
+#ifdef __cplusplus
+#define EXECUTE_THREAD_LOCAL thread_local
+#else
+#define EXECUTE_THREAD_LOCAL _Thread_local
+#endif
+
+extern EXECUTE_THREAD_LOCAL struct STMT* volatile execute_current;
+
+
 //
 // Public functions:
 //
@@ -22,4 +56,79 @@
 // and error message is output, execution stops,
 // and the function returns.
 //
+// NOTE: a STMT_COUNTED loop (see optimize.h) runs to the end in
+// one go here; execute_step() and execute_with_budget() run it as
+// written, one test at a time.
+//
 void execute(struct STMT* program, struct RAM* memory);
+
+//
+// execute_step
+//
+// Executes the single statement stmt and returns the statement
+// that runs next (the loop body or the stmt after the loop, for
+// a while loop), or NULL if the program is done. The program
+// graph is never modified, so a debugger can step through a
+// program by calling this repeatedly. If a semantic error
+// occurs, the error message is output, *success is set to
+// false and NULL is returned; otherwise *success is true.
+//
+struct STMT* execute_step(struct STMT* stmt, struct RAM* memory, bool* success);
+
+//
+// execute_unit
+//
+// Like execute_step(), except that a STMT_COUNTED loop runs to the
+// end in one go when it can, as in execute(), so the loop and its
+// body are one unit of work.
+//
+struct STMT* execute_unit(struct STMT* stmt, struct RAM* memory, bool* success);
+
+//
+// execute_with_budget
+//
+// Executes at most max_steps statements of the given program
+// and returns, so one thread can interleave many programs or
+// cap how long one program runs. A while loop's test counts as
+// a statement. The cursor records where execution stopped and
+// must be zero-initialized before the first call; each later
+// call with the same cursor and memory continues from there.
+// Returns the cursor's status (enum EXECUTE_STATUS). Once the
+// status is EXECUTE_COMPLETED or EXECUTE_FAILED, further calls
+// do nothing.
+//
+int execute_with_budget(struct STMT* program, struct RAM* memory, struct EXECUTE_CURSOR* cursor, long long max_steps);
+
+//
+// execute_operator
+//
+// Applies the given binary operator op (enum OPERATORS) to lhs and
+// rhs exactly as a binary expression in the program would, and
+// stores the result in *value. Returns false if a semantic error
+// occurs, in which case the error message has been output. If
+// the result is a string it was allocated with malloc, and the
+// caller must free it.
+//
+bool execute_operator(struct RAM_VALUE lhs, struct RAM_VALUE rhs, int op, int line, struct RAM_VALUE* value);
+
+//
+// execute_call
+//
+// Calls the built-in function on the right-hand side of an
+// assignment (input, int or float), storing what it returns in
+// *value. Returns false if a semantic error occurs, in which
+// case the error message has been output. A string result was
+// allocated with malloc, and the caller must free it.
+//
+bool execute_call(struct FUNCTION_CALL* call, struct RAM* memory, int line, struct RAM_VALUE* value);
+
+//
+// execute_int_power
+//
+// Returns base ** exponent for ints, as the ** operator computes
+// it: by repeated multiplication, wrapping around on overflow like
+// the other int operators. A negative exponent gives the result
+// truncated towards 0 (1 or -1 for a base of 1 or -1, else 0),
+// except that 0 to a negative power gives INT_MIN.
+//
+int execute_int_power(int base, int exponent);
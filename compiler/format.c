@@ -0,0 +1,607 @@
+/*format.c*/
+
+//
+// Fast number-to-text conversions for printing nuPython values.
+// Integers are converted two digits at a time; reals in the usual
+// range are converted with exact integer arithmetic, so the result
+// matches printf("%f") digit for digit.
+//
+// Text-to-number conversions for int() and float() validate and
+// convert in one pass, 8 digits at a time where the machine allows.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <math.h>
+#include <float.h>   // DBL_MIN
+#include <limits.h>  // INT_MAX
+#include <ctype.h>   // tolower
+#include <stdint.h>  // uint64_t
+
+#include "format.h"
+
+
+//
+// 128-bit integers, needed for exact rounding of reals:
+//
+__extension__ typedef unsigned __int128 uint128;
+
+//
+// "00", "01", ..., "99" back to back:
+//
+static const char DigitPairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+//
+// powers of ten that are exact doubles:
+//
+static const double ExactPowers[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//
+// 8 digits are checked and converted at once by treating them as
+// one little-endian 64-bit word:
+//
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define FORMAT_SWAR 1
+#else
+#define FORMAT_SWAR 0
+#endif
+
+//
+// a run of digits, as read by parse_digits():
+//
+struct DIGITS
+{
+  unsigned long long mantissa;  // the first 19 significant digits
+  int  significant;             // # of digits in mantissa
+  int  dropped;                 // # of significant digits past the 19th
+  int  count;                   // # of digits, leading zeros included
+  bool underscores;             // true => '_'s were skipped
+};
+
+#define is_digit(c)  ((c) >= '0' && (c) <= '9')
+#define is_space(c)  ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+
+//
+// Private functions:
+//
+
+//Writes the given unsigned integer in decimal, returns # of chars
+static int format_uint(char* buf, unsigned long long value);
+
+//Copies s into buf, returns # of chars
+static int format_copy(char* buf, const char* s);
+
+//Skips whitespace at both ends of s, returns the start and sets *end
+static const char* trim(const char* s, const char** end);
+
+//Reads digits, with single '_'s between them, from p into *d; returns
+// where they stop, or NULL if a '_' isn't between two digits
+static const char* parse_digits(const char* p, const char* end, struct DIGITS* d);
+
+#if FORMAT_SWAR
+//Returns true if the 8 chars at p are all digits
+static bool is_eight_digits(const char* p);
+
+//Returns the value of the 8 digits at p
+static unsigned long long eight_digits(const char* p);
+#endif
+
+//Returns true if [p, end) is word, ignoring case
+static bool match_word(const char* p, const char* end, const char* word);
+
+//Converts a validated real with strtod(), correctly rounded; too
+// large a number becomes +/-inf, as in Python
+static int parse_real_exactly(const char* first, const char* end, double* value);
+
+
+//
+// Public functions:
+//
+
+//
+// format_int
+//
+// Writes the given integer in decimal to buf and returns the
+// # of characters written.
+//
+int format_int(char* buf, long long value)
+{
+  if (value < 0) {
+    buf[0] = '-';
+    return 1 + format_uint(buf + 1, 0ULL - (unsigned long long) value);
+  }
+  return format_uint(buf, (unsigned long long) value);
+}
+
+
+//
+// format_real
+//
+// Writes the given real exactly as printf("%f") would and returns
+// the # of characters written.
+//
+int format_real(char* buf, double value)
+{
+  double magnitude = fabs(value);
+
+  //
+  // at 2^53 and beyond (and for nan / inf) let printf do it:
+  //
+  if (!(magnitude < 9007199254740992.0))
+    return snprintf(buf, FORMAT_REAL_SIZE, "%f", value);
+
+  int len = 0;
+  if (signbit(value))  // printf keeps the sign of -0.0
+    buf[len++] = '-';
+
+  double whole = floor(magnitude);
+  double fraction = magnitude - whole;  // exact below 2^53
+
+  unsigned long long integer = (unsigned long long) whole;
+  unsigned long long micros = 0;
+
+  if (fraction != 0.0) {
+    //
+    // fraction == bits / 2^shift exactly; round bits * 10^6 / 2^shift
+    // to the nearest integer, ties to even, as printf does:
+    //
+    int exponent;
+    double mantissa = frexp(fraction, &exponent);
+    unsigned long long bits = (unsigned long long) ldexp(mantissa, 53);
+    int shift = 53 - exponent;
+
+    if (shift < 128) { // else fraction < 2^-74 and rounds to 0
+      uint128 scaled = (uint128) bits * 1000000;
+      uint128 half = (uint128) 1 << (shift - 1);
+      uint128 remainder = scaled & ((half << 1) - 1);
+
+      micros = (unsigned long long) (scaled >> shift);
+
+      if (remainder > half || (remainder == half && (micros & 1) != 0))
+        micros++;
+    }
+
+    if (micros == 1000000) { // rounded up into the integer part
+      micros = 0;
+      integer++;
+    }
+  }
+
+  len += format_uint(buf + len, integer);
+  buf[len++] = '.';
+
+  for (int i = 5; i >= 0; i--) {
+    buf[len + i] = (char) ('0' + micros % 10);
+    micros /= 10;
+  }
+  len += 6;
+
+  buf[len] = '\0';
+  return len;
+}
+
+
+//
+// format_real_repr
+//
+// Writes the given real the way Python's repr() does and returns
+// the # of characters written.
+//
+int format_real_repr(char* buf, double value)
+{
+  if (isnan(value))
+    return format_copy(buf, "nan");
+  if (isinf(value))
+    return format_copy(buf, (value < 0) ? "-inf" : "inf");
+
+  //
+  // Find the fewest significant digits that read back as value.
+  // Any number with 15 or fewer digits survives a round trip
+  // through %.15e, so if 15 digits work the shortest form is
+  // those digits without trailing zeros; otherwise 16 or 17.
+  // Subnormals carry fewer bits, so search them from 1 digit up.
+  //
+  int shortest = (value != 0.0 && fabs(value) < DBL_MIN) ? 1 : 15;
+
+  char sci[40];
+  for (int precision = shortest; precision <= 17; precision++) {
+    snprintf(sci, sizeof(sci), "%.*e", precision - 1, value);
+    if (strtod(sci, NULL) == value)
+      break;
+  }
+
+  //
+  // take apart "-d.ddde+XX":
+  //
+  char digits[20];
+  int num_digits = 0;
+  bool negative = (sci[0] == '-');
+
+  const char* p = negative ? sci + 1 : sci;
+  for (; *p != 'e'; p++) {
+    if (*p != '.')
+      digits[num_digits++] = *p;
+  }
+  int exponent = atoi(p + 1);
+
+  while (num_digits > 1 && digits[num_digits - 1] == '0')
+    num_digits--;
+
+  int len = 0;
+  if (negative)
+    buf[len++] = '-';
+
+  if (exponent >= -4 && exponent < 16) {
+    //
+    // positional notation, always with a fractional part:
+    //
+    if (exponent >= 0) {
+      for (int i = 0; i <= exponent; i++)
+        buf[len++] = (i < num_digits) ? digits[i] : '0';
+
+      buf[len++] = '.';
+
+      if (num_digits > exponent + 1) {
+        for (int i = exponent + 1; i < num_digits; i++)
+          buf[len++] = digits[i];
+      }
+      else {
+        buf[len++] = '0';
+      }
+    }
+    else {
+      buf[len++] = '0';
+      buf[len++] = '.';
+      for (int i = -1; i > exponent; i--)
+        buf[len++] = '0';
+      for (int i = 0; i < num_digits; i++)
+        buf[len++] = digits[i];
+    }
+  }
+  else {
+    //
+    // scientific notation, exponent has at least 2 digits:
+    //
+    buf[len++] = digits[0];
+    if (num_digits > 1) {
+      buf[len++] = '.';
+      for (int i = 1; i < num_digits; i++)
+        buf[len++] = digits[i];
+    }
+    buf[len++] = 'e';
+    buf[len++] = (exponent < 0) ? '-' : '+';
+    if (exponent < 0)
+      exponent = -exponent;
+    if (exponent < 10)
+      buf[len++] = '0';
+    len += format_uint(buf + len, (unsigned long long) exponent);
+  }
+
+  buf[len] = '\0';
+  return len;
+}
+
+
+//
+// format_parse_int
+//
+// Parses s the way Python's int() parses a string, in one pass.
+//
+int format_parse_int(const char* s, int* value)
+{
+  const char* end;
+  const char* p = trim(s, &end);
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    p++;
+  }
+
+  struct DIGITS d;
+  memset(&d, 0, sizeof(d));
+
+  p = parse_digits(p, end, &d);
+  if (p == NULL || p != end || d.count == 0)
+    return FORMAT_PARSE_INVALID;
+
+  unsigned long long limit = negative ? (unsigned long long) INT_MAX + 1 : (unsigned long long) INT_MAX;
+  if (d.dropped > 0 || d.mantissa > limit)
+    return FORMAT_PARSE_RANGE;
+
+  *value = negative ? (int) -(long long) d.mantissa : (int) d.mantissa;
+  return FORMAT_PARSE_OK;
+}
+
+//
+// format_parse_real
+//
+// Parses s the way Python's float() parses a string, correctly
+// rounded.
+//
+int format_parse_real(const char* s, double* value)
+{
+  const char* end;
+  const char* first = trim(s, &end);
+  const char* p = first;
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    p++;
+  }
+
+  if (p < end && !is_digit(*p) && *p != '.') {
+    double special;
+    if (match_word(p, end, "inf") || match_word(p, end, "infinity"))
+      special = HUGE_VAL;
+    else if (match_word(p, end, "nan"))
+      special = NAN;
+    else
+      return FORMAT_PARSE_INVALID;
+
+    *value = negative ? -special : special;
+    return FORMAT_PARSE_OK;
+  }
+
+  //
+  // digits [. digits] [e [sign] digits], the value being
+  // d.mantissa * 10^exponent:
+  //
+  struct DIGITS d;
+  memset(&d, 0, sizeof(d));
+
+  p = parse_digits(p, end, &d);
+  if (p == NULL)
+    return FORMAT_PARSE_INVALID;
+
+  int exponent = d.dropped;  // integer digits past the 19th
+
+  if (p < end && *p == '.') {
+    int count = d.count;
+    int dropped = d.dropped;
+
+    p = parse_digits(p + 1, end, &d);
+    if (p == NULL)
+      return FORMAT_PARSE_INVALID;
+
+    exponent -= (d.count - count) - (d.dropped - dropped);
+  }
+
+  if (d.count == 0)
+    return FORMAT_PARSE_INVALID;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+
+    bool exponent_negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+      exponent_negative = (*p == '-');
+      p++;
+    }
+
+    struct DIGITS e;
+    memset(&e, 0, sizeof(e));
+
+    p = parse_digits(p, end, &e);
+    if (p == NULL || e.count == 0)
+      return FORMAT_PARSE_INVALID;
+
+    //
+    // anything past 100000 is past the range of a double either way:
+    //
+    int written = (e.dropped > 0 || e.mantissa > 100000) ? 100000 : (int) e.mantissa;
+    exponent += exponent_negative ? -written : written;
+  }
+
+  if (p != end)
+    return FORMAT_PARSE_INVALID;
+
+  //
+  // Both the mantissa and the power of ten are exact doubles, so
+  // one multiply or divide rounds correctly; anything else goes
+  // through strtod():
+  //
+  if (d.dropped == 0 && d.mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+    double result = (double) d.mantissa;
+    if (exponent < 0)
+      result /= ExactPowers[-exponent];
+    else
+      result *= ExactPowers[exponent];
+
+    *value = negative ? -result : result;
+    return FORMAT_PARSE_OK;
+  }
+
+  return parse_real_exactly(first, end, value);
+}
+
+
+//
+// Private functions:
+//
+
+static int format_uint(char* buf, unsigned long long value)
+{
+  char tmp[FORMAT_INT_SIZE];
+  char* p = tmp + sizeof(tmp);
+
+  while (value >= 100) {
+    int pair = (int) (value % 100) * 2;
+    value /= 100;
+    p -= 2;
+    p[0] = DigitPairs[pair];
+    p[1] = DigitPairs[pair + 1];
+  }
+
+  if (value >= 10) {
+    int pair = (int) value * 2;
+    p -= 2;
+    p[0] = DigitPairs[pair];
+    p[1] = DigitPairs[pair + 1];
+  }
+  else {
+    p--;
+    *p = (char) ('0' + value);
+  }
+
+  int len = (int) (tmp + sizeof(tmp) - p);
+  memcpy(buf, p, len);
+  buf[len] = '\0';
+  return len;
+}
+
+static int format_copy(char* buf, const char* s)
+{
+  int len = (int) strlen(s);
+  memcpy(buf, s, len + 1);
+  return len;
+}
+
+static const char* trim(const char* s, const char** end)
+{
+  const char* last = s + strlen(s);
+
+  while (s < last && is_space(*s))
+    s++;
+  while (last > s && is_space(last[-1]))
+    last--;
+
+  *end = last;
+  return s;
+}
+
+static const char* parse_digits(const char* p, const char* end, struct DIGITS* d)
+{
+  const char* start = p;
+
+  while (p < end) {
+    if (*p == '_') {
+      if (p == start || p + 1 == end || !is_digit(p[-1]) || !is_digit(p[1]))
+        return NULL;
+      d->underscores = true;
+      p++;
+      continue;
+    }
+
+    if (!is_digit(*p))
+      break;
+
+#if FORMAT_SWAR
+    //
+    // 8 digits at once while they still fit in the mantissa:
+    //
+    if ((d->significant > 0 || *p != '0') && d->significant + 8 <= 19 && end - p >= 8 && is_eight_digits(p)) {
+      d->mantissa = d->mantissa * 100000000 + eight_digits(p);
+      d->significant += 8;
+      d->count += 8;
+      p += 8;
+      continue;
+    }
+#endif
+
+    if (d->significant == 0 && *p == '0')
+      ;  // a leading zero
+    else if (d->significant < 19) {
+      d->mantissa = d->mantissa * 10 + (unsigned long long) (*p - '0');
+      d->significant++;
+    }
+    else
+      d->dropped++;
+
+    d->count++;
+    p++;
+  }
+
+  return p;
+}
+
+#if FORMAT_SWAR
+static bool is_eight_digits(const char* p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+
+  //
+  // every byte 0x30..0x39: high nibble 3, and adding 6 doesn't
+  // carry into the high nibble:
+  //
+  return ((v & 0xF0F0F0F0F0F0F0F0ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+    == 0x3333333333333333ULL;
+}
+
+static unsigned long long eight_digits(const char* p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+
+  //
+  // combine neighbouring digits into 2-digit, then 4-digit, then
+  // the 8-digit value; the first char is the lowest byte:
+  //
+  v -= 0x3030303030303030ULL;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+       + (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+  return (unsigned long long) v;
+}
+#endif
+
+static bool match_word(const char* p, const char* end, const char* word)
+{
+  size_t length = strlen(word);
+  if ((size_t) (end - p) != length)
+    return false;
+
+  for (size_t i = 0; i < length; i++) {
+    if (tolower((unsigned char) p[i]) != word[i])
+      return false;
+  }
+  return true;
+}
+
+static int parse_real_exactly(const char* first, const char* end, double* value)
+{
+  //
+  // strtod() doesn't take underscores, copy without them:
+  //
+  char small[64];
+  size_t length = (size_t) (end - first);
+  char* text = (length < sizeof(small)) ? small : (char*) malloc(length + 1);
+
+  if (text == NULL) {
+    printf("**OUT OF MEMORY (format)\n");
+    exit(-1);
+  }
+
+  size_t n = 0;
+  for (const char* p = first; p < end; p++) {
+    if (*p != '_')
+      text[n++] = *p;
+  }
+  text[n] = '\0';
+
+  *value = strtod(text, NULL);  // +/-HUGE_VAL, i.e. inf, on overflow
+
+  if (text != small)
+    free(text);
+
+  return FORMAT_PARSE_OK;
+}
@@ -0,0 +1,86 @@
+/*format.h*/
+
+//
+// Fast number-to-text conversions for printing nuPython values,
+// without going through printf's format string parsing, and the
+// text-to-number conversions behind int() and float().
+
+
+#pragma once
+
+
+//
+// Buffer sizes (including the null terminator) large enough for
+// any value:
+//
+#define FORMAT_INT_SIZE   24
+#define FORMAT_REAL_SIZE  330   // "%f" of 1e308 is 316 chars
+
+//
+// Results of format_parse_int() and format_parse_real():
+//
+enum FORMAT_PARSE_RESULTS
+{
+  FORMAT_PARSE_OK = 0,
+  FORMAT_PARSE_INVALID,  // not a number
+  FORMAT_PARSE_RANGE     // a number, but too large for an int
+};
+
+
+//
+// Public functions:
+//
+
+//
+// format_int
+//
+// Writes the given integer in decimal, e.g. "-123", to buf and
+// returns the # of characters written. buf must hold at least
+// FORMAT_INT_SIZE chars; the result is null-terminated.
+//
+int format_int(char* buf, long long value);
+
+//
+// format_real
+//
+// Writes the given real exactly as printf("%f") would, e.g.
+// "3.140000", to buf and returns the # of characters written.
+// buf must hold at least FORMAT_REAL_SIZE chars; the result is
+// null-terminated.
+//
+int format_real(char* buf, double value);
+
+//
+// format_real_repr
+//
+// Writes the given real the way Python's repr() does: the
+// shortest digits that read back as the same value, e.g. "3.14",
+// "100.0" or "1e-05". Returns the # of characters written. buf
+// must hold at least FORMAT_REAL_SIZE chars; the result is
+// null-terminated.
+//
+int format_real_repr(char* buf, double value);
+
+//
+// format_parse_int
+//
+// Parses s the way Python's int() parses a string: an optional
+// sign and decimal digits, with whitespace allowed around them
+// and single underscores between digits, e.g. " -1_000 ". On
+// success stores the value in *value and returns FORMAT_PARSE_OK.
+// Returns FORMAT_PARSE_RANGE if the number doesn't fit in an
+// int, FORMAT_PARSE_INVALID if s isn't a number at all.
+//
+int format_parse_int(const char* s, int* value);
+
+//
+// format_parse_real
+//
+// Parses s the way Python's float() parses a string, e.g. "2.5",
+// "-.5e3", "1_000.25", "inf" or "nan", rounding correctly. On
+// success stores the value in *value and returns FORMAT_PARSE_OK;
+// like float(), a number too large for a double, e.g. "1e400",
+// gives inf or -inf. Returns FORMAT_PARSE_INVALID if s isn't a
+// number at all.
+//
+int format_parse_real(const char* s, double* value);
@@ -0,0 +1,289 @@
+/*input.c*/
+
+//
+// Line input for the nuPython interpreter. Lines are cut out of a
+// large block buffer, or straight out of a mapped file, and copied
+// once into a string of exactly the right size that the caller
+// keeps, so there is no fixed line limit and no per-line read().
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>     // open
+#include <unistd.h>    // read, close
+#include <pthread.h>
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>  // fstat
+
+#include "input.h"
+
+
+#define INPUT_BLOCK_SIZE (1 << 16)  // 64KB
+
+
+//
+// Private functions:
+//
+
+//Reads the next line of the standard input through stdio
+static char* read_stdio_line(int* length);
+
+//Reads the next line from the block buffer, refilling it as needed
+static char* read_block_line(int* length);
+
+//Reads the next line of the mapped file
+static char* read_mapped_line(int* length);
+
+//Returns a copy of the given line, cut at its first '\r'
+static char* copy_line(const char* line, size_t size, int* length);
+
+
+//
+// the one source, shared by every thread:
+//
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static int Source = INPUT_STDIO;  // enum INPUT_SOURCES
+
+static int    Fd = -1;           // INPUT_BLOCKS
+static char*  Buffer = NULL;
+static size_t Start = 0;         // Buffer[Start, End) is unread
+static size_t End = 0;
+static size_t Capacity = 0;
+static bool   Eof = false;
+
+static char*  Map = NULL;        // INPUT_MAPPED
+static size_t MapLength = 0;
+static size_t MapPos = 0;
+
+
+//
+// Public functions:
+//
+
+//
+// input_use_blocks
+//
+// Reads input() lines from the standard input in large blocks.
+//
+void input_use_blocks(void)
+{
+  pthread_mutex_lock(&Lock);
+  if (Source == INPUT_STDIO) {
+    Source = INPUT_BLOCKS;
+    Fd = 0;
+    Start = End = 0;
+    Eof = false;
+  }
+  pthread_mutex_unlock(&Lock);
+}
+
+//
+// input_use_file
+//
+// Reads input() lines from the given file, mapped when possible.
+//
+bool input_use_file(const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  char* map = NULL;
+  bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+
+  if (regular && info.st_size > 0) {
+    void* p = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      map = (char*) p;
+      posix_madvise(p, (size_t) info.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+  }
+
+  input_close();
+
+  pthread_mutex_lock(&Lock);
+  if (map != NULL) {
+    close(fd);  // the mapping stays valid
+    Source = INPUT_MAPPED;
+    Map = map;
+    MapLength = (size_t) info.st_size;
+    MapPos = 0;
+  }
+  else if (regular && info.st_size == 0) {
+    close(fd);  // nothing to map, every input() sees the end
+    Source = INPUT_MAPPED;
+    Map = NULL;
+    MapLength = 0;
+    MapPos = 0;
+  }
+  else {
+    Source = INPUT_BLOCKS;
+    Fd = fd;
+    Start = End = 0;
+    Eof = false;
+  }
+  pthread_mutex_unlock(&Lock);
+
+  return true;
+}
+
+//
+// input_read_line
+//
+// Returns the next line of input in a string the caller owns, or
+// NULL at the end of the input.
+//
+char* input_read_line(int* length)
+{
+  char* line;
+
+  pthread_mutex_lock(&Lock);
+  if (Source == INPUT_BLOCKS)
+    line = read_block_line(length);
+  else if (Source == INPUT_MAPPED)
+    line = read_mapped_line(length);
+  else
+    line = read_stdio_line(length);
+  pthread_mutex_unlock(&Lock);
+
+  return line;
+}
+
+//
+// input_close
+//
+// Releases the current source and goes back to INPUT_STDIO.
+//
+void input_close(void)
+{
+  pthread_mutex_lock(&Lock);
+  if (Map != NULL)
+    munmap(Map, MapLength);
+  if (Fd > 0)  // never close the standard input
+    close(Fd);
+  free(Buffer);
+
+  Source = INPUT_STDIO;
+  Fd = -1;
+  Buffer = NULL;
+  Start = End = Capacity = 0;
+  Eof = false;
+  Map = NULL;
+  MapLength = MapPos = 0;
+  pthread_mutex_unlock(&Lock);
+}
+
+
+//
+// Private functions:
+//
+
+static char* read_stdio_line(int* length)
+{
+  //
+  // getline() allocates a fresh buffer when given NULL, which is
+  // handed over as is:
+  //
+  char* line = NULL;
+  size_t size = 0;
+  ssize_t n = getline(&line, &size, stdin);
+
+  if (n < 0) {
+    free(line);
+    return NULL;
+  }
+
+  size_t end = strcspn(line, "\r\n");
+  line[end] = '\0';
+  *length = (int) end;
+  return line;
+}
+
+static char* read_block_line(int* length)
+{
+  size_t scanned = Start;  // no '\n' in Buffer[Start, scanned)
+
+  for (;;) {
+    char* newline = (End > scanned) ? (char*) memchr(Buffer + scanned, '\n', End - scanned) : NULL;
+    if (newline != NULL) {
+      char* line = copy_line(Buffer + Start, (size_t) (newline - (Buffer + Start)), length);
+      Start = (size_t) (newline - Buffer) + 1;
+      return line;
+    }
+    scanned = End;
+
+    if (Eof) {
+      if (Start == End)
+        return NULL;
+      char* line = copy_line(Buffer + Start, End - Start, length);  // last line, no '\n'
+      Start = End;
+      return line;
+    }
+
+    //
+    // make room: move the partial line to the front, and grow the
+    // buffer if the line fills all of it:
+    //
+    if (Start > 0) {
+      memmove(Buffer, Buffer + Start, End - Start);
+      End -= Start;
+      scanned -= Start;
+      Start = 0;
+    }
+    if (Capacity - End < INPUT_BLOCK_SIZE / 2) {
+      size_t capacity = (Capacity == 0) ? INPUT_BLOCK_SIZE : 2 * Capacity;
+      char* bigger = (char*) realloc(Buffer, capacity);
+      if (bigger == NULL) {
+        fprintf(stderr, "**OUT OF MEMORY (input)\n");
+        exit(-1);
+      }
+      Buffer = bigger;
+      Capacity = capacity;
+    }
+
+    ssize_t n = read(Fd, Buffer + End, Capacity - End);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      Eof = true;
+    else
+      End += (size_t) n;
+  }
+}
+
+static char* read_mapped_line(int* length)
+{
+  if (MapPos >= MapLength)
+    return NULL;
+
+  const char* start = Map + MapPos;
+  size_t left = MapLength - MapPos;
+  const char* newline = (const char*) memchr(start, '\n', left);
+  size_t size = (newline != NULL) ? (size_t) (newline - start) : left;
+
+  MapPos += (newline != NULL) ? size + 1 : size;
+  return copy_line(start, size, length);
+}
+
+static char* copy_line(const char* line, size_t size, int* length)
+{
+  const char* cr = (const char*) memchr(line, '\r', size);
+  if (cr != NULL)
+    size = (size_t) (cr - line);
+
+  char* copy = (char*) malloc(size + 1);
+  if (copy == NULL) {
+    fprintf(stderr, "**OUT OF MEMORY (input)\n");
+    exit(-1);
+  }
+  memcpy(copy, line, size);
+  copy[size] = '\0';
+  *length = (int) size;
+  return copy;
+}
@@ -0,0 +1,68 @@
+/*input.h*/
+
+//
+// Line input for the nuPython interpreter. Every input() call reads
+// its line through here, so a program can stream a large data set
+// from a pipe or a file without a system call or a copy per line.
+
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+//
+// Where do input() lines come from?
+//
+enum INPUT_SOURCES
+{
+  INPUT_STDIO = 0,  // stdin through stdio, safe to share with other readers
+  INPUT_BLOCKS,     // large read()s of a file descriptor
+  INPUT_MAPPED      // a file mapped into memory
+};
+
+
+//
+// Public functions:
+//
+
+//
+// input_use_blocks
+//
+// Reads input() lines from the standard input in large blocks
+// instead of through stdio. Only call this when nothing else
+// reads the standard input, since whatever is read ahead is
+// invisible to stdio.
+//
+void input_use_blocks(void);
+
+//
+// input_use_file
+//
+// Reads input() lines from the given file, which is mapped into
+// memory when possible and read in large blocks otherwise (e.g.
+// a named pipe). Returns true if successful, false if the file
+// cannot be opened, in which case the source is unchanged.
+//
+bool input_use_file(const char* filename);
+
+//
+// input_read_line
+//
+// Returns the next line of input, without its line ending, in a
+// dynamically-allocated string of any length; the caller owns it
+// (see ram_take_str_by_name()). *length is set to its strlen().
+// Returns NULL at the end of the input. Safe to call from
+// several threads at once.
+//
+// NOTE: as with the original input(), a line ends at its first
+// '\r' as well as at '\n'.
+//
+char* input_read_line(int* length);
+
+//
+// input_close
+//
+// Releases the current source and goes back to INPUT_STDIO.
+//
+void input_close(void);
@@ -10,7 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>  // true, false
-#include <string.h>   // strcspn
+#include <string.h>   // strcspn, strcmp, strncmp, strlen
+#include <unistd.h>   // sysconf
 
 #include "token.h"    // token defs
 #include "scanner.h" 
@@ -19,41 +20,281 @@
 #include "programgraph.h" 
 #include "ram.h"
 #include "execute.h"
+#include "optimize.h"
+#include "output.h"
+#include "input.h"
+#include "batch.h"
+#include "nupyc.h"
+#include "transpile.h"
+#include "analyze.h"
+#include "profile.h"
+#include "phase.h"
+#include "sampler.h"
+#include "alloc.h"
+#include "source.h"
 
 
 //
 // main
 //
-// usage: program.exe [filename.py]
+// usage: program.exe [options] [filename.py]
+//        program.exe [options] --batch file1.py file2.py ...
 // 
-// If a filename is given, the file is opened and serves as
-// input to the program. If a filename is not given, then 
+// If a filename is given, the file is mapped into memory and
+// serves as input to the program. If a filename is not given, then 
 // input is taken from the keyboard until $ is input.
 //
+// options:
+//   --flush=line|block|never   when program output is written
+//                              (default: line for a terminal,
+//                              block otherwise)
+//   --repr                     print reals the way Python does,
+//                              e.g. 2.5 rather than 2.500000
+//   --max-steps=N              stop after executing N statements
+//   --batch                    run every file given, in parallel,
+//                              printing their output in order
+//   --jobs=N                   # of programs run at once by
+//                              --batch (default: # of cores)
+//   --emit-c out.c             translate the program to C in out.c
+//                              instead of executing it
+//   --no-cache                 always parse, don't use or update
+//                              the compiled program cache (see
+//                              nupyc.h)
+//   --input-file data.txt      input() reads lines from data.txt,
+//                              mapped into memory, instead of
+//                              the keyboard
+//   --stats                    after running, write to stderr how
+//                              often each fused statement shape
+//                              ran (see optimize.h)
+//   --profile out.prof         count and time every statement,
+//                              writing callgrind format to out.prof
+//                              and flamegraph.pl's folded stacks to
+//                              out.prof.folded (see profile.h)
+//   --phase-stats[=json]       after running, write to stderr the
+//                              time and hardware counters of each
+//                              phase: parse, build, optimize,
+//                              execute, teardown (see phase.h)
+//   --sample out.txt           sample the statement executing,
+//                              997 times per second of CPU time,
+//                              writing a histogram of lines to
+//                              out.txt at the end and whenever
+//                              the process gets SIGUSR1 (see
+//                              sampler.h)
+//   --sample-hz=N              samples per second for --sample
+//   --alloc-stats              count every allocation, writing
+//                              to stderr at exit the peak live
+//                              memory, each phase's allocations
+//                              and the top allocation sites (see
+//                              alloc.h)
+//
 int main(int argc, char* argv[])
 {
   FILE* input = NULL;
+  struct SOURCE* source = NULL;  // the file given, in memory
   bool  keyboardInput = false;
+  char* filename = NULL;
+  long long max_steps = 0;  // 0 => no limit
+  bool  batch = false;
+  bool  use_cache = true;
+  bool  stats = false;
+  char* emit_c = NULL;      // where to write C, if anywhere
+  char* input_file = NULL;  // where input() reads from, if not stdin
+  char* profile_path = NULL; // where to write a profile, if anywhere
+  char* sample_path = NULL;  // where to write samples, if anywhere
+  int   sample_hz = SAMPLER_DEFAULT_HZ;
+  bool  phase_stats = false;
+  bool  phase_json = false;
+  bool  alloc_stats = false;
+  int   num_jobs = 0;       // 0 => one per core
+  int   exit_status = 0;    // non-zero only when --emit-c fails
+  char** filenames = (char**) malloc(argc * sizeof(char*));
+  int   num_files = 0;
+
+  if (filenames == NULL) {
+    printf("**OUT OF MEMORY (main)\n");
+    return 0;
+  }
+
+  //
+  // options start with --, anything else is the filename:
+  //
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--flush=", 8) == 0) {
+      int policy = output_parse_policy(argv[i] + 8);
+
+      if (policy < 0) {
+        printf("**ERROR: unknown flush policy '%s', expecting line, block or never.\n", argv[i] + 8);
+        return 0;
+      }
+
+      output_set_policy(output_current(), policy);
+    }
+    else if (strcmp(argv[i], "--repr") == 0) {
+      output_current()->repr = true;
+    }
+    else if (strncmp(argv[i], "--max-steps=", 12) == 0) {
+      max_steps = atoll(argv[i] + 12);
+
+      if (max_steps <= 0) {
+        printf("**ERROR: --max-steps expects a positive number of statements.\n");
+        return 0;
+      }
+    }
+    else if (strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    }
+    else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+      num_jobs = atoi(argv[i] + 7);
+
+      if (num_jobs <= 0) {
+        printf("**ERROR: --jobs expects a positive number of programs.\n");
+        return 0;
+      }
+    }
+    else if (strcmp(argv[i], "--emit-c") == 0) {
+      if (i + 1 == argc) {
+        printf("**ERROR: --emit-c expects the name of the C file to write.\n");
+        return 0;
+      }
+      emit_c = argv[++i];
+    }
+    else if (strcmp(argv[i], "--input-file") == 0) {
+      if (i + 1 == argc) {
+        printf("**ERROR: --input-file expects the name of the file input() reads.\n");
+        return 0;
+      }
+      input_file = argv[++i];
+    }
+    else if (strcmp(argv[i], "--profile") == 0) {
+      if (i + 1 >= argc) {
+        printf("**ERROR: --profile expects the name of the profile to write.\n");
+        return 0;
+      }
+      profile_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--sample") == 0) {
+      if (i + 1 >= argc) {
+        printf("**ERROR: --sample expects the name of the histogram to write.\n");
+        return 0;
+      }
+      sample_path = argv[++i];
+    }
+    else if (strncmp(argv[i], "--sample-hz=", 12) == 0) {
+      sample_hz = atoi(argv[i] + 12);
+
+      if (sample_hz <= 0 || sample_hz > 100000) {
+        printf("**ERROR: --sample-hz expects a rate from 1 to 100000 samples per second.\n");
+        return 0;
+      }
+    }
+    else if (strcmp(argv[i], "--phase-stats") == 0 || strcmp(argv[i], "--phase-stats=table") == 0) {
+      phase_stats = true;
+    }
+    else if (strcmp(argv[i], "--phase-stats=json") == 0) {
+      phase_stats = true;
+      phase_json = true;
+    }
+    else if (strcmp(argv[i], "--alloc-stats") == 0) {
+      alloc_stats = true;
+    }
+    else if (strcmp(argv[i], "--stats") == 0) {
+      stats = true;
+    }
+    else if (strcmp(argv[i], "--no-cache") == 0) {
+      use_cache = false;
+    }
+    else if (strncmp(argv[i], "--", 2) == 0) {
+      printf("**ERROR: unknown option '%s'.\n", argv[i]);
+      return 0;
+    }
+    else {
+      filename = argv[i];
+      filenames[num_files++] = argv[i];
+    }
+  }
+
+  //
+  // input() reads the given file, else stdin in large blocks when
+  // the program itself doesn't come from stdin:
+  //
+  if (input_file != NULL) {
+    if (!input_use_file(input_file)) {
+      printf("**ERROR: unable to open input file '%s' for input().\n", input_file);
+      return 0;
+    }
+  }
+  else if (batch || filename != NULL) {
+    input_use_blocks();
+  }
+
+  if (batch) {
+    if (max_steps != 0) {
+      printf("**ERROR: --max-steps cannot be used with --batch.\n");
+      return 0;
+    }
+    if (stats) {
+      printf("**ERROR: --stats cannot be used with --batch.\n");
+      return 0;
+    }
+    if (profile_path != NULL) {
+      printf("**ERROR: --profile cannot be used with --batch.\n");
+      return 0;
+    }
+    if (phase_stats) {
+      printf("**ERROR: --phase-stats cannot be used with --batch.\n");
+      return 0;
+    }
+    if (sample_path != NULL) {
+      printf("**ERROR: --sample cannot be used with --batch.\n");
+      return 0;
+    }
+    if (alloc_stats) {
+      printf("**ERROR: --alloc-stats cannot be used with --batch.\n");
+      return 0;
+    }
+
+    if (num_jobs == 0) {
+      long cores = sysconf(_SC_NPROCESSORS_ONLN);
+      num_jobs = (cores > 0) ? (int) cores : 1;
+    }
+
+    batch_run(filenames, num_files, num_jobs, output_current()->repr, use_cache);
+
+    free(filenames);
+    input_close();
+    return 0;
+  }
+
+  free(filenames);
+
+  if (alloc_stats && !alloc_start())
+    fprintf(stderr, "**ERROR: allocations can't be counted in this build, running without --alloc-stats.\n");
+
+  if (profile_path != NULL && max_steps != 0) {
+    printf("**ERROR: --profile cannot be used with --max-steps.\n");
+    input_close();
+    return 0;
+  }
+  if (profile_path != NULL && sample_path != NULL) {
+    printf("**ERROR: --profile cannot be used with --sample.\n");
+    input_close();
+    return 0;
+  }
 
   //
   // where is the input coming from?
   //
-  if (argc < 2) {
+  if (filename == NULL) {
     //
-    // no args, just the program name:
+    // no filename, read the keyboard:
     //
     input = stdin;
     keyboardInput = true;
   }
   else {
-    //
-    // assume 2nd arg is a nuPython file:
-    //
-    char* filename = argv[1];
+    source = source_open(filename);
 
-    input = fopen(filename, "r");
-
-    if (input == NULL) // unable to open:
+    if (source == NULL) // unable to open:
     {
       printf("**ERROR: unable to open input file '%s' for input.\n", filename);
       return 0;
@@ -67,51 +308,212 @@ int main(int argc, char* argv[])
     printf("nuPython input (enter $ when you're done)>\n");
   }
 
+  struct PHASE_STATS* phases = phase_stats ? phase_create() : NULL;
+
+  //
+  // if this exact source was compiled before, skip the front end:
+  //
+  phase_begin(phases, "parse");
+  alloc_phase("parse");
+
+  unsigned long long source_hash = 0;
+  long long source_length = -1;
+  struct NUPYC* image = NULL;
+
+  if (use_cache && !keyboardInput) {
+    source_hash = nupyc_hash_buffer(source->text, source->length);
+    source_length = (long long) source->length;
+    image = nupyc_cache_load(source_hash, source_length);
+  }
+
   //
   // call parser to check program syntax:
   //
-  struct TokenQueue* tokens = parser_parse(input);
+  struct TokenQueue* tokens = NULL;
+
+  if (image == NULL && source != NULL)
+    tokens = parser_parse_buffer(source->text, source->length);
+  else if (image == NULL)
+    tokens = parser_parse(input);
 
-  if (tokens == NULL)
+  if (image == NULL && tokens == NULL)
   {
     // 
     // program has a syntax error, error msg already output:
     //
     printf("**parsing failed...\n");
+
+    if (emit_c != NULL)
+      exit_status = 1;
   }
   else
   {
     printf("**parsing successful, valid syntax\n");
     printf("**building program graph...\n");
 
-    struct STMT* program = programgraph_build(tokens);
+    phase_begin(phases, "build");
+    alloc_phase("build");
+
+    struct STMT* program = NULL;
+
+    if (image != NULL) {
+      program = nupyc_program(image);
+    }
+    else {
+      program = programgraph_build(tokens);
+
+      if (use_cache && !keyboardInput)
+        nupyc_cache_store(program, source_hash, source_length);
+    }
 
     // programgraph_print(program); // debugging purpose. Comment out for submission.
 
+    if (emit_c != NULL) {
+      //
+      // translate instead of executing:
+      //
+      phase_begin(phases, "transpile");
+      alloc_phase("transpile");
+
+      //
+      // write next to the target and rename when complete, so a
+      // failure never leaves a partial file behind:
+      //
+      size_t tmp_size = strlen(emit_c) + sizeof(".tmp");
+      char* tmp_name = (char*) malloc(tmp_size);
+      FILE* c_file = NULL;
+
+      if (tmp_name != NULL && program != NULL) {
+        snprintf(tmp_name, tmp_size, "%s.tmp", emit_c);
+        c_file = fopen(tmp_name, "w");
+      }
+
+      bool written = c_file != NULL && transpile_program(program, c_file, (filename != NULL) ? filename : "stdin");
+
+      if (c_file != NULL && fclose(c_file) != 0)
+        written = false;
+
+      if (written && rename(tmp_name, emit_c) != 0)
+        written = false;
+
+      if (!written && c_file != NULL)
+        remove(tmp_name);
+
+      free(tmp_name);
+
+      if (written)
+        printf("**wrote C to '%s'\n", emit_c);
+      else
+        printf("**ERROR: unable to write C to '%s'.\n", emit_c);
+
+      if (tokens != NULL)
+        tokenqueue_destroy(tokens);
+      nupyc_close(image);
+      source_close(source);
+
+      phase_end(phases);
+      phase_print(phases, stderr, phase_json);
+      phase_destroy(phases);
+      alloc_report(stderr);
+      return written ? 0 : 1;
+    }
+
+    phase_begin(phases, "optimize");
+    alloc_phase("optimize");
+
+    struct OPT_LOG* optimizations = optimize_program(program);
+
+    //
+    // errors that are certain go to stderr before anything runs:
+    //
+    struct ANALYSIS* analysis = analyze_program(program, stderr);
+
     //
     // now execute the program:
     //
     printf("**executing...\n");
+    fflush(stdout);  // program output bypasses stdio
+
+    phase_begin(phases, "execute");
+    alloc_phase("execute");
 
     struct RAM* memory = ram_init();
+    analyze_reserve(analysis, memory);
+
+    struct PROFILE* profile = NULL;
+    if (profile_path != NULL)
+      profile = profile_create(program, optimizations, filename);
 
-    execute(program, memory);
+    struct SAMPLER* sampler = NULL;
+    if (sample_path != NULL) {
+      sampler = sampler_start(sample_path, sample_hz);
+      if (sampler == NULL)
+        fprintf(stderr, "**ERROR: unable to start sampling, running without it.\n");
+    }
+
+    if (profile != NULL) {
+      profile_execute(profile, program, memory);
+    }
+    else if (max_steps == 0) {
+      execute(program, memory);
+    }
+    else {
+      struct EXECUTE_CURSOR cursor = { NULL, EXECUTE_READY, 0 };
+
+      if (execute_with_budget(program, memory, &cursor, max_steps) == EXECUTE_PAUSED) {
+        output_printf(output_current(), "**EXECUTION LIMIT: stopped after %lld statements (line %d)\n",
+                      cursor.steps, cursor.stmt->line);
+      }
+    }
+
+    if (sampler != NULL) {
+      if (sampler_stop(sampler))
+        fprintf(stderr, "**wrote samples to '%s'\n", sample_path);
+      else
+        fprintf(stderr, "**ERROR: unable to write samples to '%s'.\n", sample_path);
+    }
+
+    phase_begin(phases, "teardown");
+    alloc_phase("teardown");
+
+    output_flush(output_current());
 
     printf("**done\n");
+    fflush(stdout);
 
     ram_print(memory);
 
+    if (stats)
+      optimize_print_stats(optimizations, stderr);
+
+    if (profile_path != NULL) {
+      if (profile != NULL && profile_write(profile, profile_path))
+        fprintf(stderr, "**wrote profile to '%s' and '%s.folded'\n", profile_path, profile_path);
+      else
+        fprintf(stderr, "**ERROR: unable to write profile to '%s'.\n", profile_path);
+      profile_destroy(profile);
+    }
+
     //
     // cleanup:
     //
-    tokenqueue_destroy(tokens);
+    analyze_restore(analysis);
+    optimize_restore(optimizations);
+    if (tokens != NULL)
+      tokenqueue_destroy(tokens);
+    nupyc_close(image);
   }
 
   //
   // done:
   //
-  if (!keyboardInput)
-    fclose(input);
+  source_close(source);
+  input_close();
+
+  phase_end(phases);
+  phase_print(phases, stderr, phase_json);
+  phase_destroy(phases);
+  alloc_report(stderr);
 
-  return 0;
+  return exit_status;
 }
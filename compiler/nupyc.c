@@ -0,0 +1,947 @@
+/*nupyc.c*/
+
+//
+// Compiled nuPython programs. A .nupyc file is a header, followed
+// by the program graph laid out in one block with every pointer
+// stored as an offset into the block, followed by the list of
+// where those pointers are. Loading maps the file copy-on-write
+// and adds the block's address to each listed pointer, so the
+// graph is usable without building it node by node. A checksum of
+// the block and the list, and a walk over the graph checking every
+// node's tags and bounds, keep a damaged file from being run.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stddef.h>   // offsetof
+#include <stdint.h>   // uintptr_t
+#include <errno.h>
+#include <fcntl.h>    // open
+#include <unistd.h>   // write, close, unlink
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat, mkdir
+
+#include "programgraph.h"
+#include "nupyc.h"
+
+
+#define NUPYC_VERSION     2
+#define NUPYC_BYTE_ORDER  0x01020304
+#define NUPYC_ALIGNMENT   8
+
+struct NUPYC_HEADER
+{
+  char               magic[8];       // "NUPYC"
+  unsigned int       version;        // NUPYC_VERSION
+  unsigned int       byte_order;     // NUPYC_BYTE_ORDER as written
+  unsigned int       pointer_size;
+  unsigned int       unused;
+  unsigned long long source_hash;
+  long long          source_length;
+  unsigned long long image_size;     // bytes of graph, right after the header
+  unsigned long long num_relocs;     // # of pointers, listed after the graph
+  unsigned long long program;        // offset of the first stmt
+  unsigned long long checksum;       // of the graph and the pointer list
+};
+
+struct NUPYC
+{
+  char*        base;     // the mapping
+  size_t       size;
+  struct STMT* program;
+};
+
+//
+// Kinds of node in a program graph:
+//
+enum NUPYC_NODES
+{
+  NODE_STMT = 0,
+  NODE_ASSIGNMENT,
+  NODE_CALL_STMT,
+  NODE_IF_THEN_ELSE,
+  NODE_WHILE_LOOP,
+  NODE_PASS,
+  NODE_VALUE,
+  NODE_FUNCTION_CALL,
+  NODE_EXPR,
+  NODE_UNARY_EXPR,
+  NODE_ELEMENT,
+  NODE_STRING
+};
+
+//
+// Size of each kind of node, but strings:
+//
+static const size_t NodeSizes[] = {
+  sizeof(struct STMT), sizeof(struct STMT_ASSIGNMENT), sizeof(struct STMT_FUNCTION_CALL),
+  sizeof(struct STMT_IF_THEN_ELSE), sizeof(struct STMT_WHILE_LOOP), sizeof(struct STMT_PASS),
+  sizeof(struct VALUE), sizeof(struct FUNCTION_CALL), sizeof(struct EXPR),
+  sizeof(struct UNARY_EXPR), sizeof(struct ELEMENT)
+};
+
+//
+// A pointer field in the image that still has to be filled in:
+//
+struct PENDING
+{
+  size_t      field;   // offset of the field in the image
+  const void* target;  // node it points to in the original graph
+  int         kind;    // enum NUPYC_NODES
+};
+
+//
+// Nodes already in the image, by (address, kind):
+//
+struct PLACED
+{
+  const void* node;
+  int         kind;
+  size_t      offset;
+};
+
+struct BUILDER
+{
+  char*   image;
+  size_t  size;
+  size_t  capacity;
+
+  unsigned long long* relocs;
+  size_t  num_relocs;
+  size_t  relocs_capacity;
+
+  struct PENDING* pending;  // stack of fields to fill in
+  size_t  num_pending;
+  size_t  pending_capacity;
+
+  struct PLACED* placed;    // open addressing hash table
+  size_t  num_placed;
+  size_t  placed_capacity;  // power of 2
+
+  bool    failed;  // out of memory
+};
+
+
+//
+// Private functions:
+//
+
+//Lays out the graph reachable from program, returns its offset
+static size_t build_image(struct BUILDER* b, struct STMT* program);
+
+//Returns the offset of the given node in the image, copying it
+// in (and queuing its pointer fields) if it isn't there yet
+static size_t place(struct BUILDER* b, const void* node, int kind);
+
+//Queues the pointer at the given offset in the image
+static void push(struct BUILDER* b, size_t field, const void* target, int kind);
+
+//Reserves size bytes in the image, returns their offset
+static size_t reserve(struct BUILDER* b, size_t size);
+
+//Remembers where a node was placed; lookup returns -1 if nowhere
+static void remember(struct BUILDER* b, const void* node, int kind, size_t offset);
+static long long lookup(struct BUILDER* b, const void* node, int kind);
+
+//Writes all of data to fd, returns true if successful
+static bool write_fully(int fd, const void* data, size_t len);
+
+//Returns the path of the cache file for the given source, or
+// NULL; the caller frees it
+static char* cache_path(unsigned long long source_hash, long long source_length, bool create_dir);
+
+//Continues a 64-bit FNV-1a hash over the given bytes
+static unsigned long long hash_bytes(unsigned long long hash, const unsigned char* bytes, size_t n);
+
+//Returns the checksum of n 8-byte words, which must be aligned:
+// FNV-1a a word at a time, over 4 interleaved lanes
+static unsigned long long checksum_words(const char* words, size_t n);
+
+//Returns true if the relocated graph from program only points
+// within the image, at nodes whose tags are in range, and at
+// strings that end in the image
+static bool check_graph(const char* image, size_t image_size, const struct STMT* program);
+
+
+//
+// Public functions:
+//
+
+//
+// nupyc_write
+//
+// Saves the given program graph to the given file. The file is
+// written under a temporary name and renamed into place, so
+// readers never see part of a file.
+//
+bool nupyc_write(const char* path, struct STMT* program,
+                 unsigned long long source_hash, long long source_length)
+{
+  if (program == NULL)
+    return false;
+
+  struct BUILDER b;
+  memset(&b, 0, sizeof(b));
+
+  size_t root = build_image(&b, program);
+
+  bool success = false;
+
+  if (!b.failed) {
+    struct NUPYC_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "NUPYC", 5);
+    header.version = NUPYC_VERSION;
+    header.byte_order = NUPYC_BYTE_ORDER;
+    header.pointer_size = sizeof(void*);
+    header.source_hash = source_hash;
+    header.source_length = source_length;
+    header.image_size = b.size;
+    header.num_relocs = b.num_relocs;
+    header.program = root;
+    header.checksum = checksum_words(b.image, b.size / sizeof(unsigned long long))
+      ^ checksum_words((const char*) b.relocs, b.num_relocs);
+
+    size_t len = strlen(path);
+    char* temp = (char*) malloc(len + 8);
+
+    if (temp != NULL) {
+      strcpy(temp, path);
+      strcpy(temp + len, ".XXXXXX");
+
+      int fd = mkstemp(temp);
+      if (fd >= 0) {
+        success = write_fully(fd, &header, sizeof(header))
+          && write_fully(fd, b.image, b.size)
+          && write_fully(fd, b.relocs, b.num_relocs * sizeof(unsigned long long));
+
+        if (close(fd) != 0)
+          success = false;
+
+        if (success)
+          success = (rename(temp, path) == 0);
+        if (!success)
+          unlink(temp);
+      }
+      free(temp);
+    }
+  }
+
+  free(b.image);
+  free(b.relocs);
+  free(b.pending);
+  free(b.placed);
+
+  return success;
+}
+
+
+//
+// nupyc_open
+//
+// Maps the given .nupyc file and relocates its pointers. Returns
+// NULL if the file can't be used.
+//
+struct NUPYC* nupyc_open(const char* path,
+                         unsigned long long source_hash, long long source_length)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(struct NUPYC_HEADER)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t) info.st_size;
+  char* base = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (base == MAP_FAILED)
+    return NULL;
+
+  //
+  // is this the file we want, and is it all there?
+  //
+  struct NUPYC_HEADER* header = (struct NUPYC_HEADER*) base;
+  char* image = base + sizeof(struct NUPYC_HEADER);
+  size_t available = size - sizeof(struct NUPYC_HEADER);
+
+  bool valid = memcmp(header->magic, "NUPYC", 5) == 0
+    && header->version == NUPYC_VERSION
+    && header->byte_order == NUPYC_BYTE_ORDER
+    && header->pointer_size == sizeof(void*)
+    && header->source_hash == source_hash
+    && header->source_length == source_length
+    && header->image_size % NUPYC_ALIGNMENT == 0
+    && header->image_size <= available
+    && header->num_relocs == (available - header->image_size) / sizeof(unsigned long long)
+    && (available - header->image_size) % sizeof(unsigned long long) == 0
+    && header->program + sizeof(struct STMT) <= header->image_size
+    && header->checksum == (checksum_words(image, header->image_size / sizeof(unsigned long long))
+                            ^ checksum_words(image + header->image_size, header->num_relocs));
+
+  //
+  // turn the offsets back into pointers:
+  //
+  unsigned long long* relocs = (unsigned long long*) (image + (valid ? header->image_size : 0));
+
+  for (unsigned long long i = 0; valid && i < header->num_relocs; i++) {
+    unsigned long long field = relocs[i];
+
+    if (field % sizeof(void*) != 0 || field + sizeof(void*) > header->image_size) {
+      valid = false;
+      break;
+    }
+
+    uintptr_t offset;
+    memcpy(&offset, image + field, sizeof(offset));
+
+    if (offset >= header->image_size) {
+      valid = false;
+      break;
+    }
+
+    uintptr_t pointer = (uintptr_t) image + offset;
+    memcpy(image + field, &pointer, sizeof(pointer));
+  }
+
+  if (valid)
+    valid = check_graph(image, header->image_size, (struct STMT*) (image + header->program));
+
+  struct NUPYC* result = valid ? (struct NUPYC*) malloc(sizeof(struct NUPYC)) : NULL;
+  if (result == NULL) {
+    munmap(base, size);
+    return NULL;
+  }
+
+  result->base = base;
+  result->size = size;
+  result->program = (struct STMT*) (image + header->program);
+
+  return result;
+}
+
+
+//
+// nupyc_program
+//
+// Returns the program graph held by the given .nupyc file.
+//
+struct STMT* nupyc_program(struct NUPYC* image)
+{
+  return image->program;
+}
+
+
+//
+// nupyc_close
+//
+// Unmaps the given .nupyc file.
+//
+void nupyc_close(struct NUPYC* image)
+{
+  if (image == NULL)
+    return;
+
+  munmap(image->base, image->size);
+  free(image);
+}
+
+
+//
+// nupyc_hash_buffer
+//
+// Returns the 64-bit FNV-1a hash of the given text.
+//
+unsigned long long nupyc_hash_buffer(const char* text, size_t length)
+{
+  return hash_bytes(14695981039346656037ULL, (const unsigned char*) text, length);
+}
+
+
+//
+// nupyc_cache_load
+//
+// Looks up the compiled form of the given source in the cache.
+//
+struct NUPYC* nupyc_cache_load(unsigned long long source_hash, long long source_length)
+{
+  if (source_length < 0)
+    return NULL;
+
+  char* path = cache_path(source_hash, source_length, false);
+  if (path == NULL)
+    return NULL;
+
+  struct NUPYC* image = nupyc_open(path, source_hash, source_length);
+
+  free(path);
+  return image;
+}
+
+
+//
+// nupyc_cache_store
+//
+// Saves the given program graph in the cache.
+//
+void nupyc_cache_store(struct STMT* program, unsigned long long source_hash, long long source_length)
+{
+  if (program == NULL || source_length < 0)
+    return;
+
+  char* path = cache_path(source_hash, source_length, true);
+  if (path == NULL)
+    return;
+
+  nupyc_write(path, program, source_hash, source_length);
+
+  free(path);
+}
+
+
+//
+// Private functions:
+//
+
+static size_t build_image(struct BUILDER* b, struct STMT* program)
+{
+  //
+  // no recursion, the statement chain can be very long:
+  //
+  size_t root = place(b, program, NODE_STMT);
+
+  while (b->num_pending > 0 && !b->failed) {
+    struct PENDING p = b->pending[--b->num_pending];
+
+    uintptr_t offset = (uintptr_t) place(b, p.target, p.kind);
+    if (b->failed)
+      break;
+
+    memcpy(b->image + p.field, &offset, sizeof(offset));
+
+    if (b->num_relocs == b->relocs_capacity) {
+      size_t capacity = (b->relocs_capacity == 0) ? 256 : 2 * b->relocs_capacity;
+      unsigned long long* relocs = (unsigned long long*) realloc(b->relocs, capacity * sizeof(unsigned long long));
+      if (relocs == NULL) {
+        b->failed = true;
+        break;
+      }
+      b->relocs = relocs;
+      b->relocs_capacity = capacity;
+    }
+    b->relocs[b->num_relocs++] = p.field;
+  }
+
+  return root;
+}
+
+static size_t place(struct BUILDER* b, const void* node, int kind)
+{
+  long long found = lookup(b, node, kind);
+  if (found >= 0)
+    return (size_t) found;
+
+  size_t size = (kind == NODE_STRING) ? strlen((const char*) node) + 1 : NodeSizes[kind];
+
+  size_t at = reserve(b, size);
+  if (b->failed)
+    return 0;
+
+  memcpy(b->image + at, node, size);
+  remember(b, node, kind, at);
+
+  //
+  // queue the node's pointers, which still point into the
+  // original graph:
+  //
+  switch (kind)
+  {
+  case NODE_STMT: {
+    const struct STMT* stmt = (const struct STMT*) node;
+    size_t field = at + offsetof(struct STMT, types);
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT)
+      push(b, field, stmt->types.assignment, NODE_ASSIGNMENT);
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+      push(b, field, stmt->types.function_call, NODE_CALL_STMT);
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE)
+      push(b, field, stmt->types.if_then_else, NODE_IF_THEN_ELSE);
+    else if (stmt->stmt_type == STMT_WHILE_LOOP)
+      push(b, field, stmt->types.while_loop, NODE_WHILE_LOOP);
+    else
+      push(b, field, stmt->types.pass, NODE_PASS);
+    break;
+  }
+
+  case NODE_ASSIGNMENT: {
+    const struct STMT_ASSIGNMENT* assignment = (const struct STMT_ASSIGNMENT*) node;
+    push(b, at + offsetof(struct STMT_ASSIGNMENT, var_name), assignment->var_name, NODE_STRING);
+    push(b, at + offsetof(struct STMT_ASSIGNMENT, rhs), assignment->rhs, NODE_VALUE);
+    push(b, at + offsetof(struct STMT_ASSIGNMENT, next_stmt), assignment->next_stmt, NODE_STMT);
+    break;
+  }
+
+  case NODE_CALL_STMT: {
+    const struct STMT_FUNCTION_CALL* call = (const struct STMT_FUNCTION_CALL*) node;
+    push(b, at + offsetof(struct STMT_FUNCTION_CALL, function_name), call->function_name, NODE_STRING);
+    push(b, at + offsetof(struct STMT_FUNCTION_CALL, parameter), call->parameter, NODE_ELEMENT);
+    push(b, at + offsetof(struct STMT_FUNCTION_CALL, next_stmt), call->next_stmt, NODE_STMT);
+    break;
+  }
+
+  case NODE_IF_THEN_ELSE: {
+    const struct STMT_IF_THEN_ELSE* branch = (const struct STMT_IF_THEN_ELSE*) node;
+    push(b, at + offsetof(struct STMT_IF_THEN_ELSE, condition), branch->condition, NODE_EXPR);
+    push(b, at + offsetof(struct STMT_IF_THEN_ELSE, true_path), branch->true_path, NODE_STMT);
+    push(b, at + offsetof(struct STMT_IF_THEN_ELSE, false_path), branch->false_path, NODE_STMT);
+    break;
+  }
+
+  case NODE_WHILE_LOOP: {
+    const struct STMT_WHILE_LOOP* loop = (const struct STMT_WHILE_LOOP*) node;
+    push(b, at + offsetof(struct STMT_WHILE_LOOP, condition), loop->condition, NODE_EXPR);
+    push(b, at + offsetof(struct STMT_WHILE_LOOP, loop_body), loop->loop_body, NODE_STMT);
+    push(b, at + offsetof(struct STMT_WHILE_LOOP, next_stmt), loop->next_stmt, NODE_STMT);
+    break;
+  }
+
+  case NODE_PASS: {
+    const struct STMT_PASS* pass = (const struct STMT_PASS*) node;
+    push(b, at + offsetof(struct STMT_PASS, next_stmt), pass->next_stmt, NODE_STMT);
+    break;
+  }
+
+  case NODE_VALUE: {
+    const struct VALUE* value = (const struct VALUE*) node;
+    size_t field = at + offsetof(struct VALUE, types);
+
+    if (value->value_type == VALUE_FUNCTION_CALL)
+      push(b, field, value->types.function_call, NODE_FUNCTION_CALL);
+    else
+      push(b, field, value->types.expr, NODE_EXPR);
+    break;
+  }
+
+  case NODE_FUNCTION_CALL: {
+    const struct FUNCTION_CALL* call = (const struct FUNCTION_CALL*) node;
+    push(b, at + offsetof(struct FUNCTION_CALL, function_name), call->function_name, NODE_STRING);
+    push(b, at + offsetof(struct FUNCTION_CALL, parameter), call->parameter, NODE_ELEMENT);
+    break;
+  }
+
+  case NODE_EXPR: {
+    const struct EXPR* expr = (const struct EXPR*) node;
+    push(b, at + offsetof(struct EXPR, lhs), expr->lhs, NODE_UNARY_EXPR);
+    push(b, at + offsetof(struct EXPR, rhs), expr->rhs, NODE_UNARY_EXPR);
+    break;
+  }
+
+  case NODE_UNARY_EXPR: {
+    const struct UNARY_EXPR* unary = (const struct UNARY_EXPR*) node;
+    push(b, at + offsetof(struct UNARY_EXPR, element), unary->element, NODE_ELEMENT);
+    break;
+  }
+
+  case NODE_ELEMENT: {
+    const struct ELEMENT* element = (const struct ELEMENT*) node;
+    push(b, at + offsetof(struct ELEMENT, element_value), element->element_value, NODE_STRING);
+    break;
+  }
+
+  default: // NODE_STRING, no pointers
+    break;
+  }
+
+  return at;
+}
+
+static void push(struct BUILDER* b, size_t field, const void* target, int kind)
+{
+  if (target == NULL) // stays NULL, nothing to relocate
+    return;
+
+  if (b->num_pending == b->pending_capacity) {
+    size_t capacity = (b->pending_capacity == 0) ? 64 : 2 * b->pending_capacity;
+    struct PENDING* pending = (struct PENDING*) realloc(b->pending, capacity * sizeof(struct PENDING));
+    if (pending == NULL) {
+      b->failed = true;
+      return;
+    }
+    b->pending = pending;
+    b->pending_capacity = capacity;
+  }
+
+  b->pending[b->num_pending].field = field;
+  b->pending[b->num_pending].target = target;
+  b->pending[b->num_pending].kind = kind;
+  b->num_pending++;
+}
+
+static size_t reserve(struct BUILDER* b, size_t size)
+{
+  size = (size + NUPYC_ALIGNMENT - 1) & ~(size_t) (NUPYC_ALIGNMENT - 1);
+
+  if (b->size + size > b->capacity) {
+    size_t capacity = (b->capacity == 0) ? 4096 : b->capacity;
+    while (capacity < b->size + size)
+      capacity *= 2;
+
+    char* image = (char*) realloc(b->image, capacity);
+    if (image == NULL) {
+      b->failed = true;
+      return 0;
+    }
+    b->image = image;
+    b->capacity = capacity;
+  }
+
+  size_t at = b->size;
+  memset(b->image + at, 0, size);  // no stray padding bytes in the file
+  b->size += size;
+  return at;
+}
+
+static size_t hash_node(const void* node, int kind, size_t mask)
+{
+  uintptr_t h = (uintptr_t) node;
+  h ^= h >> 17;
+  h *= 0x9E3779B97F4A7C15ULL;
+  h ^= (uintptr_t) kind;
+  return (size_t) (h ^ (h >> 29)) & mask;
+}
+
+static void remember(struct BUILDER* b, const void* node, int kind, size_t offset)
+{
+  if (2 * (b->num_placed + 1) > b->placed_capacity) {
+    size_t capacity = (b->placed_capacity == 0) ? 256 : 2 * b->placed_capacity;
+    struct PLACED* placed = (struct PLACED*) calloc(capacity, sizeof(struct PLACED));
+    if (placed == NULL) {
+      b->failed = true;
+      return;
+    }
+
+    for (size_t i = 0; i < b->placed_capacity; i++) {
+      if (b->placed[i].node == NULL)
+        continue;
+
+      size_t slot = hash_node(b->placed[i].node, b->placed[i].kind, capacity - 1);
+      while (placed[slot].node != NULL)
+        slot = (slot + 1) & (capacity - 1);
+      placed[slot] = b->placed[i];
+    }
+
+    free(b->placed);
+    b->placed = placed;
+    b->placed_capacity = capacity;
+  }
+
+  size_t slot = hash_node(node, kind, b->placed_capacity - 1);
+  while (b->placed[slot].node != NULL)
+    slot = (slot + 1) & (b->placed_capacity - 1);
+
+  b->placed[slot].node = node;
+  b->placed[slot].kind = kind;
+  b->placed[slot].offset = offset;
+  b->num_placed++;
+}
+
+static long long lookup(struct BUILDER* b, const void* node, int kind)
+{
+  if (b->placed_capacity == 0)
+    return -1;
+
+  size_t slot = hash_node(node, kind, b->placed_capacity - 1);
+  while (b->placed[slot].node != NULL) {
+    if (b->placed[slot].node == node && b->placed[slot].kind == kind)
+      return (long long) b->placed[slot].offset;
+    slot = (slot + 1) & (b->placed_capacity - 1);
+  }
+  return -1;
+}
+
+static bool write_fully(int fd, const void* data, size_t len)
+{
+  const char* p = (const char*) data;
+
+  while (len > 0) {
+    ssize_t written = write(fd, p, len);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += written;
+    len -= (size_t) written;
+  }
+  return true;
+}
+
+static unsigned long long hash_bytes(unsigned long long hash, const unsigned char* bytes, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static unsigned long long checksum_words(const char* words, size_t n)
+{
+  const unsigned long long* w = (const unsigned long long*) words;
+
+  //
+  // the lanes' multiplies don't wait on each other:
+  //
+  unsigned long long lanes[4] = { 14695981039346656037ULL, 1, 2, 3 };
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    lanes[0] = (lanes[0] ^ w[i]) * 1099511628211ULL;
+    lanes[1] = (lanes[1] ^ w[i + 1]) * 1099511628211ULL;
+    lanes[2] = (lanes[2] ^ w[i + 2]) * 1099511628211ULL;
+    lanes[3] = (lanes[3] ^ w[i + 3]) * 1099511628211ULL;
+  }
+  for (; i < n; i++)
+    lanes[0] = (lanes[0] ^ w[i]) * 1099511628211ULL;
+
+  unsigned long long hash = n;
+  for (int k = 0; k < 4; k++) {
+    hash = (hash ^ lanes[k] ^ (lanes[k] >> 29)) * 1099511628211ULL;  // high bits reach the low ones
+  }
+  return hash;
+}
+
+static bool check_graph(const char* image, size_t image_size, const struct STMT* program)
+{
+  //
+  // every node sits at its own aligned offset; kinds[] holds the
+  // kind + 1 it was reached as, so a node reached twice is only
+  // checked once and can't be two kinds at once:
+  //
+  size_t num_slots = image_size / NUPYC_ALIGNMENT;
+  unsigned char* kinds = (unsigned char*) calloc(num_slots + 1, 1);
+
+  size_t capacity = 256;
+  size_t count = 0;
+  struct PENDING* stack = (struct PENDING*) malloc(capacity * sizeof(struct PENDING));
+
+  bool valid = (kinds != NULL && stack != NULL);
+
+  if (valid) {
+    stack[count].target = program;
+    stack[count].kind = NODE_STMT;
+    count++;
+  }
+
+  while (valid && count > 0) {
+    struct PENDING p = stack[--count];
+    const char* node = (const char*) p.target;
+    size_t at = (size_t) (node - image);
+
+    if (node < image || at >= image_size || at % NUPYC_ALIGNMENT != 0) {
+      valid = false;
+      break;
+    }
+    if (kinds[at / NUPYC_ALIGNMENT] != 0) {
+      valid = (kinds[at / NUPYC_ALIGNMENT] == p.kind + 1);
+      continue;
+    }
+    kinds[at / NUPYC_ALIGNMENT] = (unsigned char) (p.kind + 1);
+
+    if (p.kind == NODE_STRING) {
+      valid = memchr(node, '\0', image_size - at) != NULL;
+      continue;
+    }
+    if (NodeSizes[p.kind] > image_size - at) {
+      valid = false;
+      break;
+    }
+
+    //
+    // the node's pointers, NULL where the graph allows it:
+    //
+    const void* children[3] = { NULL, NULL, NULL };
+    int child_kinds[3] = { NODE_STMT, NODE_STMT, NODE_STMT };
+    bool required[3] = { false, false, false };
+
+    switch (p.kind)
+    {
+    case NODE_STMT: {
+      const struct STMT* stmt = (const struct STMT*) node;
+      static const int Kinds[] = { NODE_ASSIGNMENT, NODE_CALL_STMT, NODE_IF_THEN_ELSE, NODE_WHILE_LOOP, NODE_PASS };
+
+      valid = stmt->stmt_type >= STMT_ASSIGNMENT && stmt->stmt_type <= STMT_PASS;
+      if (valid) {
+        children[0] = stmt->types.pass;  // every member of the union is a pointer
+        child_kinds[0] = Kinds[stmt->stmt_type];
+        required[0] = true;
+      }
+      break;
+    }
+
+    case NODE_ASSIGNMENT: {
+      const struct STMT_ASSIGNMENT* assignment = (const struct STMT_ASSIGNMENT*) node;
+      unsigned char deref;
+      memcpy(&deref, &assignment->isPtrDeref, 1);
+
+      valid = deref <= 1;
+      children[0] = assignment->var_name;   child_kinds[0] = NODE_STRING;  required[0] = true;
+      children[1] = assignment->rhs;        child_kinds[1] = NODE_VALUE;   required[1] = true;
+      children[2] = assignment->next_stmt;
+      break;
+    }
+
+    case NODE_CALL_STMT: {
+      const struct STMT_FUNCTION_CALL* call = (const struct STMT_FUNCTION_CALL*) node;
+      children[0] = call->function_name;    child_kinds[0] = NODE_STRING;  required[0] = true;
+      children[1] = call->parameter;        child_kinds[1] = NODE_ELEMENT;
+      children[2] = call->next_stmt;
+      break;
+    }
+
+    case NODE_IF_THEN_ELSE: {
+      const struct STMT_IF_THEN_ELSE* branch = (const struct STMT_IF_THEN_ELSE*) node;
+      children[0] = branch->condition;      child_kinds[0] = NODE_EXPR;    required[0] = true;
+      children[1] = branch->true_path;
+      children[2] = branch->false_path;
+      break;
+    }
+
+    case NODE_WHILE_LOOP: {
+      const struct STMT_WHILE_LOOP* loop = (const struct STMT_WHILE_LOOP*) node;
+      children[0] = loop->condition;        child_kinds[0] = NODE_EXPR;    required[0] = true;
+      children[1] = loop->loop_body;
+      children[2] = loop->next_stmt;
+      break;
+    }
+
+    case NODE_PASS: {
+      const struct STMT_PASS* pass = (const struct STMT_PASS*) node;
+      children[0] = pass->next_stmt;
+      break;
+    }
+
+    case NODE_VALUE: {
+      const struct VALUE* value = (const struct VALUE*) node;
+
+      valid = value->value_type == VALUE_FUNCTION_CALL || value->value_type == VALUE_EXPR;
+      children[0] = value->types.expr;
+      child_kinds[0] = (value->value_type == VALUE_FUNCTION_CALL) ? NODE_FUNCTION_CALL : NODE_EXPR;
+      required[0] = true;
+      break;
+    }
+
+    case NODE_FUNCTION_CALL: {
+      const struct FUNCTION_CALL* call = (const struct FUNCTION_CALL*) node;
+      children[0] = call->function_name;    child_kinds[0] = NODE_STRING;  required[0] = true;
+      children[1] = call->parameter;        child_kinds[1] = NODE_ELEMENT;
+      break;
+    }
+
+    case NODE_EXPR: {
+      const struct EXPR* expr = (const struct EXPR*) node;
+      unsigned char binary;
+      memcpy(&binary, &expr->isBinaryExpr, 1);
+
+      valid = binary <= 1 && expr->operator >= OPERATOR_PLUS && expr->operator <= OPERATOR_NO_OP;
+      children[0] = expr->lhs;              child_kinds[0] = NODE_UNARY_EXPR;  required[0] = true;
+      children[1] = expr->rhs;              child_kinds[1] = NODE_UNARY_EXPR;  required[1] = (binary != 0);
+      break;
+    }
+
+    case NODE_UNARY_EXPR: {
+      const struct UNARY_EXPR* unary = (const struct UNARY_EXPR*) node;
+
+      valid = unary->expr_type >= UNARY_PTR_DEREF && unary->expr_type <= UNARY_ELEMENT;
+      children[0] = unary->element;         child_kinds[0] = NODE_ELEMENT;  required[0] = true;
+      break;
+    }
+
+    case NODE_ELEMENT: {
+      const struct ELEMENT* element = (const struct ELEMENT*) node;
+
+      valid = element->element_type >= ELEMENT_IDENTIFIER && element->element_type <= ELEMENT_NONE;
+      children[0] = element->element_value; child_kinds[0] = NODE_STRING;  required[0] = true;
+      break;
+    }
+    }
+
+    for (int i = 0; valid && i < 3; i++) {
+      if (children[i] == NULL) {
+        valid = !required[i];
+        continue;
+      }
+
+      if (count == capacity) {
+        struct PENDING* bigger = (struct PENDING*) realloc(stack, 2 * capacity * sizeof(struct PENDING));
+        if (bigger == NULL) {
+          valid = false;
+          break;
+        }
+        stack = bigger;
+        capacity *= 2;
+      }
+      stack[count].target = children[i];
+      stack[count].kind = child_kinds[i];
+      count++;
+    }
+  }
+
+  free(kinds);
+  free(stack);
+  return valid;
+}
+
+static char* cache_path(unsigned long long source_hash, long long source_length, bool create_dir)
+{
+  const char* dir = getenv("NUPY_CACHE_DIR");
+  const char* home = getenv("HOME");
+  const char* suffix = "";
+
+  if (dir == NULL || dir[0] == '\0') {
+    if (home == NULL || home[0] == '\0')
+      return NULL;
+    dir = home;
+    suffix = "/.cache/nupython";
+  }
+
+  size_t len = strlen(dir) + strlen(suffix) + 64;
+  char* path = (char*) malloc(len);
+  if (path == NULL)
+    return NULL;
+
+  snprintf(path, len, "%s%s", dir, suffix);
+
+  if (create_dir) {
+    //
+    // mkdir -p, one component at a time:
+    //
+    for (char* p = path + 1; ; p++) {
+      if (*p == '/' || *p == '\0') {
+        char c = *p;
+        *p = '\0';
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+          free(path);
+          return NULL;
+        }
+        *p = c;
+        if (c == '\0')
+          break;
+      }
+    }
+  }
+
+  size_t used = strlen(path);
+  snprintf(path + used, len - used, "/%016llx-%llx.nupyc", source_hash, (unsigned long long) source_length);
+
+  return path;
+}
@@ -0,0 +1,94 @@
+/*nupyc.h*/
+
+//
+// Compiled nuPython programs (.nupyc files): a program graph saved
+// in one flat block that is mmap'ed back in and used directly, plus
+// a cache of them keyed by the contents of the source file.
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+
+
+//
+// A program graph loaded from a .nupyc file.
+//
+struct NUPYC;
+
+
+//
+// Public functions:
+//
+
+//
+// nupyc_write
+//
+// Saves the given program graph, which must be the graph built
+// by programgraph_build() (i.e. not yet optimized), to the given
+// file. source_hash and source_length identify the source the
+// graph was built from. Returns true if successful.
+//
+bool nupyc_write(const char* path, struct STMT* program,
+                 unsigned long long source_hash, long long source_length);
+
+//
+// nupyc_open
+//
+// Maps the given .nupyc file into memory and returns it, or NULL
+// if the file is missing, damaged (its checksum doesn't match, or
+// a node's type tag, pointer or string is out of range), or was
+// not built from a source with the given hash and length. The graph lives in the mapping
+// itself, so there is no allocation per node; it may be modified
+// (e.g. by the optimizer) without changing the file.
+//
+struct NUPYC* nupyc_open(const char* path,
+                         unsigned long long source_hash, long long source_length);
+
+//
+// nupyc_program
+//
+// Returns the program graph held by the given .nupyc file.
+//
+struct STMT* nupyc_program(struct NUPYC* image);
+
+//
+// nupyc_close
+//
+// Unmaps the given .nupyc file. Its program graph can no longer
+// be used, and must not be passed to programgraph_destroy().
+//
+void nupyc_close(struct NUPYC* image);
+
+//
+// nupyc_hash_buffer
+//
+// Hashes the contents of a source file already in memory, the
+// hash nupyc_cache_load() and nupyc_cache_store() key the cache
+// by, along with the length.
+//
+unsigned long long nupyc_hash_buffer(const char* text, size_t length);
+
+//
+// nupyc_cache_load
+//
+// Looks up the compiled form of a source with the given hash and
+// length in the cache directory. Returns NULL if there is none.
+//
+// The cache directory is $NUPY_CACHE_DIR if set, otherwise
+// $HOME/.cache/nupython.
+//
+struct NUPYC* nupyc_cache_load(unsigned long long source_hash, long long source_length);
+
+//
+// nupyc_cache_store
+//
+// Saves the given (unoptimized) program graph in the cache
+// directory under the given source hash and length, creating the
+// directory if need be. Failures are ignored, the cache is only
+// an optimization.
+//
+void nupyc_cache_store(struct STMT* program, unsigned long long source_hash, long long source_length);
@@ -0,0 +1,1457 @@
+/*optimize.c*/
+
+//
+// Optimization passes over a nuPython program graph. Every change
+// made to a statement that programgraph_build() allocated is logged,
+// so optimize_restore() can put the graph back the way it was.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <assert.h>
+#include <limits.h>   // INT_MIN, LLONG_MAX
+
+#include "programgraph.h"
+#include "optimize.h"
+
+
+//
+// A link that was overwritten, i.e. stmt's next_stmt was next:
+//
+struct OPT_LINK
+{
+  struct STMT* stmt;
+  struct STMT* next;
+};
+
+struct OPT_LOG
+{
+  struct OPT_LINK* links;  // overwritten links, in the order changed
+  int num_links;
+  int links_capacity;
+
+  struct STMT** nodes;     // statements allocated by the optimizer
+  struct STMT** originals; // nodes[i] is a copy of originals[i]
+  int num_nodes;
+  int nodes_capacity;
+  long long budget;        // # of statements peeling may still scan or copy
+
+  struct STMT** switches;  // ifs turned into STMT_SWITCH
+  int num_switches;
+  int switches_capacity;
+
+  struct STMT** fused;     // statements turned into STMT_FUSED
+  int num_fused;
+  int fused_capacity;
+
+  struct STMT** counted;   // loops turned into STMT_COUNTED
+  int num_counted;
+  int counted_capacity;
+};
+
+//
+// Set of statements already visited, open addressing:
+//
+struct STMT_SET
+{
+  struct STMT** slots;
+  int capacity;  // power of 2
+  int count;
+};
+
+struct STMT_STACK
+{
+  struct STMT** stmts;
+  int count;
+  int capacity;
+};
+
+//
+// Peeling a loop scans and copies its body, inner loops included,
+// and the copy's inner loops are peeled in turn. So that deep
+// nesting can't blow up, all the peeling together scans or copies
+// at most this many statements per statement of the program;
+// once that's used up, no more loops are peeled:
+//
+#define OPT_WORK_FACTOR 8
+
+//
+// One if of a chain being lowered:
+//
+struct CHAIN_CASE
+{
+  int value;
+  int position;
+  struct STMT* target;
+};
+
+//
+// Shortest if/elif chain worth a table:
+//
+#define OPT_MIN_CASES 3
+
+//
+// Most statements computing a reduction's term:
+//
+#define OPT_MAX_TERMS 8
+
+//
+// Number of times each variable is assigned within a loop:
+//
+struct VAR_DEF
+{
+  char* name;
+  int   count;
+};
+
+struct DEF_SET
+{
+  struct VAR_DEF* defs;
+  int num_defs;
+  int capacity;
+  bool unknown;  // true => a write we can't attribute to a name
+};
+
+
+//
+// Private functions:
+//
+
+//Returns the statement that follows stmt; for a while loop this
+// is the statement after the loop.
+static struct STMT* stmt_next(struct STMT* stmt);
+
+//Sets the statement that follows stmt
+static void stmt_set_next(struct STMT* stmt, struct STMT* next);
+
+//Walks the statements from start up to (not including) stop, and
+// hoists invariants out of every while loop found along the way,
+// outer loops before inner ones, while the budget lasts.
+static void optimize_chain(struct STMT* start, struct STMT* stop, struct OPT_LOG* log);
+
+//Hoists the invariant assignments out of the given while loop.
+//
+// Returns the loop that later iterations run, or NULL if there
+// was nothing to hoist or the loop is too big for the budget left.
+static struct STMT* hoist_invariants(struct STMT* loop, struct OPT_LOG* log);
+
+//Returns the # of statements from start up to stop, including the
+// bodies of nested loops, counting no further than limit + 1
+static long long count_stmts(struct STMT* start, struct STMT* stop, long long limit);
+
+//Counts the assignments to each variable from start up to stop,
+// including the bodies of nested loops.
+static void collect_defs(struct STMT* start, struct STMT* stop, struct DEF_SET* set);
+
+//Returns the # of times name is assigned in the set
+static int def_count(struct DEF_SET* set, char* name);
+
+//Returns true if the assignment's value is the same on every
+// iteration of a loop whose writes are in the set.
+static bool is_invariant(struct STMT* stmt, struct DEF_SET* set);
+
+//Copies the statements from start up to stop, skipping those in
+// skip[]; the last copy is linked to stop_to. Returns the first
+// copy, or NULL if nothing was copied.
+static struct STMT* copy_chain(struct STMT* start, struct STMT* stop, struct STMT* stop_to,
+                               struct STMT** skip, int num_skip, struct OPT_LOG* log);
+
+//Returns a shallow copy of stmt; expressions are shared
+static struct STMT* copy_stmt(struct STMT* stmt, struct OPT_LOG* log);
+
+//Records that stmt's next_stmt is about to be overwritten
+static void log_link(struct OPT_LOG* log, struct STMT* stmt);
+
+//Visits every statement reachable from program and lowers the
+// if/elif chains found to STMT_SWITCH
+static void lower_switches(struct STMT* program, struct OPT_LOG* log);
+
+//Lowers the chain starting at the given if. Returns true if it
+// became a STMT_SWITCH.
+static bool lower_chain(struct STMT* head, struct OPT_LOG* log);
+
+//Returns true if stmt is "if var == k" or "if k == var" for an int
+// literal k, storing k in *value. If *var is NULL any variable is
+// accepted and stored in *var, otherwise it must have the same name.
+static bool is_case(struct STMT* stmt, struct ELEMENT** var, int* value);
+
+//Orders cases by value, then by position in the chain
+static int compare_cases(const void* p1, const void* p2);
+
+//Adds stmt to the set; returns false if it was already there
+static bool set_add(struct STMT_SET* set, struct STMT* stmt);
+
+//Pushes stmt onto the stack
+static void push_stmt(struct STMT_STACK* stack, struct STMT* stmt);
+
+//Visits every statement reachable from program and turns the
+// counting while loops into STMT_COUNTED
+static void count_loops(struct STMT* program, struct OPT_LOG* log);
+
+//Turns the given while loop into a STMT_COUNTED if it counts.
+// Returns true if it did.
+static bool count_loop(struct STMT* loop, struct OPT_LOG* log);
+
+//Returns true if stmt is "name = name + k" for an int literal k > 0
+static bool is_increment(struct STMT* stmt, char* name);
+
+//Returns true if stmt reads the variable with the given name
+static bool reads_var(struct STMT* stmt, char* name);
+
+//Returns the reduction a counted loop's body computes, see struct
+// OPT_REDUCTION, or NULL if it does something else
+static struct OPT_REDUCTION* find_reduction(struct STMT* body, struct STMT* increment, char* i);
+
+//Returns true if stmt is "t = a op b" for a, b int literals, i or
+// (when prev isn't NULL) t, and op one of + - *; *t is set to the
+// variable the first time. The polynomial in i it computes, given
+// t = prev before, is stored in p.
+static bool is_term(struct STMT* stmt, char* i, char** t, const int* prev, int p[]);
+
+//Stores an operand of a term as a polynomial in i in p. Returns
+// false if it's not an int literal, i or t (when prev isn't NULL)
+static bool term_operand(struct UNARY_EXPR* operand, char* i, char* t, const int* prev, int p[]);
+
+//Returns the statement a STMT_SWITCH or STMT_COUNTED stands for,
+// stmt itself for any other
+static struct STMT* as_written(struct STMT* stmt);
+
+//Stores the statements that can follow stmt in succ, NULL for the
+// end of the program, and returns how many there are
+static int stmt_successors(struct STMT* stmt, struct STMT* succ[2]);
+
+//Visits every statement reachable from program and turns the ones
+// of a common shape into STMT_FUSED
+static void fuse_statements(struct STMT* program, struct OPT_LOG* log);
+
+//Turns stmt into a STMT_FUSED if it has one of the shapes
+static void fuse_stmt(struct STMT* stmt, struct OPT_LOG* log);
+
+//Returns true if element is the variable with the given name
+static bool is_var(struct ELEMENT* element, char* name);
+
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Runs the optimization passes over the given program graph,
+// rewriting it in place. Returns a log of the changes made.
+//
+struct OPT_LOG* optimize_program(struct STMT* program)
+{
+  struct OPT_LOG* log = (struct OPT_LOG*) malloc(sizeof(struct OPT_LOG));
+  if (log == NULL) {
+    fprintf(stderr, "Error: Failed to allocate memory for optimizer");
+    return NULL;
+  }
+  log->links = NULL;
+  log->num_links = 0;
+  log->links_capacity = 0;
+  log->nodes = NULL;
+  log->originals = NULL;
+  log->num_nodes = 0;
+  log->nodes_capacity = 0;
+  log->switches = NULL;
+  log->num_switches = 0;
+  log->switches_capacity = 0;
+  log->fused = NULL;
+  log->num_fused = 0;
+  log->fused_capacity = 0;
+  log->counted = NULL;
+  log->num_counted = 0;
+  log->counted_capacity = 0;
+
+  log->budget = OPT_WORK_FACTOR * count_stmts(program, NULL, LLONG_MAX);
+
+  optimize_chain(program, NULL, log);
+  lower_switches(program, log);
+  count_loops(program, log);
+  fuse_statements(program, log);
+
+  return log;
+}
+
+
+//
+// optimize_restore
+//
+// Undoes the changes recorded in the given log and frees the
+// statements the optimizer allocated.
+//
+void optimize_restore(struct OPT_LOG* log)
+{
+  if (log == NULL)
+    return;
+
+  for (int i = 0; i < log->num_fused; i++) { // the newest changes
+    struct STMT* stmt = log->fused[i];
+    struct OPT_FUSED* fused = OPT_FUSED_OF(stmt);
+
+    *stmt = *fused->original;
+
+    free(fused->original);
+    free(fused);
+  }
+
+  for (int i = 0; i < log->num_counted; i++) {
+    struct STMT* stmt = log->counted[i];
+    struct OPT_COUNTED* counted = OPT_COUNTED_OF(stmt);
+
+    *stmt = *counted->original;
+
+    free(counted->original);
+    free(counted->reduction);
+    free(counted);
+  }
+
+  for (int i = log->num_links - 1; i >= 0; i--) { // newest change first
+    stmt_set_next(log->links[i].stmt, log->links[i].next);
+  }
+
+  for (int i = 0; i < log->num_switches; i++) {
+    struct STMT* stmt = log->switches[i];
+    struct OPT_SWITCH* sw = OPT_SWITCH_OF(stmt);
+
+    stmt->stmt_type = STMT_IF_THEN_ELSE;
+    stmt->types.if_then_else = sw->fallback->types.if_then_else;
+
+    free(sw->fallback); // shares the if with stmt
+    free(sw->table);
+    free(sw->cases);
+    free(sw);
+  }
+
+  for (int i = 0; i < log->num_nodes; i++) {
+    struct STMT* stmt = log->nodes[i];
+    free(stmt->types.pass); // every member of the union is a pointer
+    free(stmt);
+  }
+
+  free(log->links);
+  free(log->nodes);
+  free(log->originals);
+  free(log->switches);
+  free(log->fused);
+  free(log->counted);
+  free(log);
+}
+
+
+//
+// optimize_print_stats
+//
+// Writes how many statements were fused and how often they ran
+// to the given stream.
+//
+void optimize_print_stats(struct OPT_LOG* log, FILE* out)
+{
+  static const char* Shapes[OPT_NUM_FUSED] = {
+    "x = x + k", "x = x + y", "s = s + \"...\"", "while i < n"
+  };
+
+  long long stmts[OPT_NUM_FUSED] = { 0 };
+  long long runs[OPT_NUM_FUSED] = { 0 };
+  long long fallbacks[OPT_NUM_FUSED] = { 0 };
+
+  for (int i = 0; log != NULL && i < log->num_fused; i++) {
+    struct OPT_FUSED* fused = OPT_FUSED_OF(log->fused[i]);
+    stmts[fused->op]++;
+    runs[fused->op] += fused->runs;
+    fallbacks[fused->op] += fused->fallbacks;
+  }
+
+  fprintf(out, "**STATS: fused statements\n");
+  fprintf(out, "  %-16s %8s %14s %14s\n", "shape", "stmts", "runs fused", "runs as is");
+  for (int op = 0; op < OPT_NUM_FUSED; op++)
+    fprintf(out, "  %-16s %8lld %14lld %14lld\n", Shapes[op], stmts[op], runs[op], fallbacks[op]);
+
+  long long loops = 0;
+  long long counted_runs = 0;
+  long long counted_fallbacks = 0;
+  long long reductions = 0;
+  long long reduction_runs = 0;
+  long long reduction_fallbacks = 0;
+
+  for (int i = 0; log != NULL && i < log->num_counted; i++) {
+    struct OPT_COUNTED* counted = OPT_COUNTED_OF(log->counted[i]);
+    loops++;
+    counted_runs += counted->runs;
+    counted_fallbacks += counted->fallbacks;
+
+    if (counted->reduction != NULL) {
+      reductions++;
+      reduction_runs += counted->reduction->runs;
+      reduction_fallbacks += counted->reduction->fallbacks;
+    }
+  }
+
+  fprintf(out, "  %-16s %8lld %14lld %14lld\n", "counted loop", loops, counted_runs, counted_fallbacks);
+  fprintf(out, "  %-16s %8lld %14lld %14lld\n", "reduction", reductions, reduction_runs, reduction_fallbacks);
+  fprintf(out, "  reduction kernel: %s\n", reduce_kernel_name(reduce_kernel()));
+}
+
+
+//
+// optimize_copies
+//
+// Hands out the log's arrays of copied statements and what each
+// was copied from.
+//
+int optimize_copies(struct OPT_LOG* log, struct STMT*** copies, struct STMT*** originals)
+{
+  *copies = log->nodes;
+  *originals = log->originals;
+  return log->num_nodes;
+}
+
+
+//
+// Private functions:
+//
+
+static struct STMT* stmt_next(struct STMT* stmt)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT)
+    return stmt->types.assignment->next_stmt;
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    return stmt->types.function_call->next_stmt;
+  else if (stmt->stmt_type == STMT_WHILE_LOOP)
+    return stmt->types.while_loop->next_stmt;
+  else if (stmt->stmt_type == STMT_PASS)
+    return stmt->types.pass->next_stmt;
+
+  return NULL; // if-then-else has no single successor
+}
+
+static void stmt_set_next(struct STMT* stmt, struct STMT* next)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT)
+    stmt->types.assignment->next_stmt = next;
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    stmt->types.function_call->next_stmt = next;
+  else if (stmt->stmt_type == STMT_WHILE_LOOP)
+    stmt->types.while_loop->next_stmt = next;
+  else {
+    assert(stmt->stmt_type == STMT_PASS);
+    stmt->types.pass->next_stmt = next;
+  }
+}
+
+static void optimize_chain(struct STMT* start, struct STMT* stop, struct OPT_LOG* log)
+{
+  for (struct STMT* stmt = start; stmt != NULL && stmt != stop; stmt = stmt_next(stmt)) {
+    if (stmt->stmt_type == STMT_IF_THEN_ELSE)
+      return; // not produced by programgraph_build, leave as is
+
+    if (stmt->stmt_type != STMT_WHILE_LOOP)
+      continue;
+
+    struct STMT* steady = hoist_invariants(stmt, log);
+
+    if (steady == NULL) {
+      optimize_chain(stmt->types.while_loop->loop_body, stmt, log);
+    }
+    else {
+      //
+      // the steady loop runs every iteration but the first, so it
+      // gets the budget first; the first iteration's body falls
+      // through to it:
+      //
+      optimize_chain(steady->types.while_loop->loop_body, steady, log);
+      optimize_chain(stmt->types.while_loop->loop_body, steady, log);
+    }
+  }
+}
+
+static struct STMT* hoist_invariants(struct STMT* loop, struct OPT_LOG* log)
+{
+  struct STMT* body = loop->types.while_loop->loop_body;
+  if (body == NULL)
+    return NULL;
+
+  //
+  // the loop is scanned once for its writes and, if peeled, copied
+  // once, inner loops included:
+  //
+  long long size = count_stmts(loop, loop->types.while_loop->next_stmt, log->budget);
+  if (2 * size > log->budget) {
+    log->budget = 0;
+    return NULL;
+  }
+  log->budget -= size;
+
+  struct DEF_SET set;
+  set.defs = NULL;
+  set.num_defs = 0;
+  set.capacity = 0;
+  set.unknown = false;
+
+  collect_defs(body, loop, &set);
+
+  struct STMT** hoisted = NULL;
+  int num_hoisted = 0;
+  int num_stmts = 0;
+  struct STMT* last = NULL;
+
+  if (!set.unknown) {
+    for (struct STMT* stmt = body; stmt != loop; stmt = stmt_next(stmt)) {
+      num_stmts++;
+      last = stmt;
+
+      if (!is_invariant(stmt, &set))
+        continue;
+
+      hoisted = (struct STMT**) realloc(hoisted, (num_hoisted + 1) * sizeof(struct STMT*));
+      hoisted[num_hoisted] = stmt;
+      num_hoisted++;
+    }
+  }
+
+  free(set.defs);
+
+  //
+  // nothing to hoist, or nothing left in the body once we do:
+  //
+  if (num_hoisted == 0 || num_hoisted == num_stmts) {
+    free(hoisted);
+    return NULL;
+  }
+  log->budget -= size;  // the copy
+
+  //
+  // The loop now runs its body once as written, then falls into
+  // a copy of the loop (the "steady" loop) whose body leaves out
+  // the hoisted assignments. Their values were computed on the
+  // first iteration and nothing in the loop can change them, so
+  // errors and output happen exactly as before.
+  //
+  struct STMT* steady = copy_stmt(loop, log);
+
+  steady->types.while_loop->loop_body = copy_chain(body, loop, steady, hoisted, num_hoisted, log);
+
+  log_link(log, last);
+  stmt_set_next(last, steady);
+
+  free(hoisted);
+  return steady;
+}
+
+static long long count_stmts(struct STMT* start, struct STMT* stop, long long limit)
+{
+  long long count = 0;
+
+  for (struct STMT* stmt = start; stmt != NULL && stmt != stop && count <= limit; stmt = stmt_next(stmt)) {
+    count++;
+    if (stmt->stmt_type == STMT_WHILE_LOOP)
+      count += count_stmts(stmt->types.while_loop->loop_body, stmt, limit - count);
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE)
+      break; // not produced by programgraph_build
+  }
+
+  return count;
+}
+
+static void collect_defs(struct STMT* start, struct STMT* stop, struct DEF_SET* set)
+{
+  for (struct STMT* stmt = start; stmt != NULL && stmt != stop; stmt = stmt_next(stmt)) {
+    if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      collect_defs(stmt->types.while_loop->loop_body, stmt, set);
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      set->unknown = true;
+      return;
+    }
+    else if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+      if (assignment->isPtrDeref) { // could write any variable
+        set->unknown = true;
+        continue;
+      }
+
+      int i;
+      for (i = 0; i < set->num_defs; i++) {
+        if (strcmp(set->defs[i].name, assignment->var_name) == 0)
+          break;
+      }
+
+      if (i == set->num_defs) { // first write to this name
+        if (set->num_defs == set->capacity) {
+          set->capacity = (set->capacity == 0) ? 8 : set->capacity * 2;
+          set->defs = (struct VAR_DEF*) realloc(set->defs, set->capacity * sizeof(struct VAR_DEF));
+        }
+        set->defs[i].name = assignment->var_name;
+        set->defs[i].count = 0;
+        set->num_defs++;
+      }
+
+      set->defs[i].count++;
+    }
+  }
+}
+
+static int def_count(struct DEF_SET* set, char* name)
+{
+  for (int i = 0; i < set->num_defs; i++) {
+    if (strcmp(set->defs[i].name, name) == 0)
+      return set->defs[i].count;
+  }
+  return 0;
+}
+
+static bool is_invariant(struct STMT* stmt, struct DEF_SET* set)
+{
+  if (stmt->stmt_type != STMT_ASSIGNMENT)
+    return false;
+
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+
+  //
+  // input(), int() and float() read state we can't see:
+  //
+  if (assignment->isPtrDeref || assignment->rhs->value_type != VALUE_EXPR)
+    return false;
+
+  //
+  // a second write to the same name would make the value depend
+  // on where we are in the body:
+  //
+  if (def_count(set, assignment->var_name) != 1)
+    return false;
+
+  struct EXPR* expr = assignment->rhs->types.expr;
+
+  struct ELEMENT* lhs = expr->lhs->element;
+  if (lhs->element_type == ELEMENT_IDENTIFIER && def_count(set, lhs->element_value) > 0)
+    return false;
+
+  if (expr->isBinaryExpr && expr->rhs != NULL) {
+    struct ELEMENT* rhs = expr->rhs->element;
+    if (rhs->element_type == ELEMENT_IDENTIFIER && def_count(set, rhs->element_value) > 0)
+      return false;
+  }
+
+  return true;
+}
+
+static struct STMT* copy_chain(struct STMT* start, struct STMT* stop, struct STMT* stop_to,
+                               struct STMT** skip, int num_skip, struct OPT_LOG* log)
+{
+  struct STMT* head = NULL;
+  struct STMT* tail = NULL;
+
+  for (struct STMT* stmt = start; stmt != NULL && stmt != stop; stmt = stmt_next(stmt)) {
+    bool skipped = false;
+    for (int i = 0; i < num_skip; i++) {
+      if (skip[i] == stmt)
+        skipped = true;
+    }
+    if (skipped)
+      continue;
+
+    struct STMT* copy = copy_stmt(stmt, log);
+
+    if (stmt->stmt_type == STMT_WHILE_LOOP) { // the body loops back to the copy
+      copy->types.while_loop->loop_body =
+        copy_chain(stmt->types.while_loop->loop_body, stmt, copy, NULL, 0, log);
+    }
+
+    if (tail == NULL)
+      head = copy;
+    else
+      stmt_set_next(tail, copy);
+    tail = copy;
+  }
+
+  if (tail != NULL)
+    stmt_set_next(tail, stop_to);
+
+  return head;
+}
+
+static struct STMT* copy_stmt(struct STMT* stmt, struct OPT_LOG* log)
+{
+  struct STMT* copy = (struct STMT*) malloc(sizeof(struct STMT));
+  if (copy == NULL) {
+    printf("**OUT OF MEMORY (optimizer)\n");
+    exit(-1);
+  }
+  copy->stmt_type = stmt->stmt_type;
+  copy->line = stmt->line;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    copy->types.assignment = (struct STMT_ASSIGNMENT*) malloc(sizeof(struct STMT_ASSIGNMENT));
+    *copy->types.assignment = *stmt->types.assignment;
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+    copy->types.function_call = (struct STMT_FUNCTION_CALL*) malloc(sizeof(struct STMT_FUNCTION_CALL));
+    *copy->types.function_call = *stmt->types.function_call;
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    copy->types.while_loop = (struct STMT_WHILE_LOOP*) malloc(sizeof(struct STMT_WHILE_LOOP));
+    *copy->types.while_loop = *stmt->types.while_loop;
+  }
+  else {
+    assert(stmt->stmt_type == STMT_PASS);
+    copy->types.pass = (struct STMT_PASS*) malloc(sizeof(struct STMT_PASS));
+    *copy->types.pass = *stmt->types.pass;
+  }
+
+  if (log->num_nodes == log->nodes_capacity) {
+    log->nodes_capacity = (log->nodes_capacity == 0) ? 16 : log->nodes_capacity * 2;
+    log->nodes = (struct STMT**) realloc(log->nodes, log->nodes_capacity * sizeof(struct STMT*));
+    log->originals = (struct STMT**) realloc(log->originals, log->nodes_capacity * sizeof(struct STMT*));
+  }
+  log->nodes[log->num_nodes] = copy;
+  log->originals[log->num_nodes] = stmt;
+  log->num_nodes++;
+
+  return copy;
+}
+
+static void log_link(struct OPT_LOG* log, struct STMT* stmt)
+{
+  if (log->num_links == log->links_capacity) {
+    log->links_capacity = (log->links_capacity == 0) ? 8 : log->links_capacity * 2;
+    log->links = (struct OPT_LINK*) realloc(log->links, log->links_capacity * sizeof(struct OPT_LINK));
+  }
+  log->links[log->num_links].stmt = stmt;
+  log->links[log->num_links].next = stmt_next(stmt);
+  log->num_links++;
+}
+
+static void lower_switches(struct STMT* program, struct OPT_LOG* log)
+{
+  struct STMT_SET seen = { NULL, 0, 0 };
+  struct STMT_STACK stack = { NULL, 0, 0 };
+
+  push_stmt(&stack, program);
+
+  while (stack.count > 0) {
+    struct STMT* stmt = stack.stmts[--stack.count];
+    if (stmt == NULL || !set_add(&seen, stmt))
+      continue;
+
+    if (stmt->stmt_type == STMT_IF_THEN_ELSE && lower_chain(stmt, log)) {
+      struct OPT_SWITCH* sw = OPT_SWITCH_OF(stmt);
+
+      //
+      // the later ifs of the chain only run for values that aren't
+      // ints, leave them as written:
+      //
+      for (struct STMT* s = sw->fallback->types.if_then_else->false_path; s != sw->otherwise;
+           s = s->types.if_then_else->false_path) {
+        set_add(&seen, s);
+        push_stmt(&stack, s->types.if_then_else->true_path);
+      }
+      push_stmt(&stack, sw->fallback->types.if_then_else->true_path);
+      push_stmt(&stack, sw->otherwise);
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      push_stmt(&stack, stmt->types.if_then_else->false_path);
+      push_stmt(&stack, stmt->types.if_then_else->true_path);
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      push_stmt(&stack, stmt->types.while_loop->next_stmt);
+      push_stmt(&stack, stmt->types.while_loop->loop_body);
+    }
+    else if (stmt->stmt_type != STMT_SWITCH) {
+      push_stmt(&stack, stmt_next(stmt));
+    }
+  }
+
+  free(stack.stmts);
+  free(seen.slots);
+}
+
+static bool lower_chain(struct STMT* head, struct OPT_LOG* log)
+{
+  struct ELEMENT* var = NULL;
+  int value;
+  int num_ifs = 0;
+  struct STMT* stmt;
+
+  for (stmt = head; stmt != NULL && is_case(stmt, &var, &value); stmt = stmt->types.if_then_else->false_path) {
+    num_ifs++;
+    if (stmt->types.if_then_else->false_path == head)
+      return false; // not a chain
+  }
+
+  if (num_ifs < OPT_MIN_CASES)
+    return false;
+
+  struct OPT_SWITCH* sw = (struct OPT_SWITCH*) malloc(sizeof(struct OPT_SWITCH));
+  struct CHAIN_CASE* chain = (struct CHAIN_CASE*) malloc(num_ifs * sizeof(struct CHAIN_CASE));
+  struct OPT_CASE* unique = (struct OPT_CASE*) malloc(num_ifs * sizeof(struct OPT_CASE));
+  struct STMT* fallback = (struct STMT*) malloc(sizeof(struct STMT));
+
+  if (sw == NULL || chain == NULL || unique == NULL || fallback == NULL) {
+    free(sw);
+    free(chain);
+    free(unique);
+    free(fallback);
+    return false;
+  }
+
+  //
+  // collect the cases in chain order, then sort them; for a value
+  // compared more than once the first if wins, as it would when
+  // the chain runs:
+  //
+  stmt = head;
+  for (int i = 0; i < num_ifs; i++) {
+    is_case(stmt, &var, &chain[i].value);
+    chain[i].position = i;
+    chain[i].target = stmt->types.if_then_else->true_path;
+    sw->otherwise = stmt->types.if_then_else->false_path;
+    stmt = stmt->types.if_then_else->false_path;
+  }
+
+  qsort(chain, num_ifs, sizeof(struct CHAIN_CASE), compare_cases);
+
+  int num_cases = 0;
+  for (int i = 0; i < num_ifs; i++) {
+    if (num_cases > 0 && unique[num_cases - 1].value == chain[i].value)
+      continue;
+    unique[num_cases].value = chain[i].value;
+    unique[num_cases].target = chain[i].target;
+    num_cases++;
+  }
+  free(chain);
+
+  sw->var = var;
+  sw->cases = unique;
+  sw->num_cases = num_cases;
+  sw->table = NULL;
+  sw->min = unique[0].value;
+  sw->count = 0;
+
+  //
+  // a table when the values are close together, at most about
+  // half of it empty (NULL marks the holes, so no NULL targets):
+  //
+  long long range = (long long) unique[num_cases - 1].value - (long long) unique[0].value + 1;
+  bool has_null = false;
+  for (int i = 0; i < num_cases; i++)
+    has_null = has_null || (unique[i].target == NULL);
+
+  if (range <= 2 * (long long) num_cases + 8 && !has_null) {
+    sw->table = (struct STMT**) calloc((size_t) range, sizeof(struct STMT*));
+    if (sw->table != NULL) {
+      sw->count = (int) range;
+      for (int i = 0; i < num_cases; i++)
+        sw->table[unique[i].value - sw->min] = unique[i].target;
+    }
+  }
+
+  //
+  // the first if, untouched, is kept for values that aren't ints:
+  //
+  *fallback = *head;
+  sw->fallback = fallback;
+
+  if (log->num_switches == log->switches_capacity) {
+    int capacity = (log->switches_capacity == 0) ? 8 : log->switches_capacity * 2;
+    struct STMT** switches = (struct STMT**) realloc(log->switches, capacity * sizeof(struct STMT*));
+    if (switches == NULL) {
+      free(sw->table);
+      free(sw->cases);
+      free(sw);
+      free(fallback);
+      return false;
+    }
+    log->switches = switches;
+    log->switches_capacity = capacity;
+  }
+  log->switches[log->num_switches] = head;
+  log->num_switches++;
+
+  head->stmt_type = STMT_SWITCH;
+  head->types.opt_switch = sw;
+
+  return true;
+}
+
+static bool is_case(struct STMT* stmt, struct ELEMENT** var, int* value)
+{
+  if (stmt->stmt_type != STMT_IF_THEN_ELSE)
+    return false;
+
+  struct EXPR* condition = stmt->types.if_then_else->condition;
+  if (!condition->isBinaryExpr || condition->operator != OPERATOR_EQUAL || condition->rhs == NULL)
+    return false;
+
+  struct ELEMENT* lhs = condition->lhs->element;
+  struct ELEMENT* rhs = condition->rhs->element;
+
+  if (lhs->element_type == ELEMENT_INT_LITERAL) { // k == var
+    struct ELEMENT* swap = lhs;
+    lhs = rhs;
+    rhs = swap;
+  }
+
+  if (lhs->element_type != ELEMENT_IDENTIFIER || rhs->element_type != ELEMENT_INT_LITERAL)
+    return false;
+
+  if (*var == NULL)
+    *var = lhs;
+  else if (strcmp((*var)->element_value, lhs->element_value) != 0)
+    return false;
+
+  *value = atoi(rhs->element_value);
+  return true;
+}
+
+static int compare_cases(const void* p1, const void* p2)
+{
+  const struct CHAIN_CASE* c1 = (const struct CHAIN_CASE*) p1;
+  const struct CHAIN_CASE* c2 = (const struct CHAIN_CASE*) p2;
+
+  if (c1->value != c2->value)
+    return (c1->value < c2->value) ? -1 : 1;
+  return c1->position - c2->position;
+}
+
+static bool set_add(struct STMT_SET* set, struct STMT* stmt)
+{
+  if (2 * (set->count + 1) > set->capacity) {
+    int capacity = (set->capacity == 0) ? 256 : 2 * set->capacity;
+    struct STMT** slots = (struct STMT**) calloc(capacity, sizeof(struct STMT*));
+    if (slots == NULL) {
+      printf("**OUT OF MEMORY (optimizer)\n");
+      exit(-1);
+    }
+    for (int i = 0; i < set->capacity; i++) {
+      if (set->slots[i] == NULL)
+        continue;
+      size_t slot = ((size_t) set->slots[i] >> 4) & (size_t) (capacity - 1);
+      while (slots[slot] != NULL)
+        slot = (slot + 1) & (size_t) (capacity - 1);
+      slots[slot] = set->slots[i];
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->capacity = capacity;
+  }
+
+  size_t slot = ((size_t) stmt >> 4) & (size_t) (set->capacity - 1);
+  while (set->slots[slot] != NULL) {
+    if (set->slots[slot] == stmt)
+      return false;
+    slot = (slot + 1) & (size_t) (set->capacity - 1);
+  }
+  set->slots[slot] = stmt;
+  set->count++;
+  return true;
+}
+
+static void push_stmt(struct STMT_STACK* stack, struct STMT* stmt)
+{
+  if (stack->count == stack->capacity) {
+    stack->capacity = (stack->capacity == 0) ? 64 : stack->capacity * 2;
+    stack->stmts = (struct STMT**) realloc(stack->stmts, stack->capacity * sizeof(struct STMT*));
+    if (stack->stmts == NULL) {
+      printf("**OUT OF MEMORY (optimizer)\n");
+      exit(-1);
+    }
+  }
+  stack->stmts[stack->count++] = stmt;
+}
+
+static void fuse_statements(struct STMT* program, struct OPT_LOG* log)
+{
+  struct STMT_SET seen = { NULL, 0, 0 };
+  struct STMT_STACK stack = { NULL, 0, 0 };
+
+  push_stmt(&stack, program);
+
+  while (stack.count > 0) {
+    struct STMT* stmt = stack.stmts[--stack.count];
+    if (stmt == NULL || !set_add(&seen, stmt))
+      continue;
+
+    if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      push_stmt(&stack, stmt->types.if_then_else->false_path);
+      push_stmt(&stack, stmt->types.if_then_else->true_path);
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      push_stmt(&stack, stmt->types.while_loop->next_stmt);
+      push_stmt(&stack, stmt->types.while_loop->loop_body);
+    }
+    else if (stmt->stmt_type == STMT_SWITCH) {
+      push_stmt(&stack, OPT_SWITCH_OF(stmt)->fallback); // reaches every case
+    }
+    else if (stmt->stmt_type == STMT_COUNTED) {
+      //
+      // the loop as written stays a while loop, execute() needs its
+      // body and next_stmt:
+      //
+      struct STMT_WHILE_LOOP* loop = OPT_COUNTED_OF(stmt)->original->types.while_loop;
+      push_stmt(&stack, loop->next_stmt);
+      push_stmt(&stack, loop->loop_body);
+    }
+    else {
+      push_stmt(&stack, stmt_next(stmt));
+    }
+
+    fuse_stmt(stmt, log);
+  }
+
+  free(stack.stmts);
+  free(seen.slots);
+}
+
+static void fuse_stmt(struct STMT* stmt, struct OPT_LOG* log)
+{
+  struct OPT_FUSED shape;
+  memset(&shape, 0, sizeof(shape));
+  shape.target.addr = -1;
+  shape.operand.addr = -1;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+    if (assignment->rhs->value_type != VALUE_EXPR)
+      return;
+
+    struct EXPR* expr = assignment->rhs->types.expr;
+    if (!expr->isBinaryExpr || expr->rhs == NULL)
+      return;
+
+    struct ELEMENT* lhs = expr->lhs->element;
+    struct ELEMENT* rhs = expr->rhs->element;
+    char* x = assignment->var_name;
+
+    shape.target.name = x;
+
+    if (expr->operator == OPERATOR_PLUS && is_var(lhs, x) && rhs->element_type == ELEMENT_INT_LITERAL) {
+      shape.op = OPT_FUSED_INC;
+      shape.k = atoi(rhs->element_value);
+    }
+    else if (expr->operator == OPERATOR_PLUS && is_var(rhs, x) && lhs->element_type == ELEMENT_INT_LITERAL) {
+      shape.op = OPT_FUSED_INC;
+      shape.k = atoi(lhs->element_value);
+    }
+    else if (expr->operator == OPERATOR_MINUS && is_var(lhs, x) && rhs->element_type == ELEMENT_INT_LITERAL
+             && atoi(rhs->element_value) != INT_MIN) {
+      shape.op = OPT_FUSED_INC;
+      shape.k = -atoi(rhs->element_value);
+    }
+    else if (expr->operator == OPERATOR_PLUS && is_var(lhs, x) && rhs->element_type == ELEMENT_IDENTIFIER) {
+      shape.op = OPT_FUSED_ADD;
+      shape.operand.name = rhs->element_value;
+    }
+    else if (expr->operator == OPERATOR_PLUS && is_var(lhs, x) && rhs->element_type == ELEMENT_STR_LITERAL) {
+      shape.op = OPT_FUSED_APPEND;
+      shape.text = rhs->element_value;
+    }
+    else
+      return;
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    struct EXPR* condition = stmt->types.while_loop->condition;
+    if (!condition->isBinaryExpr || condition->rhs == NULL)
+      return;
+
+    int compare = condition->operator;
+    if (compare != OPERATOR_LT && compare != OPERATOR_LTE && compare != OPERATOR_GT
+        && compare != OPERATOR_GTE && compare != OPERATOR_EQUAL && compare != OPERATOR_NOT_EQUAL)
+      return;
+
+    struct ELEMENT* lhs = condition->lhs->element;
+    struct ELEMENT* rhs = condition->rhs->element;
+    if (lhs->element_type != ELEMENT_IDENTIFIER)
+      return;
+
+    shape.op = OPT_FUSED_LOOP;
+    shape.compare = compare;
+    shape.target.name = lhs->element_value;
+
+    if (rhs->element_type == ELEMENT_IDENTIFIER)
+      shape.operand.name = rhs->element_value;
+    else if (rhs->element_type == ELEMENT_INT_LITERAL)
+      shape.k = atoi(rhs->element_value);
+    else
+      return;
+  }
+  else
+    return;
+
+  struct OPT_FUSED* fused = (struct OPT_FUSED*) malloc(sizeof(struct OPT_FUSED));
+  struct STMT* original = (struct STMT*) malloc(sizeof(struct STMT));
+
+  if (fused == NULL || original == NULL) {
+    free(fused);
+    free(original);
+    return;
+  }
+
+  if (log->num_fused == log->fused_capacity) {
+    int capacity = (log->fused_capacity == 0) ? 16 : log->fused_capacity * 2;
+    struct STMT** stmts = (struct STMT**) realloc(log->fused, capacity * sizeof(struct STMT*));
+    if (stmts == NULL) {
+      free(fused);
+      free(original);
+      return;
+    }
+    log->fused = stmts;
+    log->fused_capacity = capacity;
+  }
+  log->fused[log->num_fused] = stmt;
+  log->num_fused++;
+
+  *original = *stmt;
+  *fused = shape;
+  fused->original = original;
+
+  stmt->stmt_type = STMT_FUSED;
+  stmt->types.opt_fused = fused;
+}
+
+static bool is_var(struct ELEMENT* element, char* name)
+{
+  return element->element_type == ELEMENT_IDENTIFIER && strcmp(element->element_value, name) == 0;
+}
+
+static void count_loops(struct STMT* program, struct OPT_LOG* log)
+{
+  struct STMT_SET seen = { NULL, 0, 0 };
+  struct STMT_STACK stack = { NULL, 0, 0 };
+
+  push_stmt(&stack, program);
+
+  while (stack.count > 0) {
+    struct STMT* stmt = stack.stmts[--stack.count];
+    if (stmt == NULL || !set_add(&seen, stmt))
+      continue;
+
+    struct STMT* succ[2];
+    int num_succ = stmt_successors(stmt, succ);
+    for (int i = num_succ - 1; i >= 0; i--)
+      push_stmt(&stack, succ[i]);
+
+    if (stmt->stmt_type == STMT_WHILE_LOOP)
+      count_loop(stmt, log);
+  }
+
+  free(stack.stmts);
+  free(seen.slots);
+}
+
+static bool count_loop(struct STMT* loop, struct OPT_LOG* log)
+{
+  struct EXPR* condition = loop->types.while_loop->condition;
+  if (!condition->isBinaryExpr || condition->rhs == NULL || loop->types.while_loop->loop_body == NULL)
+    return false;
+  if (condition->operator != OPERATOR_LT && condition->operator != OPERATOR_LTE)
+    return false;
+
+  struct ELEMENT* lhs = condition->lhs->element;
+  struct ELEMENT* rhs = condition->rhs->element;
+  if (lhs->element_type != ELEMENT_IDENTIFIER)
+    return false;
+  if (rhs->element_type != ELEMENT_INT_LITERAL && (rhs->element_type != ELEMENT_IDENTIFIER || is_var(rhs, lhs->element_value)))
+    return false;
+
+  char* i = lhs->element_value;
+  char* n = (rhs->element_type == ELEMENT_IDENTIFIER) ? rhs->element_value : NULL;
+
+  //
+  // Walk the body. It has to come back to the loop through one
+  // statement only, i = i + k, and nowhere else may it write i or
+  // n or leave the loop:
+  //
+  struct STMT_SET body = { NULL, 0, 0 };
+  struct STMT_STACK stack = { NULL, 0, 0 };
+  struct STMT* increment = NULL;
+  bool countable = true;
+  bool reads_counter = false;
+
+  push_stmt(&stack, loop->types.while_loop->loop_body);
+
+  while (countable && stack.count > 0) {
+    struct STMT* stmt = stack.stmts[--stack.count];
+    if (!set_add(&body, stmt))
+      continue;
+
+    struct STMT* succ[2];
+    int num_succ = stmt_successors(stmt, succ);
+    bool back = false;
+
+    for (int s = 0; s < num_succ; s++) {
+      if (succ[s] == NULL || succ[s] == loop->types.while_loop->next_stmt)
+        countable = false; // leaves the loop another way
+      else if (succ[s] == loop)
+        back = true;
+      else
+        push_stmt(&stack, succ[s]);
+    }
+
+    if (back) {
+      if (increment != NULL || num_succ != 1 || !is_increment(stmt, i))
+        countable = false;
+      increment = stmt;
+      continue;
+    }
+
+    struct STMT* written = as_written(stmt);
+    if (written->stmt_type == STMT_ASSIGNMENT
+        && (strcmp(written->types.assignment->var_name, i) == 0
+            || (n != NULL && strcmp(written->types.assignment->var_name, n) == 0)))
+      countable = false;
+
+    if (reads_var(written, i))
+      reads_counter = true;
+  }
+
+  free(stack.stmts);
+  free(body.slots);
+
+  if (!countable || increment == NULL)
+    return false;
+
+  struct OPT_COUNTED* counted = (struct OPT_COUNTED*) malloc(sizeof(struct OPT_COUNTED));
+  struct STMT* original = (struct STMT*) malloc(sizeof(struct STMT));
+
+  if (counted == NULL || original == NULL) {
+    free(counted);
+    free(original);
+    return false;
+  }
+
+  if (log->num_counted == log->counted_capacity) {
+    int capacity = (log->counted_capacity == 0) ? 16 : log->counted_capacity * 2;
+    struct STMT** stmts = (struct STMT**) realloc(log->counted, capacity * sizeof(struct STMT*));
+    if (stmts == NULL) {
+      free(counted);
+      free(original);
+      return false;
+    }
+    log->counted = stmts;
+    log->counted_capacity = capacity;
+  }
+  log->counted[log->num_counted] = loop;
+  log->num_counted++;
+
+  *original = *loop;
+
+  counted->original = original;
+  counted->increment = increment;
+  counted->counter.name = i;
+  counted->counter.addr = -1;
+  counted->limit.name = n;
+  counted->limit.addr = -1;
+  counted->bound = (n == NULL) ? atoi(rhs->element_value) : 0;
+  counted->step = atoi(increment->types.assignment->rhs->types.expr->rhs->element->element_value);
+  counted->inclusive = (condition->operator == OPERATOR_LTE);
+  counted->reads_counter = reads_counter;
+  counted->reduction = find_reduction(loop->types.while_loop->loop_body, increment, i);
+  counted->runs = 0;
+  counted->fallbacks = 0;
+
+  loop->stmt_type = STMT_COUNTED;
+  loop->types.opt_counted = counted;
+  return true;
+}
+
+static bool is_increment(struct STMT* stmt, char* name)
+{
+  if (stmt->stmt_type != STMT_ASSIGNMENT || strcmp(stmt->types.assignment->var_name, name) != 0)
+    return false;
+
+  struct VALUE* rhs = stmt->types.assignment->rhs;
+  if (rhs->value_type != VALUE_EXPR)
+    return false;
+
+  struct EXPR* expr = rhs->types.expr;
+  return expr->isBinaryExpr && expr->rhs != NULL && expr->operator == OPERATOR_PLUS
+    && is_var(expr->lhs->element, name)
+    && expr->rhs->element->element_type == ELEMENT_INT_LITERAL
+    && atoi(expr->rhs->element->element_value) > 0;
+}
+
+static bool reads_var(struct STMT* stmt, char* name)
+{
+  struct EXPR* expr = NULL;
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    struct VALUE* rhs = stmt->types.assignment->rhs;
+    if (rhs->value_type == VALUE_FUNCTION_CALL)
+      return rhs->types.function_call->parameter != NULL && is_var(rhs->types.function_call->parameter, name);
+    expr = rhs->types.expr;
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    return stmt->types.function_call->parameter != NULL && is_var(stmt->types.function_call->parameter, name);
+  else if (stmt->stmt_type == STMT_WHILE_LOOP)
+    expr = stmt->types.while_loop->condition;
+  else if (stmt->stmt_type == STMT_IF_THEN_ELSE)
+    expr = stmt->types.if_then_else->condition;
+  else
+    return false;
+
+  return is_var(expr->lhs->element, name)
+    || (expr->isBinaryExpr && expr->rhs != NULL && is_var(expr->rhs->element, name));
+}
+
+static struct OPT_REDUCTION* find_reduction(struct STMT* body, struct STMT* increment, char* i)
+{
+  int term[REDUCE_MAX_DEGREE + 1] = { 0, 1 }; // i itself when there is no t
+  struct STMT_ASSIGNMENT* last_term = NULL;
+  char* t = NULL;
+  struct STMT* stmt = body;
+
+  //
+  // the terms, then the sum, then the increment, and nothing else:
+  //
+  for (int n = 0; stmt->stmt_type == STMT_ASSIGNMENT && stmt_next(stmt) != increment; n++) {
+    if (n == OPT_MAX_TERMS || !is_term(stmt, i, &t, (last_term != NULL) ? term : NULL, term))
+      return NULL;
+    last_term = stmt->types.assignment;
+    stmt = stmt_next(stmt);
+  }
+
+  if (stmt->stmt_type != STMT_ASSIGNMENT || stmt->types.assignment->rhs->value_type != VALUE_EXPR)
+    return NULL;
+
+  char* total = stmt->types.assignment->var_name;
+  struct EXPR* expr = stmt->types.assignment->rhs->types.expr;
+  if (strcmp(total, i) == 0 || (t != NULL && strcmp(total, t) == 0))
+    return NULL;
+  if (!expr->isBinaryExpr || expr->rhs == NULL || expr->lhs->expr_type != UNARY_ELEMENT || expr->rhs->expr_type != UNARY_ELEMENT)
+    return NULL;
+
+  struct ELEMENT* lhs = expr->lhs->element;
+  struct ELEMENT* rhs = expr->rhs->element;
+  char* y = (t != NULL) ? t : i;
+  bool subtract = (expr->operator == OPERATOR_MINUS);
+
+  if (expr->operator == OPERATOR_PLUS && is_var(lhs, y) && is_var(rhs, total)) {
+    // total = t + total
+  }
+  else if ((expr->operator != OPERATOR_PLUS && !subtract) || !is_var(lhs, total) || !is_var(rhs, y))
+    return NULL;
+
+  struct OPT_REDUCTION* reduction = (struct OPT_REDUCTION*) malloc(sizeof(struct OPT_REDUCTION));
+  if (reduction == NULL)
+    return NULL;
+
+  reduction->term = last_term;
+  reduction->total = stmt->types.assignment;
+  reduction->acc.name = total;
+  reduction->acc.addr = -1;
+  memcpy(reduction->coeffs, term, sizeof(term));
+  reduction->subtract = subtract;
+  reduction->runs = 0;
+  reduction->fallbacks = 0;
+
+  return reduction;
+}
+
+static bool is_term(struct STMT* stmt, char* i, char** t, const int* prev, int p[])
+{
+  if (stmt->types.assignment->rhs->value_type != VALUE_EXPR)
+    return false;
+
+  char* name = stmt->types.assignment->var_name;
+  if (*t == NULL && strcmp(name, i) != 0)
+    *t = name;
+  else if (*t == NULL || strcmp(name, *t) != 0)
+    return false;
+
+  struct EXPR* expr = stmt->types.assignment->rhs->types.expr;
+  int a[REDUCE_MAX_DEGREE + 1];
+  int b[REDUCE_MAX_DEGREE + 1];
+
+  if (!term_operand(expr->lhs, i, *t, prev, a))
+    return false;
+
+  if (!expr->isBinaryExpr) {
+    memcpy(p, a, sizeof(a));
+    return true;
+  }
+
+  if (expr->rhs == NULL || !term_operand(expr->rhs, i, *t, prev, b))
+    return false;
+
+  //
+  // the same wrapping arithmetic as the ints themselves:
+  //
+  unsigned int result[REDUCE_MAX_DEGREE + 1] = { 0 };
+
+  for (int d = 0; d <= REDUCE_MAX_DEGREE; d++) {
+    if (expr->operator == OPERATOR_PLUS)
+      result[d] = (unsigned int) a[d] + (unsigned int) b[d];
+    else if (expr->operator == OPERATOR_MINUS)
+      result[d] = (unsigned int) a[d] - (unsigned int) b[d];
+    else if (expr->operator == OPERATOR_ASTERISK) {
+      for (int e = 0; e <= REDUCE_MAX_DEGREE; e++) {
+        if (a[d] == 0 || b[e] == 0)
+          continue;
+        if (d + e > REDUCE_MAX_DEGREE)
+          return false; // too high a power
+        result[d + e] += (unsigned int) a[d] * (unsigned int) b[e];
+      }
+    }
+    else
+      return false;
+  }
+
+  for (int d = 0; d <= REDUCE_MAX_DEGREE; d++)
+    p[d] = (int) result[d];
+  return true;
+}
+
+static bool term_operand(struct UNARY_EXPR* operand, char* i, char* t, const int* prev, int p[])
+{
+  if (operand->expr_type != UNARY_ELEMENT)
+    return false;
+
+  struct ELEMENT* element = operand->element;
+
+  for (int d = 0; d <= REDUCE_MAX_DEGREE; d++)
+    p[d] = 0;
+
+  if (element->element_type == ELEMENT_INT_LITERAL)
+    p[0] = atoi(element->element_value);
+  else if (is_var(element, i))
+    p[1] = 1;
+  else if (prev != NULL && is_var(element, t))
+    memcpy(p, prev, (REDUCE_MAX_DEGREE + 1) * sizeof(int));
+  else
+    return false;
+
+  return true;
+}
+
+static struct STMT* as_written(struct STMT* stmt)
+{
+  if (stmt->stmt_type == STMT_SWITCH)
+    return OPT_SWITCH_OF(stmt)->fallback;
+  if (stmt->stmt_type == STMT_COUNTED)
+    return OPT_COUNTED_OF(stmt)->original;
+  return stmt;
+}
+
+static int stmt_successors(struct STMT* stmt, struct STMT* succ[2])
+{
+  stmt = as_written(stmt);
+
+  if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+    succ[0] = stmt->types.if_then_else->true_path;
+    succ[1] = stmt->types.if_then_else->false_path;
+    return 2;
+  }
+  if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    succ[0] = stmt->types.while_loop->loop_body;
+    succ[1] = stmt->types.while_loop->next_stmt;
+    return 2;
+  }
+  succ[0] = stmt_next(stmt);
+  return 1;
+}
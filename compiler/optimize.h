@@ -0,0 +1,215 @@
+/*optimize.h*/
+
+//
+// Optimization passes over a nuPython program graph. The passes
+// rewrite the graph in place; every change is logged so the graph
+// can be restored to the shape programgraph_build() produced.
+
+
+#pragma once
+
+#include <stdio.h>    // FILE
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "reduce.h"   // REDUCE_MAX_DEGREE
+
+//
+// Log of the changes made to a program graph by the optimizer.
+//
+struct OPT_LOG;
+
+//
+// Statement type the optimizer gives the first if of a chain
+// "if x == 1: ... elif x == 2: ..." comparing one variable against
+// int literals; its types.opt_switch then points at a struct
+// OPT_SWITCH (see OPT_SWITCH_OF).
+//
+#define STMT_SWITCH 16
+
+#define OPT_SWITCH_OF(stmt) ((stmt)->types.opt_switch)
+
+struct OPT_CASE
+{
+  int value;
+  struct STMT* target;  // true_path of the first if comparing to value
+};
+
+struct OPT_SWITCH
+{
+  struct ELEMENT* var;      // the variable the chain compares
+  struct STMT* fallback;    // the chain as written, for non-int values
+  struct STMT* otherwise;   // where an int matching no case goes
+
+  struct STMT** table;      // dense: table[value - min], NULL => otherwise
+  int min;
+  int count;
+
+  struct OPT_CASE* cases;   // sparse (table == NULL): sorted by value
+  int num_cases;
+};
+
+//
+// Statement type the optimizer gives an assignment or while loop
+// of one of the common shapes below, executed as one operation;
+// its types.opt_fused then points at a struct OPT_FUSED (see
+// OPT_FUSED_OF).
+//
+#define STMT_FUSED 17
+
+#define OPT_FUSED_OF(stmt) ((stmt)->types.opt_fused)
+
+enum OPT_FUSED_OPS
+{
+  OPT_FUSED_INC = 0,  // x = x + k, x = k + x or x = x - k, k an int literal
+  OPT_FUSED_ADD,      // x = x + y
+  OPT_FUSED_APPEND,   // s = s + "..."
+  OPT_FUSED_LOOP,     // while i < n:, any comparison, n a variable or int literal
+  OPT_NUM_FUSED
+};
+
+//
+// A variable and the address of its memory cell, found on first
+// use (cells never move):
+//
+struct OPT_OPERAND
+{
+  char* name;
+  int   addr;  // -1 => not looked up yet
+};
+
+struct OPT_FUSED
+{
+  int op;                  // enum OPT_FUSED_OPS
+  struct STMT* original;   // the statement as written, run when the
+                           // operand types aren't the expected ones
+  struct OPT_OPERAND target;   // x, s or i
+  struct OPT_OPERAND operand;  // y or n; name NULL => k
+  int   k;                 // INC: what is added, LOOP: n if a literal
+  char* text;              // APPEND: what is appended
+  int   compare;           // LOOP: enum OPERATORS
+
+  long long runs;          // # of times executed fused
+  long long fallbacks;     // # of times the original ran instead
+};
+
+//
+// Statement type the optimizer gives a counting while loop:
+// "while i < n:" (or <=) whose body ends with "i = i + k", k an
+// int literal > 0, and otherwise writes neither i nor n. execute()
+// runs it with i in a local variable; its types.opt_counted points
+// at a struct OPT_COUNTED (see OPT_COUNTED_OF).
+//
+#define STMT_COUNTED 18
+
+#define OPT_COUNTED_OF(stmt) ((stmt)->types.opt_counted)
+
+//
+// A counted loop whose body only sums a polynomial in i:
+//
+//   t = ...           zero or more, each an int polynomial in i
+//   total = total + t (or - t, or + i when there is no t)
+//   i = i + k
+//
+// execute() sums all the terms at once with a kernel from reduce.h
+// when total is an int, or a real for which the sum is exact.
+//
+struct OPT_REDUCTION
+{
+  struct STMT_ASSIGNMENT* term;    // the last t = ..., NULL if none
+  struct STMT_ASSIGNMENT* total;   // total = total + t
+  struct OPT_OPERAND acc;          // total
+  int  coeffs[REDUCE_MAX_DEGREE + 1]; // t = coeffs[0] + coeffs[1]*i + ...
+  bool subtract;                   // true => total = total - t
+  long long runs;                  // # of times run by a kernel
+  long long fallbacks;             // # of times a guard failed
+};
+
+struct OPT_COUNTED
+{
+  struct STMT* original;       // the loop as written
+  struct STMT* increment;      // the body's last statement, i = i + k
+
+  struct OPT_OPERAND counter;  // i
+  struct OPT_OPERAND limit;    // n; name NULL => bound
+  int  bound;                  // n if a literal
+  int  step;                   // k
+  bool inclusive;              // true => i <= n
+  bool reads_counter;          // true => the body reads i, so i is
+                               // written to memory every iteration
+  struct OPT_REDUCTION* reduction; // NULL if the body isn't one
+  long long runs;              // # of times run as a counted loop
+  long long fallbacks;         // # of times its test ran as written
+};
+
+//
+// Public functions:
+//
+
+//
+// optimize_program
+//
+// Runs the optimization passes over the given program graph,
+// rewriting it in place. The first statement of the program
+// never changes. Returns a log of the changes made, which must
+// eventually be passed to optimize_restore().
+//
+// Passes:
+//   loop-invariant code motion -- assignments inside a while loop
+//   whose right-hand side only reads variables the loop never
+//   writes are executed on the first iteration only. Later
+//   iterations run a copy of the loop body without them, so the
+//   output (including **SEMANTIC ERROR lines) is unchanged.
+//
+//   if/elif chains -- three or more ifs in a row, each comparing
+//   the same variable to an int literal with ==, become one
+//   STMT_SWITCH that picks the branch with a table lookup (or a
+//   binary search when the literals are spread out). A value that
+//   is not an int takes the chain as written.
+//
+//   counted loops -- a while loop stepping an int i up to n, whose
+//   body doesn't otherwise write i or n, becomes a STMT_COUNTED.
+//   If i and n are ints when the loop is reached, execute() runs it
+//   with i in a local, updating i's memory cell only when the body
+//   reads i and when the loop ends or fails.
+//
+//   reductions -- a counted loop that only adds up a polynomial in
+//   i, e.g. t = i * i then total = total + t, is summed by a SIMD
+//   kernel instead (see OPT_REDUCTION).
+//
+//   superinstructions -- x = x + 1, x = x + y, s = s + "..." and
+//   while i < n: become one STMT_FUSED each, which works on the
+//   variables' memory cells directly when they hold the usual
+//   types, and runs the statement as written otherwise.
+//
+struct OPT_LOG* optimize_program(struct STMT* program);
+
+//
+// optimize_restore
+//
+// Undoes the changes recorded in the given log, returning the
+// program graph to its original shape, and frees the statements
+// the optimizer allocated along with the log itself.
+//
+void optimize_restore(struct OPT_LOG* log);
+
+//
+// optimize_print_stats
+//
+// Writes, for each kind of STMT_FUSED, for STMT_COUNTED and for
+// reductions, how many statements became one and how many times
+// they ran fused (counted, summed) and as written, to the given
+// stream. Call before optimize_restore().
+//
+void optimize_print_stats(struct OPT_LOG* log, FILE* out);
+
+//
+// optimize_copies
+//
+// Returns the # of statements the optimizer added by copying the
+// program's, e.g. the loop that runs every iteration after the
+// first, and points *copies and *originals at arrays of that many:
+// copies[i] is a copy of originals[i], which may itself be a copy.
+// The arrays belong to the log.
+//
+int optimize_copies(struct OPT_LOG* log, struct STMT*** copies, struct STMT*** originals);
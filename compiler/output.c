@@ -0,0 +1,411 @@
+/*output.c*/
+
+//
+// Buffered output for the nuPython interpreter. Output is collected
+// in a large user-space buffer and written with writev(), so a
+// print-heavy program costs a handful of system calls instead of
+// one per line.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>   // write, isatty
+#include <sys/uio.h>  // writev
+
+#include "output.h"
+#include "format.h"
+
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)  // 1MB
+
+
+//
+// Private functions:
+//
+
+//Writes all the given buffers, retrying after partial writes
+static void write_all(int fd, struct iovec* iov, int count);
+
+//Flushes the standard output at exit
+static void flush_at_exit(void);
+
+//Grows a capture buffer to hold at least needed bytes
+static bool grow(struct OUTPUT* out, size_t needed);
+
+
+//
+// standard output, created on first use:
+//
+static struct OUTPUT* Stdout = NULL;
+
+//
+// per-thread redirection set by output_set_current():
+//
+static __thread struct OUTPUT* Current = NULL;
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+// Returns a pointer to a dynamically-allocated output that
+// writes to the given file descriptor using the given flush
+// policy.
+//
+struct OUTPUT* output_init(int fd, int policy)
+{
+  struct OUTPUT* out = (struct OUTPUT*) malloc(sizeof(struct OUTPUT));
+  if (out == NULL) {
+    fprintf(stderr, "Error: Failed to allocate memory for output");
+    return NULL;
+  }
+  out->fd = fd;
+  out->policy = policy;
+  out->repr = false;
+  out->length = 0;
+  out->capacity = OUTPUT_BUFFER_SIZE;
+  out->buffer = (char*) malloc(out->capacity);
+  if (out->buffer == NULL) { // fall back to unbuffered
+    out->capacity = 0;
+  }
+  return out;
+}
+
+
+//
+// output_destroy
+//
+// Flushes the given output and frees its memory.
+//
+void output_destroy(struct OUTPUT* out)
+{
+  output_flush(out);
+  free(out->buffer);
+  free(out);
+}
+
+
+//
+// output_current
+//
+// Returns the output that print() and error messages are written
+// to by the calling thread, standard output unless redirected.
+//
+struct OUTPUT* output_current(void)
+{
+  if (Current != NULL)
+    return Current;
+
+  if (Stdout == NULL) {
+    //
+    // like stdio: line buffered for a terminal, else block buffered
+    //
+    int policy = isatty(STDOUT_FILENO) ? OUTPUT_FLUSH_LINE : OUTPUT_FLUSH_BLOCK;
+
+    Stdout = output_init(STDOUT_FILENO, policy);
+    if (Stdout == NULL) {
+      printf("**OUT OF MEMORY (output)\n");
+      exit(-1);
+    }
+    atexit(flush_at_exit);
+  }
+  return Stdout;
+}
+
+
+//
+// output_set_current
+//
+// Directs the calling thread's output to out, or back to standard
+// output if out is NULL.
+//
+void output_set_current(struct OUTPUT* out)
+{
+  Current = out;
+}
+
+
+//
+// output_parse_policy
+//
+// Given "line", "block" or "never", returns the matching flush
+// policy. Returns -1 if the name is not a policy.
+//
+int output_parse_policy(const char* name)
+{
+  if (strcmp(name, "line") == 0)
+    return OUTPUT_FLUSH_LINE;
+  else if (strcmp(name, "block") == 0)
+    return OUTPUT_FLUSH_BLOCK;
+  else if (strcmp(name, "never") == 0)
+    return OUTPUT_FLUSH_NEVER;
+
+  return -1;
+}
+
+
+//
+// output_set_policy
+//
+// Changes the flush policy of the given output.
+//
+void output_set_policy(struct OUTPUT* out, int policy)
+{
+  out->policy = policy;
+  if (policy == OUTPUT_FLUSH_LINE)
+    output_flush(out);
+}
+
+
+//
+// output_write
+//
+// Appends len bytes to the output.
+//
+void output_write(struct OUTPUT* out, const char* data, size_t len)
+{
+  if (out->fd == OUTPUT_CAPTURE && out->length + len > out->capacity) {
+    if (!grow(out, out->length + len))
+      return;
+  }
+
+  if (out->length + len <= out->capacity) {
+    memcpy(out->buffer + out->length, data, len);
+    out->length += len;
+  }
+  else {
+    //
+    // doesn't fit, write buffer and data together:
+    //
+    struct iovec iov[2];
+    iov[0].iov_base = out->buffer;
+    iov[0].iov_len = out->length;
+    iov[1].iov_base = (void*) data;
+    iov[1].iov_len = len;
+
+    write_all(out->fd, iov, 2);
+    out->length = 0;
+  }
+
+  if (out->policy == OUTPUT_FLUSH_LINE && len > 0 && data[len - 1] == '\n')
+    output_flush(out);
+}
+
+
+//
+// output_puts
+//
+// Writes the given string followed by a newline.
+//
+void output_puts(struct OUTPUT* out, const char* s)
+{
+  size_t len = strlen(s);
+
+  if (out->fd == OUTPUT_CAPTURE && out->length + len + 1 > out->capacity) {
+    if (!grow(out, out->length + len + 1))
+      return;
+  }
+
+  if (out->length + len + 1 <= out->capacity) {
+    memcpy(out->buffer + out->length, s, len);
+    out->buffer[out->length + len] = '\n';
+    out->length += len + 1;
+  }
+  else {
+    struct iovec iov[3];
+    iov[0].iov_base = out->buffer;
+    iov[0].iov_len = out->length;
+    iov[1].iov_base = (void*) s;
+    iov[1].iov_len = len;
+    iov[2].iov_base = (void*) "\n";
+    iov[2].iov_len = 1;
+
+    write_all(out->fd, iov, 3);
+    out->length = 0;
+  }
+
+  if (out->policy == OUTPUT_FLUSH_LINE)
+    output_flush(out);
+}
+
+
+//
+// output_string
+//
+// Writes the given string, without a newline.
+//
+void output_string(struct OUTPUT* out, const char* s)
+{
+  output_write(out, s, strlen(s));
+}
+
+
+//
+// output_int
+//
+// Writes the given integer in decimal, formatted directly into
+// the buffer.
+//
+void output_int(struct OUTPUT* out, long long value)
+{
+  if (out->capacity - out->length < FORMAT_INT_SIZE)
+    output_flush(out);
+
+  if (out->capacity - out->length >= FORMAT_INT_SIZE) {
+    out->length += format_int(out->buffer + out->length, value);
+  }
+  else { // unbuffered
+    char digits[FORMAT_INT_SIZE];
+    int len = format_int(digits, value);
+    output_write(out, digits, len);
+  }
+}
+
+
+//
+// output_real
+//
+// Writes the given real, formatted directly into the buffer.
+//
+void output_real(struct OUTPUT* out, double value)
+{
+  if (out->capacity - out->length < FORMAT_REAL_SIZE)
+    output_flush(out);
+
+  if (out->capacity - out->length >= FORMAT_REAL_SIZE) {
+    char* dest = out->buffer + out->length;
+    out->length += out->repr ? format_real_repr(dest, value) : format_real(dest, value);
+  }
+  else { // unbuffered
+    char digits[FORMAT_REAL_SIZE];
+    int len = out->repr ? format_real_repr(digits, value) : format_real(digits, value);
+    output_write(out, digits, len);
+  }
+}
+
+
+//
+// output_printf
+//
+// printf() into the output.
+//
+void output_printf(struct OUTPUT* out, const char* format, ...)
+{
+  char small[256];
+
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+
+  if (len < 0)
+    return;
+
+  if ((size_t) len < sizeof(small)) {
+    output_write(out, small, len);
+    return;
+  }
+
+  char* large = (char*) malloc(len + 1);
+  if (large == NULL)
+    return;
+
+  va_start(args, format);
+  vsnprintf(large, len + 1, format, args);
+  va_end(args);
+
+  output_write(out, large, len);
+  free(large);
+}
+
+
+//
+// output_sync
+//
+// Flushes unless the policy is OUTPUT_FLUSH_NEVER.
+//
+void output_sync(struct OUTPUT* out)
+{
+  if (out->policy != OUTPUT_FLUSH_NEVER)
+    output_flush(out);
+}
+
+
+//
+// output_flush
+//
+// Writes out everything buffered so far.
+//
+void output_flush(struct OUTPUT* out)
+{
+  if (out->length == 0 || out->fd == OUTPUT_CAPTURE)
+    return;
+
+  struct iovec iov;
+  iov.iov_base = out->buffer;
+  iov.iov_len = out->length;
+
+  write_all(out->fd, &iov, 1);
+  out->length = 0;
+}
+
+
+//
+// Private functions:
+//
+
+static void write_all(int fd, struct iovec* iov, int count)
+{
+  while (count > 0) {
+    ssize_t written = writev(fd, iov, count);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return; // nowhere to report it, drop the output
+    }
+
+    //
+    // skip past what was written, may end mid-buffer:
+    //
+    while (count > 0 && (size_t) written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char*) iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+static void flush_at_exit(void)
+{
+  if (Stdout != NULL)
+    output_flush(Stdout);
+}
+
+static bool grow(struct OUTPUT* out, size_t needed)
+{
+  size_t capacity = (out->capacity == 0) ? OUTPUT_BUFFER_SIZE : out->capacity;
+  while (capacity < needed)
+    capacity *= 2;
+
+  char* buffer = (char*) realloc(out->buffer, capacity);
+  if (buffer == NULL)
+    return false;
+
+  out->buffer = buffer;
+  out->capacity = capacity;
+  return true;
+}
@@ -0,0 +1,158 @@
+/*output.h*/
+
+//
+// Buffered output for the nuPython interpreter. Everything the
+// executing program prints goes through an OUTPUT so that many
+// print() calls are batched into a few large writes.
+
+
+#pragma once
+
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // true, false
+
+
+//
+// When is buffered output written out?
+//
+enum OUTPUT_FLUSH_POLICIES
+{
+  OUTPUT_FLUSH_LINE = 0,  // after every line
+  OUTPUT_FLUSH_BLOCK,     // when full, at input() prompts, on errors, at exit
+  OUTPUT_FLUSH_NEVER      // only when full and at exit
+};
+
+//
+// fd for an output that is only collected in memory, never written:
+//
+#define OUTPUT_CAPTURE -1
+
+struct OUTPUT
+{
+  int    fd;        // file descriptor the output is written to, or OUTPUT_CAPTURE
+  int    policy;    // enum OUTPUT_FLUSH_POLICIES
+  bool   repr;      // true => reals print like Python's repr()
+  char*  buffer;
+  size_t length;    // # of bytes currently buffered
+  size_t capacity;  // size of buffer in bytes
+};
+
+
+//
+// Public functions:
+//
+
+//
+// output_init
+//
+// Returns a pointer to a dynamically-allocated output that
+// writes to the given file descriptor using the given flush
+// policy. If fd is OUTPUT_CAPTURE, the output is kept in the
+// buffer, which grows as needed; flushing does nothing.
+//
+struct OUTPUT* output_init(int fd, int policy);
+
+//
+// output_destroy
+//
+// Flushes the given output and frees its memory.
+//
+void output_destroy(struct OUTPUT* out);
+
+//
+// output_current
+//
+// Returns the output that print() and error messages are written
+// to by the calling thread. Unless output_set_current() says
+// otherwise, this is the process's standard output, which is
+// flushed automatically at exit.
+//
+// NOTE: the standard output is created on first use; call this
+// once before starting threads.
+//
+struct OUTPUT* output_current(void);
+
+//
+// output_set_current
+//
+// Directs the calling thread's print() and error messages to the
+// given output; NULL goes back to standard output. Other threads
+// are not affected.
+//
+void output_set_current(struct OUTPUT* out);
+
+//
+// output_parse_policy
+//
+// Given "line", "block" or "never", returns the matching flush
+// policy. Returns -1 if the name is not a policy.
+//
+int output_parse_policy(const char* name);
+
+//
+// output_set_policy
+//
+// Changes the flush policy of the given output.
+//
+void output_set_policy(struct OUTPUT* out, int policy);
+
+//
+// output_write
+//
+// Appends len bytes to the output. Data too large for the
+// buffer is written together with the buffer in one writev().
+//
+void output_write(struct OUTPUT* out, const char* data, size_t len);
+
+//
+// output_puts
+//
+// Writes the given string followed by a newline.
+//
+void output_puts(struct OUTPUT* out, const char* s);
+
+//
+// output_string
+//
+// Writes the given string, without a newline.
+//
+void output_string(struct OUTPUT* out, const char* s);
+
+//
+// output_int
+//
+// Writes the given integer in decimal, formatted directly into
+// the buffer.
+//
+void output_int(struct OUTPUT* out, long long value);
+
+//
+// output_real
+//
+// Writes the given real, formatted directly into the buffer: as
+// printf("%f") would, or as Python's repr() would if out->repr.
+//
+void output_real(struct OUTPUT* out, double value);
+
+//
+// output_printf
+//
+// printf() into the output.
+//
+void output_printf(struct OUTPUT* out, const char* format, ...);
+
+//
+// output_sync
+//
+// Called at points where the user should see everything
+// printed so far (input() prompts, semantic errors). Flushes
+// unless the policy is OUTPUT_FLUSH_NEVER.
+//
+void output_sync(struct OUTPUT* out);
+
+//
+// output_flush
+//
+// Writes out everything buffered so far.
+//
+void output_flush(struct OUTPUT* out);
@@ -0,0 +1,323 @@
+/*phase.c*/
+
+//
+// Phase timing for nuPython runs. The four hardware counters are
+// opened as one perf_event_open group, counting this process in
+// user mode, and read together at every phase boundary; a counter
+// the machine lacks is left out of the group, and without a group
+// leader only the monotonic clock is used.
+//
+
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   // syscall
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>  // uint64_t
+#include <time.h>    // clock_gettime
+#include <unistd.h>  // read, close
+
+#ifdef __linux__
+#include <sys/syscall.h>         // SYS_perf_event_open
+#include <linux/perf_event.h>
+#endif
+
+#include "phase.h"
+
+
+//
+// The counters, in the order they join the group:
+//
+enum PHASE_COUNTERS
+{
+  PHASE_CYCLES = 0,
+  PHASE_INSTRUCTIONS,
+  PHASE_CACHE_MISSES,
+  PHASE_BRANCH_MISSES,
+  PHASE_NUM_COUNTERS
+};
+
+struct PHASE
+{
+  const char* name;
+  double seconds;
+  uint64_t counts[PHASE_NUM_COUNTERS];
+};
+
+struct PHASE_STATS
+{
+  int fds[PHASE_NUM_COUNTERS];    // -1 => not counted
+  int positions[PHASE_NUM_COUNTERS]; // where each is in a group read
+  int num_open;
+
+  struct PHASE phases[PHASE_MAX];
+  int num_phases;
+
+  int current;                    // phase running, -1 if none
+  double start;                   // when it began
+  uint64_t start_counts[PHASE_NUM_COUNTERS];
+};
+
+
+//
+// Private functions:
+//
+
+//Opens the given counter in the group led by group_fd (-1 for
+// the leader); returns its fd, -1 if it can't be counted
+static int open_counter(int counter, int group_fd);
+
+//Returns the monotonic clock, in seconds
+static double phase_clock(void);
+
+//Reads the counters into counts, scaled up if the kernel had to
+// share them with other groups; unopened counters read 0
+static void read_counters(struct PHASE_STATS* stats, uint64_t counts[]);
+
+//Writes a count, or "-" if the counter isn't open, in a column of
+// the given width
+static void print_count(struct PHASE_STATS* stats, FILE* out, int counter, uint64_t value, int width);
+
+
+//
+// Public functions:
+//
+
+//
+// phase_create
+//
+// Opens the counters if possible and returns an object to time
+// phases with.
+//
+struct PHASE_STATS* phase_create(void)
+{
+  struct PHASE_STATS* stats = (struct PHASE_STATS*) calloc(1, sizeof(struct PHASE_STATS));
+  if (stats == NULL)
+    return NULL;
+
+  stats->current = -1;
+
+  int leader = -1;
+  for (int counter = 0; counter < PHASE_NUM_COUNTERS; counter++) {
+    stats->fds[counter] = -1;
+    stats->positions[counter] = -1;
+
+    if (counter > 0 && leader < 0)
+      continue; // no group to join
+
+    int fd = open_counter(counter, leader);
+    if (fd < 0)
+      continue;
+
+    if (leader < 0)
+      leader = fd;
+    stats->fds[counter] = fd;
+    stats->positions[counter] = stats->num_open++;
+  }
+
+  return stats;
+}
+
+//
+// phase_begin
+//
+// Ends the current phase and starts the named one.
+//
+void phase_begin(struct PHASE_STATS* stats, const char* name)
+{
+  if (stats == NULL)
+    return;
+
+  phase_end(stats);
+
+  int phase = 0;
+  while (phase < stats->num_phases && strcmp(stats->phases[phase].name, name) != 0)
+    phase++;
+
+  if (phase == stats->num_phases) {
+    if (phase == PHASE_MAX)
+      return; // untimed
+    stats->phases[phase].name = name;
+    stats->num_phases++;
+  }
+
+  stats->current = phase;
+  read_counters(stats, stats->start_counts);
+  stats->start = phase_clock();
+}
+
+//
+// phase_end
+//
+// Ends the current phase, adding its time and counts to it.
+//
+void phase_end(struct PHASE_STATS* stats)
+{
+  if (stats == NULL || stats->current < 0)
+    return;
+
+  double end = phase_clock();
+  uint64_t counts[PHASE_NUM_COUNTERS];
+  read_counters(stats, counts);
+
+  struct PHASE* phase = &stats->phases[stats->current];
+  phase->seconds += end - stats->start;
+  for (int counter = 0; counter < PHASE_NUM_COUNTERS; counter++)
+    phase->counts[counter] += counts[counter] - stats->start_counts[counter];
+
+  stats->current = -1;
+}
+
+//
+// phase_print
+//
+// Writes the phases as a table or as JSON.
+//
+void phase_print(struct PHASE_STATS* stats, FILE* out, bool json)
+{
+  static const char* Names[PHASE_NUM_COUNTERS] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+  };
+
+  if (stats == NULL)
+    return;
+
+  if (json) {
+    fprintf(out, "{\"counters\": %s, \"phases\": [", (stats->num_open > 0) ? "true" : "false");
+
+    for (int p = 0; p < stats->num_phases; p++) {
+      struct PHASE* phase = &stats->phases[p];
+      fprintf(out, "%s\n  {\"name\": \"%s\", \"ms\": %.3f", (p > 0) ? "," : "", phase->name, phase->seconds * 1000.0);
+
+      for (int counter = 0; counter < PHASE_NUM_COUNTERS; counter++) {
+        if (stats->fds[counter] >= 0)
+          fprintf(out, ", \"%s\": %llu", Names[counter], (unsigned long long) phase->counts[counter]);
+        else
+          fprintf(out, ", \"%s\": null", Names[counter]);
+      }
+      fprintf(out, "}");
+    }
+
+    fprintf(out, "\n]}\n");
+    return;
+  }
+
+  fprintf(out, "**PHASE STATS%s\n", (stats->num_open > 0) ? "" : " (clock only, perf_event_open is unavailable)");
+  fprintf(out, "  %-10s %10s %14s %14s %12s %12s %6s %6s  %s\n",
+          "phase", "ms", "cycles", "instructions", "cache-miss", "branch-miss", "IPC", "MPKI", "bound");
+
+  for (int p = 0; p < stats->num_phases; p++) {
+    struct PHASE* phase = &stats->phases[p];
+    uint64_t* counts = phase->counts;
+
+    fprintf(out, "  %-10s %10.3f", phase->name, phase->seconds * 1000.0);
+    print_count(stats, out, PHASE_CYCLES, counts[PHASE_CYCLES], 14);
+    print_count(stats, out, PHASE_INSTRUCTIONS, counts[PHASE_INSTRUCTIONS], 14);
+    print_count(stats, out, PHASE_CACHE_MISSES, counts[PHASE_CACHE_MISSES], 12);
+    print_count(stats, out, PHASE_BRANCH_MISSES, counts[PHASE_BRANCH_MISSES], 12);
+
+    bool ipc = stats->fds[PHASE_CYCLES] >= 0 && stats->fds[PHASE_INSTRUCTIONS] >= 0 && counts[PHASE_CYCLES] > 0;
+    bool mpki = stats->fds[PHASE_INSTRUCTIONS] >= 0 && stats->fds[PHASE_CACHE_MISSES] >= 0 && counts[PHASE_INSTRUCTIONS] > 0;
+
+    if (ipc)
+      fprintf(out, " %6.2f", (double) counts[PHASE_INSTRUCTIONS] / (double) counts[PHASE_CYCLES]);
+    else
+      fprintf(out, " %6s", "-");
+
+    if (mpki) {
+      double misses = 1000.0 * (double) counts[PHASE_CACHE_MISSES] / (double) counts[PHASE_INSTRUCTIONS];
+      fprintf(out, " %6.2f  %s\n", misses, (misses >= PHASE_MEMORY_BOUND_MPKI) ? "memory" : "instructions");
+    }
+    else
+      fprintf(out, " %6s  %s\n", "-", "-");
+  }
+}
+
+//
+// phase_destroy
+//
+// Closes the counters and frees stats.
+//
+void phase_destroy(struct PHASE_STATS* stats)
+{
+  if (stats == NULL)
+    return;
+
+  for (int counter = 0; counter < PHASE_NUM_COUNTERS; counter++) {
+    if (stats->fds[counter] >= 0)
+      close(stats->fds[counter]);
+  }
+  free(stats);
+}
+
+
+//
+// Private functions:
+//
+
+static int open_counter(int counter, int group_fd)
+{
+#ifdef __linux__
+  static const uint64_t Configs[PHASE_NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = Configs[counter];
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.exclude_kernel = 1;  // allowed without privileges
+  attr.exclude_hv = 1;
+
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+#else
+  return -1;
+#endif
+}
+
+static double phase_clock(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static void read_counters(struct PHASE_STATS* stats, uint64_t counts[])
+{
+  for (int counter = 0; counter < PHASE_NUM_COUNTERS; counter++)
+    counts[counter] = 0;
+
+  if (stats->num_open == 0)
+    return;
+
+  //
+  // nr, time enabled, time running, then a value per counter:
+  //
+  uint64_t buffer[3 + PHASE_NUM_COUNTERS];
+  ssize_t bytes = read(stats->fds[PHASE_CYCLES], buffer, sizeof(buffer));
+  if (bytes < (ssize_t) ((3 + stats->num_open) * sizeof(uint64_t)))
+    return;
+
+  double scale = (buffer[2] > 0 && buffer[2] < buffer[1]) ? (double) buffer[1] / (double) buffer[2] : 1.0;
+
+  for (int counter = 0; counter < PHASE_NUM_COUNTERS; counter++) {
+    if (stats->positions[counter] >= 0)
+      counts[counter] = (uint64_t) ((double) buffer[3 + stats->positions[counter]] * scale);
+  }
+}
+
+static void print_count(struct PHASE_STATS* stats, FILE* out, int counter, uint64_t value, int width)
+{
+  if (stats->fds[counter] >= 0)
+    fprintf(out, " %*llu", width, (unsigned long long) value);
+  else
+    fprintf(out, " %*s", width, "-");
+}
@@ -0,0 +1,74 @@
+/*phase.h*/
+
+//
+// Phase timing for nuPython runs: wall-clock time and, where the
+// kernel allows perf_event_open, hardware counters (cycles,
+// instructions, cache misses, branch misses) for each phase of a
+// run, e.g. parsing, building the program graph and executing.
+
+
+#pragma once
+
+#include <stdio.h>    // FILE
+#include <stdbool.h>  // true, false
+
+
+//
+// Most phases a run can have:
+//
+#define PHASE_MAX 8
+
+//
+// Cache misses per 1000 instructions from which a phase counts as
+// bound by memory rather than by the instructions it executes:
+//
+#define PHASE_MEMORY_BOUND_MPKI 10.0
+
+struct PHASE_STATS;
+
+
+//
+// Public functions:
+//
+
+//
+// phase_create
+//
+// Opens the hardware counters, if the kernel allows it, and
+// returns an object to time phases with; the clock is used alone
+// otherwise. Returns NULL if out of memory.
+//
+struct PHASE_STATS* phase_create(void);
+
+//
+// phase_begin
+//
+// Ends the current phase, if any, and starts the phase with the
+// given name; a name used before adds to that phase. Does nothing
+// if stats is NULL, so callers needn't check whether phases are
+// being timed.
+//
+void phase_begin(struct PHASE_STATS* stats, const char* name);
+
+//
+// phase_end
+//
+// Ends the current phase, if any. Does nothing if stats is NULL.
+//
+void phase_end(struct PHASE_STATS* stats);
+
+//
+// phase_print
+//
+// Writes the phases in the order they first began, as a table or,
+// if json is true, as one JSON object, to the given stream. Does
+// nothing if stats is NULL.
+//
+void phase_print(struct PHASE_STATS* stats, FILE* out, bool json);
+
+//
+// phase_destroy
+//
+// Closes the counters and frees stats.
+//
+void phase_destroy(struct PHASE_STATS* stats);
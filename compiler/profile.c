@@ -0,0 +1,597 @@
+/*profile.c*/
+
+//
+// Per-line execution profiler for nuPython programs. Every
+// statement reachable in the program graph gets an entry, found
+// through a hash table on the statement's address, that records
+// its hits, its cycles and the while loop it is in; the loops
+// become the frames of the folded stacks. Statements the optimizer
+// copied are charged to the statement as written.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <time.h>    // clock_gettime
+
+#include "programgraph.h"
+#include "ram.h"
+#include "execute.h"
+#include "optimize.h"  // STMT_SWITCH, STMT_FUSED, STMT_COUNTED
+#include "profile.h"
+
+
+//
+// Cycles come from the time-stamp counter on x86, nanoseconds
+// from the monotonic clock elsewhere:
+//
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PROFILE_RDTSC 1
+#include <x86intrin.h>  // __rdtsc
+#else
+#define PROFILE_RDTSC 0
+#endif
+
+
+struct PROFILE_ENTRY
+{
+  struct STMT* stmt;
+  int  line;
+  int  loop;              // entry of the enclosing while loop, -1 if none
+  int  copy_of;           // entry this statement is a copy of, -1 if none
+  bool visited;
+  bool unit;              // an innermost counted loop, run in one go
+  long long hits;         // # of times executed
+  unsigned long long cycles;  // self time
+};
+
+struct PROFILE
+{
+  char* filename;         // NULL => the keyboard
+
+  struct PROFILE_ENTRY* entries;
+  int num_entries;
+  int entries_capacity;
+
+  int* table;             // entry + 1 by stmt address, 0 => empty
+  int table_size;         // a power of 2
+};
+
+//
+// A statement waiting to be visited, and the loop it is in:
+//
+struct PROFILE_VISIT
+{
+  struct STMT* stmt;
+  int loop;
+};
+
+
+//
+// Private functions:
+//
+
+//Returns the current cycle count
+static unsigned long long profile_now(void);
+
+//Returns the entry for stmt, adding one in the given loop if
+// there isn't one yet; -1 if out of memory
+static int find_entry(struct PROFILE* profile, struct STMT* stmt, int loop);
+
+//Returns the entry of the statement as written that the given
+// entry is a copy of, the entry itself if it isn't a copy
+static int original_entry(struct PROFILE* profile, int entry);
+
+//Returns true if the body of the given loop has no loop (or if)
+// inside it
+static bool is_innermost(struct STMT* loop);
+
+//Returns the statement stmt stands for: the loop or if as written
+// for optimized statements, stmt itself otherwise
+static struct STMT* as_written(struct STMT* stmt);
+
+//Reads the lines of the given file; returns NULL if it can't be
+// read, otherwise *num_lines is set and the caller frees both the
+// array and its first element
+static char** read_lines(const char* filename, int* num_lines);
+
+//Writes the frame name for the given line to out, e.g.
+// "7: total = total + t"
+static void write_frame(FILE* out, char** lines, int num_lines, int line);
+
+
+//
+// Public functions:
+//
+
+//
+// profile_create
+//
+// Returns an empty profile of the given (optimized) program graph.
+//
+struct PROFILE* profile_create(struct STMT* program, struct OPT_LOG* optimizations, const char* filename)
+{
+  struct PROFILE* profile = (struct PROFILE*) calloc(1, sizeof(struct PROFILE));
+  if (profile == NULL)
+    return NULL;
+
+  if (filename != NULL) {
+    profile->filename = (char*) malloc(strlen(filename) + 1);
+    if (profile->filename == NULL) {
+      free(profile);
+      return NULL;
+    }
+    strcpy(profile->filename, filename);
+  }
+
+  //
+  // the optimizer's copies, e.g. the loop that runs after a peeled
+  // first iteration, are tied to what they were copied from:
+  //
+  struct STMT** copies = NULL;
+  struct STMT** originals = NULL;
+  int num_copies = (optimizations != NULL) ? optimize_copies(optimizations, &copies, &originals) : 0;
+
+  for (int i = 0; i < num_copies; i++) {
+    int copy = find_entry(profile, copies[i], -1);
+    int original = find_entry(profile, originals[i], -1);
+    if (copy < 0 || original < 0) {
+      profile_destroy(profile);
+      return NULL;
+    }
+    profile->entries[copy].copy_of = original;
+  }
+
+  //
+  // visit every statement once, passing down the loop it is in;
+  // a loop's body is in the loop, its next_stmt is not. A copy of
+  // a loop is in the loop its original is in, even when reached
+  // from the original's body:
+  //
+  int capacity = 64;
+  int count = 0;
+  struct PROFILE_VISIT* stack = (struct PROFILE_VISIT*) malloc(capacity * sizeof(struct PROFILE_VISIT));
+  if (stack == NULL) {
+    profile_destroy(profile);
+    return NULL;
+  }
+
+  stack[count].stmt = program;
+  stack[count].loop = -1;
+  count++;
+
+  while (count > 0) {
+    struct PROFILE_VISIT visit = stack[--count];
+    if (visit.stmt == NULL)
+      continue;
+
+    int entry = find_entry(profile, visit.stmt, visit.loop);
+    if (entry < 0)
+      break;
+    if (profile->entries[entry].visited)
+      continue;
+    profile->entries[entry].visited = true;
+    profile->entries[entry].loop = visit.loop;
+
+    if (count + 2 > capacity) {
+      capacity *= 2;
+      struct PROFILE_VISIT* bigger = (struct PROFILE_VISIT*) realloc(stack, capacity * sizeof(struct PROFILE_VISIT));
+      if (bigger == NULL)
+        break;
+      stack = bigger;
+    }
+
+    struct STMT* stmt = as_written(visit.stmt);
+
+    if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      profile->entries[entry].unit = (visit.stmt->stmt_type == STMT_COUNTED) && is_innermost(visit.stmt);
+
+      int original = original_entry(profile, entry);
+      if (original != entry && profile->entries[original].visited)
+        profile->entries[entry].loop = profile->entries[original].loop;
+
+      stack[count].stmt = stmt->types.while_loop->next_stmt;
+      stack[count].loop = profile->entries[entry].loop;
+      count++;
+      stack[count].stmt = stmt->types.while_loop->loop_body;
+      stack[count].loop = entry;
+      count++;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      stack[count].stmt = stmt->types.if_then_else->false_path;
+      stack[count].loop = visit.loop;
+      count++;
+      stack[count].stmt = stmt->types.if_then_else->true_path;
+      stack[count].loop = visit.loop;
+      count++;
+    }
+    else {
+      if (stmt->stmt_type == STMT_ASSIGNMENT)
+        stack[count].stmt = stmt->types.assignment->next_stmt;
+      else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+        stack[count].stmt = stmt->types.function_call->next_stmt;
+      else
+        stack[count].stmt = stmt->types.pass->next_stmt;
+      stack[count].loop = visit.loop;
+      count++;
+    }
+  }
+
+  free(stack);
+  return profile;
+}
+
+//
+// profile_execute
+//
+// Executes the program one statement at a time, timing each; an
+// innermost counted loop is one statement.
+//
+void profile_execute(struct PROFILE* profile, struct STMT* program, struct RAM* memory)
+{
+  struct STMT* stmt = program;
+
+  //
+  // one reading of the clock per statement, which can cost as much
+  // as a simple statement: each statement is charged the time since
+  // the previous reading, its own bookkeeping included. Hot inner
+  // loops would pay that on every line of every iteration, so a
+  // counted loop with no loop inside runs in one go, as execute()
+  // runs it, and is charged as a whole
+  //
+  unsigned long long last = profile_now();
+
+  while (stmt != NULL) {
+    bool success;
+    int entry = find_entry(profile, stmt, -1); // only new for a stmt made at run time
+
+    struct STMT* next = (entry >= 0 && profile->entries[entry].unit)
+      ? execute_unit(stmt, memory, &success)
+      : execute_step(stmt, memory, &success);
+
+    unsigned long long now = profile_now();
+
+    if (entry >= 0) {
+      profile->entries[entry].hits++;
+      profile->entries[entry].cycles += now - last;
+    }
+    last = now;
+
+    if (!success)
+      return; // error already output
+    stmt = next;
+  }
+}
+
+//
+// profile_write
+//
+// Writes the profile in callgrind format to path and in folded
+// stack format to path.folded.
+//
+bool profile_write(struct PROFILE* profile, const char* path)
+{
+  const char* name = (profile->filename != NULL) ? profile->filename : "stdin";
+  int num_lines = 0;
+  char** lines = (profile->filename != NULL) ? read_lines(profile->filename, &num_lines) : NULL;
+
+  //
+  // callgrind: the costs of each source line, in line order:
+  //
+  int max_line = 0;
+  unsigned long long total_cycles = 0;
+  long long total_hits = 0;
+
+  for (int e = 0; e < profile->num_entries; e++) {
+    if (profile->entries[e].line > max_line)
+      max_line = profile->entries[e].line;
+    total_cycles += profile->entries[e].cycles;
+    total_hits += profile->entries[e].hits;
+  }
+
+  unsigned long long* line_cycles = (unsigned long long*) calloc(max_line + 1, sizeof(unsigned long long));
+  long long* line_hits = (long long*) calloc(max_line + 1, sizeof(long long));
+  FILE* out = fopen(path, "w");
+  bool written = line_cycles != NULL && line_hits != NULL && out != NULL;
+
+  if (written) {
+    for (int e = 0; e < profile->num_entries; e++) {
+      int line = (profile->entries[e].line >= 0) ? profile->entries[e].line : 0;
+      line_cycles[line] += profile->entries[e].cycles;
+      line_hits[line] += profile->entries[e].hits;
+    }
+
+    fprintf(out, "# callgrind format\n");
+    fprintf(out, "version: 1\n");
+    fprintf(out, "creator: nuPython --profile\n");
+    fprintf(out, "cmd: %s\n", name);
+    fprintf(out, "positions: line\n");
+    fprintf(out, "events: %s Hits\n", PROFILE_RDTSC ? "Cycles" : "Nanoseconds");
+    fprintf(out, "summary: %llu %lld\n", total_cycles, total_hits);
+    fprintf(out, "\n");
+    fprintf(out, "fl=%s\n", name);
+    fprintf(out, "fn=<module>\n");
+
+    for (int line = 0; line <= max_line; line++) {
+      if (line_hits[line] > 0)
+        fprintf(out, "%d %llu %lld\n", line, line_cycles[line], line_hits[line]);
+    }
+  }
+
+  if (out != NULL && fclose(out) != 0)
+    written = false;
+  free(line_cycles);
+  free(line_hits);
+
+  //
+  // folded stacks: the file, the loops from the outermost in, and
+  // the statement, then its self time, copies' included:
+  //
+  char* folded_path = (char*) malloc(strlen(path) + sizeof(".folded"));
+  int* frames = (int*) malloc((profile->num_entries + 1) * sizeof(int));
+  unsigned long long* cycles = (unsigned long long*) calloc(profile->num_entries + 1, sizeof(unsigned long long));
+  out = NULL;
+
+  if (cycles != NULL) {
+    for (int e = 0; e < profile->num_entries; e++)
+      cycles[original_entry(profile, e)] += profile->entries[e].cycles;
+  }
+
+  if (folded_path != NULL && frames != NULL && cycles != NULL) {
+    strcpy(folded_path, path);
+    strcat(folded_path, ".folded");
+    out = fopen(folded_path, "w");
+  }
+
+  if (out == NULL)
+    written = false;
+  else {
+    for (int e = 0; e < profile->num_entries; e++) {
+      if (cycles[e] == 0)
+        continue;
+
+      int depth = 0;
+      for (int f = e; f >= 0 && depth <= profile->num_entries; f = profile->entries[f].loop)
+        frames[depth++] = f;
+
+      fputs(name, out);
+      while (depth > 0) {
+        fputc(';', out);
+        write_frame(out, lines, num_lines, profile->entries[frames[--depth]].line);
+      }
+      fprintf(out, " %llu\n", cycles[e]);
+    }
+
+    if (fclose(out) != 0)
+      written = false;
+  }
+
+  free(folded_path);
+  free(frames);
+  free(cycles);
+  if (lines != NULL) {
+    free(lines[0]);
+    free(lines);
+  }
+
+  return written;
+}
+
+//
+// profile_destroy
+//
+// Frees the profile.
+//
+void profile_destroy(struct PROFILE* profile)
+{
+  if (profile == NULL)
+    return;
+
+  free(profile->filename);
+  free(profile->entries);
+  free(profile->table);
+  free(profile);
+}
+
+
+//
+// Private functions:
+//
+
+static unsigned long long profile_now(void)
+{
+#if PROFILE_RDTSC
+  return (unsigned long long) __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+#endif
+}
+
+static int find_entry(struct PROFILE* profile, struct STMT* stmt, int loop)
+{
+  size_t mask = (size_t) profile->table_size - 1;
+  size_t slot = ((size_t) stmt >> 4) & mask;
+
+  if (profile->table_size > 0) {
+    while (profile->table[slot] != 0) {
+      int entry = profile->table[slot] - 1;
+      if (profile->entries[entry].stmt == stmt)
+        return entry;
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  //
+  // a new entry; keep the table at most half full:
+  //
+  if (profile->num_entries == profile->entries_capacity) {
+    int capacity = (profile->entries_capacity == 0) ? 256 : 2 * profile->entries_capacity;
+    struct PROFILE_ENTRY* entries = (struct PROFILE_ENTRY*) realloc(profile->entries, capacity * sizeof(struct PROFILE_ENTRY));
+    if (entries == NULL)
+      return -1;
+    profile->entries = entries;
+    profile->entries_capacity = capacity;
+  }
+
+  if (2 * (profile->num_entries + 1) > profile->table_size) {
+    int size = (profile->table_size == 0) ? 512 : 2 * profile->table_size;
+    int* table = (int*) calloc(size, sizeof(int));
+    if (table == NULL)
+      return -1;
+
+    mask = (size_t) size - 1;
+    for (int e = 0; e < profile->num_entries; e++) {
+      size_t s = ((size_t) profile->entries[e].stmt >> 4) & mask;
+      while (table[s] != 0)
+        s = (s + 1) & mask;
+      table[s] = e + 1;
+    }
+
+    free(profile->table);
+    profile->table = table;
+    profile->table_size = size;
+
+    slot = ((size_t) stmt >> 4) & mask;
+    while (table[slot] != 0)
+      slot = (slot + 1) & mask;
+  }
+
+  int entry = profile->num_entries++;
+  profile->entries[entry].stmt = stmt;
+  profile->entries[entry].line = stmt->line;
+  profile->entries[entry].loop = loop;
+  profile->entries[entry].copy_of = -1;
+  profile->entries[entry].visited = false;
+  profile->entries[entry].unit = false;
+  profile->entries[entry].hits = 0;
+  profile->entries[entry].cycles = 0;
+  profile->table[slot] = entry + 1;
+
+  return entry;
+}
+
+static int original_entry(struct PROFILE* profile, int entry)
+{
+  while (profile->entries[entry].copy_of >= 0)
+    entry = profile->entries[entry].copy_of;
+  return entry;
+}
+
+static bool is_innermost(struct STMT* loop)
+{
+  struct STMT* stmt = as_written(loop)->types.while_loop->loop_body;
+
+  while (stmt != NULL && stmt != loop) {
+    stmt = as_written(stmt);
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT)
+      stmt = stmt->types.assignment->next_stmt;
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+      stmt = stmt->types.function_call->next_stmt;
+    else if (stmt->stmt_type == STMT_PASS)
+      stmt = stmt->types.pass->next_stmt;
+    else
+      return false;
+  }
+  return true;
+}
+
+static struct STMT* as_written(struct STMT* stmt)
+{
+  for (;;) {
+    if (stmt->stmt_type == STMT_SWITCH)
+      stmt = OPT_SWITCH_OF(stmt)->fallback;
+    else if (stmt->stmt_type == STMT_COUNTED)
+      stmt = OPT_COUNTED_OF(stmt)->original;
+    else if (stmt->stmt_type == STMT_FUSED)
+      stmt = OPT_FUSED_OF(stmt)->original;
+    else
+      return stmt;
+  }
+}
+
+static char** read_lines(const char* filename, int* num_lines)
+{
+  FILE* in = fopen(filename, "rb");
+  if (in == NULL)
+    return NULL;
+
+  size_t length = 0;
+  size_t capacity = 4096;
+  char* text = (char*) malloc(capacity);
+
+  while (text != NULL) {
+    length += fread(text + length, 1, capacity - length - 1, in);
+    if (length < capacity - 1)
+      break;
+    capacity *= 2;
+    char* bigger = (char*) realloc(text, capacity);
+    if (bigger == NULL) {
+      free(text);
+      text = NULL;
+    }
+    else
+      text = bigger;
+  }
+  fclose(in);
+
+  if (text == NULL)
+    return NULL;
+  text[length] = '\0';
+
+  int count = 1;
+  for (size_t c = 0; c < length; c++) {
+    if (text[c] == '\n')
+      count++;
+  }
+
+  char** lines = (char**) malloc(count * sizeof(char*));
+  if (lines == NULL) {
+    free(text);
+    return NULL;
+  }
+
+  //
+  // split in place; lines[0] is text itself:
+  //
+  lines[0] = text;
+  count = 1;
+  for (size_t c = 0; c < length; c++) {
+    if (text[c] == '\n') {
+      text[c] = '\0';
+      lines[count++] = text + c + 1;
+    }
+  }
+
+  *num_lines = count;
+  return lines;
+}
+
+static void write_frame(FILE* out, char** lines, int num_lines, int line)
+{
+  if (lines == NULL || line < 1 || line > num_lines) {
+    fprintf(out, "line %d", line);
+    return;
+  }
+
+  const char* text = lines[line - 1];
+  while (*text == ' ' || *text == '\t')
+    text++;
+
+  //
+  // ';' separates frames, so it becomes ','; blanks at the end
+  // are dropped, the count follows a blank:
+  //
+  size_t length = strcspn(text, "\r");
+  while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t'))
+    length--;
+
+  fprintf(out, "%d: ", line);
+  for (size_t c = 0; c < length; c++)
+    fputc((text[c] == ';') ? ',' : text[c], out);
+}
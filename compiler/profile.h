@@ -0,0 +1,67 @@
+/*profile.h*/
+
+//
+// Per-line execution profiler for nuPython programs: counts how
+// often each statement runs and the CPU cycles it takes itself,
+// and writes the result for kcachegrind and flamegraph.pl.
+
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+#include "ram.h"
+#include "optimize.h"  // struct OPT_LOG
+
+
+struct PROFILE;
+
+
+//
+// Public functions:
+//
+
+//
+// profile_create
+//
+// Returns an empty profile of the given program graph, after
+// optimize_program() has run on it; optimizations is the log it
+// returned, so copied statements are charged to the statements
+// they were copied from (NULL if the graph wasn't optimized).
+// filename is the program's source file, whose lines label the
+// profile, or NULL when the program came from the keyboard.
+// Returns NULL if out of memory.
+//
+struct PROFILE* profile_create(struct STMT* program, struct OPT_LOG* optimizations, const char* filename);
+
+//
+// profile_execute
+//
+// Executes the program like execute(), one statement at a time
+// through execute_step(), adding each statement's run and the
+// cycles it took (rdtsc, or nanoseconds where there is no rdtsc)
+// to the profile. An innermost counted loop (see optimize.h) runs
+// in one go through execute_unit() instead, as execute() runs it:
+// its while line is charged for the whole loop, reductions
+// included, and its body lines only for the times the loop had to
+// run as written.
+//
+void profile_execute(struct PROFILE* profile, struct STMT* program, struct RAM* memory);
+
+//
+// profile_write
+//
+// Writes the profile in callgrind format to the file at path, one
+// cost line per source line, and in folded-stack format, one stack
+// per statement with the enclosing while loops as frames, to path
+// followed by ".folded". Returns true if both were written.
+//
+bool profile_write(struct PROFILE* profile, const char* path);
+
+//
+// profile_destroy
+//
+// Frees the profile.
+//
+void profile_destroy(struct PROFILE* profile);
@@ -43,6 +43,10 @@ struct STMT
     struct STMT_IF_THEN_ELSE* if_then_else;
     struct STMT_WHILE_LOOP* while_loop;
     struct STMT_PASS* pass;
+
+    struct OPT_SWITCH* opt_switch;  // STMT_SWITCH, see optimize.h
+    struct OPT_FUSED* opt_fused;    // STMT_FUSED
+    struct OPT_COUNTED* opt_counted;  // STMT_COUNTED
   } types;
 };
 
@@ -7,6 +7,19 @@
 #include <assert.h>
 
 #include "ram.h"
+#include "output.h"
+
+
+//
+// Private functions:
+//
+
+//Copies a bound cell's value from its slot into the cell
+static void sync_cell(struct RAM* memory, struct RAM_CELL* cell);
+
+//Grows a slot array from old_count to count entries, setting the
+// new ones to fill
+static bool grow_slots(void** array, size_t size, int old_count, int count, int fill);
 
 
 //
@@ -29,10 +42,17 @@ struct RAM* ram_init(void)
   }
   ram->capacity = 4;
   ram->num_values = 0;
+  ram->ints = NULL;
+  ram->reals = NULL;
+  ram->int_cells = NULL;
+  ram->real_cells = NULL;
+  ram->num_ints = 0;
+  ram->num_reals = 0;
   ram->cells = (struct RAM_CELL*) malloc(ram->capacity * sizeof(struct RAM_CELL));
   for(int i = 0; i < ram->capacity; i++){ //Initialize each cell in the ram array
     ram->cells[i].identifier = NULL;
     ram->cells[i].value.value_type = RAM_TYPE_NONE;
+    ram->cells[i].slot = -1;
   }
   return ram;
 }
@@ -56,6 +76,10 @@ void ram_destroy(struct RAM* memory)
     }
   }
   free(memory->cells);
+  free(memory->ints);
+  free(memory->reals);
+  free(memory->int_cells);
+  free(memory->real_cells);
   free(memory);
 }
 
@@ -103,7 +127,9 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
 {
   if(address >= memory->num_values || address < 0) //out of bounds
     return NULL;
-  
+
+  sync_cell(memory, &memory->cells[address]);
+
   struct RAM_VALUE* value_copy = (struct RAM_VALUE*) malloc(sizeof(struct RAM_VALUE)); //create copy of RAM_VALUE struct
   value_copy->value_type = memory->cells[address].value.value_type;
    if(value_copy->value_type == RAM_TYPE_STR){//If its a type string dupe 
@@ -138,6 +164,40 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
 }
 
 
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value stored in that memory cell,
+// NOT a copy. Returns NULL if the address is not valid.
+//
+struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address)
+{
+  if(address >= memory->num_values || address < 0) //out of bounds
+    return NULL;
+
+  sync_cell(memory, &memory->cells[address]);
+  return &memory->cells[address].value;
+}
+
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value stored in memory, NOT a copy.
+// Returns NULL if no such name exists in memory.
+//
+struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name)
+{
+  int address = ram_get_addr(memory, name);
+  if (address == -1){
+    return NULL;
+  }
+  return ram_peek_cell_by_addr(memory, address);
+}
+
+
 //
 // ram_free_value
 //
@@ -177,19 +237,41 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
   }
   struct RAM_CELL* cell = &memory->cells[address]; //Get a pointer to the cell
 
-  if(cell->value.value_type == RAM_TYPE_STR && cell->value.types.s != NULL){
-    free(cell->value.types.s);//If its a string free the old one
-    cell->value.types.s = NULL;
+  if(cell->slot >= 0){
+    if(value.value_type == RAM_TYPE_INT && cell->value.value_type == RAM_TYPE_INT){
+      memory->ints[cell->slot] = value.types.i;
+      return true;
+    }
+    if(value.value_type == RAM_TYPE_REAL && cell->value.value_type == RAM_TYPE_REAL){
+      memory->reals[cell->slot] = value.types.d;
+      return true;
+    }
+    //another type, the variable goes back to being tagged
+    if(cell->value.value_type == RAM_TYPE_INT){
+      memory->int_cells[cell->slot] = -1;
+    }
+    else{
+      memory->real_cells[cell->slot] = -1;
+    }
+    cell->slot = -1;
+  }
+
+  char* old_string = NULL;
+  if(cell->value.value_type == RAM_TYPE_STR){
+    old_string = cell->value.types.s; //Free after copying, value may point to it
   }
   cell->value.value_type = value.value_type;//copy the new value_type
   
   if(cell->value.value_type == RAM_TYPE_STR){
     cell->value.types.s = strdup(value.types.s); //Duplicate string and assign
+    cell->str_length = (int) strlen(cell->value.types.s);
+    cell->str_capacity = cell->str_length + 1;
   }
   else
   {
     cell->value.types = value.types; //Update every other value type
   }
+  free(old_string);
   return true;
 }
 
@@ -222,17 +304,191 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
       for(int i = old_capacity; i < memory->capacity; i++){
         memory->cells[i].identifier = NULL; //Initialize all of the identifiers to nullptrs
         memory->cells[i].value.value_type = RAM_TYPE_NONE;//initialize all of the new cells to none values
+        memory->cells[i].slot = -1;
       }
     }
     address = memory->num_values;
     memory->cells[memory->num_values].identifier = strdup(name);//Duplicate the string into the new cell
     memory->cells[memory->num_values].value.value_type = RAM_TYPE_NONE; //Marking the current cell as optional in case
+    memory->cells[memory->num_values].slot = -1;
     memory->num_values++; //Updating the number of values in the array
   }
   return ram_write_cell_by_addr(memory, value, address);
 }
 
 
+//
+// ram_append_cell_by_addr
+//
+// Appends the given string to the string stored in the memory
+// cell at the given address, growing the cell's buffer
+// geometrically. Returns true if successful, false if the
+// address is invalid or the cell does not hold a string.
+//
+bool ram_append_cell_by_addr(struct RAM* memory, char* suffix, int address)
+{
+  if(address >= memory->num_values || address < 0){
+    return false;
+  }
+  struct RAM_CELL* cell = &memory->cells[address];
+
+  if(cell->value.value_type != RAM_TYPE_STR){
+    return false;
+  }
+
+  int suffix_length = (int) strlen(suffix);
+  int needed = cell->str_length + suffix_length + 1;
+
+  if(needed > cell->str_capacity){
+    //
+    // copy into a new buffer before freeing the old one, suffix may
+    // point into it (s = s + s):
+    //
+    int capacity = cell->str_capacity * 2;
+    if(capacity < needed){
+      capacity = needed;
+    }
+    char* new_string = (char*) malloc(capacity);
+    if(new_string == NULL){
+      return false;
+    }
+    memcpy(new_string, cell->value.types.s, cell->str_length);
+    memcpy(new_string + cell->str_length, suffix, suffix_length);
+
+    free(cell->value.types.s);
+    cell->value.types.s = new_string;
+    cell->str_capacity = capacity;
+  }
+  else{
+    memcpy(cell->value.types.s + cell->str_length, suffix, suffix_length);
+  }
+
+  cell->str_length += suffix_length;
+  cell->value.types.s[cell->str_length] = '\0';
+  return true;
+}
+
+
+//
+// ram_take_str_by_name
+//
+// Writes the string s to the memory cell named by the given name
+// without duplicating it; memory takes ownership of s.
+//
+bool ram_take_str_by_name(struct RAM* memory, char* s, int length, char* name)
+{
+  int address = ram_get_addr(memory, name);
+
+  if(address == -1 || memory->cells[address].slot >= 0){
+    //create the cell, or unbind its slot, the way any other write would
+    struct RAM_VALUE none;
+    none.value_type = RAM_TYPE_NONE;
+
+    if(!ram_write_cell_by_name(memory, none, name)){
+      free(s);
+      return false;
+    }
+    address = ram_get_addr(memory, name);
+  }
+  struct RAM_CELL* cell = &memory->cells[address];
+
+  if(cell->value.value_type == RAM_TYPE_STR){
+    free(cell->value.types.s);
+  }
+  cell->value.value_type = RAM_TYPE_STR;
+  cell->value.types.s = s;
+  cell->str_length = length;
+  cell->str_capacity = length + 1;
+  return true;
+}
+
+
+//
+// ram_reserve_slots
+//
+// Makes sure memory has at least num_ints int slots and num_reals
+// real slots.
+//
+bool ram_reserve_slots(struct RAM* memory, int num_ints, int num_reals)
+{
+  if(num_ints > memory->num_ints){
+    if(!grow_slots((void**) &memory->ints, sizeof(int), memory->num_ints, num_ints, 0) ||
+       !grow_slots((void**) &memory->int_cells, sizeof(int), memory->num_ints, num_ints, -1)){
+      return false;
+    }
+    memory->num_ints = num_ints;
+  }
+  if(num_reals > memory->num_reals){
+    if(!grow_slots((void**) &memory->reals, sizeof(double), memory->num_reals, num_reals, 0) ||
+       !grow_slots((void**) &memory->real_cells, sizeof(int), memory->num_reals, num_reals, -1)){
+      return false;
+    }
+    memory->num_reals = num_reals;
+  }
+  return true;
+}
+
+//
+// ram_bind_slot
+//
+// Keeps the named variable's value in the given int or real slot
+// from now on. Returns its address, -1 if the slot is invalid.
+//
+int ram_bind_slot(struct RAM* memory, char* name, int value_type, int slot)
+{
+  bool is_int = (value_type == RAM_TYPE_INT);
+  if((!is_int && value_type != RAM_TYPE_REAL) ||
+     slot < 0 || slot >= (is_int ? memory->num_ints : memory->num_reals)){
+    return -1;
+  }
+
+  int address = ram_get_addr(memory, name);
+  if(address == -1){
+    struct RAM_VALUE zero;
+    zero.value_type = value_type;
+    if(is_int){
+      zero.types.i = 0;
+    }
+    else{
+      zero.types.d = 0.0;
+    }
+    ram_write_cell_by_name(memory, zero, name);
+    address = memory->num_values - 1;
+  }
+
+  struct RAM_CELL* cell = &memory->cells[address];
+  if(cell->slot >= 0){ //bound elsewhere, take it back first
+    sync_cell(memory, cell);
+    if(cell->value.value_type == RAM_TYPE_INT){
+      memory->int_cells[cell->slot] = -1;
+    }
+    else{
+      memory->real_cells[cell->slot] = -1;
+    }
+    cell->slot = -1;
+  }
+
+  //
+  // the slot starts with the variable's value if it has the right
+  // type, 0 otherwise:
+  //
+  if(is_int){
+    memory->ints[slot] = (cell->value.value_type == RAM_TYPE_INT) ? cell->value.types.i : 0;
+    memory->int_cells[slot] = address;
+  }
+  else{
+    memory->reals[slot] = (cell->value.value_type == RAM_TYPE_REAL) ? cell->value.types.d : 0.0;
+    memory->real_cells[slot] = address;
+  }
+  if(cell->value.value_type == RAM_TYPE_STR){
+    free(cell->value.types.s);
+  }
+  cell->value.value_type = value_type;
+  cell->slot = slot;
+
+  return address;
+}
+
 //
 // ram_print
 //
@@ -240,41 +496,92 @@ bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* na
 //
 void ram_print(struct RAM* memory)
 {
-  printf("**MEMORY PRINT**\n");
+  struct OUTPUT* out = output_current();
 
-  printf("Capacity: %d\n", memory->capacity);
-  printf("Num values: %d\n", memory->num_values);
-  printf("Contents:\n");
+  output_puts(out, "**MEMORY PRINT**");
+
+  output_string(out, "Capacity: ");
+  output_int(out, memory->capacity);
+  output_string(out, "\nNum values: ");
+  output_int(out, memory->num_values);
+  output_string(out, "\nContents:\n");
 
   for (int i = 0; i < memory->num_values; i++)
   {
-      printf(" %d: %s, ", i, memory->cells[i].identifier);
+      output_string(out, " ");
+      output_int(out, i);
+      output_string(out, ": ");
+      output_string(out, memory->cells[i].identifier);
+      output_string(out, ", ");
+      sync_cell(memory, &memory->cells[i]);
       int value_type = memory->cells[i].value.value_type;
       if(value_type == RAM_TYPE_INT){
-        printf("int, %d", memory->cells[i].value.types.i);        
+        output_string(out, "int, ");
+        output_int(out, memory->cells[i].value.types.i);
       }
       else if (value_type == RAM_TYPE_REAL){
-        printf("real, %lf", memory->cells[i].value.types.d);
+        output_string(out, "real, ");
+        output_real(out, memory->cells[i].value.types.d);
       }
       else if(value_type == RAM_TYPE_STR){
-        printf("str, '%s'", memory->cells[i].value.types.s);
+        output_string(out, "str, '");
+        output_string(out, memory->cells[i].value.types.s);
+        output_string(out, "'");
       }
       else if(value_type == RAM_TYPE_PTR){
-        printf("ptr, %d", memory->cells[i].value.types.i);
+        output_string(out, "ptr, ");
+        output_int(out, memory->cells[i].value.types.i);
       }
       else if(value_type == RAM_TYPE_BOOLEAN){
         if(memory->cells[i].value.types.i == 0)
-          printf("boolean, False");
+          output_string(out, "boolean, False");
         else
         {
-          printf("boolean, True");      
+          output_string(out, "boolean, True");
         }
       }
       else if(value_type == RAM_TYPE_NONE){
-        printf("none, None");
+        output_string(out, "none, None");
       }
-   printf("\n");
+   output_string(out, "\n");
+  }
+
+  output_puts(out, "**END PRINT**");
+  output_sync(out); // a console dump, show it now
+}
+
+
+//
+// Private functions:
+//
+
+static void sync_cell(struct RAM* memory, struct RAM_CELL* cell)
+{
+  if(cell->slot < 0){
+    return;
+  }
+  if(cell->value.value_type == RAM_TYPE_INT){
+    cell->value.types.i = memory->ints[cell->slot];
+  }
+  else{
+    cell->value.types.d = memory->reals[cell->slot];
   }
+}
 
-  printf("**END PRINT**\n");
+static bool grow_slots(void** array, size_t size, int old_count, int count, int fill)
+{
+  char* grown = (char*) realloc(*array, size * count);
+  if(grown == NULL){
+    return false;
+  }
+  if(fill == 0){
+    memset(grown + size * old_count, 0, size * (count - old_count));
+  }
+  else{
+    for(int i = old_count; i < count; i++){
+      ((int*) grown)[i] = fill; // only the *_cells arrays have a fill
+    }
+  }
+  *array = grown;
+  return true;
 }
@@ -41,6 +41,9 @@ struct RAM_CELL
 {
   char* identifier;  // variable name for this memory cell
   struct RAM_VALUE value;
+  int str_length;    // if value is a string, its strlen()
+  int str_capacity;  // if value is a string, # of bytes allocated
+  int slot;          // >= 0 => value lives in ints[slot] or reals[slot]
 };
 
 struct RAM
@@ -48,6 +51,18 @@ struct RAM
   struct RAM_CELL* cells;  // array of memory cells
   int num_values;  // # of values currently stored in memory
   int capacity;    // total # of cells available in memory
+
+  //
+  // Untagged storage for variables that only ever hold an int, or
+  // only ever a real, see ram_bind_slot(). *_cells[slot] is the
+  // address of the cell bound to the slot, -1 until it is written.
+  //
+  int*    ints;
+  double* reals;
+  int*    int_cells;
+  int*    real_cells;
+  int num_ints;
+  int num_reals;
 };
 
 
@@ -118,6 +133,30 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
 //
 struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name);
 
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address (an integer in the range 0..N-1),
+// returns a pointer to the value stored in that memory cell,
+// NOT a copy. Returns NULL if the address is not valid.
+//
+// NOTE: the value belongs to memory and must not be freed or
+// modified. It is only valid until memory is next written.
+//
+struct RAM_VALUE* ram_peek_cell_by_addr(struct RAM* memory, int address);
+
+//
+// ram_peek_cell_by_name
+//
+// If the given name (e.g. "x") has been written to memory,
+// returns a pointer to the value stored in memory, NOT a copy.
+// Returns NULL if no such name exists in memory.
+//
+// NOTE: the value belongs to memory and must not be freed or
+// modified. It is only valid until memory is next written.
+//
+struct RAM_VALUE* ram_peek_cell_by_name(struct RAM* memory, char* name);
+
 //
 // ram_free_value
 //
@@ -161,10 +200,61 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 //
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name);
 
+//
+// ram_append_cell_by_addr
+//
+// Appends the given string to the string stored in the memory
+// cell at the given address, i.e. s = s + suffix, without
+// copying s. The cell's buffer grows geometrically, so building
+// a string by repeated appends takes linear time. Returns true
+// if successful, false if the address is invalid or the cell
+// does not hold a string.
+//
+// NOTE: suffix may point into the cell's own string.
+//
+bool ram_append_cell_by_addr(struct RAM* memory, char* suffix, int address);
+
+//
+// ram_take_str_by_name
+//
+// Writes the string s, of the given strlen(), to the memory cell
+// named by the given name, like ram_write_cell_by_name(), except
+// that s is not duplicated: memory takes ownership of s, which
+// must have been allocated with malloc(). Returns true if
+// successful, false if not (s is freed either way).
+//
+bool ram_take_str_by_name(struct RAM* memory, char* s, int length, char* name);
+
+//
+// ram_reserve_slots
+//
+// Makes sure memory has at least num_ints int slots and
+// num_reals real slots. New slots are unbound. Returns true if
+// successful, false if out of memory.
+//
+bool ram_reserve_slots(struct RAM* memory, int num_ints, int num_reals);
+
+//
+// ram_bind_slot
+//
+// Moves the value of the variable with the given name into the
+// given int slot (value_type RAM_TYPE_INT) or real slot (value_type
+// RAM_TYPE_REAL), creating the variable with value 0 if it doesn't
+// exist. From then on ints[slot] / reals[slot] may be read and
+// written directly; the ram_* functions still see an ordinary cell.
+// Returns the variable's address, or -1 if the slot is invalid.
+//
+// NOTE: writing a value of another type to the cell through
+// ram_write_cell_by_*() unbinds the slot.
+//
+int ram_bind_slot(struct RAM* memory, char* name, int value_type, int slot);
+
 //
 // ram_print
 //
 // Prints the contents of RAM to the console, for debugging.
+// Output goes through output_current(); callers that also use
+// stdio must fflush(stdout) first.
 //
 void ram_print(struct RAM* memory);
 
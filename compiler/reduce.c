@@ -0,0 +1,274 @@
+/*reduce.c*/
+
+//
+// Vectorized kernels for the reduction loops the optimizer finds.
+// A term is evaluated for 4 (SSE2) or 8 (AVX2) values of the loop
+// variable at once in 32-bit lanes, which wrap around exactly as
+// the interpreter's ints do, and summed in 64-bit lanes. The kernel
+// is picked at run time from what the CPU supports; anything else
+// runs the scalar loop.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+
+#include "reduce.h"
+
+
+//
+// The SSE2 and AVX2 kernels need GCC or clang on x86:
+//
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define REDUCE_X86 1
+#include <immintrin.h>
+#else
+#define REDUCE_X86 0
+#endif
+
+
+//
+// Private functions:
+//
+
+//Adds the terms for count values of x, from x = start, to *result
+static void poly_scalar(const int coeffs[], int start, int step, long long count, struct REDUCE_SUM* result);
+
+#if REDUCE_X86
+//Adds the terms 4 at a time, the last few with poly_scalar()
+static void poly_sse2(const int coeffs[], int start, int step, long long count, struct REDUCE_SUM* result);
+
+//Adds the terms 8 at a time, the last few with poly_scalar()
+static void poly_avx2(const int coeffs[], int start, int step, long long count, struct REDUCE_SUM* result);
+
+//Multiplies the 32-bit lanes of a and b, keeping the low 32 bits
+// of each product (SSE2 only has _mm_mul_epu32)
+static __m128i mullo_sse2(__m128i a, __m128i b);
+#endif
+
+
+//
+// Public functions:
+//
+
+//
+// reduce_kernel
+//
+// Returns the kernel reduce_poly() runs on this CPU.
+//
+int reduce_kernel(void)
+{
+#if REDUCE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return REDUCE_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return REDUCE_SSE2;
+#endif
+  return REDUCE_SCALAR;
+}
+
+//
+// reduce_kernel_name
+//
+// Returns the name of the given kernel.
+//
+const char* reduce_kernel_name(int kernel)
+{
+  if (kernel == REDUCE_AVX2)
+    return "avx2";
+  if (kernel == REDUCE_SSE2)
+    return "sse2";
+  return "scalar";
+}
+
+//
+// reduce_poly_at
+//
+// Returns p(x), wrapping around like the interpreter's ints.
+//
+int reduce_poly_at(const int coeffs[REDUCE_MAX_DEGREE + 1], int x)
+{
+  unsigned int p = (unsigned int) coeffs[REDUCE_MAX_DEGREE];
+
+  for (int d = REDUCE_MAX_DEGREE - 1; d >= 0; d--)
+    p = p * (unsigned int) x + (unsigned int) coeffs[d];
+
+  return (int) p;
+}
+
+//
+// reduce_poly
+//
+// Sums p(x) for count values of x from start, step apart.
+//
+void reduce_poly(const int coeffs[REDUCE_MAX_DEGREE + 1], int start, int step, long long count, struct REDUCE_SUM* result)
+{
+  result->sum = 0;
+  result->magnitude = 0;
+  result->bits = 0;
+
+  if (count <= 0)
+    return;
+
+#if REDUCE_X86
+  int kernel = reduce_kernel();
+
+  if (kernel == REDUCE_AVX2) {
+    poly_avx2(coeffs, start, step, count, result);
+    return;
+  }
+  if (kernel == REDUCE_SSE2) {
+    poly_sse2(coeffs, start, step, count, result);
+    return;
+  }
+#endif
+
+  poly_scalar(coeffs, start, step, count, result);
+}
+
+
+//
+// Private functions:
+//
+
+static void poly_scalar(const int coeffs[], int start, int step, long long count, struct REDUCE_SUM* result)
+{
+  unsigned long long sum = (unsigned long long) result->sum;
+  unsigned long long magnitude = result->magnitude;
+  unsigned int bits = result->bits;
+  unsigned int x = (unsigned int) start;
+
+  for (long long k = 0; k < count; k++) {
+    int term = reduce_poly_at(coeffs, (int) x);
+    unsigned int abs = (term < 0) ? 0u - (unsigned int) term : (unsigned int) term;
+
+    sum += (unsigned long long) (long long) term;
+    magnitude += abs;
+    bits |= abs;
+    x += (unsigned int) step;
+  }
+
+  result->sum = (long long) sum;
+  result->magnitude = magnitude;
+  result->bits = bits;
+}
+
+#if REDUCE_X86
+__attribute__((target("sse2")))
+static void poly_sse2(const int coeffs[], int start, int step, long long count, struct REDUCE_SUM* result)
+{
+  __m128i c[REDUCE_MAX_DEGREE + 1];
+  for (int d = 0; d <= REDUCE_MAX_DEGREE; d++)
+    c[d] = _mm_set1_epi32(coeffs[d]);
+
+  unsigned int s = (unsigned int) step;
+  unsigned int x0 = (unsigned int) start;
+  __m128i x = _mm_setr_epi32((int) x0, (int) (x0 + s), (int) (x0 + 2 * s), (int) (x0 + 3 * s));
+  __m128i dx = _mm_set1_epi32((int) (4 * s));
+  __m128i zero = _mm_setzero_si128();
+  __m128i sum = zero;
+  __m128i magnitude = zero;
+  __m128i bits = zero;
+
+  long long blocks = count / 4;
+
+  for (long long b = 0; b < blocks; b++) {
+    __m128i p = c[REDUCE_MAX_DEGREE];
+    for (int d = REDUCE_MAX_DEGREE - 1; d >= 0; d--)
+      p = _mm_add_epi32(mullo_sse2(p, x), c[d]);
+
+    //
+    // widen to 64 bits: with its sign for the sum, with zeros for
+    // the magnitude:
+    //
+    __m128i sign = _mm_srai_epi32(p, 31);
+    __m128i abs = _mm_sub_epi32(_mm_xor_si128(p, sign), sign);
+
+    sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(p, sign));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(p, sign));
+    magnitude = _mm_add_epi64(magnitude, _mm_unpacklo_epi32(abs, zero));
+    magnitude = _mm_add_epi64(magnitude, _mm_unpackhi_epi32(abs, zero));
+    bits = _mm_or_si128(bits, abs);
+
+    x = _mm_add_epi32(x, dx);
+  }
+
+  unsigned long long sums[2];
+  unsigned long long magnitudes[2];
+  unsigned int ors[4];
+  _mm_storeu_si128((__m128i*) sums, sum);
+  _mm_storeu_si128((__m128i*) magnitudes, magnitude);
+  _mm_storeu_si128((__m128i*) ors, bits);
+
+  result->sum = (long long) ((unsigned long long) result->sum + sums[0] + sums[1]);
+  result->magnitude += magnitudes[0] + magnitudes[1];
+  result->bits |= ors[0] | ors[1] | ors[2] | ors[3];
+
+  unsigned int rest = x0 + (unsigned int) (4 * blocks) * s;
+  poly_scalar(coeffs, (int) rest, step, count - 4 * blocks, result);
+}
+
+__attribute__((target("avx2")))
+static void poly_avx2(const int coeffs[], int start, int step, long long count, struct REDUCE_SUM* result)
+{
+  __m256i c[REDUCE_MAX_DEGREE + 1];
+  for (int d = 0; d <= REDUCE_MAX_DEGREE; d++)
+    c[d] = _mm256_set1_epi32(coeffs[d]);
+
+  unsigned int s = (unsigned int) step;
+  unsigned int x0 = (unsigned int) start;
+  __m256i x = _mm256_setr_epi32((int) x0, (int) (x0 + s), (int) (x0 + 2 * s), (int) (x0 + 3 * s),
+                                (int) (x0 + 4 * s), (int) (x0 + 5 * s), (int) (x0 + 6 * s), (int) (x0 + 7 * s));
+  __m256i dx = _mm256_set1_epi32((int) (8 * s));
+  __m256i zero = _mm256_setzero_si256();
+  __m256i sum = zero;
+  __m256i magnitude = zero;
+  __m256i bits = zero;
+
+  long long blocks = count / 8;
+
+  for (long long b = 0; b < blocks; b++) {
+    __m256i p = c[REDUCE_MAX_DEGREE];
+    for (int d = REDUCE_MAX_DEGREE - 1; d >= 0; d--)
+      p = _mm256_add_epi32(_mm256_mullo_epi32(p, x), c[d]);
+
+    __m256i sign = _mm256_srai_epi32(p, 31);
+    __m256i abs = _mm256_abs_epi32(p); // INT_MIN stays 0x80000000, 2^31 unsigned
+
+    sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(p, sign));
+    sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(p, sign));
+    magnitude = _mm256_add_epi64(magnitude, _mm256_unpacklo_epi32(abs, zero));
+    magnitude = _mm256_add_epi64(magnitude, _mm256_unpackhi_epi32(abs, zero));
+    bits = _mm256_or_si256(bits, abs);
+
+    x = _mm256_add_epi32(x, dx);
+  }
+
+  unsigned long long sums[4];
+  unsigned long long magnitudes[4];
+  unsigned int ors[8];
+  _mm256_storeu_si256((__m256i*) sums, sum);
+  _mm256_storeu_si256((__m256i*) magnitudes, magnitude);
+  _mm256_storeu_si256((__m256i*) ors, bits);
+
+  result->sum = (long long) ((unsigned long long) result->sum + sums[0] + sums[1] + sums[2] + sums[3]);
+  result->magnitude += magnitudes[0] + magnitudes[1] + magnitudes[2] + magnitudes[3];
+  for (int lane = 0; lane < 8; lane++)
+    result->bits |= ors[lane];
+
+  unsigned int rest = x0 + (unsigned int) (8 * blocks) * s;
+  poly_scalar(coeffs, (int) rest, step, count - 8 * blocks, result);
+}
+
+__attribute__((target("sse2")))
+static __m128i mullo_sse2(__m128i a, __m128i b)
+{
+  __m128i even = _mm_mul_epu32(a, b);                                      // lanes 0, 2
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)); // lanes 1, 3
+
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
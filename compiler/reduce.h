@@ -0,0 +1,85 @@
+/*reduce.h*/
+
+//
+// Vectorized kernels for the reduction loops the optimizer finds
+// (see OPT_REDUCTION in optimize.h): the sum of a polynomial in an
+// int loop variable over a run of its values, computed with SSE2 or
+// AVX2 when the CPU has them.
+
+
+#pragma once
+
+
+//
+// Highest power of the loop variable a reduction's term may have:
+//
+#define REDUCE_MAX_DEGREE 3
+
+//
+// Largest value every partial sum of a real reduction may reach
+// for the sum to be exact in any order, 2^53:
+//
+#define REDUCE_EXACT 9007199254740992.0
+
+//
+// Ints below this convert to a float exactly, 2^24:
+//
+#define REDUCE_EXACT_FLOAT (1u << 24)
+
+//
+// The kernels, best last:
+//
+enum REDUCE_KERNELS
+{
+  REDUCE_SCALAR = 0,
+  REDUCE_SSE2,
+  REDUCE_AVX2
+};
+
+//
+// Result of reduce_poly():
+//
+struct REDUCE_SUM
+{
+  long long sum;                 // sum of the terms, exact
+  unsigned long long magnitude;  // sum of their absolute values
+  unsigned int bits;             // their absolute values or'ed together
+};
+
+
+//
+// Public functions:
+//
+
+//
+// reduce_kernel
+//
+// Returns the kernel reduce_poly() runs on this CPU, see enum
+// REDUCE_KERNELS.
+//
+int reduce_kernel(void);
+
+//
+// reduce_kernel_name
+//
+// Returns the name of the given kernel, e.g. "avx2".
+//
+const char* reduce_kernel_name(int kernel);
+
+//
+// reduce_poly_at
+//
+// Returns p(x) = coeffs[0] + coeffs[1]*x + ... + coeffs[3]*x^3,
+// evaluated with int arithmetic that wraps around, as execute()
+// evaluates int expressions.
+//
+int reduce_poly_at(const int coeffs[REDUCE_MAX_DEGREE + 1], int x);
+
+//
+// reduce_poly
+//
+// Sums reduce_poly_at(coeffs, x) for the count values x = start,
+// start + step, start + 2*step, ... into *result. The caller makes
+// sure none of these x passes INT_MAX.
+//
+void reduce_poly(const int coeffs[REDUCE_MAX_DEGREE + 1], int start, int step, long long count, struct REDUCE_SUM* result);
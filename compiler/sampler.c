@@ -0,0 +1,447 @@
+/*sampler.c*/
+
+//
+// Sampling profiler for nuPython programs. A timer on the process's
+// CPU clock raises SIGPROF, whose handler reads execute_current and
+// pushes the statement's line and type onto a ring buffer without
+// taking a lock: the handler is the only writer of head, the
+// collecting thread the only writer of tail. The collecting thread
+// wakes every SAMPLER_DRAIN_MS to move the ring into a histogram,
+// and on SIGUSR1 also writes the histogram out.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <signal.h>  // sigaction, sigtimedwait, SIGPROF
+#include <time.h>    // timer_create
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "programgraph.h"
+#include "execute.h"   // execute_current
+#include "optimize.h"  // STMT_SWITCH, STMT_FUSED, STMT_COUNTED
+#include "sampler.h"
+
+
+//
+// Samples the ring holds, a power of 2; at the default rate that is
+// 16 seconds of samples, far more than arrive between drains:
+//
+#define SAMPLER_RING_SIZE 16384
+#define SAMPLER_DRAIN_MS 100
+
+struct SAMPLE
+{
+  int line;
+  int type;   // enum STMT_TYPES, or STMT_SWITCH etc.
+};
+
+//
+// One line of the histogram; samples == 0 => an empty slot:
+//
+struct SAMPLER_COUNT
+{
+  int line;
+  int type;
+  long long samples;
+};
+
+struct SAMPLER
+{
+  char* path;
+  int hz;
+  double start;                 // CPU seconds when sampling began
+  timer_t timer;
+  struct sigaction old_action;  // SIGPROF's, put back when stopping
+  pthread_t collector;
+  atomic_bool stopping;
+
+  struct SAMPLE ring[SAMPLER_RING_SIZE];
+  atomic_ulong head;            // next sample to write, by the handler
+  atomic_ulong tail;            // next sample to read, by the collector
+  atomic_ulong dropped;         // ring full or out of memory
+
+  struct SAMPLER_COUNT* counts; // hash table on (line, type)
+  int counts_size;              // a power of 2
+  int num_counts;
+  long long total;
+};
+
+//
+// The sampler the signal handler writes to, NULL if none:
+//
+static struct SAMPLER* volatile Running = NULL;
+
+
+//
+// Private functions:
+//
+
+//The SIGPROF handler: records the statement being executed
+static void on_sample(int sig);
+
+//The collecting thread: drains the ring until the sampler stops,
+// writing the histogram on SIGUSR1
+static void* collect(void* arg);
+
+//Moves the samples in the ring into the histogram
+static void drain(struct SAMPLER* sampler);
+
+//Adds one sample to the histogram; returns false if out of memory
+static bool add_count(struct SAMPLER* sampler, struct SAMPLE sample);
+
+//Writes the histogram to the sampler's file, replacing it only
+// once complete; returns true if written
+static bool write_histogram(struct SAMPLER* sampler);
+
+//Orders counts by samples, most first, then by line
+static int compare_counts(const void* a, const void* b);
+
+//Returns the name of the given statement type
+static const char* type_name(int type);
+
+//Returns the CPU time the process has used, in seconds
+static double cpu_seconds(void);
+
+
+//
+// Public functions:
+//
+
+//
+// sampler_start
+//
+// Starts the timer and the collecting thread.
+//
+struct SAMPLER* sampler_start(const char* path, int hz)
+{
+  if (Running != NULL || hz <= 0)
+    return NULL;
+
+  struct SAMPLER* sampler = (struct SAMPLER*) calloc(1, sizeof(struct SAMPLER));
+  if (sampler == NULL)
+    return NULL;
+
+  sampler->path = (char*) malloc(strlen(path) + 1);
+  sampler->counts_size = 256;
+  sampler->counts = (struct SAMPLER_COUNT*) calloc(sampler->counts_size, sizeof(struct SAMPLER_COUNT));
+  if (sampler->path == NULL || sampler->counts == NULL) {
+    free(sampler->path);
+    free(sampler->counts);
+    free(sampler);
+    return NULL;
+  }
+  strcpy(sampler->path, path);
+  sampler->hz = hz;
+  sampler->start = cpu_seconds();
+  atomic_init(&sampler->stopping, false);
+  atomic_init(&sampler->head, 0);
+  atomic_init(&sampler->tail, 0);
+  atomic_init(&sampler->dropped, 0);
+
+  //
+  // the collector is started with SIGPROF and SIGUSR1 blocked, so
+  // samples always interrupt this thread and SIGUSR1 only wakes the
+  // collector; SIGUSR1 stays blocked here even after stopping, a
+  // late one stays pending rather than killing the process:
+  //
+  sigset_t both;
+  sigemptyset(&both);
+  sigaddset(&both, SIGPROF);
+  sigaddset(&both, SIGUSR1);
+
+  sigset_t profiling;
+  sigemptyset(&profiling);
+  sigaddset(&profiling, SIGPROF);
+
+  pthread_sigmask(SIG_BLOCK, &both, NULL);
+  int started = pthread_create(&sampler->collector, NULL, collect, sampler);
+  pthread_sigmask(SIG_UNBLOCK, &profiling, NULL);
+
+  if (started != 0) {
+    free(sampler->path);
+    free(sampler->counts);
+    free(sampler);
+    return NULL;
+  }
+
+  Running = sampler;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_sample;
+  action.sa_flags = SA_RESTART;  // input() shouldn't see EINTR
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, &sampler->old_action);
+
+  struct sigevent event;
+  memset(&event, 0, sizeof(event));
+  event.sigev_notify = SIGEV_SIGNAL;
+  event.sigev_signo = SIGPROF;
+
+  long interval = 1000000000L / hz;
+  struct itimerspec period;
+  period.it_interval.tv_sec = interval / 1000000000L;
+  period.it_interval.tv_nsec = interval % 1000000000L;
+  period.it_value = period.it_interval;
+
+  if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &sampler->timer) != 0) {
+    sigaction(SIGPROF, &sampler->old_action, NULL);
+    Running = NULL;
+
+    atomic_store(&sampler->stopping, true);
+    pthread_kill(sampler->collector, SIGUSR1);
+    pthread_join(sampler->collector, NULL);
+
+    free(sampler->path);
+    free(sampler->counts);
+    free(sampler);
+    return NULL;
+  }
+  timer_settime(sampler->timer, 0, &period, NULL);
+
+  return sampler;
+}
+
+//
+// sampler_stop
+//
+// Stops sampling, writes the histogram and frees the sampler.
+//
+bool sampler_stop(struct SAMPLER* sampler)
+{
+  if (sampler == NULL)
+    return false;
+
+  if (Running == sampler) {
+    timer_delete(sampler->timer);
+
+    //
+    // ignoring SIGPROF discards one still pending, before the old
+    // handler (usually the default, which would kill us) is back:
+    //
+    struct sigaction ignore;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPROF, &ignore, NULL);
+    sigaction(SIGPROF, &sampler->old_action, NULL);
+
+    Running = NULL;
+  }
+
+  atomic_store(&sampler->stopping, true);
+  pthread_kill(sampler->collector, SIGUSR1);
+  pthread_join(sampler->collector, NULL);
+
+  drain(sampler);
+  bool written = write_histogram(sampler);
+
+  free(sampler->path);
+  free(sampler->counts);
+  free(sampler);
+
+  return written;
+}
+
+
+//
+// Private functions:
+//
+
+static void on_sample(int sig)
+{
+  struct SAMPLER* sampler = Running;
+  struct STMT* stmt = execute_current;
+
+  if (sampler == NULL || stmt == NULL)
+    return;  // not executing yet
+
+  unsigned long head = atomic_load_explicit(&sampler->head, memory_order_relaxed);
+  unsigned long tail = atomic_load_explicit(&sampler->tail, memory_order_acquire);
+
+  if (head - tail == SAMPLER_RING_SIZE) {
+    atomic_fetch_add_explicit(&sampler->dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  sampler->ring[head & (SAMPLER_RING_SIZE - 1)].line = stmt->line;
+  sampler->ring[head & (SAMPLER_RING_SIZE - 1)].type = stmt->stmt_type;
+  atomic_store_explicit(&sampler->head, head + 1, memory_order_release);
+}
+
+static void* collect(void* arg)
+{
+  struct SAMPLER* sampler = (struct SAMPLER*) arg;
+
+  sigset_t wake;
+  sigemptyset(&wake);
+  sigaddset(&wake, SIGUSR1);
+
+  struct timespec period;
+  period.tv_sec = 0;
+  period.tv_nsec = SAMPLER_DRAIN_MS * 1000000L;
+
+  while (!atomic_load(&sampler->stopping)) {
+    int sig = sigtimedwait(&wake, NULL, &period);
+
+    drain(sampler);
+
+    if (sig == SIGUSR1 && !atomic_load(&sampler->stopping)) {
+      if (!write_histogram(sampler))
+        fprintf(stderr, "**ERROR: unable to write samples to '%s'.\n", sampler->path);
+    }
+  }
+
+  return NULL;
+}
+
+static void drain(struct SAMPLER* sampler)
+{
+  unsigned long tail = atomic_load_explicit(&sampler->tail, memory_order_relaxed);
+  unsigned long head = atomic_load_explicit(&sampler->head, memory_order_acquire);
+
+  for (; tail != head; tail++) {
+    if (!add_count(sampler, sampler->ring[tail & (SAMPLER_RING_SIZE - 1)]))
+      atomic_fetch_add_explicit(&sampler->dropped, 1, memory_order_relaxed);
+  }
+
+  atomic_store_explicit(&sampler->tail, tail, memory_order_release);
+}
+
+static bool add_count(struct SAMPLER* sampler, struct SAMPLE sample)
+{
+  //
+  // grow at half full, rehashing what's there:
+  //
+  if (2 * (sampler->num_counts + 1) > sampler->counts_size) {
+    int size = 2 * sampler->counts_size;
+    struct SAMPLER_COUNT* counts = (struct SAMPLER_COUNT*) calloc(size, sizeof(struct SAMPLER_COUNT));
+    if (counts == NULL)
+      return false;
+
+    for (int i = 0; i < sampler->counts_size; i++) {
+      struct SAMPLER_COUNT* count = &sampler->counts[i];
+      if (count->samples == 0)
+        continue;
+
+      unsigned int slot = ((unsigned int) count->line * 31u + (unsigned int) count->type) & (size - 1);
+      while (counts[slot].samples != 0)
+        slot = (slot + 1) & (size - 1);
+      counts[slot] = *count;
+    }
+
+    free(sampler->counts);
+    sampler->counts = counts;
+    sampler->counts_size = size;
+  }
+
+  int mask = sampler->counts_size - 1;
+  unsigned int slot = ((unsigned int) sample.line * 31u + (unsigned int) sample.type) & mask;
+
+  while (sampler->counts[slot].samples != 0 &&
+         (sampler->counts[slot].line != sample.line || sampler->counts[slot].type != sample.type))
+    slot = (slot + 1) & mask;
+
+  if (sampler->counts[slot].samples == 0) {
+    sampler->counts[slot].line = sample.line;
+    sampler->counts[slot].type = sample.type;
+    sampler->num_counts++;
+  }
+  sampler->counts[slot].samples++;
+  sampler->total++;
+
+  return true;
+}
+
+static bool write_histogram(struct SAMPLER* sampler)
+{
+  struct SAMPLER_COUNT* sorted = (struct SAMPLER_COUNT*) malloc((sampler->num_counts + 1) * sizeof(struct SAMPLER_COUNT));
+  if (sorted == NULL)
+    return false;
+
+  int n = 0;
+  for (int i = 0; i < sampler->counts_size; i++) {
+    if (sampler->counts[i].samples != 0)
+      sorted[n++] = sampler->counts[i];
+  }
+  qsort(sorted, n, sizeof(struct SAMPLER_COUNT), compare_counts);
+
+  char* temp = (char*) malloc(strlen(sampler->path) + 5);
+  if (temp == NULL) {
+    free(sorted);
+    return false;
+  }
+  strcpy(temp, sampler->path);
+  strcat(temp, ".tmp");
+
+  FILE* out = fopen(temp, "w");
+  bool written = (out != NULL);
+
+  if (out != NULL) {
+    //
+    // the kernel may deliver fewer samples than asked for, at most
+    // one per scheduler tick, so the CPU time they cover is given:
+    //
+    fprintf(out, "# nuPython samples: %lld over %.3f s of CPU time (%d Hz asked), %lu dropped\n",
+            sampler->total, cpu_seconds() - sampler->start, sampler->hz, atomic_load(&sampler->dropped));
+    fprintf(out, "# samples  percent   line  statement\n");
+
+    for (int i = 0; i < n; i++) {
+      fprintf(out, "%9lld  %6.2f%%  %5d  %s\n", sorted[i].samples,
+              100.0 * (double) sorted[i].samples / (double) sampler->total,
+              sorted[i].line, type_name(sorted[i].type));
+    }
+
+    if (fclose(out) != 0)
+      written = false;
+  }
+
+  if (written && rename(temp, sampler->path) != 0)
+    written = false;
+
+  if (!written)
+    remove(temp);
+
+  free(temp);
+  free(sorted);
+  return written;
+}
+
+static int compare_counts(const void* a, const void* b)
+{
+  const struct SAMPLER_COUNT* x = (const struct SAMPLER_COUNT*) a;
+  const struct SAMPLER_COUNT* y = (const struct SAMPLER_COUNT*) b;
+
+  if (x->samples != y->samples)
+    return (x->samples > y->samples) ? -1 : 1;
+  if (x->line != y->line)
+    return (x->line < y->line) ? -1 : 1;
+  return x->type - y->type;
+}
+
+static const char* type_name(int type)
+{
+  switch (type) {
+    case STMT_ASSIGNMENT:    return "assignment";
+    case STMT_FUNCTION_CALL: return "call";
+    case STMT_IF_THEN_ELSE:  return "if";
+    case STMT_WHILE_LOOP:    return "while";
+    case STMT_PASS:          return "pass";
+    case STMT_SWITCH:        return "switch";
+    case STMT_FUSED:         return "fused";
+    case STMT_COUNTED:       return "counted loop";
+    default:                 return "?";
+  }
+}
+
+static double cpu_seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
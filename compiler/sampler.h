@@ -0,0 +1,49 @@
+/*sampler.h*/
+
+//
+// Sampling profiler for long-running nuPython programs: a CPU-time
+// timer interrupts execution a few hundred times a second and the
+// statement being executed (see execute_current in execute.h) is
+// counted, so the program runs at nearly full speed, unlike under
+// the per-statement profiler in profile.h.
+
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+//
+// Samples per second of CPU time when none is given, a prime so
+// sampling doesn't fall into step with the program's loops:
+//
+#define SAMPLER_DEFAULT_HZ 997
+
+struct SAMPLER;
+
+
+//
+// Public functions:
+//
+
+//
+// sampler_start
+//
+// Starts sampling the calling thread, which must be the one that
+// executes the program, hz times per second of CPU time, and
+// starts a thread that collects the samples. Sending the process
+// SIGUSR1 writes the samples so far to the file at path. Only one
+// sampler can run at a time. Returns NULL if the timer or the
+// thread can't be started.
+//
+struct SAMPLER* sampler_start(const char* path, int hz);
+
+//
+// sampler_stop
+//
+// Stops the timer and the collecting thread and writes the final
+// histogram to the file given to sampler_start(): one line per
+// source line and statement type, most samples first. Returns
+// true if it was written. Frees the sampler.
+//
+bool sampler_stop(struct SAMPLER* sampler);
@@ -0,0 +1,233 @@
+/*source.c*/
+
+//
+// nuPython source files in memory. parser_parse_buffer() hands the
+// prebuilt parser a stream opened on the buffer, and makes it the
+// calling thread's buffer stream; the __wrap_fgetc and
+// __wrap_ungetc below, which the linker substitutes for fgetc and
+// ungetc when asked to, read that stream from the buffer directly,
+// one array access per character rather than a call into stdio.
+// Other streams go on to the C library's fgetc and ungetc.
+//
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <fcntl.h>    // open
+#include <unistd.h>   // read, close
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+
+#include "parser.h"
+#include "source.h"
+
+
+//
+// The buffer being parsed by this thread, if any:
+//
+struct SOURCE_BUFFER
+{
+  FILE*                stream;  // NULL => none
+  const unsigned char* text;
+  size_t               length;
+  size_t               pos;
+  int                  pushed;  // a character put back that doesn't
+                                // match the text, else EOF
+};
+
+static _Thread_local struct SOURCE_BUFFER Buffer = { NULL, NULL, 0, 0, EOF };
+
+//
+// The C library's fgetc and ungetc when --wrap is used, else NULL:
+//
+extern int __real_fgetc(FILE* stream) __attribute__((weak));
+extern int __real_ungetc(int c, FILE* stream) __attribute__((weak));
+
+int __wrap_fgetc(FILE* stream);
+int __wrap_ungetc(int c, FILE* stream);
+
+
+//
+// Private functions:
+//
+
+//Reads all of fd into a malloc'ed block, storing its length in
+// *length; returns NULL if out of memory or unreadable
+static char* read_fully(int fd, size_t* length);
+
+
+//
+// Public functions:
+//
+
+//
+// source_open
+//
+// Maps the file if it is a regular one, else reads it in.
+//
+struct SOURCE* source_open(const char* filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct SOURCE* source = (struct SOURCE*) calloc(1, sizeof(struct SOURCE));
+  if (source == NULL) {
+    close(fd);
+    return NULL;
+  }
+
+  struct stat info;
+  bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+
+  if (regular && info.st_size > 0) {
+    void* p = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      posix_madvise(p, (size_t) info.st_size, POSIX_MADV_SEQUENTIAL);
+      source->map = p;
+      source->text = (const char*) p;
+      source->length = (size_t) info.st_size;
+    }
+  }
+
+  if (source->map == NULL && !(regular && info.st_size == 0)) {
+    source->copy = read_fully(fd, &source->length);
+    if (source->copy == NULL) {
+      close(fd);
+      free(source);
+      return NULL;
+    }
+    source->text = source->copy;
+  }
+
+  if (source->text == NULL)
+    source->text = "";  // empty
+
+  close(fd);  // the mapping stays valid
+  return source;
+}
+
+//
+// source_close
+//
+// Unmaps or frees the source.
+//
+void source_close(struct SOURCE* source)
+{
+  if (source == NULL)
+    return;
+
+  if (source->map != NULL)
+    munmap(source->map, source->length);
+  free(source->copy);
+  free(source);
+}
+
+//
+// parser_parse_buffer
+//
+// Parses the program in src.
+//
+struct TokenQueue* parser_parse_buffer(const char* src, size_t len)
+{
+  //
+  // fmemopen() wants at least one byte to point at, even for an
+  // empty program:
+  //
+  FILE* stream = fmemopen((void*) ((len > 0) ? src : ""), len, "r");
+  if (stream == NULL) {
+    printf("**OUT OF MEMORY (parser_parse_buffer)\n");
+    return NULL;
+  }
+
+  Buffer.stream = stream;
+  Buffer.text = (const unsigned char*) src;
+  Buffer.length = len;
+  Buffer.pos = 0;
+  Buffer.pushed = EOF;
+
+  struct TokenQueue* tokens = parser_parse(stream);
+
+  Buffer.stream = NULL;
+  fclose(stream);
+
+  return tokens;
+}
+
+
+//
+// The replacements for fgetc and ungetc:
+//
+
+int __wrap_fgetc(FILE* stream)
+{
+  if (stream != NULL && stream == Buffer.stream) {
+    if (Buffer.pushed != EOF) {
+      int c = Buffer.pushed;
+      Buffer.pushed = EOF;
+      return c;
+    }
+    return (Buffer.pos < Buffer.length) ? Buffer.text[Buffer.pos++] : EOF;
+  }
+
+  return (__real_fgetc != NULL) ? __real_fgetc(stream) : fgetc(stream);
+}
+
+int __wrap_ungetc(int c, FILE* stream)
+{
+  if (stream != NULL && stream == Buffer.stream) {
+    if (c == EOF || Buffer.pushed != EOF)
+      return EOF;
+
+    //
+    // putting back what was just read is the usual case, and just
+    // steps back:
+    //
+    if (Buffer.pos > 0 && Buffer.text[Buffer.pos - 1] == (unsigned char) c)
+      Buffer.pos--;
+    else
+      Buffer.pushed = (unsigned char) c;
+    return (unsigned char) c;
+  }
+
+  return (__real_ungetc != NULL) ? __real_ungetc(c, stream) : ungetc(c, stream);
+}
+
+
+//
+// Private functions:
+//
+
+static char* read_fully(int fd, size_t* length)
+{
+  size_t capacity = 1 << 16;
+  size_t total = 0;
+  char* text = (char*) malloc(capacity);
+
+  while (text != NULL) {
+    if (total == capacity) {
+      char* bigger = (char*) realloc(text, capacity * 2);
+      if (bigger == NULL) {
+        free(text);
+        return NULL;
+      }
+      text = bigger;
+      capacity *= 2;
+    }
+
+    ssize_t n = read(fd, text + total, capacity - total);
+    if (n < 0) {
+      free(text);
+      return NULL;
+    }
+    if (n == 0)
+      break;
+    total += (size_t) n;
+  }
+
+  *length = total;
+  return text;
+}
@@ -0,0 +1,62 @@
+/*source.h*/
+
+//
+// nuPython source files held in memory, mapped when possible, and
+// parsed from there.
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "tokenqueue.h"
+
+
+//
+// A source file's contents; text is not '\0'-terminated:
+//
+struct SOURCE
+{
+  const char* text;
+  size_t      length;
+
+  void*       map;     // the mapping, NULL if none
+  char*       copy;    // else the contents read, NULL if empty
+};
+
+
+//
+// Public functions:
+//
+
+//
+// source_open
+//
+// Maps the given file into memory, or reads it in if it can't
+// be mapped (e.g. a pipe). Returns NULL if the file can't be
+// opened or read.
+//
+struct SOURCE* source_open(const char* filename);
+
+//
+// source_close
+//
+// Unmaps or frees the source; its text can no longer be used.
+//
+void source_close(struct SOURCE* source);
+
+//
+// parser_parse_buffer
+//
+// parser_parse() on a program in memory: src holds len bytes of
+// source, not necessarily '\0'-terminated. Returns the tokens, or
+// NULL if a syntax error was found, as parser_parse() does.
+//
+// NOTE: the scanner is prebuilt and reads through fgetc() and
+// ungetc(). When the program is linked with
+// -Wl,--wrap=fgetc,--wrap=ungetc (see the makefile), those calls
+// are answered straight from src; otherwise they read a stream
+// opened on src with fmemopen(), which is slower but the same.
+//
+struct TokenQueue* parser_parse_buffer(const char* src, size_t len);
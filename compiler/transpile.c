@@ -0,0 +1,1039 @@
+/*transpile.c*/
+
+//
+// Translates a nuPython program graph into C. Statements are laid
+// out in program order, each under a label, and control flow
+// becomes gotos, so any graph translates the same way. Operators,
+// input(), int() and float() call back into execute.c, and memory
+// is the usual RAM, so the generated program behaves exactly like
+// execute() does, down to the error messages.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdint.h>   // uintptr_t
+#include <limits.h>   // INT_MAX, INT_MIN
+#include <math.h>     // isinf
+
+#include "programgraph.h"
+#include "transpile.h"
+
+
+//
+// What we know about each variable in the program:
+//
+struct TP_VAR
+{
+  char* name;
+  int   first_def;   // position of the first assignment, -1 if none
+  int   first_use;   // position of the first read, INT_MAX if none
+  bool  by_name;     // read by name from memory, e.g. by int()
+  bool  typed;       // true => always an int, kept in a C local
+};
+
+//
+// Statement to position lookup, open addressing:
+//
+struct TP_SLOT
+{
+  struct STMT* stmt;
+  int          pos;
+};
+
+struct TRANSPILER
+{
+  FILE* out;
+
+  struct STMT** order;     // statements in the order they are emitted
+  bool* on_chain;          // executed exactly once, outside any loop
+  bool* targeted;          // reached by a goto, so needs a label
+  int   num_stmts;
+  int   stmts_capacity;
+
+  struct TP_SLOT* slots;
+  int   slots_capacity;    // power of 2
+
+  struct TP_VAR* vars;
+  int   num_vars;
+  int   vars_capacity;
+
+  bool  has_if;
+  bool  failed_used;       // some statement jumps to failed:
+  bool  completed_used;    // some statement jumps to completed:
+  bool  out_of_memory;
+};
+
+
+//
+// Helper functions copied into every generated program:
+//
+static const char* Prelude[] = {
+  "//",
+  "// Finds the named variable's memory cell the first time, then uses",
+  "// the address saved in *addr.",
+  "//",
+  "static bool load(struct RAM* memory, int* addr, char* name, int line, struct RAM_VALUE* value)",
+  "{",
+  "  if (*addr < 0) {",
+  "    *addr = ram_get_addr(memory, name);",
+  "    if (*addr < 0) {",
+  "      output_printf(output_current(), \"**SEMANTIC ERROR: name '%s' is not defined (line %d)\\n\", name, line);",
+  "      return false;",
+  "    }",
+  "  }",
+  "  *value = *ram_peek_cell_by_addr(memory, *addr);",
+  "  return true;",
+  "}",
+  "",
+  "static void store(struct RAM* memory, int* addr, char* name, struct RAM_VALUE value)",
+  "{",
+  "  if (*addr < 0) {",
+  "    ram_write_cell_by_name(memory, value, name);",
+  "    *addr = ram_get_addr(memory, name);",
+  "  }",
+  "  else {",
+  "    ram_write_cell_by_addr(memory, value, *addr);",
+  "  }",
+  "}",
+  "",
+  "static void store_int(struct RAM* memory, int* addr, char* name, int i)",
+  "{",
+  "  struct RAM_VALUE value;",
+  "  value.value_type = RAM_TYPE_INT;",
+  "  value.types.i = i;",
+  "  store(memory, addr, name, value);",
+  "}",
+  "",
+  "static bool print_var(struct RAM* memory, int* addr, char* name, int line, struct OUTPUT* out)",
+  "{",
+  "  struct RAM_VALUE value;",
+  "  if (!load(memory, addr, name, line, &value))",
+  "    return false;",
+  "",
+  "  if (value.value_type == RAM_TYPE_INT) {",
+  "    output_int(out, value.types.i);",
+  "    output_write(out, \"\\n\", 1);",
+  "  }",
+  "  else if (value.value_type == RAM_TYPE_REAL) {",
+  "    output_real(out, value.types.d);",
+  "    output_write(out, \"\\n\", 1);",
+  "  }",
+  "  else if (value.value_type == RAM_TYPE_STR) {",
+  "    output_puts(out, value.types.s);",
+  "  }",
+  "  else if (value.value_type == RAM_TYPE_BOOLEAN) {",
+  "    output_puts(out, value.types.i ? \"True\" : \"False\");",
+  "  }",
+  "  return true;",
+  "}",
+  NULL
+};
+
+static const char* Main[] = {
+  "int main(int argc, char* argv[])",
+  "{",
+  "  input_use_blocks();",
+  "",
+  "  for (int i = 1; i < argc; i++) {",
+  "    if (strncmp(argv[i], \"--flush=\", 8) == 0 && output_parse_policy(argv[i] + 8) >= 0)",
+  "      output_set_policy(output_current(), output_parse_policy(argv[i] + 8));",
+  "    else if (strcmp(argv[i], \"--repr\") == 0)",
+  "      output_current()->repr = true;",
+  "    else if (strcmp(argv[i], \"--input-file\") == 0 && i + 1 < argc && !input_use_file(argv[++i])) {",
+  "      printf(\"**ERROR: unable to open input file '%s' for input().\\n\", argv[i]);",
+  "      return 0;",
+  "    }",
+  "  }",
+  "",
+  "  printf(\"**parsing successful, valid syntax\\n\");",
+  "  printf(\"**building program graph...\\n\");",
+  "  printf(\"**executing...\\n\");",
+  "  fflush(stdout);",
+  "",
+  "  struct RAM* memory = ram_init();",
+  "",
+  "  run(memory);",
+  "",
+  "  output_flush(output_current());",
+  "",
+  "  printf(\"**done\\n\");",
+  "  fflush(stdout);",
+  "",
+  "  ram_print(memory);",
+  "  ram_destroy(memory);",
+  "  input_close();",
+  "",
+  "  return 0;",
+  "}",
+  NULL
+};
+
+//
+// C names of the operators, for the generated code:
+//
+static const char* OperatorNames[] = {
+  "OPERATOR_PLUS", "OPERATOR_MINUS", "OPERATOR_ASTERISK", "OPERATOR_POWER",
+  "OPERATOR_MOD", "OPERATOR_DIV", "OPERATOR_EQUAL", "OPERATOR_NOT_EQUAL",
+  "OPERATOR_LT", "OPERATOR_LTE", "OPERATOR_GT", "OPERATOR_GTE",
+  "OPERATOR_IS", "OPERATOR_IN", "OPERATOR_NO_OP"
+};
+
+//
+// C operators for int operands, NULL where there isn't one:
+//
+static const char* IntOperators[] = {
+  "+", "-", "*", NULL, "%", "/", "==", "!=", "<", "<=", ">", ">=", NULL, NULL, NULL
+};
+
+
+//
+// Private functions:
+//
+
+//Returns the statement that follows stmt; for a while loop this
+// is the statement after the loop
+static struct STMT* stmt_next(struct STMT* stmt);
+
+//Puts the statements from stmt on into emission order, loop
+// bodies right after their loop
+static void order_chain(struct TRANSPILER* t, struct STMT* stmt, bool on_chain);
+
+//Returns the position of stmt in emission order, -1 if none
+static int stmt_pos(struct TRANSPILER* t, struct STMT* stmt);
+
+//Records where every variable is assigned and read, and decides
+// which variables can be C ints
+static void analyze_vars(struct TRANSPILER* t);
+
+//Returns the index of the named variable, adding it if need be
+static int var_index(struct TRANSPILER* t, char* name);
+
+//Notes a read of element at the given position
+static void note_use(struct TRANSPILER* t, struct ELEMENT* element, int pos, bool by_name);
+
+//Returns true if the element is an int literal or typed variable
+static bool is_int_element(struct TRANSPILER* t, struct ELEMENT* element);
+
+//Returns true if the value is provably an int
+static bool is_int_value(struct TRANSPILER* t, struct VALUE* value);
+
+//Writes the C expression for an int element into buf
+static void int_operand(struct TRANSPILER* t, struct ELEMENT* element, char* buf);
+
+//Writes the C expression for an int binary expression into buf,
+// emitting the division by zero check first if needed
+static void int_binary(struct TRANSPILER* t, struct EXPR* expr, int line, char* buf);
+
+//Emits code setting the RAM_VALUE named dest to the element's value
+static void emit_load(struct TRANSPILER* t, struct ELEMENT* element, const char* dest, int line);
+
+//Emits code evaluating a binary expression into result
+static void emit_binary(struct TRANSPILER* t, struct EXPR* expr, int line);
+
+//Emits the code for the statement at the given position
+static void emit_stmt(struct TRANSPILER* t, int pos);
+static void emit_assignment(struct TRANSPILER* t, struct STMT* stmt, int pos);
+static void emit_print(struct TRANSPILER* t, struct STMT* stmt);
+static void emit_while(struct TRANSPILER* t, struct STMT* stmt, int pos);
+
+//Emits a jump from the statement at pos to next, unless next
+// comes right after it
+static void emit_goto(struct TRANSPILER* t, int pos, struct STMT* next);
+
+//Emits the given string as a C string literal
+static void emit_string(struct TRANSPILER* t, const char* s);
+
+//Emits the given real as a C double constant
+static void emit_real(struct TRANSPILER* t, double d);
+
+
+//
+// Public functions:
+//
+
+//
+// transpile_program
+//
+// Writes a C translation of the given program graph to out.
+// Returns true if successful.
+//
+bool transpile_program(struct STMT* program, FILE* out, const char* source_name)
+{
+  struct TRANSPILER t;
+  memset(&t, 0, sizeof(t));
+  t.out = out;
+
+  order_chain(&t, program, true);
+
+  t.targeted = (bool*) calloc(t.num_stmts + 1, sizeof(bool));
+  if (t.targeted == NULL)
+    t.out_of_memory = true;
+
+  if (!t.out_of_memory)
+    analyze_vars(&t);
+
+  if (t.out_of_memory) {
+    free(t.order);
+    free(t.on_chain);
+    free(t.targeted);
+    free(t.slots);
+    free(t.vars);
+    return false;
+  }
+
+  //
+  // which statements are jumped to?
+  //
+  for (int pos = 0; pos < t.num_stmts; pos++) {
+    struct STMT* stmt = t.order[pos];
+    struct STMT* successors[2] = { stmt_next(stmt), NULL };
+
+    if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      successors[1] = stmt->types.while_loop->loop_body;
+      if (successors[0] != NULL) // the test jumps out of the loop
+        t.targeted[stmt_pos(&t, successors[0])] = true;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      successors[0] = stmt->types.if_then_else->false_path;
+      successors[1] = stmt->types.if_then_else->true_path;
+      if (successors[0] != NULL)
+        t.targeted[stmt_pos(&t, successors[0])] = true;
+    }
+
+    for (int i = 0; i < 2; i++) {
+      if (successors[i] != NULL && stmt_pos(&t, successors[i]) != pos + 1)
+        t.targeted[stmt_pos(&t, successors[i])] = true;
+    }
+  }
+
+  //
+  // header and helpers:
+  //
+  fprintf(out, "/*generated by compiler_out --emit-c from %s*/\n\n", source_name);
+  fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n#include <stdbool.h>\n#include <string.h>\n#include <math.h>\n\n");
+  fprintf(out, "#include \"programgraph.h\"\n#include \"ram.h\"\n#include \"execute.h\"\n#include \"output.h\"\n#include \"input.h\"\n\n\n");
+
+  for (int i = 0; Prelude[i] != NULL; i++)
+    fprintf(out, "%s\n", Prelude[i]);
+  fprintf(out, "\n\n");
+
+  //
+  // arguments of input(), int() and float(), passed to execute_call():
+  //
+  for (int pos = 0; pos < t.num_stmts; pos++) {
+    struct STMT* stmt = t.order[pos];
+    if (stmt->stmt_type != STMT_ASSIGNMENT || stmt->types.assignment->rhs->value_type != VALUE_FUNCTION_CALL)
+      continue;
+
+    struct FUNCTION_CALL* call = stmt->types.assignment->rhs->types.function_call;
+
+    if (call->parameter != NULL) {
+      fprintf(out, "static struct ELEMENT arg%d = { %d, ", pos, call->parameter->element_type);
+      emit_string(&t, call->parameter->element_value);
+      fprintf(out, " };\n");
+    }
+    fprintf(out, "static struct FUNCTION_CALL call%d = { ", pos);
+    emit_string(&t, call->function_name);
+    if (call->parameter != NULL)
+      fprintf(out, ", &arg%d };\n", pos);
+    else
+      fprintf(out, ", NULL };\n");
+  }
+
+  //
+  // the program:
+  //
+  fprintf(out, "\n\nstatic void run(struct RAM* memory)\n{\n");
+  fprintf(out, "  struct OUTPUT* out = output_current();\n");
+  fprintf(out, "  struct RAM_VALUE lhs = { RAM_TYPE_NONE, { 0 } };\n");
+  fprintf(out, "  struct RAM_VALUE rhs = { RAM_TYPE_NONE, { 0 } };\n");
+  fprintf(out, "  struct RAM_VALUE result = { RAM_TYPE_NONE, { 0 } };\n\n");
+
+  for (int i = 0; i < t.num_vars; i++) {
+    fprintf(out, "  int addr%d = -1;  // %s\n", i, t.vars[i].name);
+    if (t.vars[i].typed)
+      fprintf(out, "  int v%d = 0;\n", i);
+  }
+  fprintf(out, "\n");
+
+  for (int pos = 0; pos < t.num_stmts; pos++)
+    emit_stmt(&t, pos);
+
+  if (t.failed_used) {
+    fprintf(out, "  goto completed;\n\nfailed:\n  output_sync(out);\n");
+    t.completed_used = true;
+  }
+  if (t.completed_used)
+    fprintf(out, "\ncompleted:\n");
+
+  //
+  // typed variables go back to memory for ram_print():
+  //
+  for (int i = 0; i < t.num_vars; i++) {
+    if (t.vars[i].typed)
+      fprintf(out, "  if (addr%d >= 0)\n    store_int(memory, &addr%d, NULL, v%d);\n", i, i, i);
+  }
+  fprintf(out, "  return;\n}\n\n\n");
+
+  for (int i = 0; Main[i] != NULL; i++)
+    fprintf(out, "%s\n", Main[i]);
+
+  free(t.order);
+  free(t.on_chain);
+  free(t.targeted);
+  free(t.slots);
+  free(t.vars);
+
+  return !ferror(out);
+}
+
+
+//
+// Private functions:
+//
+
+static struct STMT* stmt_next(struct STMT* stmt)
+{
+  if (stmt->stmt_type == STMT_ASSIGNMENT)
+    return stmt->types.assignment->next_stmt;
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+    return stmt->types.function_call->next_stmt;
+  else if (stmt->stmt_type == STMT_WHILE_LOOP)
+    return stmt->types.while_loop->next_stmt;
+  else if (stmt->stmt_type == STMT_PASS)
+    return stmt->types.pass->next_stmt;
+  else
+    return NULL;  // if-then-else, which has no single next stmt
+}
+
+static size_t hash_stmt(struct STMT* stmt, int capacity)
+{
+  uintptr_t h = (uintptr_t) stmt;
+  h ^= h >> 17;
+  h *= 0x9E3779B97F4A7C15ULL;
+  return (size_t) (h ^ (h >> 29)) & (size_t) (capacity - 1);
+}
+
+static void order_chain(struct TRANSPILER* t, struct STMT* stmt, bool on_chain)
+{
+  while (stmt != NULL && stmt_pos(t, stmt) < 0 && !t->out_of_memory) {
+    //
+    // make room, keeping the lookup table at most half full:
+    //
+    if (t->num_stmts == t->stmts_capacity) {
+      int capacity = (t->stmts_capacity == 0) ? 64 : 2 * t->stmts_capacity;
+      struct STMT** order = (struct STMT**) realloc(t->order, capacity * sizeof(struct STMT*));
+      bool* chain = (bool*) realloc(t->on_chain, capacity * sizeof(bool));
+      struct TP_SLOT* slots = (struct TP_SLOT*) calloc(2 * capacity, sizeof(struct TP_SLOT));
+
+      if (order != NULL)
+        t->order = order;
+      if (chain != NULL)
+        t->on_chain = chain;
+      if (order == NULL || chain == NULL || slots == NULL) {
+        free(slots);
+        t->out_of_memory = true;
+        return;
+      }
+
+      for (int i = 0; i < t->num_stmts; i++) {
+        size_t slot = hash_stmt(t->order[i], 2 * capacity);
+        while (slots[slot].stmt != NULL)
+          slot = (slot + 1) & (size_t) (2 * capacity - 1);
+        slots[slot].stmt = t->order[i];
+        slots[slot].pos = i;
+      }
+      free(t->slots);
+      t->slots = slots;
+      t->slots_capacity = 2 * capacity;
+      t->stmts_capacity = capacity;
+    }
+
+    int pos = t->num_stmts++;
+    t->order[pos] = stmt;
+    t->on_chain[pos] = on_chain;
+
+    size_t slot = hash_stmt(stmt, t->slots_capacity);
+    while (t->slots[slot].stmt != NULL)
+      slot = (slot + 1) & (size_t) (t->slots_capacity - 1);
+    t->slots[slot].stmt = stmt;
+    t->slots[slot].pos = pos;
+
+    if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      order_chain(t, stmt->types.while_loop->loop_body, false);
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      t->has_if = true;
+      order_chain(t, stmt->types.if_then_else->true_path, false);
+      stmt = stmt->types.if_then_else->false_path;
+      on_chain = false;
+    }
+    else {
+      stmt = stmt_next(stmt);
+    }
+  }
+}
+
+static int stmt_pos(struct TRANSPILER* t, struct STMT* stmt)
+{
+  if (t->slots_capacity == 0)
+    return -1;
+
+  size_t slot = hash_stmt(stmt, t->slots_capacity);
+  while (t->slots[slot].stmt != NULL) {
+    if (t->slots[slot].stmt == stmt)
+      return t->slots[slot].pos;
+    slot = (slot + 1) & (size_t) (t->slots_capacity - 1);
+  }
+  return -1;
+}
+
+static void analyze_vars(struct TRANSPILER* t)
+{
+  //
+  // where is each variable assigned and read?
+  //
+  for (int pos = 0; pos < t->num_stmts && !t->out_of_memory; pos++) {
+    struct STMT* stmt = t->order[pos];
+
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct VALUE* rhs = stmt->types.assignment->rhs;
+
+      if (rhs->value_type == VALUE_FUNCTION_CALL) {
+        struct FUNCTION_CALL* call = rhs->types.function_call;
+        if (call->parameter != NULL && strcmp(call->function_name, "input") != 0)
+          note_use(t, call->parameter, pos, true);
+      }
+      else {
+        note_use(t, rhs->types.expr->lhs->element, pos, false);
+        if (rhs->types.expr->isBinaryExpr && rhs->types.expr->rhs != NULL)
+          note_use(t, rhs->types.expr->rhs->element, pos, false);
+      }
+
+      int v = var_index(t, stmt->types.assignment->var_name);
+      if (v >= 0 && t->vars[v].first_def < 0) {
+        t->vars[v].first_def = pos;
+        // only a first assignment outside any loop is sure to run
+        // before everything after it
+        t->vars[v].typed = t->on_chain[pos];
+      }
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      if (stmt->types.function_call->parameter != NULL)
+        note_use(t, stmt->types.function_call->parameter, pos, false);
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP || stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      struct EXPR* condition = (stmt->stmt_type == STMT_WHILE_LOOP)
+        ? stmt->types.while_loop->condition : stmt->types.if_then_else->condition;
+
+      note_use(t, condition->lhs->element, pos, false);
+      if (condition->isBinaryExpr && condition->rhs != NULL)
+        note_use(t, condition->rhs->element, pos, false);
+    }
+  }
+
+  for (int i = 0; i < t->num_vars; i++) {
+    struct TP_VAR* var = &t->vars[i];
+    if (t->has_if || var->by_name || var->first_use <= var->first_def)
+      var->typed = false;
+  }
+
+  //
+  // drop variables that are assigned something other than an int,
+  // until nothing changes (dropping one can drop others):
+  //
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (int pos = 0; pos < t->num_stmts; pos++) {
+      struct STMT* stmt = t->order[pos];
+      if (stmt->stmt_type != STMT_ASSIGNMENT)
+        continue;
+
+      int v = var_index(t, stmt->types.assignment->var_name);
+      if (v >= 0 && t->vars[v].typed && !is_int_value(t, stmt->types.assignment->rhs)) {
+        t->vars[v].typed = false;
+        changed = true;
+      }
+    }
+  }
+}
+
+static int var_index(struct TRANSPILER* t, char* name)
+{
+  for (int i = 0; i < t->num_vars; i++) {
+    if (strcmp(t->vars[i].name, name) == 0)
+      return i;
+  }
+
+  if (t->num_vars == t->vars_capacity) {
+    int capacity = (t->vars_capacity == 0) ? 16 : 2 * t->vars_capacity;
+    struct TP_VAR* vars = (struct TP_VAR*) realloc(t->vars, capacity * sizeof(struct TP_VAR));
+    if (vars == NULL) {
+      t->out_of_memory = true;
+      return -1;
+    }
+    t->vars = vars;
+    t->vars_capacity = capacity;
+  }
+
+  struct TP_VAR* var = &t->vars[t->num_vars];
+  var->name = name;
+  var->first_def = -1;
+  var->first_use = INT_MAX;
+  var->by_name = false;
+  var->typed = false;
+
+  return t->num_vars++;
+}
+
+static void note_use(struct TRANSPILER* t, struct ELEMENT* element, int pos, bool by_name)
+{
+  if (element->element_type != ELEMENT_IDENTIFIER)
+    return;
+
+  int v = var_index(t, element->element_value);
+  if (v < 0)
+    return;
+
+  if (pos < t->vars[v].first_use)
+    t->vars[v].first_use = pos;
+  if (by_name)
+    t->vars[v].by_name = true;
+}
+
+static bool is_int_element(struct TRANSPILER* t, struct ELEMENT* element)
+{
+  if (element->element_type == ELEMENT_INT_LITERAL)
+    return true;
+
+  if (element->element_type == ELEMENT_IDENTIFIER) {
+    int v = var_index(t, element->element_value);
+    return v >= 0 && t->vars[v].typed;
+  }
+  return false;
+}
+
+static bool is_int_value(struct TRANSPILER* t, struct VALUE* value)
+{
+  if (value->value_type == VALUE_FUNCTION_CALL)
+    return strcmp(value->types.function_call->function_name, "int") == 0;
+
+  struct EXPR* expr = value->types.expr;
+
+  if (!expr->isBinaryExpr)
+    return is_int_element(t, expr->lhs->element);
+
+  if (expr->rhs == NULL || !is_int_element(t, expr->lhs->element) || !is_int_element(t, expr->rhs->element))
+    return false;
+
+  // arithmetic only, comparisons produce booleans:
+  return expr->operator == OPERATOR_PLUS || expr->operator == OPERATOR_MINUS ||
+    expr->operator == OPERATOR_ASTERISK || expr->operator == OPERATOR_POWER ||
+    expr->operator == OPERATOR_MOD || expr->operator == OPERATOR_DIV;
+}
+
+static void int_operand(struct TRANSPILER* t, struct ELEMENT* element, char* buf)
+{
+  if (element->element_type == ELEMENT_IDENTIFIER) {
+    sprintf(buf, "v%d", var_index(t, element->element_value));
+    return;
+  }
+
+  int i = atoi(element->element_value);  // as execute() converts it
+  if (i == INT_MIN)
+    sprintf(buf, "(-%d - 1)", INT_MAX);
+  else
+    sprintf(buf, "%d", i);
+}
+
+static void int_binary(struct TRANSPILER* t, struct EXPR* expr, int line, char* buf)
+{
+  char lhs[32];
+  char rhs[32];
+
+  int_operand(t, expr->lhs->element, lhs);
+  int_operand(t, expr->rhs->element, rhs);
+
+  if (expr->operator == OPERATOR_DIV || expr->operator == OPERATOR_MOD) {
+    bool literal = expr->rhs->element->element_type == ELEMENT_INT_LITERAL;
+
+    if (literal && atoi(expr->rhs->element->element_value) == 0) {
+      //
+      // always fails, and x / 0 would not compile:
+      //
+      fprintf(t->out, "  output_printf(out, \"**ZeroDivisionError: division by zero (line %d)\\n\");\n", line);
+      fprintf(t->out, "  goto failed;\n");
+      t->failed_used = true;
+      strcpy(buf, "0");
+      return;
+    }
+    if (!literal) {
+      fprintf(t->out, "  if (%s == 0) {\n", rhs);
+      fprintf(t->out, "    output_printf(out, \"**ZeroDivisionError: division by zero (line %d)\\n\");\n", line);
+      fprintf(t->out, "    goto failed;\n  }\n");
+      t->failed_used = true;
+    }
+  }
+
+  //
+  // + - * wrap around as execute() does; in unsigned arithmetic
+  // that is defined, and literals don't overflow when folded:
+  //
+  if (expr->operator == OPERATOR_POWER)
+    sprintf(buf, "execute_int_power(%s, %s)", lhs, rhs);
+  else if (expr->operator == OPERATOR_PLUS || expr->operator == OPERATOR_MINUS || expr->operator == OPERATOR_ASTERISK)
+    sprintf(buf, "(int) ((unsigned int) %s %s (unsigned int) %s)", lhs, IntOperators[expr->operator], rhs);
+  else
+    sprintf(buf, "%s %s %s", lhs, IntOperators[expr->operator], rhs);
+}
+
+static void emit_load(struct TRANSPILER* t, struct ELEMENT* element, const char* dest, int line)
+{
+  FILE* out = t->out;
+  char* value = element->element_value;
+
+  switch (element->element_type)
+  {
+  case ELEMENT_IDENTIFIER: {
+    int v = var_index(t, value);
+
+    if (t->vars[v].typed) {
+      fprintf(out, "  %s.value_type = RAM_TYPE_INT;\n  %s.types.i = v%d;\n", dest, dest, v);
+    }
+    else {
+      fprintf(out, "  if (!load(memory, &addr%d, ", v);
+      emit_string(t, value);
+      fprintf(out, ", %d, &%s))\n    goto failed;\n", line, dest);
+      t->failed_used = true;
+    }
+    break;
+  }
+
+  case ELEMENT_INT_LITERAL: {
+    char buf[32];
+    int_operand(t, element, buf);
+    fprintf(out, "  %s.value_type = RAM_TYPE_INT;\n  %s.types.i = %s;\n", dest, dest, buf);
+    break;
+  }
+
+  case ELEMENT_REAL_LITERAL:
+    fprintf(out, "  %s.value_type = RAM_TYPE_REAL;\n  %s.types.d = ", dest, dest);
+    emit_real(t, atof(value));
+    fprintf(out, ";\n");
+    break;
+
+  case ELEMENT_STR_LITERAL:
+    fprintf(out, "  %s.value_type = RAM_TYPE_STR;\n  %s.types.s = ", dest, dest);
+    emit_string(t, value);
+    fprintf(out, ";\n");
+    break;
+
+  case ELEMENT_TRUE:
+  case ELEMENT_FALSE:
+    fprintf(out, "  %s.value_type = RAM_TYPE_BOOLEAN;\n  %s.types.i = %d;\n",
+            dest, dest, element->element_type == ELEMENT_TRUE);
+    break;
+
+  default: // None has no value, execution stops without a message
+    fprintf(out, "  goto failed;\n");
+    t->failed_used = true;
+    break;
+  }
+}
+
+static void emit_binary(struct TRANSPILER* t, struct EXPR* expr, int line)
+{
+  FILE* out = t->out;
+
+  if (expr->operator == OPERATOR_NO_OP || expr->rhs == NULL) {
+    fprintf(out, "  goto failed;\n");
+    t->failed_used = true;
+    return;
+  }
+
+  if (is_int_element(t, expr->lhs->element) && is_int_element(t, expr->rhs->element)
+      && (IntOperators[expr->operator] != NULL || expr->operator == OPERATOR_POWER)) {
+    char buf[96];
+    int_binary(t, expr, line, buf);
+
+    bool relational = expr->operator >= OPERATOR_EQUAL;
+    fprintf(out, "  result.value_type = %s;\n  result.types.i = %s;\n",
+            relational ? "RAM_TYPE_BOOLEAN" : "RAM_TYPE_INT", buf);
+    return;
+  }
+
+  emit_load(t, expr->lhs->element, "lhs", line);
+  emit_load(t, expr->rhs->element, "rhs", line);
+  fprintf(out, "  if (!execute_operator(lhs, rhs, %s, %d, &result))\n    goto failed;\n",
+          OperatorNames[expr->operator], line);
+  t->failed_used = true;
+}
+
+static void emit_stmt(struct TRANSPILER* t, int pos)
+{
+  struct STMT* stmt = t->order[pos];
+
+  if (t->targeted[pos])
+    fprintf(t->out, "s%d:\n", pos);
+
+  fprintf(t->out, "  // line %d\n", stmt->line);
+
+  if (stmt->stmt_type == STMT_ASSIGNMENT) {
+    emit_assignment(t, stmt, pos);
+    emit_goto(t, pos, stmt->types.assignment->next_stmt);
+  }
+  else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+    if (strcmp(stmt->types.function_call->function_name, "print") == 0) {
+      emit_print(t, stmt);
+      emit_goto(t, pos, stmt->types.function_call->next_stmt);
+    }
+    else { // execution stops without a message
+      fprintf(t->out, "  goto failed;\n");
+      t->failed_used = true;
+    }
+  }
+  else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    emit_while(t, stmt, pos);
+  }
+  else if (stmt->stmt_type == STMT_PASS) {
+    emit_goto(t, pos, stmt->types.pass->next_stmt);
+  }
+  else { // not supported by execute() either
+    fprintf(t->out, "  goto failed;\n");
+    t->failed_used = true;
+  }
+
+  fprintf(t->out, "\n");
+}
+
+static void emit_assignment(struct TRANSPILER* t, struct STMT* stmt, int pos)
+{
+  FILE* out = t->out;
+  struct STMT_ASSIGNMENT* assignment = stmt->types.assignment;
+  int v = var_index(t, assignment->var_name);
+  int line = stmt->line;
+
+  if (assignment->rhs->value_type == VALUE_FUNCTION_CALL) {
+    fprintf(out, "  if (!execute_call(&call%d, memory, %d, &result))\n    goto failed;\n", pos, line);
+    t->failed_used = true;
+
+    if (t->vars[v].typed) {
+      fprintf(out, "  v%d = result.types.i;\n", v);
+    }
+    else {
+      //
+      // input()'s line is handed to memory rather than copied:
+      //
+      fprintf(out, "  if (result.value_type == RAM_TYPE_STR)\n    ram_take_str_by_name(memory, result.types.s, (int) strlen(result.types.s), ");
+      emit_string(t, assignment->var_name);
+      fprintf(out, ");\n  else\n    store(memory, &addr%d, ", v);
+      emit_string(t, assignment->var_name);
+      fprintf(out, ", result);\n");
+    }
+  }
+  else {
+    struct EXPR* expr = assignment->rhs->types.expr;
+
+    if (t->vars[v].typed) {
+      if (expr->isBinaryExpr) {
+        char buf[96];
+        int_binary(t, expr, line, buf);
+        fprintf(out, "  v%d = %s;\n", v, buf);
+      }
+      else {
+        char buf[32];
+        int_operand(t, expr->lhs->element, buf);
+        fprintf(out, "  v%d = %s;\n", v, buf);
+      }
+    }
+    else if (!expr->isBinaryExpr) {
+      emit_load(t, expr->lhs->element, "result", line);
+      fprintf(out, "  store(memory, &addr%d, ", v);
+      emit_string(t, assignment->var_name);
+      fprintf(out, ", result);\n");
+    }
+    else {
+      bool self_append = expr->operator == OPERATOR_PLUS && expr->rhs != NULL
+        && expr->lhs->element->element_type == ELEMENT_IDENTIFIER
+        && strcmp(expr->lhs->element->element_value, assignment->var_name) == 0;
+
+      if (self_append) {
+        //
+        // s = s + t appends in place, as execute() does:
+        //
+        emit_load(t, expr->lhs->element, "lhs", line);
+        emit_load(t, expr->rhs->element, "rhs", line);
+        fprintf(out, "  if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) {\n");
+        fprintf(out, "    if (!ram_append_cell_by_addr(memory, rhs.types.s, addr%d))\n      goto failed;\n", v);
+        fprintf(out, "  }\n  else {\n");
+        fprintf(out, "    if (!execute_operator(lhs, rhs, OPERATOR_PLUS, %d, &result))\n      goto failed;\n", line);
+        fprintf(out, "    store(memory, &addr%d, ", v);
+        emit_string(t, assignment->var_name);
+        fprintf(out, ", result);\n  }\n");
+        t->failed_used = true;
+      }
+      else {
+        emit_binary(t, expr, line);
+        fprintf(out, "  store(memory, &addr%d, ", v);
+        emit_string(t, assignment->var_name);
+        fprintf(out, ", result);\n");
+        fprintf(out, "  if (result.value_type == RAM_TYPE_STR)\n    free(result.types.s);\n");
+      }
+    }
+  }
+
+  //
+  // a typed variable's cell is created where execute() would create
+  // it, so memory prints in the same order:
+  //
+  if (t->vars[v].typed && t->vars[v].first_def == pos) {
+    fprintf(out, "  store_int(memory, &addr%d, ", v);
+    emit_string(t, assignment->var_name);
+    fprintf(out, ", v%d);\n", v);
+  }
+}
+
+static void emit_print(struct TRANSPILER* t, struct STMT* stmt)
+{
+  FILE* out = t->out;
+  struct ELEMENT* parameter = stmt->types.function_call->parameter;
+
+  if (parameter == NULL) {
+    fprintf(out, "  output_write(out, \"\\n\", 1);\n");
+    return;
+  }
+
+  char* value = parameter->element_value;
+
+  if (parameter->element_type == ELEMENT_INT_LITERAL) {
+    char buf[32];
+    sprintf(buf, "%d", atoi(value));
+    fprintf(out, "  output_puts(out, \"%s\");\n", buf);
+  }
+  else if (parameter->element_type == ELEMENT_IDENTIFIER) {
+    int v = var_index(t, value);
+
+    if (t->vars[v].typed) {
+      fprintf(out, "  output_int(out, v%d);\n  output_write(out, \"\\n\", 1);\n", v);
+    }
+    else {
+      fprintf(out, "  if (!print_var(memory, &addr%d, ", v);
+      emit_string(t, value);
+      fprintf(out, ", %d, out))\n    goto failed;\n", stmt->line);
+      t->failed_used = true;
+    }
+  }
+  else if (parameter->element_type == ELEMENT_REAL_LITERAL) {
+    fprintf(out, "  output_real(out, ");
+    emit_real(t, atof(value));
+    fprintf(out, ");\n  output_write(out, \"\\n\", 1);\n");
+  }
+  else {
+    fprintf(out, "  output_puts(out, ");
+    emit_string(t, value);
+    fprintf(out, ");\n");
+  }
+}
+
+static void emit_while(struct TRANSPILER* t, struct STMT* stmt, int pos)
+{
+  FILE* out = t->out;
+  struct STMT_WHILE_LOOP* loop = stmt->types.while_loop;
+  struct EXPR* condition = loop->condition;
+  int line = stmt->line;
+
+  char exit[32];
+  if (loop->next_stmt == NULL) {
+    strcpy(exit, "completed");
+    t->completed_used = true;
+  }
+  else {
+    sprintf(exit, "s%d", stmt_pos(t, loop->next_stmt));
+  }
+
+  if (!condition->isBinaryExpr) {
+    if (is_int_element(t, condition->lhs->element)) {
+      char buf[32];
+      int_operand(t, condition->lhs->element, buf);
+      fprintf(out, "  if (%s == 0)\n    goto %s;\n", buf, exit);
+    }
+    else {
+      emit_load(t, condition->lhs->element, "result", line);
+      fprintf(out, "  if (result.types.i == 0)\n    goto %s;\n", exit);
+    }
+  }
+  else if (condition->rhs != NULL && condition->operator != OPERATOR_NO_OP
+           && is_int_element(t, condition->lhs->element) && is_int_element(t, condition->rhs->element)
+           && (IntOperators[condition->operator] != NULL || condition->operator == OPERATOR_POWER)) {
+    char buf[96];
+    int_binary(t, condition, line, buf);
+    fprintf(out, "  if (!(%s))\n    goto %s;\n", buf, exit);
+  }
+  else {
+    emit_binary(t, condition, line);
+    fprintf(out, "  if (result.value_type == RAM_TYPE_STR)\n    free(result.types.s);\n");
+    fprintf(out, "  if (result.types.i == 0)\n    goto %s;\n", exit);
+  }
+
+  if (loop->loop_body == NULL) { // empty body, test again
+    fprintf(out, "  goto s%d;\n", pos);
+    t->targeted[pos] = true;
+  }
+  else {
+    emit_goto(t, pos, loop->loop_body);
+  }
+}
+
+static void emit_goto(struct TRANSPILER* t, int pos, struct STMT* next)
+{
+  if (next == NULL) {
+    if (pos + 1 < t->num_stmts) {
+      fprintf(t->out, "  goto completed;\n");
+      t->completed_used = true;
+    }
+    return;
+  }
+
+  int target = stmt_pos(t, next);
+  if (target != pos + 1)
+    fprintf(t->out, "  goto s%d;\n", target);
+}
+
+static void emit_string(struct TRANSPILER* t, const char* s)
+{
+  if (s == NULL) {
+    fprintf(t->out, "NULL");
+    return;
+  }
+
+  fputc('"', t->out);
+  for (const unsigned char* p = (const unsigned char*) s; *p != '\0'; p++) {
+    if (*p == '"' || *p == '\\' || *p == '?')  // '?' => no trigraphs
+      fprintf(t->out, "\\%c", *p);
+    else if (*p < 32 || *p >= 127)
+      fprintf(t->out, "\\%03o", *p);
+    else
+      fputc(*p, t->out);
+  }
+  fputc('"', t->out);
+}
+
+static void emit_real(struct TRANSPILER* t, double d)
+{
+  if (isinf(d)) {
+    fprintf(t->out, "%sHUGE_VAL", (d < 0) ? "-" : "");
+    return;
+  }
+
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.17g", d);  // reads back exactly
+  if (strpbrk(buf, ".e") == NULL)
+    strcat(buf, ".0");
+  fprintf(t->out, "%s", buf);
+}
@@ -0,0 +1,38 @@
+/*transpile.h*/
+
+//
+// Translates a nuPython program graph into a standalone C program.
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>  // true, false
+
+#include "programgraph.h"
+
+
+//
+// Public functions:
+//
+
+//
+// transpile_program
+//
+// Writes a C translation of the given program graph, which must
+// be the graph built by programgraph_build() (i.e. not yet
+// optimized), to the given file. source_name is mentioned in a
+// comment at the top. Returns true if successful.
+//
+// The generated program links against execute.c, analyze.c, ram.c,
+// input.c, output.c and format.c, and prints exactly what compiler_out
+// prints for the same script (it also accepts --flush=, --repr and
+// --input-file). Each
+// statement becomes straight-line C joined by gotos; variables
+// find their memory cell once instead of on every use; literals
+// are converted at translation time. A variable that is provably
+// always an int (its first assignment runs before any use, and
+// every assignment produces an int) lives in a C local and is
+// written to memory when the program stops.
+//
+bool transpile_program(struct STMT* program, FILE* out, const char* source_name);
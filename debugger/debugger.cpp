@@ -3,17 +3,20 @@
 //
 // Debugger for nuPython, C++ edition! Provides a simple gdb-like
 // interface, with support for multiple breakpoints and step-by-step
-// execution of straight-line code. Uses nuPython interpreter as 
-// execution engine.
+// execution. Uses nuPython interpreter as execution engine, one
+// execute_step() at a time; the program graph is never modified.
 // Northwestern University
 // CS 211
 //
 
 #include <iostream>
-#include <cassert>
+#include <vector>
+#include <cstdlib>   // getenv
+#include <cstring>   // strcmp
 
 #include "debugger.h"
 #include "execute.h"
+#include "output.h"
 #include "programgraph.h"
 #include "tokenqueue.h"
 
@@ -58,127 +61,64 @@ void Debugger::printValue(string varname, struct RAM_VALUE* value)
 
 
 //
-// breakLink
-//
-// Breaks the link between the cur statement and the one 
-// that follows; returns a pointer to the statement that
-// follows before the link was broken.
-//
-// NOTE: with a while loop, we break both links.
-//
-struct STMT* Debugger::breakLink(struct STMT* cur)
-{
-  STMT* next = nullptr;
-  
-  if (cur == nullptr) // nothing to break:
-    return nullptr;
-  
-  if (cur->stmt_type == STMT_ASSIGNMENT) {
-    next = cur->types.assignment->next_stmt;
-    cur->types.assignment->next_stmt = nullptr;
-  }
-  else if (cur->stmt_type == STMT_FUNCTION_CALL) {
-    next = cur->types.function_call->next_stmt;
-    cur->types.function_call->next_stmt = nullptr;
-  }
-  else if (cur->stmt_type == STMT_PASS) {
-    next = cur->types.pass->next_stmt;
-    cur->types.pass->next_stmt = nullptr;
-  }
-  else if (cur->stmt_type == STMT_WHILE_LOOP){//Breaklink with next not loop body
-    next = cur->types.while_loop->next_stmt;
-    cur->types.while_loop->next_stmt = nullptr;
-  }
-  else { // unexpected stmt type:
-    cout << "**ERROR" << endl;
-    cout << "**ERROR: unexpected stmt type in breakLink" << endl;
-    cout << "**ERROR" << endl;
-    assert(false);
-  }
-  
-  return next;
-}
-
-
-//
-// restoreLink
-//
-// Restores the link between the cur statement and the one 
-// that follows.
-//
-void Debugger::restoreLink(struct STMT* cur, struct STMT* next)
-{
-  if (cur == nullptr) // nothing to restore:
-    return;
-  
-  if (cur->stmt_type == STMT_ASSIGNMENT) {
-    cur->types.assignment->next_stmt = next;
-  }
-  else if (cur->stmt_type == STMT_FUNCTION_CALL) {
-    cur->types.function_call->next_stmt = next;
-  }
-  else if (cur->stmt_type == STMT_PASS) {
-    cur->types.pass->next_stmt = next;
-  }
-  else if (cur->stmt_type == STMT_WHILE_LOOP){
-    cur->types.while_loop->next_stmt = next;
-  }
-  else { // unexpected stmt type:
-    cout << "**ERROR" << endl;
-    cout << "**ERROR: unexpected stmt type in restoreLink" << endl;
-    cout << "**ERROR" << endl;
-    assert(false);
-  }
-  
-  return;
-}
-
-//
-//Find the length of the program (Number of nodes)
+//Find the lines of the program that hold a stmt
 //
 void Debugger::programLength()
 {
+  unordered_set<struct STMT*> visited;
+  vector<struct STMT*> pending;
+  pending.push_back(this->Program);
+
+  while (!pending.empty()) { //Go through the whole program nodes
+    struct STMT* stmt = pending.back();
+    pending.pop_back();
 
-  struct STMT* stmt = this->Program;
-  while(stmt != nullptr){//Go through the whole program nodes
+    if (stmt == nullptr || visited.count(stmt) > 0) //End of a path or loop back
+      continue;
+    visited.insert(stmt);
+    StatementLines.emplace(stmt->line); //Emplace line int
 
     if (stmt->stmt_type == STMT_ASSIGNMENT) {
-      StatementLines.emplace(stmt->line); //Emplace line int
-      stmt = stmt->types.assignment->next_stmt;
+      pending.push_back(stmt->types.assignment->next_stmt);
     }
     else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
-      StatementLines.emplace(stmt->line);
-      stmt = stmt->types.function_call->next_stmt;
+      pending.push_back(stmt->types.function_call->next_stmt);
     }
     else if (stmt->stmt_type == STMT_PASS) {
-      StatementLines.emplace(stmt->line);
-      stmt = stmt->types.pass->next_stmt;
-    }    
+      pending.push_back(stmt->types.pass->next_stmt);
+    }
     else if (stmt->stmt_type == STMT_WHILE_LOOP) {
-      auto iter = this->StatementLines.find(stmt->line);//Have we gone through this node
-      if(iter == StatementLines.end()){//If we havent emplace the line number
-        StatementLines.emplace(stmt->line);
-        stmt = stmt->types.while_loop->loop_body; //Go through the body
-      }
-      else{//If we have go through the next stmts
-        stmt = stmt->types.while_loop->next_stmt; 
-      } 
-    }    
-    else { // unexpected stmt type:
-    cout << "**ERROR" << endl;
-    cout << "**ERROR: unexpected stmt type in restoreLink" << endl;
-    cout << "**ERROR" << endl;
-    assert(false);
+      pending.push_back(stmt->types.while_loop->next_stmt);
+      pending.push_back(stmt->types.while_loop->loop_body); //Go through the body
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      pending.push_back(stmt->types.if_then_else->false_path);
+      pending.push_back(stmt->types.if_then_else->true_path);
     }
   }//while
 }
 //
 // constructor:
 //
+// Setting NUPY_PHASE_STATS (to "table" or "json") times the
+// execution and teardown phases like compiler_out --phase-stats;
+// parsing happens before the debugger exists.
+//
 Debugger::Debugger(struct STMT* program)
-  : State("Loaded"), Program(program), Memory(nullptr)
+  : State("Loaded"), Program(program), Memory(nullptr), Phases(nullptr), PhasesJson(false)
 {
+  const char* phases = getenv("NUPY_PHASE_STATS");
+  if (phases != nullptr && phases[0] != '\0') {
+    this->Phases = phase_create();
+    this->PhasesJson = (strcmp(phases, "json") == 0);
+  }
+
   this->Memory = ram_init();
+
+  //
+  // program output interleaves with ours, write it line by line:
+  //
+  output_set_policy(output_current(), OUTPUT_FLUSH_LINE);
 }
 
 
@@ -187,7 +127,12 @@ Debugger::Debugger(struct STMT* program)
 //
 Debugger::~Debugger()
 {
+  phase_begin(this->Phases, "teardown");
   ram_destroy(this->Memory);
+  phase_end(this->Phases);
+
+  phase_print(this->Phases, stderr, this->PhasesJson);
+  phase_destroy(this->Phases);
 }
 
 
@@ -199,19 +144,12 @@ Debugger::~Debugger()
 void Debugger::run()
 {
   string cmd;
-  programLength(); //Find the length before breaking
+  programLength(); //Find the lines with stmts for breakpoints
 
   //
   // controls where we start execution from:
   //
   struct STMT* curStmt = this->Program;
-  
-  //
-  // we're going to execute stmt-by-stmt, so we have to break
-  // the program graph so that if we run the program, we just
-  // run the first stmt:
-  //
-  struct STMT* nextStmt = breakLink(curStmt);
 
 
   //
@@ -259,6 +197,8 @@ void Debugger::run()
       //
       // execute current stmt via nuPython interpreter:
       //
+      phase_begin(this->Phases, "execute");
+
       while (curStmt != nullptr) {
         //
         //Check for breakpoint
@@ -273,54 +213,22 @@ void Debugger::run()
           iter->second = false; //Clear for the while loop
         }
 
-        if (curStmt->stmt_type == STMT_WHILE_LOOP){
-          //
-          //Execute While Loop Statement
-          //
-          struct RAM_VALUE* value = execute_expr(curStmt, this->Memory, curStmt->types.while_loop->condition);
-          
-          if (value == nullptr) { // there was an error, we've complete execution:
-            this->State = "Completed";
-            // we need to repair the program graph:
-            restoreLink(curStmt, nextStmt);
-            break;
-          }
-          restoreLink(curStmt, nextStmt);
-          if(value->types.i == 1){//Statement in while loop is true
-            curStmt = curStmt->types.while_loop->loop_body;
-            nextStmt = breakLink(curStmt);
-          }
-          else{
-            curStmt = nextStmt;
-            nextStmt = breakLink(curStmt);
-          }
-          ram_free_value(value);
-        }
-        else{
         // 
-        // execute this line:
+        // execute this stmt, the engine tells us what comes next:
         //
-          struct ExecuteResult er = execute(curStmt, this->Memory);
-        
-          //
-          // what happened during execution?
-          //
-          if (!er.Success) { // there was an error, we've complete execution:
-            this->State = "Completed";
-            
-            // we need to repair the program graph:
-            restoreLink(curStmt, nextStmt);
-            
-            break;
-          }
-          //
-          // advance one stmt:
-          //
-          restoreLink(curStmt, nextStmt);
-          
-          curStmt = nextStmt;
-          nextStmt = breakLink(curStmt);
+        bool success;
+        struct STMT* nextStmt = execute_step(curStmt, this->Memory, &success);
+
+        if (!success) { // there was an error, we've complete execution:
+          this->State = "Completed";
+          break;
         }
+
+        //
+        // advance one stmt:
+        //
+        curStmt = nextStmt;
+
         // 
         // are we stepping? if so, exit loop:
         //
@@ -328,7 +236,11 @@ void Debugger::run()
           break;
         
       }//while
+
+      phase_end(this->Phases); // not the time spent at the prompt
       
+      output_flush(output_current()); // program output before our prompt
+
       //
       // loop has ended, why? There are 3 cases:
       //   1. hit a breakpoint or we stepped once
@@ -337,7 +249,6 @@ void Debugger::run()
       //
       if (curStmt == nullptr) {  // we ran to completion:
         this->State = "Completed";
-        // program graph is fine since we ran to the end
       }
       else if (this->State == "Completed") {  // semantic error
         //
@@ -419,6 +330,7 @@ void Debugger::run()
     }
     else if (cmd == "sm") {
       
+      fflush(stdout); // ram_print bypasses stdio
       ram_print(this->Memory);
     }
     else if (cmd == "ss") {
@@ -446,13 +358,5 @@ void Debugger::run()
     
   }//while
   
-  //
-  // at this point execution has completed (or the user quit
-  // early). Repair the program graph if need be:
-  //
-  if (curStmt != nullptr) {
-    restoreLink(curStmt, nextStmt);
-  }
-  
 }//run
 
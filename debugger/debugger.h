@@ -17,6 +17,7 @@
 
 #include "programgraph.h"
 #include "ram.h"
+#include "phase.h"
 
 using namespace std;
 
@@ -28,11 +29,11 @@ private:
   unordered_set<int> StatementLines; //stores the lines where there are stmts
   struct STMT* Program;
   struct RAM*  Memory;
+  struct PHASE_STATS* Phases; // NULL unless NUPY_PHASE_STATS is set
+  bool PhasesJson;
   
   void printValue(string varname, struct RAM_VALUE* value);
   struct STMT* findStmt(struct STMT* cur, int lineNum);
-  struct STMT* breakLink(struct STMT* cur);
-  void restoreLink(struct STMT* cur, struct STMT* next);
   void programLength();
 
   
@@ -0,0 +1,27 @@
+#
+# test07.py
+#
+# a nuPython program of while loops with loop-invariant assignments
+#
+print("")
+print("TEST CASE: test07.py")
+print("")
+
+n = 4
+i = 0
+s = "a"
+while i < n:
+{
+  print(i)
+  limit = n * 2    # 8, same every iteration
+  t = "x" + "y"    # 'xy', same every iteration
+  s = s + t
+  i = i + 1
+}
+
+print(limit)
+print(s)
+
+print("")
+print("DONE")
+print("")
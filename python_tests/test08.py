@@ -0,0 +1,129 @@
+#
+# test08.py
+#
+# a nuPython program of deeply nested while loops, each with a
+# loop-invariant assignment; optimizing it must not take time or
+# memory exponential in the nesting depth
+#
+print("")
+print("TEST CASE: test08.py")
+print("")
+
+total = 0
+i1 = 0
+while i1 < 2:
+{
+  k1 = 1 * 2
+  i2 = 0
+  while i2 < 2:
+  {
+    k2 = 2 * 2
+    i3 = 0
+    while i3 < 2:
+    {
+      k3 = 3 * 2
+      i4 = 0
+      while i4 < 2:
+      {
+        k4 = 4 * 2
+        i5 = 0
+        while i5 < 2:
+        {
+          k5 = 5 * 2
+          i6 = 0
+          while i6 < 2:
+          {
+            k6 = 6 * 2
+            i7 = 0
+            while i7 < 2:
+            {
+              k7 = 7 * 2
+              i8 = 0
+              while i8 < 2:
+              {
+                k8 = 8 * 2
+                i9 = 0
+                while i9 < 2:
+                {
+                  k9 = 9 * 2
+                  i10 = 0
+                  while i10 < 2:
+                  {
+                    k10 = 10 * 2
+                    i11 = 0
+                    while i11 < 2:
+                    {
+                      k11 = 11 * 2
+                      i12 = 0
+                      while i12 < 2:
+                      {
+                        k12 = 12 * 2
+                        i13 = 0
+                        while i13 < 2:
+                        {
+                          k13 = 13 * 2
+                          i14 = 0
+                          while i14 < 2:
+                          {
+                            k14 = 14 * 2
+                            i15 = 0
+                            while i15 < 2:
+                            {
+                              k15 = 15 * 2
+                              i16 = 0
+                              while i16 < 2:
+                              {
+                                k16 = 16 * 2
+                                i17 = 0
+                                while i17 < 2:
+                                {
+                                  k17 = 17 * 2
+                                  i18 = 0
+                                  while i18 < 2:
+                                  {
+                                    k18 = 18 * 2
+                                    total = total + 1
+                                    i18 = i18 + 1
+                                  }
+                                  i17 = i17 + 1
+                                }
+                                i16 = i16 + 1
+                              }
+                              i15 = i15 + 1
+                            }
+                            i14 = i14 + 1
+                          }
+                          i13 = i13 + 1
+                        }
+                        i12 = i12 + 1
+                      }
+                      i11 = i11 + 1
+                    }
+                    i10 = i10 + 1
+                  }
+                  i9 = i9 + 1
+                }
+                i8 = i8 + 1
+              }
+              i7 = i7 + 1
+            }
+            i6 = i6 + 1
+          }
+          i5 = i5 + 1
+        }
+        i4 = i4 + 1
+      }
+      i3 = i3 + 1
+    }
+    i2 = i2 + 1
+  }
+  i1 = i1 + 1
+}
+
+print(total)
+print(k1)
+print(k18)
+
+print("")
+print("DONE")
+print("")
@@ -0,0 +1,266 @@
+/*graph_tests.c*/
+
+//
+// Tests of the optimizer passes that programgraph_build() can't
+// produce input for yet, e.g. if/elif chains, on program graphs
+// built by hand. Built as C, since programgraph.h names a field
+// "operator" and so can't be included by the C++ tests in tests.c.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "programgraph.h"
+#include "ram.h"
+#include "execute.h"
+#include "optimize.h"
+
+
+//
+// Every node a test allocates, freed by free_nodes():
+//
+static void* Nodes[256];
+static int   NumNodes = 0;
+
+static int NumChecks = 0;
+static int NumFailed = 0;
+
+#define CHECK(cond)                                              \
+  do {                                                           \
+    NumChecks++;                                                 \
+    if (!(cond)) {                                               \
+      NumFailed++;                                               \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    }                                                            \
+  } while (0)
+
+
+//
+// private helper functions:
+//
+
+static void* node(size_t size)
+{
+  void* p = calloc(1, size);
+  if (p == NULL || NumNodes == (int) (sizeof(Nodes) / sizeof(Nodes[0]))) {
+    printf("**OUT OF MEMORY (graph_tests)\n");
+    exit(1);
+  }
+  Nodes[NumNodes++] = p;
+  return p;
+}
+
+static void free_nodes(void)
+{
+  for (int i = 0; i < NumNodes; i++)
+    free(Nodes[i]);
+  NumNodes = 0;
+}
+
+static struct ELEMENT* element(int type, const char* value)
+{
+  struct ELEMENT* e = (struct ELEMENT*) node(sizeof(struct ELEMENT));
+  e->element_type = type;
+  e->element_value = (char*) node(strlen(value) + 1);
+  strcpy(e->element_value, value);
+  return e;
+}
+
+static struct UNARY_EXPR* unary(struct ELEMENT* e)
+{
+  struct UNARY_EXPR* u = (struct UNARY_EXPR*) node(sizeof(struct UNARY_EXPR));
+  u->expr_type = UNARY_ELEMENT;
+  u->element = e;
+  return u;
+}
+
+//
+// var = value, where value is an element of the given type:
+//
+static struct STMT* assign(int line, const char* var, int type, const char* value, struct STMT* next)
+{
+  struct STMT* stmt = (struct STMT*) node(sizeof(struct STMT));
+  struct STMT_ASSIGNMENT* assignment = (struct STMT_ASSIGNMENT*) node(sizeof(struct STMT_ASSIGNMENT));
+  struct VALUE* rhs = (struct VALUE*) node(sizeof(struct VALUE));
+  struct EXPR* expr = (struct EXPR*) node(sizeof(struct EXPR));
+
+  expr->lhs = unary(element(type, value));
+  rhs->value_type = VALUE_EXPR;
+  rhs->types.expr = expr;
+  assignment->var_name = element(ELEMENT_IDENTIFIER, var)->element_value;
+  assignment->rhs = rhs;
+  assignment->next_stmt = next;
+
+  stmt->stmt_type = STMT_ASSIGNMENT;
+  stmt->line = line;
+  stmt->types.assignment = assignment;
+  return stmt;
+}
+
+//
+// if var == value: then_path else: else_path
+//
+static struct STMT* if_equal(int line, const char* var, const char* value, struct STMT* then_path, struct STMT* else_path)
+{
+  struct STMT* stmt = (struct STMT*) node(sizeof(struct STMT));
+  struct STMT_IF_THEN_ELSE* if_then_else = (struct STMT_IF_THEN_ELSE*) node(sizeof(struct STMT_IF_THEN_ELSE));
+  struct EXPR* condition = (struct EXPR*) node(sizeof(struct EXPR));
+
+  condition->lhs = unary(element(ELEMENT_IDENTIFIER, var));
+  condition->isBinaryExpr = true;
+  condition->operator = OPERATOR_EQUAL;
+  condition->rhs = unary(element(ELEMENT_INT_LITERAL, value));
+  if_then_else->condition = condition;
+  if_then_else->true_path = then_path;
+  if_then_else->false_path = else_path;
+
+  stmt->stmt_type = STMT_IF_THEN_ELSE;
+  stmt->line = line;
+  stmt->types.if_then_else = if_then_else;
+  return stmt;
+}
+
+//
+// Builds
+//
+//   x = <x_type> x_value
+//   if x == cases[0]: y = 10
+//   elif x == cases[1]: y = 20
+//   ...
+//   else: y = 0
+//   z = 1
+//
+// and returns the program; *chain is set to the first if.
+//
+static struct STMT* chain_program(int x_type, const char* x_value, const char* cases[], int num_cases, struct STMT** chain)
+{
+  struct STMT* after = assign(num_cases + 4, "z", ELEMENT_INT_LITERAL, "1", NULL);
+  struct STMT* head = assign(num_cases + 3, "y", ELEMENT_INT_LITERAL, "0", after);
+
+  for (int i = num_cases - 1; i >= 0; i--) {
+    char y[16];
+    snprintf(y, sizeof(y), "%d", 10 * (i + 1));
+    head = if_equal(i + 2, "x", cases[i], assign(i + 2, "y", ELEMENT_INT_LITERAL, y, after), head);
+  }
+
+  *chain = head;
+  return assign(1, "x", x_type, x_value, head);
+}
+
+//
+// Runs the program with fresh memory and returns the int in var,
+// -1 if var isn't an int:
+//
+static int run_for(struct STMT* program, const char* var)
+{
+  struct RAM* memory = ram_init();
+  execute(program, memory);
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, (char*) var);
+  int result = (value != NULL && value->value_type == RAM_TYPE_INT) ? value->types.i : -1;
+
+  ram_free_value(value);
+  ram_destroy(memory);
+  return result;
+}
+
+//
+// Lowers the chain for x = <x_type> x_value, runs it, and checks y
+// and z against the chain as written:
+//
+static void check_chain(int x_type, const char* x_value, const char* cases[], int num_cases, bool lowered, bool dense)
+{
+  struct STMT* chain;
+  struct STMT* program = chain_program(x_type, x_value, cases, num_cases, &chain);
+
+  int y = run_for(program, "y");
+
+  struct OPT_LOG* log = optimize_program(program);
+  CHECK((chain->stmt_type == STMT_SWITCH) == lowered);
+  if (lowered)
+    CHECK((OPT_SWITCH_OF(chain)->table != NULL) == dense);
+
+  CHECK(run_for(program, "y") == y);
+  CHECK(run_for(program, "z") == 1);
+
+  optimize_restore(log);
+  CHECK(chain->stmt_type == STMT_IF_THEN_ELSE);
+  CHECK(run_for(program, "y") == y);
+
+  free_nodes();
+}
+
+
+//
+// the tests:
+//
+
+static void switch_dense(void)
+{
+  const char* cases[] = { "1", "2", "3", "2" };  // the first 2 wins
+
+  for (int x = 0; x <= 4; x++) {
+    char value[16];
+    snprintf(value, sizeof(value), "%d", x);
+    check_chain(ELEMENT_INT_LITERAL, value, cases, 4, true, true);
+  }
+
+  struct STMT* chain;
+  struct STMT* program = chain_program(ELEMENT_INT_LITERAL, "2", cases, 4, &chain);
+  struct OPT_LOG* log = optimize_program(program);
+
+  CHECK(chain->stmt_type == STMT_SWITCH);
+  CHECK(OPT_SWITCH_OF(chain)->count == 3);
+  CHECK(run_for(program, "y") == 20);
+
+  optimize_restore(log);
+  free_nodes();
+}
+
+static void switch_sparse(void)
+{
+  const char* cases[] = { "1000", "-70000", "5" };
+  const char* values[] = { "1000", "-70000", "5", "6", "0" };
+
+  for (int i = 0; i < 5; i++)
+    check_chain(ELEMENT_INT_LITERAL, values[i], cases, 3, true, false);
+}
+
+static void switch_not_int(void)
+{
+  const char* cases[] = { "1", "2", "3" };
+
+  //
+  // reals compare as the chain is written, 2.0 == 2:
+  //
+  check_chain(ELEMENT_REAL_LITERAL, "2.0", cases, 3, true, true);
+  check_chain(ELEMENT_REAL_LITERAL, "2.5", cases, 3, true, true);
+}
+
+static void switch_short_chain(void)
+{
+  const char* cases[] = { "1", "2" };
+
+  check_chain(ELEMENT_INT_LITERAL, "2", cases, 2, false, false);
+}
+
+
+//
+// main
+//
+int main(void)
+{
+  switch_dense();
+  switch_sparse();
+  switch_not_int();
+  switch_short_chain();
+
+  if (NumFailed > 0) {
+    printf("[  FAILED  ] graph_tests: %d of %d checks\n", NumFailed, NumChecks);
+    return 1;
+  }
+
+  printf("[  PASSED  ] graph_tests: %d checks\n", NumChecks);
+  return 0;
+}
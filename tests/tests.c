@@ -9,8 +9,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>    // isinf, isnan, INFINITY
+#include <float.h>   // DBL_MAX, DBL_MIN
 
 #include "ram.h"
+#include "format.h"
 #include "gtest/gtest.h"
 
 //
@@ -203,4 +206,245 @@ TEST(memory_module, initialize_new_array) {
     }
 
     ram_destroy(memory);
-}
\ No newline at end of file
+}
+
+TEST(memory_module, peek_does_not_copy) {
+    struct RAM* memory = ram_init();
+
+    struct RAM_VALUE val;
+    val.value_type = RAM_TYPE_STR;
+    val.types.s = (char*) "cat";
+    ASSERT_TRUE(ram_write_cell_by_name(memory, val, (char*) "x"));
+
+    struct RAM_VALUE* peeked = ram_peek_cell_by_name(memory, (char*) "x");
+    ASSERT_TRUE(peeked != NULL);
+    ASSERT_EQ(peeked, &memory->cells[0].value); // the cell itself
+    ASSERT_STREQ(peeked->types.s, "cat");
+
+    ASSERT_TRUE(ram_peek_cell_by_name(memory, (char*) "y") == NULL);
+    ASSERT_TRUE(ram_peek_cell_by_addr(memory, 1) == NULL);
+
+    //
+    // writing a cell's own string back to it must not read freed memory:
+    //
+    ASSERT_TRUE(ram_write_cell_by_addr(memory, *peeked, 0));
+    ASSERT_STREQ(memory->cells[0].value.types.s, "cat");
+
+    ram_destroy(memory);
+}
+
+TEST(memory_module, append_in_place) {
+    struct RAM* memory = ram_init();
+
+    struct RAM_VALUE val;
+    val.value_type = RAM_TYPE_STR;
+    val.types.s = (char*) "ab";
+    ASSERT_TRUE(ram_write_cell_by_name(memory, val, (char*) "s"));
+
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(ram_append_cell_by_addr(memory, (char*) "xyz", 0));
+    }
+    ASSERT_EQ(memory->cells[0].str_length, 2 + 3 * 1000);
+    ASSERT_EQ((int) strlen(memory->cells[0].value.types.s), 2 + 3 * 1000);
+    ASSERT_GE(memory->cells[0].str_capacity, memory->cells[0].str_length + 1);
+    ASSERT_EQ(strncmp(memory->cells[0].value.types.s, "abxyzxyz", 8), 0);
+
+    //
+    // s = s + s, suffix points into the buffer being grown:
+    //
+    val.types.s = (char*) "ab";
+    ASSERT_TRUE(ram_write_cell_by_addr(memory, val, 0));
+    ASSERT_TRUE(ram_append_cell_by_addr(memory, memory->cells[0].value.types.s, 0));
+    ASSERT_STREQ(memory->cells[0].value.types.s, "abab");
+
+    //
+    // only strings can be appended to:
+    //
+    val.value_type = RAM_TYPE_INT;
+    val.types.i = 1;
+    ASSERT_TRUE(ram_write_cell_by_name(memory, val, (char*) "n"));
+    ASSERT_FALSE(ram_append_cell_by_addr(memory, (char*) "x", 1));
+    ASSERT_FALSE(ram_append_cell_by_addr(memory, (char*) "x", 2));
+
+    ram_destroy(memory);
+}
+
+TEST(memory_module, typed_slots) {
+    struct RAM* memory = ram_init();
+    ASSERT_TRUE(ram_reserve_slots(memory, 2, 1));
+
+    struct RAM_VALUE val;
+    val.value_type = RAM_TYPE_STR;
+    val.types.s = (char*) "first";
+    ASSERT_TRUE(ram_write_cell_by_name(memory, val, (char*) "s"));
+
+    //
+    // binding creates the cell, then the slot is the value:
+    //
+    ASSERT_EQ(memory->int_cells[1], -1);
+    ASSERT_EQ(ram_bind_slot(memory, (char*) "n", RAM_TYPE_INT, 1), 1);
+    ASSERT_EQ(memory->int_cells[1], 1);
+    memory->ints[1] = 42;
+
+    struct RAM_VALUE* peeked = ram_peek_cell_by_name(memory, (char*) "n");
+    ASSERT_EQ(peeked->value_type, RAM_TYPE_INT);
+    ASSERT_EQ(peeked->types.i, 42);
+
+    struct RAM_VALUE* copy = ram_read_cell_by_addr(memory, 1);
+    ASSERT_EQ(copy->types.i, 42);
+    ram_free_value(copy);
+
+    //
+    // writes of the same type by name land in the slot:
+    //
+    val.value_type = RAM_TYPE_INT;
+    val.types.i = 7;
+    ASSERT_TRUE(ram_write_cell_by_name(memory, val, (char*) "n"));
+    ASSERT_EQ(memory->ints[1], 7);
+
+    ASSERT_EQ(ram_bind_slot(memory, (char*) "x", RAM_TYPE_REAL, 0), 2);
+    memory->reals[0] = 2.5;
+    ASSERT_EQ(ram_peek_cell_by_addr(memory, 2)->types.d, 2.5);
+
+    //
+    // another type unbinds, invalid slots are refused:
+    //
+    val.value_type = RAM_TYPE_STR;
+    val.types.s = (char*) "now a string";
+    ASSERT_TRUE(ram_write_cell_by_name(memory, val, (char*) "n"));
+    ASSERT_EQ(memory->int_cells[1], -1);
+    ASSERT_STREQ(ram_peek_cell_by_name(memory, (char*) "n")->types.s, "now a string");
+
+    ASSERT_EQ(ram_bind_slot(memory, (char*) "y", RAM_TYPE_INT, 2), -1);
+    ASSERT_EQ(ram_bind_slot(memory, (char*) "y", RAM_TYPE_STR, 0), -1);
+    ASSERT_EQ(memory->num_values, 3);
+
+    ram_destroy(memory);
+}
+
+TEST(format_module, parse_int) {
+    int value = 0;
+
+    //
+    // signs, whitespace and underscores as int() takes them:
+    //
+    ASSERT_EQ(format_parse_int("42", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 42);
+    ASSERT_EQ(format_parse_int("  -17\t\n", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, -17);
+    ASSERT_EQ(format_parse_int("+0", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 0);
+    ASSERT_EQ(format_parse_int(" -1_000 ", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, -1000);
+    ASSERT_EQ(format_parse_int("2147483647", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 2147483647);
+    ASSERT_EQ(format_parse_int("-2147483648", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, -2147483647 - 1);
+
+    //
+    // trailing garbage and malformed numbers are invalid:
+    //
+    ASSERT_EQ(format_parse_int("", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("   ", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("-", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("12abc", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("12 3", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("1.5", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("--1", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("- 1", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("1__0", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("_1", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_int("1_", &value), FORMAT_PARSE_INVALID);
+
+    //
+    // numbers that don't fit an int are out of range:
+    //
+    ASSERT_EQ(format_parse_int("2147483648", &value), FORMAT_PARSE_RANGE);
+    ASSERT_EQ(format_parse_int("-2147483649", &value), FORMAT_PARSE_RANGE);
+    ASSERT_EQ(format_parse_int("99999999999999999999999", &value), FORMAT_PARSE_RANGE);
+}
+
+TEST(format_module, parse_real) {
+    double value = 0.0;
+
+    ASSERT_EQ(format_parse_real("2.5", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 2.5);
+    ASSERT_EQ(format_parse_real("  -.5e3\n", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, -500.0);
+    ASSERT_EQ(format_parse_real("+1_000.25", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 1000.25);
+    ASSERT_EQ(format_parse_real("7", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 7.0);
+    ASSERT_EQ(format_parse_real("0.1", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 0.1);  // correctly rounded
+    ASSERT_EQ(format_parse_real("1e308", &value), FORMAT_PARSE_OK);
+    ASSERT_EQ(value, 1e308);
+    ASSERT_EQ(format_parse_real("-inf", &value), FORMAT_PARSE_OK);
+    ASSERT_TRUE(isinf(value) && value < 0);
+    ASSERT_EQ(format_parse_real(" nan ", &value), FORMAT_PARSE_OK);
+    ASSERT_TRUE(isnan(value));
+
+    ASSERT_EQ(format_parse_real("", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_real("abc", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_real("2.5x", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_real("1e", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_real(".", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_real("1 .5", &value), FORMAT_PARSE_INVALID);
+    ASSERT_EQ(format_parse_real("0x10", &value), FORMAT_PARSE_INVALID);
+
+    //
+    // too large for a double, inf as in Python:
+    //
+    ASSERT_EQ(format_parse_real("1e400", &value), FORMAT_PARSE_OK);
+    ASSERT_TRUE(isinf(value) && value > 0);
+    ASSERT_EQ(format_parse_real("-1_0e400", &value), FORMAT_PARSE_OK);
+    ASSERT_TRUE(isinf(value) && value < 0);
+}
+
+TEST(format_module, real_matches_printf) {
+    double values[] = {
+        0.0, -0.0, 0.5, 1.5, 2.5, -2.5, 0.0000005, 0.0000015, 0.0000025,
+        0.1, 0.9999995, 9.9999995, 123456789.123456789, 1e15, 9007199254740993.0,
+        1e308, -1e308, DBL_MAX, DBL_MIN, 5e-324, 2147483647.0, -1e-7,
+        INFINITY, -INFINITY
+    };
+    char buf[FORMAT_REAL_SIZE];
+    char expected[FORMAT_REAL_SIZE];
+
+    for (double d : values) {
+        snprintf(expected, sizeof(expected), "%f", d);
+        int n = format_real(buf, d);
+        ASSERT_STREQ(buf, expected) << "value " << d;
+        ASSERT_EQ(n, (int) strlen(expected));
+    }
+}
+
+TEST(format_module, real_repr) {
+    char buf[FORMAT_REAL_SIZE];
+
+    format_real_repr(buf, 3.14);
+    ASSERT_STREQ(buf, "3.14");
+    format_real_repr(buf, 100.0);
+    ASSERT_STREQ(buf, "100.0");
+    format_real_repr(buf, 0.00001);
+    ASSERT_STREQ(buf, "1e-05");
+    format_real_repr(buf, 1e16);
+    ASSERT_STREQ(buf, "1e+16");
+    format_real_repr(buf, 0.1 + 0.2);
+    ASSERT_STREQ(buf, "0.30000000000000004");
+    format_real_repr(buf, -0.0);
+    ASSERT_STREQ(buf, "-0.0");
+
+    //
+    // repr always reads back as the same value:
+    //
+    double values[] = {
+        0.1, 1.0 / 3.0, 2.0 / 3.0, 1e-300, 5e-324, DBL_MIN, DBL_MAX,
+        123456789.123456789, 9007199254740993.0, 1e22, 1e23, -4.35, 0.000123
+    };
+
+    for (double d : values) {
+        format_real_repr(buf, d);
+        ASSERT_EQ(strtod(buf, NULL), d) << "repr " << buf;
+    }
+}